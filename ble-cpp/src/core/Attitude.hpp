@@ -25,6 +25,7 @@
 
 #include <iostream>
 #include <vector>
+#include <cereal/cereal.hpp>
 
 namespace loc{
     
@@ -37,6 +38,7 @@ namespace loc{
         double yaw_;
         
     public:
+        Attitude() = default;
         Attitude(long timestamp, double pitch, double roll, double yaw);
         ~Attitude();
         
@@ -51,6 +53,14 @@ namespace loc{
         Attitude* yaw(double yaw);
         
         friend std::ostream& operator<<(std::ostream&os, const Attitude& att);
+        
+        template<class Archive>
+        void serialize(Archive& ar){
+            ar(CEREAL_NVP(timestamp_));
+            ar(CEREAL_NVP(pitch_));
+            ar(CEREAL_NVP(roll_));
+            ar(CEREAL_NVP(yaw_));
+        }
     };
     
     typedef std::vector<Attitude> Attitudes;
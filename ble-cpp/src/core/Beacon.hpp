@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <iostream>
 #include <vector>
+#include <cereal/cereal.hpp>
 
 namespace loc{
     
@@ -41,6 +42,7 @@ namespace loc{
         class Impl;
         
     public:
+        Beacon() = default;
         Beacon(int major, int minor, double rssi);
         ~Beacon();
         
@@ -67,6 +69,13 @@ namespace loc{
         static Beacons sortByRssi(const Beacons& beacons);
         
         friend std::ostream& operator<<(std::ostream&os, const Beacon& beacon);
+        
+        template<class Archive>
+        void serialize(Archive& ar){
+            ar(CEREAL_NVP(major_));
+            ar(CEREAL_NVP(minor_));
+            ar(CEREAL_NVP(rssi_));
+        }
     };
     
     // Beacons class
@@ -25,6 +25,8 @@
 
 #include <stdio.h>
 #include <memory>
+#include <limits>
+#include <cereal/cereal.hpp>
 
 namespace loc {
     
@@ -41,6 +43,7 @@ namespace loc {
     
     public:
         using Ptr = std::shared_ptr<Heading>;
+        Heading() = default;
         Heading(long timestamp, double magneticHeading, double trueHeading, double headingAccuracy);
         Heading(long timestamp, double magneticHeading, double trueHeading, double headingAccuracy, double x, double y, double z);
         ~Heading() = default;
@@ -60,6 +63,17 @@ namespace loc {
         double y() const;
         void z(double);
         double z() const;
+        
+        template<class Archive>
+        void serialize(Archive& ar){
+            ar(CEREAL_NVP(timestamp_));
+            ar(CEREAL_NVP(magneticHeading_));
+            ar(CEREAL_NVP(trueHeading_));
+            ar(CEREAL_NVP(headingAccuracy_));
+            ar(CEREAL_NVP(x_));
+            ar(CEREAL_NVP(y_));
+            ar(CEREAL_NVP(z_));
+        }
     };
     
     
@@ -71,6 +85,7 @@ namespace loc {
         
     public:
         using Ptr = std::shared_ptr<LocalHeading>;
+        LocalHeading() = default;
         LocalHeading(long timestamp, double orientation, double orientationDeviation);
         ~LocalHeading() = default;
         
@@ -80,6 +95,13 @@ namespace loc {
         double orientation() const;
         LocalHeading& orientationDeviation(double);
         double orientationDeviation() const;
+        
+        template<class Archive>
+        void serialize(Archive& ar){
+            ar(CEREAL_NVP(timestamp_));
+            ar(CEREAL_NVP(orientation_));
+            ar(CEREAL_NVP(orientationDeviation_));
+        }
     };
 }
 
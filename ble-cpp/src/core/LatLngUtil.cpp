@@ -21,10 +21,17 @@
  *******************************************************************************/
 #include "LatLngUtil.hpp"
 
+#include <boost/version.hpp>
+// vincenty formulas were moved to boost::geometry::formula in Boost 1.62
+#if BOOST_VERSION < 106200
 #include <boost/geometry/algorithms/detail/vincenty_direct.hpp>
+#include <boost/geometry/core/srs.hpp>
+#else
+#include <boost/geometry/formulas/vincenty_direct.hpp>
+#include <boost/geometry/formulas/vincenty_inverse.hpp>
+#endif
 #include <boost/geometry/util/promote_floating_point.hpp>
 #include <boost/geometry/util/select_calculation_type.hpp>
-#include <boost/geometry/core/srs.hpp>
 #include <boost/geometry/strategies/strategies.hpp>
 #include <boost/geometry/algorithms/assign.hpp>
 #include <boost/geometry/geometries/point.hpp>
@@ -52,7 +59,11 @@ namespace loc {
         typedef typename bg::promote_floating_point
         <typename bg::select_calculation_type<P, P, void>::type>::type calc_t;
         
+#if BOOST_VERSION < 106200
         typedef bg::detail::vincenty_inverse<calc_t, true, true> inverse_formula;
+#else
+        typedef bg::formula::vincenty_inverse<calc_t, true, true> inverse_formula;
+#endif
         typename inverse_formula::result_type
         result_i = inverse_formula::apply(anchor.latlng.lng * d2r,
                                           anchor.latlng.lat * d2r,
@@ -73,7 +84,11 @@ namespace loc {
         typedef typename bg::promote_floating_point
         <typename bg::select_calculation_type<P, P, void>::type>::type calc_t;
         
+#if BOOST_VERSION < 106200
         typedef bg::detail::vincenty_direct<calc_t> direct_formula;
+#else
+        typedef bg::formula::vincenty_direct<calc_t> direct_formula;
+#endif
         typename direct_formula::result_type
         result = direct_formula::apply(latlng.lng * d2r,
                                        latlng.lat * d2r,
@@ -24,6 +24,7 @@
 #define Location_hpp
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <cmath>
 
@@ -90,8 +90,20 @@ namespace loc {
         // for string stream
         static std::string header();
         friend std::ostream& operator<<(std::ostream&os, const Pose& pose);
+        
+        // serialization
+        template<class Archive>
+        void serialize(Archive& ar);
     };
     
+    template<class Archive>
+    void Pose::serialize(Archive& ar){
+        Location::serialize(ar);
+        ar(CEREAL_NVP(mOrientation));
+        ar(CEREAL_NVP(mVelocity));
+        ar(CEREAL_NVP(mNormalVelocity));
+    }
+    
     // Template functions
     template<class Tpose>
     Pose Pose::mean(const std::vector<Tpose>& poses){
@@ -41,6 +41,10 @@ namespace  loc {
         return rssiBias_;
     }
     
+    double State::rssiBiasVariance() const{
+        return rssiBiasVariance_;
+    }
+    
     double State::weight() const{
         return weight_;
     }
@@ -68,6 +72,11 @@ namespace  loc {
         return *this;
     }
     
+    State& State::rssiBiasVariance(double rssiBiasVariance){
+        rssiBiasVariance_ = rssiBiasVariance;
+        return *this;
+    }
+    
     State& State::weight(double weight){
         weight_ = weight;
         return *this;
@@ -202,4 +211,13 @@ namespace  loc {
         return maxRssiBias_;
     }
     
+    StateProperty& StateProperty::marginalizesRssiBias(bool marginalizesRssiBias){
+        marginalizesRssiBias_ = marginalizesRssiBias;
+        return *this;
+    }
+    
+    bool StateProperty::marginalizesRssiBias() const{
+        return marginalizesRssiBias_;
+    }
+    
 }
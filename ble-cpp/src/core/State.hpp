@@ -42,6 +42,9 @@ namespace loc{
         double weight_ = 1.0;
         double negativeLogLikelihood_;
         double mahalanobisDistance_;
+        // Variance of the Gaussian posterior of rssiBias when the bias is marginalized (rssiBias is its mean).
+        // 0 when rssiBias is sampled.
+        double rssiBiasVariance_ = 0;
         
     public:
         using Ptr = std::shared_ptr<State>;
@@ -53,12 +56,14 @@ namespace loc{
         double orientationBias() const;
         double orientationAlignment() const;
         double rssiBias() const;
+        double rssiBiasVariance() const;
         double weight() const;
         double negativeLogLikelihood() const;
         double mahalanobisDistance() const;
         State& orientationBias(double orientationBias);
         State& orientationAlignment(double orientationAlignment);
         State& rssiBias(double rssiBias);
+        State& rssiBiasVariance(double rssiBiasVariance);
         State& weight(double weight);
         State& negativeLogLikelihood(double negativeLogLikelihood);
         State& mahalanobisDistance(double mahalanobisDistance);
@@ -69,8 +74,24 @@ namespace loc{
         friend std::ostream& operator<<(std::ostream&os, const State& pose);
         
         std::string header() const;
+        
+        // serialization
+        template<class Archive>
+        void serialize(Archive& ar);
     };
     
+    template<class Archive>
+    void State::serialize(Archive& ar){
+        Pose::serialize(ar);
+        ar(CEREAL_NVP(orientationBias_));
+        ar(CEREAL_NVP(orientationAlignment_));
+        ar(CEREAL_NVP(rssiBias_));
+        ar(CEREAL_NVP(weight_));
+        ar(CEREAL_NVP(negativeLogLikelihood_));
+        ar(CEREAL_NVP(mahalanobisDistance_));
+        ar(CEREAL_NVP(rssiBiasVariance_));
+    }
+    
     class StateProperty{
         
         double meanRssiBias_ = 0.0; // [dBm/s]
@@ -81,6 +102,8 @@ namespace loc{
         double minRssiBias_ = -10;
         double maxRssiBias_ = 10;
         
+        bool marginalizesRssiBias_ = false;
+        
     public:
         using Ptr = std::shared_ptr<StateProperty>;
         
@@ -96,6 +119,10 @@ namespace loc{
         double minRssiBias() const;
         StateProperty& maxRssiBias(double maxRssiBias);
         double maxRssiBias() const;
+        // Rao-Blackwellised RSSI bias. States are initialized with the prior N(meanRssiBias, stdRssiBias^2) of
+        // the bias instead of samples from it and the observation model updates the posterior analytically.
+        StateProperty& marginalizesRssiBias(bool marginalizesRssiBias);
+        bool marginalizesRssiBias() const;
         
         
         template<class Archive>
@@ -110,10 +137,13 @@ namespace loc{
                 ar(CEREAL_NVP(minRssiBias_));
                 ar(CEREAL_NVP(maxRssiBias_));
             }
+            if (1 <= version) {
+                ar(CEREAL_NVP(marginalizesRssiBias_));
+            }
         }
     };
 }
 
 // assign version
-CEREAL_CLASS_VERSION(loc::StateProperty, 0);
+CEREAL_CLASS_VERSION(loc::StateProperty, 1);
 #endif /* State_hpp */
@@ -22,58 +22,362 @@
 
 #include "Status.hpp"
 #include "Location.hpp"
+#include <cmath>
+#include <algorithm>
 
 namespace loc{
     
+    StatesMoments StatesMoments::compute(const std::vector<State>& states){
+        StatesMoments m;
+        size_t n = states.size();
+        if(n==0){
+            return m;
+        }
+        
+        // Moments are accumulated around the first state to avoid cancellation.
+        const State& ref = states.at(0);
+        double x0 = ref.x(), y0 = ref.y(), z0 = ref.z(), f0 = ref.floor();
+        
+        double sw = 0, sww = 0;
+        double swx = 0, swy = 0, swz = 0, swf = 0;
+        double swxx = 0, swyy = 0, swxy = 0;
+        double sx = 0, sy = 0, sz = 0, sf = 0;
+        double sxx = 0, syy = 0, szz = 0, sff = 0, sxy = 0;
+        
+        for(const State& s: states){
+            double w = s.weight();
+            double dx = s.x() - x0;
+            double dy = s.y() - y0;
+            double dz = s.z() - z0;
+            double df = s.floor() - f0;
+            sw += w;
+            sww += w*w;
+            swx += w*dx;
+            swy += w*dy;
+            swz += w*dz;
+            swf += w*df;
+            swxx += w*dx*dx;
+            swyy += w*dy*dy;
+            swxy += w*dx*dy;
+            double c = std::cos(s.orientation());
+            double si = std::sin(s.orientation());
+            m.wVx_ += w*s.velocity()*c;
+            m.wVy_ += w*s.velocity()*si;
+            m.wVrepx_ += w*s.normalVelocity()*c;
+            m.wVrepy_ += w*s.normalVelocity()*si;
+            sx += dx;
+            sy += dy;
+            sz += dz;
+            sf += df;
+            sxx += dx*dx;
+            syy += dy*dy;
+            szz += dz*dz;
+            sff += df*df;
+            sxy += dx*dy;
+            m.rssiBiasSum_ += s.rssiBias();
+            m.orientationBiasCosSum_ += std::cos(s.orientationBias());
+            m.orientationBiasSinSum_ += std::sin(s.orientationBias());
+            m.floorWeights_[static_cast<int>(std::round(s.floor()))] += w;
+        }
+        
+        m.count_ = n;
+        m.weightSum_ = sw;
+        m.weightSquaredSum_ = sww;
+        
+        double mx = swx/sw, my = swy/sw, mz = swz/sw, mf = swf/sw;
+        m.wMeanX_ = x0 + mx;
+        m.wMeanY_ = y0 + my;
+        m.wMeanZ_ = z0 + mz;
+        m.wMeanFloor_ = f0 + mf;
+        m.wCxx_ = swxx - sw*mx*mx;
+        m.wCyy_ = swyy - sw*my*my;
+        m.wCxy_ = swxy - sw*mx*my;
+        
+        double ux = sx/n, uy = sy/n, uz = sz/n, uf = sf/n;
+        m.uMeanX_ = x0 + ux;
+        m.uMeanY_ = y0 + uy;
+        m.uMeanZ_ = z0 + uz;
+        m.uMeanFloor_ = f0 + uf;
+        m.uCxx_ = sxx - n*ux*ux;
+        m.uCyy_ = syy - n*uy*uy;
+        m.uCzz_ = szz - n*uz*uz;
+        m.uCff_ = sff - n*uf*uf;
+        m.uCxy_ = sxy - n*ux*uy;
+        
+        return m;
+    }
+    
+    StatesMoments& StatesMoments::operator+=(const StatesMoments& m){
+        if(m.count_==0){
+            return *this;
+        }
+        if(count_==0){
+            *this = m;
+            return *this;
+        }
+        // Pairwise update of the co-moments (Chan et al.)
+        double wa = weightSum_, wb = m.weightSum_, w = wa + wb;
+        double dx = m.wMeanX_ - wMeanX_;
+        double dy = m.wMeanY_ - wMeanY_;
+        double dz = m.wMeanZ_ - wMeanZ_;
+        double df = m.wMeanFloor_ - wMeanFloor_;
+        wCxx_ += m.wCxx_ + dx*dx*wa*wb/w;
+        wCyy_ += m.wCyy_ + dy*dy*wa*wb/w;
+        wCxy_ += m.wCxy_ + dx*dy*wa*wb/w;
+        wMeanX_ += dx*wb/w;
+        wMeanY_ += dy*wb/w;
+        wMeanZ_ += dz*wb/w;
+        wMeanFloor_ += df*wb/w;
+        
+        double na = count_, nb = m.count_, n = na + nb;
+        double ux = m.uMeanX_ - uMeanX_;
+        double uy = m.uMeanY_ - uMeanY_;
+        double uz = m.uMeanZ_ - uMeanZ_;
+        double uf = m.uMeanFloor_ - uMeanFloor_;
+        uCxx_ += m.uCxx_ + ux*ux*na*nb/n;
+        uCyy_ += m.uCyy_ + uy*uy*na*nb/n;
+        uCzz_ += m.uCzz_ + uz*uz*na*nb/n;
+        uCff_ += m.uCff_ + uf*uf*na*nb/n;
+        uCxy_ += m.uCxy_ + ux*uy*na*nb/n;
+        uMeanX_ += ux*nb/n;
+        uMeanY_ += uy*nb/n;
+        uMeanZ_ += uz*nb/n;
+        uMeanFloor_ += uf*nb/n;
+        
+        count_ = n;
+        weightSum_ = w;
+        weightSquaredSum_ += m.weightSquaredSum_;
+        wVx_ += m.wVx_;
+        wVy_ += m.wVy_;
+        wVrepx_ += m.wVrepx_;
+        wVrepy_ += m.wVrepy_;
+        rssiBiasSum_ += m.rssiBiasSum_;
+        orientationBiasCosSum_ += m.orientationBiasCosSum_;
+        orientationBiasSinSum_ += m.orientationBiasSinSum_;
+        for(const auto& fw: m.floorWeights_){
+            floorWeights_[fw.first] += fw.second;
+        }
+        return *this;
+    }
+    
+    size_t StatesMoments::size() const{
+        return static_cast<size_t>(count_);
+    }
+    
+    double StatesMoments::weightSum() const{
+        return weightSum_;
+    }
+    
+    double StatesMoments::meanRssiBias() const{
+        return rssiBiasSum_/count_;
+    }
+    
+    WrappedNormalParameter StatesMoments::orientationBiasParameter() const{
+        return MathUtils::computeWrappedNormalParameters(orientationBiasCosSum_, orientationBiasSinSum_, size());
+    }
+    
+    StatesSummary::StatesSummary(const StatesMoments& m){
+        size_ = m.size();
+        if(size_==0){
+            return;
+        }
+        double sw = m.weightSum_;
+        double n = m.count_;
+        
+        // weighted values
+        meanLocation_ = Location(m.wMeanX_, m.wMeanY_, m.wMeanZ_, m.wMeanFloor_);
+        covarianceXX_ = m.wCxx_/sw;
+        covarianceYY_ = m.wCyy_/sw;
+        covarianceXY_ = m.wCxy_/sw;
+        
+        double vxm = m.wVx_/sw, vym = m.wVy_/sw;
+        double vxrepm = m.wVrepx_/sw, vyrepm = m.wVrepy_/sw;
+        meanPose_.copyLocation(meanLocation_);
+        meanPose_.orientation(std::atan2(vyrepm, vxrepm)) // orientation must be calculated by representative velocity.
+        .velocity(std::sqrt(vxm*vxm + vym*vym))
+        .normalVelocity(std::sqrt(vxrepm*vxrepm + vyrepm*vyrepm));
+        
+        for(const auto& fw: m.floorWeights_){
+            floorMass_[fw.first] = fw.second/sw;
+        }
+        effectiveSampleSize_ = sw*sw/m.weightSquaredSum_;
+        
+        // unweighted values
+        double varx = std::max(0.0, m.uCxx_/n);
+        double vary = std::max(0.0, m.uCyy_/n);
+        double varz = std::max(0.0, m.uCzz_/n);
+        double varf = std::max(0.0, m.uCff_/n);
+        double covxy = m.uCxy_/n;
+        variance2D_ = varx*vary - covxy*covxy;
+        standardDeviation_ = Location(std::sqrt(varx), std::sqrt(vary), std::sqrt(varz), std::sqrt(varf));
+    }
+    
+    StatesSummary StatesSummary::compute(const std::vector<State>& states){
+        return StatesSummary(StatesMoments::compute(states));
+    }
+    
+    const Location& StatesSummary::meanLocation() const{
+        return meanLocation_;
+    }
+    
+    const Pose& StatesSummary::meanPose() const{
+        return meanPose_;
+    }
+    
+    StatesSummary& StatesSummary::meanPose(const Pose& pose){
+        meanPose_ = pose;
+        return *this;
+    }
+    
+    double StatesSummary::covarianceXX() const{
+        return covarianceXX_;
+    }
+    
+    double StatesSummary::covarianceYY() const{
+        return covarianceYY_;
+    }
+    
+    double StatesSummary::covarianceXY() const{
+        return covarianceXY_;
+    }
+    
+    double StatesSummary::variance2D() const{
+        return variance2D_;
+    }
+    
+    double StatesSummary::stdev2D() const{
+        return std::pow(variance2D_, 1.0/4.0);
+    }
+    
+    const Location& StatesSummary::standardDeviation() const{
+        return standardDeviation_;
+    }
+    
+    const std::map<int, double>& StatesSummary::floorMass() const{
+        return floorMass_;
+    }
+    
+    double StatesSummary::floorMass(int floor) const{
+        auto iter = floorMass_.find(floor);
+        return iter==floorMass_.end() ? 0.0 : iter->second;
+    }
+    
+    double StatesSummary::effectiveSampleSize() const{
+        return effectiveSampleSize_;
+    }
+    
+    size_t StatesSummary::size() const{
+        return size_;
+    }
+    
+    
     Status::Status() : states_(new std::vector<State>()){
     }
     
     Status::~Status(){}
     
     Status::Status(const Status& status){
+        copyFrom(status);
+    }
+    
+    Status& Status::operator=(const Status& status){
+        if(this!=&status){
+            copyFrom(status);
+        }
+        return *this;
+    }
+    
+    void Status::copyFrom(const Status& status){
         step_ = status.step_;
         locationStatus_ = status.locationStatus_;
         timestamp_ = status.timestamp_;
         mWasFloorUpdated = status.mWasFloorUpdated;
-        auto meanLoc = status.meanLocation();
-        auto meanPose = status.meanPose();
+        degradations_ = status.degradations_;
         auto states = status.states();
-        if(meanLoc){
-            meanLocation_ = Location::Ptr(new Location(*meanLoc));
-        }
-        if(meanPose){
-            meanPose_ = Pose::Ptr(new Pose(*meanPose));
-        }
         if(states){
             states_ = std::shared_ptr<States>(new States(*states));
         }
+        statesVersion_ = status.statesVersion_;
+        
+        std::unique_lock<std::mutex> lockThis(summaryMutex_, std::defer_lock);
+        std::unique_lock<std::mutex> lock(status.summaryMutex_, std::defer_lock);
+        std::lock(lockThis, lock);
+        // The summary is immutable and can be shared. Mean location and pose are exposed as mutable pointers and are copied.
+        momentsVersion_ = status.momentsVersion_;
+        moments_ = status.moments_;
+        summaryVersion_ = status.summaryVersion_;
+        summary_ = status.summary_;
+        meanLocation_ = status.meanLocation_ ? Location::Ptr(new Location(*status.meanLocation_)) : nullptr;
+        meanPose_ = status.meanPose_ ? Pose::Ptr(new Pose(*status.meanPose_)) : nullptr;
     }
     
-    Status& Status::operator=(const Status& status){
-        step_ = status.step_;
-        locationStatus_ = status.locationStatus_;
-        timestamp_ = status.timestamp_;
-        mWasFloorUpdated = status.mWasFloorUpdated;
-        auto meanLoc = status.meanLocation();
-        auto meanPose = status.meanPose();
-        auto states = status.states();
-        if(meanLoc){
-            meanLocation_ = Location::Ptr(new Location(*meanLoc));
+    void Status::updateMomentsIfNeeded() const{
+        if(moments_ && momentsVersion_==statesVersion_){
+            return;
         }
-        if(meanPose){
-            meanPose_ = Pose::Ptr(new Pose(*meanPose));
-        }
-        if(states){
-            states_ = std::shared_ptr<States>(new States(*states));
+        moments_.reset(new StatesMoments(StatesMoments::compute(*states_)));
+        momentsVersion_ = statesVersion_;
+    }
+    
+    void Status::updateSummaryIfNeeded() const{
+        if(summary_ && summaryVersion_==statesVersion_){
+            return;
         }
+        updateMomentsIfNeeded();
+        summary_.reset(new StatesSummary(*moments_));
+        summaryVersion_ = statesVersion_;
+        summaryUpdated();
+    }
+    
+    void Status::summaryUpdated() const{
+        meanLocation_.reset(new Location(summary_->meanLocation()));
+        meanPose_.reset(new Pose(summary_->meanPose()));
+    }
+    
+    std::shared_ptr<const StatesSummary> Status::summary() const{
+        std::lock_guard<std::mutex> lock(summaryMutex_);
+        updateSummaryIfNeeded();
+        return summary_;
+    }
+    
+    std::shared_ptr<const StatesMoments> Status::moments() const{
+        std::lock_guard<std::mutex> lock(summaryMutex_);
+        updateMomentsIfNeeded();
+        return moments_;
+    }
+    
+    Status& Status::summary(std::shared_ptr<const StatesSummary> summary){
+        std::lock_guard<std::mutex> lock(summaryMutex_);
+        summary_ = summary;
+        summaryVersion_ = statesVersion_;
+        summaryUpdated();
+        return *this;
+    }
+    
+    long Status::statesVersion() const{
+        return statesVersion_;
+    }
+    
+    Status& Status::invalidateSummary(){
+        statesVersion_++;
         return *this;
     }
     
     std::shared_ptr<Location> Status::meanLocation() const{
+        if(statesVersion_==0){
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(summaryMutex_);
+        updateSummaryIfNeeded();
         return meanLocation_;
     }
     
     std::shared_ptr<Pose> Status::meanPose() const{
+        if(statesVersion_==0){
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(summaryMutex_);
+        updateSummaryIfNeeded();
         return meanPose_;
     }
     
@@ -85,16 +389,6 @@ namespace loc{
         return states_;
     }
     
-    Status& Status::meanLocation(std::shared_ptr<Location> location){
-        meanLocation_ = location;
-        return *this;
-    }
-    
-    Status& Status::meanPose(std::shared_ptr<Pose> pose){
-        meanPose_ = pose;
-        return *this;
-    }
-    
     Status& Status::timestamp(long timestamp){
         timestamp_ = timestamp;
         return *this;
@@ -110,16 +404,8 @@ namespace loc{
         this->step(Status::OTHER);
         
         states_ = states;
-        size_t n = states->size();
-        std::vector<double> weights(n);
-        for(int i=0; i<n; i++){
-            weights[i] = states->at(i).weight();
-        }
-        // Compute mean Location
-        auto meanLoc = std::shared_ptr<Location>(new Location(Location::weightedMean(*states, weights)));
-        meanLocation(meanLoc);
-        auto meanPs = std::shared_ptr<Pose>(new Pose(Pose::weightedMean(*states, weights)));
-        meanPose(meanPs);
+        // Summaries are recomputed on demand.
+        statesVersion_++;
         return *this;
     }
     
@@ -163,6 +449,15 @@ namespace loc{
         mWasFloorUpdated = wasFloorUpdated;
     }
     
+    int Status::degradations() const{
+        return degradations_;
+    }
+    
+    Status& Status::degradations(int degradations){
+        degradations_ = degradations;
+        return *this;
+    }
+    
     std::string Status::locationStatusToString(const loc::Status::LocationStatus & locStatus){
         std::string str;
         switch(locStatus){
@@ -209,4 +504,22 @@ namespace loc{
         }
         return str;
     }
+    
+    std::string Status::degradationsToString(int degradations){
+        if(degradations==NO_DEGRADATION){
+            return "NO_DEGRADATION";
+        }
+        std::string str;
+        auto append = [&](int flag, const std::string& name){
+            if(degradations & flag){
+                str += str.empty() ? name : "|"+name;
+            }
+        };
+        append(SKIPPED_MIXING, "SKIPPED_MIXING");
+        append(SUBSAMPLED_LIKELIHOOD, "SUBSAMPLED_LIKELIHOOD");
+        append(REDUCED_STATES, "REDUCED_STATES");
+        append(DEFERRED_POSTERIOR_RESAMPLING, "DEFERRED_POSTERIOR_RESAMPLING");
+        append(SKIPPED_UPDATE, "SKIPPED_UPDATE");
+        return str;
+    }
 }
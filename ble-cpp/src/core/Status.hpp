@@ -25,6 +25,8 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <map>
+#include <mutex>
 
 
 #include "Location.hpp"
@@ -33,6 +35,90 @@
 
 namespace loc{
     
+    // Mergeable first and second moments of a set of states.
+    // Moments of different sets can be combined with operator+= without keeping the states.
+    class StatesMoments{
+        double count_ = 0;
+        double weightSum_ = 0;
+        double weightSquaredSum_ = 0;
+        // weighted mean and co-moments
+        double wMeanX_ = 0, wMeanY_ = 0, wMeanZ_ = 0, wMeanFloor_ = 0;
+        double wCxx_ = 0, wCyy_ = 0, wCxy_ = 0;
+        // unweighted mean and co-moments
+        double uMeanX_ = 0, uMeanY_ = 0, uMeanZ_ = 0, uMeanFloor_ = 0;
+        double uCxx_ = 0, uCyy_ = 0, uCzz_ = 0, uCff_ = 0, uCxy_ = 0;
+        // weighted sums of velocity vectors
+        double wVx_ = 0, wVy_ = 0, wVrepx_ = 0, wVrepy_ = 0;
+        // unweighted sums
+        double rssiBiasSum_ = 0;
+        double orientationBiasCosSum_ = 0, orientationBiasSinSum_ = 0;
+        std::map<int, double> floorWeights_;
+        
+        friend class StatesSummary;
+        
+    public:
+        static StatesMoments compute(const std::vector<State>& states);
+        
+        StatesMoments& operator+=(const StatesMoments& moments);
+        
+        size_t size() const;
+        double weightSum() const;
+        double meanRssiBias() const;
+        WrappedNormalParameter orientationBiasParameter() const;
+        
+        template<class Archive>
+        void serialize(Archive& ar){
+            ar(CEREAL_NVP(count_), CEREAL_NVP(weightSum_), CEREAL_NVP(weightSquaredSum_));
+            ar(CEREAL_NVP(wMeanX_), CEREAL_NVP(wMeanY_), CEREAL_NVP(wMeanZ_), CEREAL_NVP(wMeanFloor_));
+            ar(CEREAL_NVP(wCxx_), CEREAL_NVP(wCyy_), CEREAL_NVP(wCxy_));
+            ar(CEREAL_NVP(uMeanX_), CEREAL_NVP(uMeanY_), CEREAL_NVP(uMeanZ_), CEREAL_NVP(uMeanFloor_));
+            ar(CEREAL_NVP(uCxx_), CEREAL_NVP(uCyy_), CEREAL_NVP(uCzz_), CEREAL_NVP(uCff_), CEREAL_NVP(uCxy_));
+            ar(CEREAL_NVP(wVx_), CEREAL_NVP(wVy_), CEREAL_NVP(wVrepx_), CEREAL_NVP(wVrepy_));
+            ar(CEREAL_NVP(rssiBiasSum_));
+            ar(CEREAL_NVP(orientationBiasCosSum_), CEREAL_NVP(orientationBiasSinSum_));
+            ar(CEREAL_NVP(floorWeights_));
+        }
+    };
+    
+    // Summary statistics of a set of states.
+    // Weighted values use the state weights. variance2D and standardDeviation are unweighted
+    // to keep the semantics of Location::compute2DVariance and Location::standardDeviation.
+    class StatesSummary{
+    public:
+        using Ptr = std::shared_ptr<const StatesSummary>;
+        
+    private:
+        Location meanLocation_;
+        Pose meanPose_;
+        double covarianceXX_ = 0;
+        double covarianceYY_ = 0;
+        double covarianceXY_ = 0;
+        double variance2D_ = 0;
+        Location standardDeviation_;
+        std::map<int, double> floorMass_;
+        double effectiveSampleSize_ = 0;
+        size_t size_ = 0;
+        
+    public:
+        StatesSummary() = default;
+        StatesSummary(const StatesMoments& moments);
+        static StatesSummary compute(const std::vector<State>& states);
+        
+        const Location& meanLocation() const;
+        const Pose& meanPose() const;
+        StatesSummary& meanPose(const Pose& pose);
+        double covarianceXX() const;
+        double covarianceYY() const;
+        double covarianceXY() const;
+        double variance2D() const;
+        double stdev2D() const;
+        const Location& standardDeviation() const;
+        const std::map<int, double>& floorMass() const;
+        double floorMass(int floor) const;
+        double effectiveSampleSize() const;
+        size_t size() const;
+    };
+    
     class Status{
         
     public:
@@ -60,8 +146,26 @@ namespace loc{
             NIL
         };
         
+        // Degradations applied to meet the time budget of an update or to save work while duty-cycling (bit flags)
+        enum Degradation{
+            NO_DEGRADATION = 0,
+            SKIPPED_MIXING = 1,
+            SUBSAMPLED_LIKELIHOOD = 2,
+            REDUCED_STATES = 4,
+            DEFERRED_POSTERIOR_RESAMPLING = 8,
+            SKIPPED_UPDATE = 16
+        };
+        
         std::shared_ptr<Location> meanLocation() const;
         std::shared_ptr<Pose> meanPose() const;
+        // Computed lazily once per states version and cached until the states change.
+        std::shared_ptr<const StatesSummary> summary() const;
+        std::shared_ptr<const StatesMoments> moments() const;
+        // Overrides the summary of the current states, e.g. with a summary smoothed over several updates.
+        Status& summary(std::shared_ptr<const StatesSummary> summary);
+        long statesVersion() const;
+        // Call after modifying the states in place.
+        Status& invalidateSummary();
         long timestamp() const;
         std::shared_ptr<std::vector<State>> states() const;
         Step step() const;
@@ -80,21 +184,35 @@ namespace loc{
         bool wasFloorUpdated() const;
         void wasFloorUpdated(bool);
         
+        int degradations() const;
+        Status& degradations(int degradations);
+        
         static std::string locationStatusToString(const LocationStatus&);
         static std::string stepToString(const Step&);
+        static std::string degradationsToString(int degradations);
         
     private:
         long timestamp_;
         Step step_ = Step::OTHER;
         LocationStatus locationStatus_ = NIL;
         //LocationStatus locationStatus_ = UNKNOWN;
-        std::shared_ptr<Location> meanLocation_;
-        std::shared_ptr<Pose> meanPose_;
         std::shared_ptr<std::vector<State>> states_;
         bool mWasFloorUpdated = false;
+        int degradations_ = NO_DEGRADATION;
+        
+        long statesVersion_ = 0;
+        mutable long momentsVersion_ = 0;
+        mutable long summaryVersion_ = 0;
+        mutable std::shared_ptr<const StatesMoments> moments_;
+        mutable std::shared_ptr<const StatesSummary> summary_;
+        mutable std::shared_ptr<Location> meanLocation_;
+        mutable std::shared_ptr<Pose> meanPose_;
+        mutable std::mutex summaryMutex_;
         
-        Status& meanLocation(std::shared_ptr<Location> location);
-        Status& meanPose(std::shared_ptr<Pose> pose);
+        void updateMomentsIfNeeded() const;
+        void updateSummaryIfNeeded() const;
+        void summaryUpdated() const;
+        void copyFrom(const Status& status);
         
     };
     
@@ -32,6 +32,7 @@
 #include "Acceleration.hpp"
 
 #include "DataUtils.hpp"
+#include "Logger.hpp"
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -262,7 +263,7 @@ namespace loc{
         std::ifstream ifs(filePath);
         
         if(! ifs.is_open()){
-            std::cout << filePath << " is not open." << std::endl;
+            LOC_LOG_WARN(DATA, filePath << " is not open.");
         }
         std::string str;
         std::stringstream stringstream;
@@ -373,7 +374,7 @@ namespace loc{
                 Location loc = parseLocationCSV(strBuffer);
                 locations.push_back(loc);
             } catch (std::invalid_argument e){
-                std::cout << "Invalid csv line was found. line=" <<strBuffer << std::endl;
+                LOC_LOG_WARN(DATA, "Invalid csv line was found. line=" <<strBuffer);
             }
         }
     }
@@ -390,7 +391,7 @@ namespace loc{
                 Sample sample = parseSampleCSV(strBuffer, noBeacons);
                 samples.push_back(sample);
             } catch (std::invalid_argument e){
-                std::cout << "Invalid csv line was found. line=" <<strBuffer << std::endl;
+                LOC_LOG_WARN(DATA, "Invalid csv line was found. line=" <<strBuffer);
                 //std::cout << "Header line is found in csv samples." << std::endl;
             }
         }
@@ -408,11 +409,11 @@ namespace loc{
                 Sample sample = parseSampleCSV(strBuffer, noBeacons);
                 samples.push_back(sample);
             } catch (std::invalid_argument e){
-                std::cout << "Invalid csv line was found. line=" <<strBuffer << std::endl;
+                LOC_LOG_WARN(DATA, "Invalid csv line was found. line=" <<strBuffer);
             }
         }
         if(samples.size()==0){
-            std::cout << "Samples CSV was not found." << std::endl;
+            LOC_LOG_WARN(DATA, "Samples CSV was not found.");
         }
         return std::move(samples);
     }
@@ -456,7 +457,7 @@ namespace loc{
                 Sample sample = parseShortSampleCSV(strBuffer);
                 samples.push_back(sample);
             } catch (std::invalid_argument e){
-                std::cout << "Invalid short csv line was found. line=" <<strBuffer << std::endl;
+                LOC_LOG_WARN(DATA, "Invalid short csv line was found. line=" <<strBuffer);
                 //std::cout << "Header line is found in csv samples." << std::endl;
             }
         }
@@ -470,11 +471,11 @@ namespace loc{
                 Sample sample = parseShortSampleCSV(strBuffer);
                 samples.push_back(sample);
             } catch (std::invalid_argument e){
-                std::cout << "Invalid short csv line was found. line=" <<strBuffer << std::endl;
+                LOC_LOG_WARN(DATA, "Invalid short csv line was found. line=" <<strBuffer);
             }
         }
         if(samples.size()==0){
-            std::cout << "Samples CSV was not found." << std::endl;
+            LOC_LOG_WARN(DATA, "Samples CSV was not found.");
         }
         return std::move(samples);
     }
@@ -528,13 +529,13 @@ namespace loc{
                 BLEBeacon bleBeacon = parseBLEBeaconCSV(strBuffer);
                 bleBeacons.push_back(bleBeacon);
             }catch(std::invalid_argument e){
-                std::cout << "Invalid csv line was found. line=" <<strBuffer << std::endl;
+                LOC_LOG_WARN(DATA, "Invalid csv line was found. line=" <<strBuffer);
                 //std::cout << "Header line is found in csv BLEBeacons." << std::endl;
             }
         }
         
         if(bleBeacons.size()==0){
-            std::cout << "BLEBeacons CSV was not found." << std::endl;
+            LOC_LOG_WARN(DATA, "BLEBeacons CSV was not found.");
         }
         
         return bleBeacons;
@@ -627,7 +628,7 @@ namespace loc{
         std::shared_ptr<Location> meanLocation = status.meanLocation();
         std::shared_ptr<Pose> meanPose = status.meanPose();
         std::shared_ptr<std::vector<State>> states = status.states();
-        Location stdevLocation = Location::standardDeviation(*states);
+        Location stdevLocation = status.summary()->standardDeviation();
         
         picojson::object json;
         if(meanPose){
@@ -636,6 +637,9 @@ namespace loc{
             json = locationToJSONObject(*meanLocation);
         }
         json.insert(std::make_pair("stdev", picojson::value(locationToJSONObject(stdevLocation))));
+        if(status.degradations()!=Status::NO_DEGRADATION){
+            json.insert(std::make_pair("degradations", picojson::value(Status::degradationsToString(status.degradations()))));
+        }
         if(optOutputStates){
             picojson::array array = statesToJSONArrayLight(*states);
             json.insert(std::make_pair("states", picojson::value(array)));
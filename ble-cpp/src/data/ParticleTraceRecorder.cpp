@@ -0,0 +1,379 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "ParticleTraceRecorder.hpp"
+#include <cstring>
+#include <cmath>
+#include "LocException.hpp"
+
+namespace loc{
+    
+    namespace{
+        const char kFileMagic[8] = {'B','L','P','T','R','A','C','E'};
+        const char kChunkMagic[4] = {'C','H','N','K'};
+        const size_t kRecordHeaderWords = 6;
+        
+        inline uint64_t toWord(double value){
+            uint64_t word;
+            std::memcpy(&word, &value, sizeof(word));
+            return word;
+        }
+        
+        inline double toDouble(uint64_t word){
+            double value;
+            std::memcpy(&value, &word, sizeof(value));
+            return value;
+        }
+        
+        template<class T>
+        void writeValue(std::ostream& os, T value){
+            os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+        
+        template<class T>
+        bool readValue(std::istream& is, T& value){
+            is.read(reinterpret_cast<char*>(&value), sizeof(T));
+            return static_cast<bool>(is);
+        }
+    }
+    
+    // ParticleTraceRecord
+    
+    std::string ParticleTraceRecord::stageToString(Stage stage){
+        switch(stage){
+            case BEFORE_LIKELIHOOD:
+                return "before_likelihood_states";
+            case AFTER_LIKELIHOOD:
+                return "after_likelihood_states";
+            case RESAMPLED:
+                return "resampled_states";
+        }
+        return "unknown_states";
+    }
+    
+    std::string ParticleTraceRecord::csvFileName() const{
+        return stageToString(stage) + "_" + std::to_string(timestamp) + ".csv";
+    }
+    
+    std::ostream& operator<<(std::ostream&os, const ParticleTraceStatistics& stats){
+        os << "recorded=" << stats.recorded << ",dropped=" << stats.dropped
+        << ",chunksWritten=" << stats.chunksWritten
+        << ",rawBytes=" << stats.rawBytes << ",storedBytes=" << stats.storedBytes;
+        return os;
+    }
+    
+    // ParticleTraceRecorder
+    
+    ParticleTraceRecorder::Ptr ParticleTraceRecorder::instance;
+    
+    ParticleTraceRecorder::ParticleTraceRecorder(const std::string& path, const ParticleTraceParameters& params)
+    : mParams(params){
+        mOfs.open(path, std::ios::binary);
+        if(!mOfs){
+            BOOST_THROW_EXCEPTION(LocException("failed to open trace file: " + path));
+        }
+        mOfs.write(kFileMagic, sizeof(kFileMagic));
+        writeValue<uint32_t>(mOfs, kVersion);
+        writeValue<uint32_t>(mOfs, kFieldsPerState);
+        mChunk.reserve(mParams.chunkSize/sizeof(uint64_t));
+        mWriter = std::thread(&ParticleTraceRecorder::run, this);
+    }
+    
+    ParticleTraceRecorder::~ParticleTraceRecorder(){
+        close();
+    }
+    
+    bool ParticleTraceRecorder::record(ParticleTraceRecord::Stage stage, long timestamp, const States& states,
+                                       int step, int degradations, double ess){
+        std::vector<uint64_t> words;
+        words.reserve(kRecordHeaderWords + states.size()*kFieldsPerState);
+        words.push_back(static_cast<uint64_t>(stage));
+        words.push_back(static_cast<uint64_t>(static_cast<int64_t>(timestamp)));
+        words.push_back(static_cast<uint64_t>(static_cast<int64_t>(step)));
+        words.push_back(static_cast<uint64_t>(static_cast<int64_t>(degradations)));
+        words.push_back(toWord(ess));
+        words.push_back(static_cast<uint64_t>(states.size()));
+        for(const State& s: states){
+            words.push_back(toWord(s.x()));
+            words.push_back(toWord(s.y()));
+            words.push_back(toWord(s.z()));
+            words.push_back(toWord(s.floor()));
+            words.push_back(toWord(s.orientation()));
+            words.push_back(toWord(s.velocity()));
+            words.push_back(toWord(s.normalVelocity()));
+            words.push_back(toWord(s.orientationBias()));
+            words.push_back(toWord(s.rssiBias()));
+            words.push_back(toWord(s.weight()));
+            words.push_back(toWord(s.negativeLogLikelihood()));
+            words.push_back(toWord(s.mahalanobisDistance()));
+            words.push_back(toWord(s.orientationAlignment()));
+        }
+        size_t bytes = words.size()*sizeof(uint64_t);
+        
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(mStopping || mParams.bufferCapacity < mPendingBytes + bytes){
+            mStats.dropped++;
+            return false;
+        }
+        mPending.push_back(std::move(words));
+        mPendingBytes += bytes;
+        mStats.recorded++;
+        mCondPending.notify_one();
+        return true;
+    }
+    
+    void ParticleTraceRecorder::flush(){
+        std::unique_lock<std::mutex> lock(mMutex);
+        if(!mWriter.joinable()){
+            return;
+        }
+        long ticket = ++mFlushRequested;
+        mCondPending.notify_one();
+        mCondFlushed.wait(lock, [&]{ return ticket <= mFlushCompleted; });
+    }
+    
+    void ParticleTraceRecorder::close(){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+            mCondPending.notify_one();
+        }
+        if(mWriter.joinable()){
+            mWriter.join();
+        }
+        if(mOfs.is_open()){
+            mOfs.close();
+        }
+    }
+    
+    ParticleTraceStatistics ParticleTraceRecorder::statistics() const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+    
+    void ParticleTraceRecorder::run(){
+        std::deque<std::vector<uint64_t>> records;
+        while(true){
+            long flushRequested;
+            bool stopping;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCondPending.wait(lock, [&]{ return !mPending.empty() || mStopping || mFlushCompleted < mFlushRequested; });
+                records.swap(mPending);
+                mPendingBytes = 0;
+                flushRequested = mFlushRequested;
+                stopping = mStopping;
+            }
+            for(auto& words: records){
+                mChunk.insert(mChunk.end(), words.begin(), words.end());
+                mChunkRecords++;
+                if(mParams.chunkSize <= mChunk.size()*sizeof(uint64_t)){
+                    writeChunk();
+                }
+            }
+            records.clear();
+            bool flushes = stopping;
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                flushes |= mFlushCompleted < flushRequested && mPending.empty();
+            }
+            if(flushes){
+                writeChunk();
+                mOfs.flush();
+                std::lock_guard<std::mutex> lock(mMutex);
+                mFlushCompleted = flushRequested;
+                mCondFlushed.notify_all();
+            }
+            if(stopping){
+                std::lock_guard<std::mutex> lock(mMutex);
+                if(mPending.empty()){
+                    mFlushCompleted = mFlushRequested;
+                    mCondFlushed.notify_all();
+                    break;
+                }
+            }
+        }
+    }
+    
+    void ParticleTraceRecorder::writeChunk(){
+        if(mChunk.empty()){
+            return;
+        }
+        uint64_t rawSize = mChunk.size()*sizeof(uint64_t);
+        std::vector<uint8_t> bytes;
+        uint32_t codec = CODEC_RAW;
+        if(mParams.compresses){
+            encodeChunk(mChunk, bytes);
+            codec = CODEC_XOR_DELTA;
+        }else{
+            bytes.resize(rawSize);
+            std::memcpy(bytes.data(), mChunk.data(), rawSize);
+        }
+        mOfs.write(kChunkMagic, sizeof(kChunkMagic));
+        writeValue<uint32_t>(mOfs, codec);
+        writeValue<uint64_t>(mOfs, rawSize);
+        writeValue<uint64_t>(mOfs, bytes.size());
+        writeValue<uint64_t>(mOfs, mChunkRecords);
+        mOfs.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStats.chunksWritten++;
+            mStats.rawBytes += rawSize;
+            mStats.storedBytes += bytes.size();
+        }
+        mChunk.clear();
+        mChunkRecords = 0;
+    }
+    
+    void ParticleTraceRecorder::encodeChunk(const std::vector<uint64_t>& words, std::vector<uint8_t>& bytes, size_t stride){
+        bytes.clear();
+        bytes.reserve(words.size()*(sizeof(uint64_t)+1));
+        for(size_t i=0; i<words.size(); i++){
+            uint64_t w = i<stride ? words[i] : words[i]^words[i-stride];
+            uint8_t n = 0;
+            for(uint64_t v = w; v!=0; v >>= 8){
+                n++;
+            }
+            bytes.push_back(n);
+            for(uint8_t k=0; k<n; k++){
+                bytes.push_back(static_cast<uint8_t>(w >> (8*k)));
+            }
+        }
+    }
+    
+    void ParticleTraceRecorder::decodeChunk(const std::vector<uint8_t>& bytes, size_t nWords, std::vector<uint64_t>& words, size_t stride){
+        words.resize(nWords);
+        size_t pos = 0;
+        for(size_t i=0; i<nWords; i++){
+            if(bytes.size() <= pos){
+                BOOST_THROW_EXCEPTION(LocException("corrupted trace chunk"));
+            }
+            uint8_t n = bytes[pos++];
+            if(8 < n || bytes.size() < pos + n){
+                BOOST_THROW_EXCEPTION(LocException("corrupted trace chunk"));
+            }
+            uint64_t w = 0;
+            for(uint8_t k=0; k<n; k++){
+                w |= static_cast<uint64_t>(bytes[pos++]) << (8*k);
+            }
+            words[i] = i<stride ? w : w^words[i-stride];
+        }
+    }
+    
+    void ParticleTraceRecorder::createInstance(const std::string& path, const ParticleTraceParameters& params){
+        instance = std::make_shared<ParticleTraceRecorder>(path, params);
+    }
+    
+    void ParticleTraceRecorder::destroyInstance(){
+        if(instance){
+            instance->close();
+            instance.reset();
+        }
+    }
+    
+    ParticleTraceRecorder::Ptr& ParticleTraceRecorder::getInstance(){
+        return instance;
+    }
+    
+    // ParticleTraceReader
+    
+    ParticleTraceReader::ParticleTraceReader(const std::string& path){
+        mIfs.open(path, std::ios::binary);
+        if(!mIfs){
+            BOOST_THROW_EXCEPTION(LocException("failed to open trace file: " + path));
+        }
+        char magic[sizeof(kFileMagic)];
+        uint32_t version = 0;
+        mIfs.read(magic, sizeof(magic));
+        if(!mIfs || std::memcmp(magic, kFileMagic, sizeof(magic))!=0 || !readValue(mIfs, version) || !readValue(mIfs, mFieldsPerState)){
+            BOOST_THROW_EXCEPTION(LocException("not a particle trace file: " + path));
+        }
+        if(ParticleTraceRecorder::kVersion < version || mFieldsPerState < ParticleTraceRecorder::kFieldsPerState){
+            BOOST_THROW_EXCEPTION(LocException("unsupported particle trace version: " + std::to_string(version)));
+        }
+    }
+    
+    bool ParticleTraceReader::readChunk(){
+        char magic[sizeof(kChunkMagic)];
+        mIfs.read(magic, sizeof(magic));
+        if(mIfs.gcount()==0){
+            return false;
+        }
+        uint32_t codec = 0;
+        uint64_t rawSize = 0, storedSize = 0, nRecords = 0;
+        if(!mIfs || std::memcmp(magic, kChunkMagic, sizeof(magic))!=0
+           || !readValue(mIfs, codec) || !readValue(mIfs, rawSize) || !readValue(mIfs, storedSize) || !readValue(mIfs, nRecords)
+           || rawSize%sizeof(uint64_t)!=0){
+            BOOST_THROW_EXCEPTION(LocException("corrupted trace chunk header"));
+        }
+        std::vector<uint8_t> bytes(storedSize);
+        mIfs.read(reinterpret_cast<char*>(bytes.data()), storedSize);
+        if(static_cast<uint64_t>(mIfs.gcount())!=storedSize){
+            BOOST_THROW_EXCEPTION(LocException("truncated trace chunk"));
+        }
+        size_t nWords = rawSize/sizeof(uint64_t);
+        if(codec==ParticleTraceRecorder::CODEC_XOR_DELTA){
+            ParticleTraceRecorder::decodeChunk(bytes, nWords, mChunk, mFieldsPerState);
+        }else if(codec==ParticleTraceRecorder::CODEC_RAW && storedSize==rawSize){
+            mChunk.resize(nWords);
+            std::memcpy(mChunk.data(), bytes.data(), rawSize);
+        }else{
+            BOOST_THROW_EXCEPTION(LocException("unknown trace codec: " + std::to_string(codec)));
+        }
+        mPosition = 0;
+        return true;
+    }
+    
+    bool ParticleTraceReader::next(ParticleTraceRecord& record){
+        while(mChunk.size() <= mPosition){
+            if(!readChunk()){
+                return false;
+            }
+        }
+        if(mChunk.size() < mPosition + kRecordHeaderWords){
+            BOOST_THROW_EXCEPTION(LocException("corrupted trace record"));
+        }
+        const uint64_t* w = &mChunk[mPosition];
+        record.stage = static_cast<ParticleTraceRecord::Stage>(w[0]);
+        record.timestamp = static_cast<long>(static_cast<int64_t>(w[1]));
+        record.step = static_cast<int>(static_cast<int64_t>(w[2]));
+        record.degradations = static_cast<int>(static_cast<int64_t>(w[3]));
+        record.ess = toDouble(w[4]);
+        uint64_t nStates = w[5];
+        mPosition += kRecordHeaderWords;
+        if((mChunk.size() - mPosition)/mFieldsPerState < nStates){
+            BOOST_THROW_EXCEPTION(LocException("corrupted trace record"));
+        }
+        record.states.resize(nStates);
+        for(uint64_t i=0; i<nStates; i++){
+            const uint64_t* f = &mChunk[mPosition];
+            State& s = record.states[i];
+            s.x(toDouble(f[0])).y(toDouble(f[1])).z(toDouble(f[2])).floor(toDouble(f[3]));
+            s.orientation(toDouble(f[4])).velocity(toDouble(f[5])).normalVelocity(toDouble(f[6]));
+            s.orientationBias(toDouble(f[7])).rssiBias(toDouble(f[8])).weight(toDouble(f[9]));
+            s.negativeLogLikelihood(toDouble(f[10])).mahalanobisDistance(toDouble(f[11]));
+            s.orientationAlignment(toDouble(f[12]));
+            mPosition += mFieldsPerState;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,158 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef ParticleTraceRecorder_hpp
+#define ParticleTraceRecorder_hpp
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include <limits>
+
+#include "State.hpp"
+
+namespace loc{
+    
+    // Trace file layout (host byte order, 8-byte words unless noted)
+    //   file header : "BLPTRACE", version(uint32), fieldsPerState(uint32)
+    //   chunk       : "CHNK", codec(uint32), rawSize(uint64), storedSize(uint64), nRecords(uint64), payload[storedSize]
+    //   record      : stage, timestamp, step, degradations, ess(double), nStates, states[nStates*fieldsPerState]
+    // With CODEC_XOR_DELTA, each word is XORed with the word one state before and
+    // stored as a byte count followed by its non-zero low-order bytes.
+    class ParticleTraceRecord{
+    public:
+        enum Stage{
+            BEFORE_LIKELIHOOD = 0,
+            AFTER_LIKELIHOOD,
+            RESAMPLED
+        };
+        
+        Stage stage = BEFORE_LIKELIHOOD;
+        long timestamp = 0;
+        int step = -1; // Status::Step, -1 if not applicable
+        int degradations = 0;
+        double ess = std::numeric_limits<double>::quiet_NaN();
+        States states;
+        
+        static std::string stageToString(Stage stage);
+        // file name used by the former per-frame CSV logging
+        std::string csvFileName() const;
+    };
+    
+    class ParticleTraceParameters{
+    public:
+        size_t chunkSize = 1<<20; // [bytes] uncompressed size of a chunk
+        size_t bufferCapacity = 16<<20; // [bytes] records are dropped when the buffered size exceeds this
+        bool compresses = true;
+    };
+    
+    class ParticleTraceStatistics{
+    public:
+        long recorded = 0;
+        long dropped = 0;
+        long chunksWritten = 0;
+        uint64_t rawBytes = 0;
+        uint64_t storedBytes = 0;
+        
+        friend std::ostream& operator<<(std::ostream&os, const ParticleTraceStatistics& stats);
+    };
+    
+    // Appends particle snapshots to a single trace file from a background writer thread.
+    // Singleton class like DataLogger: states are traced only when the instance is created.
+    class ParticleTraceRecorder{
+    public:
+        using Ptr = std::shared_ptr<ParticleTraceRecorder>;
+        
+        static const uint32_t kVersion = 1;
+        static const uint32_t kFieldsPerState = 13;
+        enum Codec{
+            CODEC_RAW = 0,
+            CODEC_XOR_DELTA = 1
+        };
+        
+        ParticleTraceRecorder(const std::string& path, const ParticleTraceParameters& params = ParticleTraceParameters());
+        ~ParticleTraceRecorder();
+        
+        ParticleTraceRecorder(const ParticleTraceRecorder&) = delete;
+        ParticleTraceRecorder& operator=(const ParticleTraceRecorder&) = delete;
+        
+        // Returns false if the record is dropped because the buffer is full.
+        bool record(ParticleTraceRecord::Stage stage, long timestamp, const States& states,
+                    int step = -1, int degradations = 0, double ess = std::numeric_limits<double>::quiet_NaN());
+        // Blocks until all buffered records are written to the file.
+        void flush();
+        void close();
+        ParticleTraceStatistics statistics() const;
+        
+        static void createInstance(const std::string& path, const ParticleTraceParameters& params = ParticleTraceParameters());
+        static void destroyInstance();
+        static Ptr& getInstance();
+        
+        static void encodeChunk(const std::vector<uint64_t>& words, std::vector<uint8_t>& bytes, size_t stride = kFieldsPerState);
+        static void decodeChunk(const std::vector<uint8_t>& bytes, size_t nWords, std::vector<uint64_t>& words, size_t stride = kFieldsPerState);
+        
+    private:
+        static Ptr instance;
+        
+        ParticleTraceParameters mParams;
+        std::ofstream mOfs;
+        std::thread mWriter;
+        mutable std::mutex mMutex;
+        std::condition_variable mCondPending;
+        std::condition_variable mCondFlushed;
+        std::deque<std::vector<uint64_t>> mPending;
+        size_t mPendingBytes = 0;
+        bool mStopping = false;
+        long mFlushRequested = 0;
+        long mFlushCompleted = 0;
+        ParticleTraceStatistics mStats;
+        
+        std::vector<uint64_t> mChunk;
+        long mChunkRecords = 0;
+        
+        void run();
+        void writeChunk();
+    };
+    
+    class ParticleTraceReader{
+    public:
+        ParticleTraceReader(const std::string& path);
+        // Returns false at the end of the trace.
+        bool next(ParticleTraceRecord& record);
+        
+    private:
+        std::ifstream mIfs;
+        uint32_t mFieldsPerState = 0;
+        std::vector<uint64_t> mChunk;
+        size_t mPosition = 0;
+        
+        bool readChunk();
+    };
+}
+
+#endif /* ParticleTraceRecorder_hpp */
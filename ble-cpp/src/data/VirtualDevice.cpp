@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "VirtualDevice.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -30,7 +31,7 @@ namespace loc{
     
     void VirtualDevice::setStdevPose(Pose stdevPose){
         stdevPose_ = stdevPose;
-        std::cout << "standard deviation of Pose was set. " << stdevPose_  << std::endl;
+        LOC_LOG_INFO(DATA, "standard deviation of Pose was set. " << stdevPose_);
     }
     
     void VirtualDevice::csvPath(std::string csvPath){
@@ -64,7 +65,7 @@ namespace loc{
             prevTimestamp = timestamp;
         }
         if(timestamp + timestampMargin < prevTimestamp){ // If new timestamp is older than previous timestamp
-            std::cout << "Inconsistent timestamp(previousTimestamp=" << prevTimestamp << ", timestamp=" << timestamp << ") was inputted. Localizer status was reset." << std::endl;
+            LOC_LOG_WARN(DATA, "Inconsistent timestamp(previousTimestamp=" << prevTimestamp << ", timestamp=" << timestamp << ") was inputted. Localizer status was reset.");
             resetLocalizer();
         }
         prevTimestamp = timestamp;
@@ -106,7 +107,7 @@ namespace loc{
             }
             if( ! Location::equals(*posePred, *previousPosePred)){
                 long timestamp = acc.timestamp();
-                std::cout << "Pre. ts="<<timestamp<< ", posePre=" << *posePred << std::endl;
+                LOC_LOG_DEBUG(DATA, "Pre. ts="<<timestamp<< ", posePre=" << *posePred);
                 previousPosePred = posePred;
             }
             
@@ -128,8 +129,8 @@ namespace loc{
                 Location locTrue = smp.location();
                 double dist2D = Location::distance2D(locTrue, *poseEst);
                 this->mCurrentError = dist2D;
-                std::cout<< "Filt, ts=" << smp.timestamp() << ",poseEst=" << *poseEst
-                <<  ",locTrue=" << locTrue << ",d2D=" << dist2D <<std::endl;
+                LOC_LOG_DEBUG(DATA, "Filt, ts=" << smp.timestamp() << ",poseEst=" << *poseEst
+                <<  ",locTrue=" << locTrue << ",d2D=" << dist2D);
                 if(wasReset){
                     if(mResultDir.size()>0){
                         sstream << locTrue << "," << *poseEst << std::endl;
@@ -145,18 +146,18 @@ namespace loc{
                     }
                 }
             }catch (std::invalid_argument e){
-                std::cout << "invalid sampleCSV was found." << std::endl;
+                LOC_LOG_WARN(DATA, "invalid sampleCSV was found.");
             }
             count_putBeacons ++;
         }else if(DataUtils::csvCheckSensorType(strBuffer, "Reset")){
             Pose poseReset = DataUtils::parseResetPoseCSV(strBuffer);
-            std::cout << "Created ResetPose=" << poseReset << std::endl;
+            LOC_LOG_INFO(DATA, "Created ResetPose=" << poseReset);
             //mStreamLocalizer->resetStatus(poseReset);
             mStreamLocalizer->resetStatus(poseReset, stdevPose_);
             Status* status = mStreamLocalizer->getStatus();
             std::shared_ptr<Pose> poseEst = status->meanPose();
             if(poseEst){
-                std::cout << "After reset, poseEst=" << *poseEst << std::endl;
+                LOC_LOG_DEBUG(DATA, "After reset, poseEst=" << *poseEst);
                 wasReset = true;
             }
         }
@@ -164,12 +165,12 @@ namespace loc{
     
     void VirtualDevice::run(){
         char*cwd = getcwd(NULL, 0);
-        std::cout << cwd << std::endl;
+        LOC_LOG_DEBUG(DATA, cwd);
         free(cwd);
         
         std::ifstream ifs(mCsvPath);
         if(! ifs.is_open()){
-            std::cout << mCsvPath << " is not open." << std::endl;
+            LOC_LOG_WARN(DATA, mCsvPath << " is not open.");
         }
         std::string strBuffer;
         
@@ -178,8 +179,8 @@ namespace loc{
             processLine(strBuffer);
         }
         clock_t end = clock();
-        std::cout << "end-start=" << end-start << std::endl;
-        std::cout << "average=" << (end-start)*1.0f/count_putBeacons/CLOCKS_PER_SEC << std::endl;
+        LOC_LOG_INFO(DATA, "end-start=" << end-start);
+        LOC_LOG_INFO(DATA, "average=" << (end-start)*1.0f/count_putBeacons/CLOCKS_PER_SEC);
         close();
     }
     
@@ -190,7 +191,7 @@ namespace loc{
             ofs << sstream.str();
             ofs.close();
         }else{
-            std::cout << "Results were not saved."  << std::endl;
+            LOC_LOG_WARN(DATA, "Results were not saved.");
         }
     }
     
@@ -0,0 +1,358 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include "AncestorResampler.hpp"
+#include "LocException.hpp"
+
+namespace loc{
+    
+    class Location;
+    class Pose;
+    
+    ResamplingScheme ResamplingParameters::scheme() const{
+        return scheme_;
+    }
+    
+    int ResamplingParameters::metropolisIterations() const{
+        return metropolisIterations_;
+    }
+    
+    int ResamplingParameters::numThreads() const{
+        return numThreads_;
+    }
+    
+    int ResamplingParameters::parallelThreshold() const{
+        return parallelThreshold_;
+    }
+    
+    ResamplingParameters& ResamplingParameters::scheme(ResamplingScheme value){
+        scheme_ = value;
+        return *this;
+    }
+    
+    ResamplingParameters& ResamplingParameters::metropolisIterations(int value){
+        metropolisIterations_ = value;
+        return *this;
+    }
+    
+    ResamplingParameters& ResamplingParameters::numThreads(int value){
+        numThreads_ = value;
+        return *this;
+    }
+    
+    ResamplingParameters& ResamplingParameters::parallelThreshold(int value){
+        parallelThreshold_ = value;
+        return *this;
+    }
+    
+    // Runs func(block) for block = 0, ..., numBlocks-1 on numBlocks threads including the caller's.
+    template<class Func>
+    static void runBlocks(int numBlocks, Func func){
+        std::vector<std::thread> threads;
+        threads.reserve(numBlocks-1);
+        for(int b=1; b<numBlocks; b++){
+            threads.emplace_back(func, b);
+        }
+        func(0);
+        for(auto& t: threads){
+            t.join();
+        }
+    }
+    
+    template<class Tstate>
+    AncestorResampler<Tstate>::AncestorResampler(ResamplingParameters::Ptr params){
+        parameters(params);
+    }
+    
+    template<class Tstate>
+    AncestorResampler<Tstate>& AncestorResampler<Tstate>::parameters(ResamplingParameters::Ptr params){
+        if(!params){
+            BOOST_THROW_EXCEPTION(LocException("resampling parameters are null"));
+        }
+        mParams = params;
+        return *this;
+    }
+    
+    template<class Tstate>
+    ResamplingParameters::Ptr AncestorResampler<Tstate>::parameters() const{
+        return mParams;
+    }
+    
+    template<class Tstate>
+    void AncestorResampler<Tstate>::ancestors(const double weights[], int n, int ancestors[]){
+        if(n<=0){
+            return;
+        }
+        ResamplingScheme scheme = mParams->scheme();
+        if(scheme==METROPOLIS_RESAMPLING){
+            metropolis(weights, n, ancestors);
+            return;
+        }
+        if(scheme==REJECTION_RESAMPLING){
+            rejection(weights, n, ancestors);
+            return;
+        }
+        if(scheme==SYSTEMATIC_RESAMPLING && 1 < mParams->numThreads() && mParams->parallelThreshold() <= n){
+            systematicParallel(weights, n, ancestors, std::min(mParams->numThreads(), n));
+            return;
+        }
+        double total = 0;
+        for(int i=0; i<n; i++){
+            total += weights[i];
+        }
+        if(scheme==RESIDUAL_RESAMPLING){
+            residual(weights, n, total, ancestors);
+        }else{
+            grid(weights, n, total, n, ancestors, scheme==STRATIFIED_RESAMPLING);
+        }
+    }
+    
+    // Draws m ancestors on the grid (k+u)/m. u is common to all points (systematic) or drawn for each point (stratified).
+    template<class Tstate>
+    void AncestorResampler<Tstate>::grid(const double weights[], int n, double total, int m, int ancestors[], bool stratified){
+        double u = rand.nextDouble();
+        double point = u/m;
+        double cumWeight = 0;
+        int k = 0;
+        for(int i=0; i<n && k<m; i++){
+            cumWeight += weights[i]/total;
+            if(i==n-1){
+                cumWeight = 1.0;
+            }
+            while(k<m && point < cumWeight){
+                ancestors[k] = i;
+                k++;
+                if(stratified){
+                    u = rand.nextDouble();
+                }
+                point = (k + u)/m;
+            }
+        }
+    }
+    
+    // Systematic resampling with a blocked prefix sum. Block b owns the grid points in [c_b, c_{b+1})
+    // where c_b is the cumulative weight before the block, so every point is written exactly once.
+    template<class Tstate>
+    void AncestorResampler<Tstate>::systematicParallel(const double weights[], int n, int ancestors[], int numThreads){
+        std::vector<int> begins(numThreads+1);
+        for(int b=0; b<=numThreads; b++){
+            begins[b] = static_cast<int>(static_cast<long>(n)*b/numThreads);
+        }
+        std::vector<double> blockSums(numThreads, 0.0);
+        runBlocks(numThreads, [&](int b){
+            double sum = 0;
+            for(int i=begins[b]; i<begins[b+1]; i++){
+                sum += weights[i];
+            }
+            blockSums[b] = sum;
+        });
+        std::vector<double> blockStarts(numThreads+1, 0.0);
+        for(int b=0; b<numThreads; b++){
+            blockStarts[b+1] = blockStarts[b] + blockSums[b];
+        }
+        double total = blockStarts[numThreads];
+        for(int b=0; b<numThreads; b++){
+            blockStarts[b] /= total;
+        }
+        blockStarts[numThreads] = 1.0;
+        
+        double u = rand.nextDouble();
+        runBlocks(numThreads, [&](int b){
+            double cumStart = blockStarts[b];
+            double cumEnd = blockStarts[b+1];
+            int k = std::max(0, std::min(n, static_cast<int>(std::ceil(cumStart*n - u))));
+            while(0<k && cumStart <= (k - 1 + u)/n){
+                k--;
+            }
+            while(k<n && (k + u)/n < cumStart){
+                k++;
+            }
+            double cumWeight = cumStart;
+            for(int i=begins[b]; i<begins[b+1]; i++){
+                cumWeight += weights[i]/total;
+                if(i==begins[b+1]-1){
+                    cumWeight = cumEnd;
+                }
+                while(k<n && (k + u)/n < cumWeight){
+                    ancestors[k] = i;
+                    k++;
+                }
+            }
+        });
+    }
+    
+    // floor(n w_i) copies of each state and systematic resampling of the rest on the residual weights
+    template<class Tstate>
+    void AncestorResampler<Tstate>::residual(const double weights[], int n, double total, int ancestors[]){
+        mResiduals.resize(n);
+        int k = 0;
+        double residualTotal = 0;
+        for(int i=0; i<n; i++){
+            double expected = n*weights[i]/total;
+            int copies = std::min(n - k, static_cast<int>(expected));
+            for(int j=0; j<copies; j++){
+                ancestors[k++] = i;
+            }
+            mResiduals[i] = std::max(0.0, expected - copies);
+            residualTotal += mResiduals[i];
+        }
+        if(k<n){
+            if(residualTotal<=0){
+                for(int i=0; i<n; i++){
+                    mResiduals[i] = 1.0;
+                }
+                residualTotal = n;
+            }
+            grid(&mResiduals[0], n, residualTotal, n - k, ancestors + k, false);
+        }
+    }
+    
+    // Runs func(i, rand_i) for i = 0, ..., n-1 where rand_i is the substream i of a generator keyed by
+    // a number drawn from rand. The outputs do not depend on how the indices are split into blocks.
+    template<class Tstate>
+    template<class Func>
+    void AncestorResampler<Tstate>::forEachOutput(int n, Func func){
+        RandomGenerator key(rand.nextUInt64());
+        int numBlocks = (1 < mParams->numThreads() && mParams->parallelThreshold() <= n) ? std::min(mParams->numThreads(), n) : 1;
+        runBlocks(numBlocks, [&](int b){
+            int begin = static_cast<int>(static_cast<long>(n)*b/numBlocks);
+            int end = static_cast<int>(static_cast<long>(n)*(b+1)/numBlocks);
+            for(int i=begin; i<end; i++){
+                RandomGenerator randOutput = key.substream(i);
+                func(i, randOutput);
+            }
+        });
+    }
+    
+    // Each output runs a Metropolis chain over the states starting from its own index [Murray et al.].
+    template<class Tstate>
+    void AncestorResampler<Tstate>::metropolis(const double weights[], int n, int ancestors[]){
+        int iterations = mParams->metropolisIterations();
+        forEachOutput(n, [&](int i, RandomGenerator& randOutput){
+            int k = i;
+            for(int t=0; t<iterations; t++){
+                int j = randOutput.nextInt(n-1);
+                if(randOutput.nextDouble()*weights[k] <= weights[j]){
+                    k = j;
+                }
+            }
+            ancestors[i] = k;
+        });
+    }
+    
+    // Each output keeps its own index with probability w_i/w_max and otherwise draws uniformly until acceptance.
+    template<class Tstate>
+    void AncestorResampler<Tstate>::rejection(const double weights[], int n, int ancestors[]){
+        double maxWeight = *std::max_element(weights, weights+n);
+        forEachOutput(n, [&](int i, RandomGenerator& randOutput){
+            int k = i;
+            if(0 < maxWeight){
+                while(weights[k] < randOutput.nextDouble()*maxWeight){
+                    k = randOutput.nextInt(n-1);
+                }
+            }
+            ancestors[i] = k;
+        });
+    }
+    
+    template<class Tstate>
+    std::vector<Tstate>* AncestorResampler<Tstate>::resample(const std::vector<Tstate>& states, const double weights[]){
+        int n = static_cast<int>(states.size());
+        mAncestors.resize(n);
+        ancestors(weights, n, mAncestors.data());
+        std::vector<Tstate>* statesResampled = new std::vector<Tstate>();
+        statesResampled->reserve(n);
+        for(int i=0; i<n; i++){
+            statesResampled->push_back(states[mAncestors[i]]);
+        }
+        return statesResampled;
+    }
+    
+    template<class Tstate>
+    void AncestorResampler<Tstate>::offspringCounts(const std::vector<Tstate>& states, const double weights[], int counts[]){
+        int n = static_cast<int>(states.size());
+        mAncestors.resize(n);
+        ancestors(weights, n, mAncestors.data());
+        std::fill(counts, counts+n, 0);
+        for(int i=0; i<n; i++){
+            counts[mAncestors[i]]++;
+        }
+    }
+    
+    template<class Tstate>
+    void AncestorResampler<Tstate>::resampleInPlace(std::vector<Tstate>& states, const double weights[]){
+        int n = static_cast<int>(states.size());
+        mAncestors.resize(n);
+        ancestors(weights, n, mAncestors.data());
+        permute(states, mAncestors.data());
+    }
+    
+    // Places each ancestor with offspring at its own slot first, so that it is never overwritten,
+    // and copies the other offspring into the slots of the states without offspring.
+    template<class Tstate>
+    void AncestorResampler<Tstate>::permute(std::vector<Tstate>& states, const int ancestors[]){
+        int n = static_cast<int>(states.size());
+        mSlots.assign(n, -1);
+        mPlaced.assign(n, 0);
+        for(int i=0; i<n; i++){
+            int a = ancestors[i];
+            if(mSlots[a]<0){
+                mSlots[a] = a;
+                mPlaced[i] = 1;
+            }
+        }
+        int slot = 0;
+        for(int i=0; i<n; i++){
+            if(mPlaced[i]){
+                continue;
+            }
+            while(0<=mSlots[slot]){
+                slot++;
+            }
+            mSlots[slot] = ancestors[i];
+        }
+        for(int i=0; i<n; i++){
+            if(mSlots[i]!=i){
+                states[i] = states[mSlots[i]];
+            }
+        }
+    }
+    
+    template<class Tstate>
+    void AncestorResampler<Tstate>::saveState(SnapshotOutputArchive& ar) const{
+        ar(cereal::make_nvp("randomGenerator", rand));
+    }
+    
+    template<class Tstate>
+    void AncestorResampler<Tstate>::loadState(SnapshotInputArchive& ar){
+        ar(cereal::make_nvp("randomGenerator", rand));
+    }
+    
+    // Explicit instantiation
+    template class AncestorResampler<Location>;
+    template class AncestorResampler<Pose>;
+    template class AncestorResampler<State>;
+    
+}
@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef AncestorResampler_hpp
+#define AncestorResampler_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <memory>
+#include "bleloc.h"
+#include "Resampler.hpp"
+#include "RandomGenerator.hpp"
+#include "SnapshotUtils.hpp"
+
+namespace loc{
+    
+    typedef enum {
+        SYSTEMATIC_RESAMPLING = 0,
+        STRATIFIED_RESAMPLING = 1,
+        RESIDUAL_RESAMPLING = 2,
+        METROPOLIS_RESAMPLING = 3, // no prefix sum, biased for small metropolisIterations
+        REJECTION_RESAMPLING = 4 // no prefix sum, needs the maximum weight
+    } ResamplingScheme;
+    
+    class ResamplingParameters{
+    protected:
+        ResamplingScheme scheme_ = SYSTEMATIC_RESAMPLING;
+        int metropolisIterations_ = 32;
+        // With at least parallelThreshold states, systematic resampling computes the prefix sum in numThreads
+        // blocks and Metropolis and rejection resampling split the outputs into numThreads blocks.
+        int numThreads_ = 1;
+        int parallelThreshold_ = 100000;
+        
+    public:
+        using Ptr = std::shared_ptr<ResamplingParameters>;
+        ResamplingScheme scheme() const;
+        int metropolisIterations() const;
+        int numThreads() const;
+        int parallelThreshold() const;
+        ResamplingParameters& scheme(ResamplingScheme);
+        ResamplingParameters& metropolisIterations(int);
+        ResamplingParameters& numThreads(int);
+        ResamplingParameters& parallelThreshold(int);
+        
+        template<class Archive>
+        void serialize(Archive & ar, std::uint32_t const version)
+        {
+            ar(CEREAL_NVP(scheme_));
+            ar(CEREAL_NVP(metropolisIterations_));
+            ar(CEREAL_NVP(numThreads_));
+            ar(CEREAL_NVP(parallelThreshold_));
+        }
+    };
+    
+    // Resampler computing ancestor indices into a buffer. The states are copied from their ancestors
+    // either into a new vector (resample) or in place (resampleInPlace).
+    template<class Tstate> class AncestorResampler : public Resampler<Tstate>, public Snapshottable{
+        
+    public:
+        AncestorResampler(ResamplingParameters::Ptr params = std::make_shared<ResamplingParameters>());
+        ~AncestorResampler(){}
+        
+        AncestorResampler& parameters(ResamplingParameters::Ptr params);
+        ResamplingParameters::Ptr parameters() const;
+        
+        // Writes n ancestor indices for the weights of n states. The weights do not have to be normalized.
+        void ancestors(const double weights[], int n, int ancestors[]);
+        
+        std::vector<Tstate>* resample(const std::vector<Tstate>& states, const double weights[]) override;
+        void offspringCounts(const std::vector<Tstate>& states, const double weights[], int counts[]) override;
+        // Overwrites only the states without offspring.
+        void resampleInPlace(std::vector<Tstate>& states, const double weights[]);
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
+        
+    private:
+        ResamplingParameters::Ptr mParams;
+        RandomGenerator rand;
+        
+        // buffers reused between calls
+        std::vector<int> mAncestors;
+        std::vector<int> mSlots;
+        std::vector<char> mPlaced;
+        std::vector<double> mResiduals;
+        
+        void grid(const double weights[], int n, double total, int m, int ancestors[], bool stratified);
+        void systematicParallel(const double weights[], int n, int ancestors[], int numThreads);
+        void residual(const double weights[], int n, double total, int ancestors[]);
+        void metropolis(const double weights[], int n, int ancestors[]);
+        void rejection(const double weights[], int n, int ancestors[]);
+        template<class Func> void forEachOutput(int n, Func func);
+        void permute(std::vector<Tstate>& states, const int ancestors[]);
+    };
+    
+}
+
+CEREAL_CLASS_VERSION(loc::ResamplingParameters, 0);
+
+#endif /* AncestorResampler_hpp */
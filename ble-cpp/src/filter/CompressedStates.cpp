@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "CompressedStates.hpp"
+#include "LocException.hpp"
+
+namespace loc{
+    
+    static double savedRatio(long total, long used){
+        return 0<total ? 1.0 - static_cast<double>(used)/total : 0.0;
+    }
+    
+    void StatesCompressionStatistics::addResampling(size_t nStates, size_t nUnique){
+        frames++;
+        states += nStates;
+        uniqueStates += nUnique;
+        lastStates = nStates;
+        lastUniqueStates = nUnique;
+    }
+    
+    void StatesCompressionStatistics::addPrediction(size_t nStates, size_t nGroups){
+        predictedStates += nStates;
+        predictedGroups += nGroups;
+    }
+    
+    void StatesCompressionStatistics::addLikelihood(size_t nStates, size_t nEvaluations){
+        evaluatedStates += nStates;
+        likelihoodEvaluations += nEvaluations;
+        lastEvaluatedStates = nStates;
+        lastLikelihoodEvaluations = nEvaluations;
+    }
+    
+    double StatesCompressionStatistics::savedRatio() const{
+        return loc::savedRatio(states, uniqueStates);
+    }
+    
+    double StatesCompressionStatistics::lastSavedRatio() const{
+        return loc::savedRatio(lastStates, lastUniqueStates);
+    }
+    
+    double StatesCompressionStatistics::predictionSavedRatio() const{
+        return loc::savedRatio(predictedStates, predictedGroups);
+    }
+    
+    double StatesCompressionStatistics::likelihoodSavedRatio() const{
+        return loc::savedRatio(evaluatedStates, likelihoodEvaluations);
+    }
+    
+    double StatesCompressionStatistics::lastLikelihoodSavedRatio() const{
+        return loc::savedRatio(lastEvaluatedStates, lastLikelihoodEvaluations);
+    }
+    
+    std::ostream& operator<<(std::ostream&os, const StatesCompressionStatistics& stats){
+        os << "frames=" << stats.frames
+        << ",states=" << stats.states
+        << ",uniqueStates=" << stats.uniqueStates
+        << ",savedRatio=" << stats.savedRatio()
+        << ",predictionSavedRatio=" << stats.predictionSavedRatio()
+        << ",likelihoodSavedRatio=" << stats.likelihoodSavedRatio()
+        << ",lastStates=" << stats.lastStates
+        << ",lastUniqueStates=" << stats.lastUniqueStates;
+        return os;
+    }
+    
+    CompressedStates::CompressedStates(const std::vector<State>& states, const std::vector<int>& counts){
+        if(states.size()!=counts.size()){
+            BOOST_THROW_EXCEPTION(LocException("the numbers of states and counts are different"));
+        }
+        for(size_t i=0; i<states.size(); i++){
+            if(0<counts[i]){
+                mUniqueStates.push_back(states[i]);
+                mMultiplicities.push_back(counts[i]);
+                mIndices.insert(mIndices.end(), counts[i], mUniqueStates.size()-1);
+            }
+        }
+    }
+    
+    CompressedStates::CompressedStates(const std::vector<State>& states){
+        mIndices.reserve(states.size());
+        for(const State& s: states){
+            if(mUniqueStates.size()==0 || !isObservedIdentically(mUniqueStates.back(), s)){
+                mUniqueStates.push_back(s);
+                mMultiplicities.push_back(0);
+            }
+            mMultiplicities.back()++;
+            mIndices.push_back(mUniqueStates.size()-1);
+        }
+    }
+    
+    std::vector<State> CompressedStates::expand() const{
+        std::vector<State> states;
+        states.reserve(mIndices.size());
+        for(size_t idx: mIndices){
+            states.push_back(mUniqueStates[idx]);
+        }
+        return states;
+    }
+    
+    const std::vector<State>& CompressedStates::uniqueStates() const{
+        return mUniqueStates;
+    }
+    
+    const std::vector<int>& CompressedStates::multiplicities() const{
+        return mMultiplicities;
+    }
+    
+    const std::vector<size_t>& CompressedStates::indices() const{
+        return mIndices;
+    }
+    
+    size_t CompressedStates::size() const{
+        return mIndices.size();
+    }
+    
+    size_t CompressedStates::numUnique() const{
+        return mUniqueStates.size();
+    }
+    
+    bool CompressedStates::isObservedIdentically(const State& s1, const State& s2){
+        return s1.x()==s2.x() && s1.y()==s2.y() && s1.z()==s2.z() && s1.floor()==s2.floor()
+        && s1.rssiBias()==s2.rssiBias() && s1.rssiBiasVariance()==s2.rssiBiasVariance();
+    }
+}
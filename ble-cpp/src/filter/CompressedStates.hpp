@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef CompressedStates_hpp
+#define CompressedStates_hpp
+
+#include <stdio.h>
+#include <iostream>
+#include "bleloc.h"
+#include "State.hpp"
+
+namespace loc{
+    
+    class StatesCompressionStatistics{
+    public:
+        // states and unique ancestors after resampling
+        long frames = 0;
+        long states = 0;
+        long uniqueStates = 0;
+        // states predicted from the compressed form and their groups (location lookups)
+        long predictedStates = 0;
+        long predictedGroups = 0;
+        // states and likelihood evaluations at the likelihood step
+        long evaluatedStates = 0;
+        long likelihoodEvaluations = 0;
+        // the latest frame
+        size_t lastStates = 0;
+        size_t lastUniqueStates = 0;
+        size_t lastEvaluatedStates = 0;
+        size_t lastLikelihoodEvaluations = 0;
+        
+        void addResampling(size_t nStates, size_t nUnique);
+        void addPrediction(size_t nStates, size_t nGroups);
+        void addLikelihood(size_t nStates, size_t nEvaluations);
+        // ratio of duplicated states after resampling
+        double savedRatio() const;
+        double lastSavedRatio() const;
+        // ratio of location lookups saved in predictions
+        double predictionSavedRatio() const;
+        // ratio of likelihood evaluations saved by sharing them between identical copies
+        double likelihoodSavedRatio() const;
+        double lastLikelihoodSavedRatio() const;
+        
+        friend std::ostream& operator<<(std::ostream&os, const StatesCompressionStatistics& stats);
+    };
+    
+    // States stored as unique states with integer multiplicities.
+    class CompressedStates{
+    public:
+        CompressedStates() = default;
+        // The states with their numbers of offspring given by a resampler. States without offspring are removed.
+        CompressedStates(const std::vector<State>& states, const std::vector<int>& counts);
+        // Merges adjacent states for which the observation model gives the same values (see isObservedIdentically).
+        // The copies of an ancestor are kept next to each other through prediction, so copies that were not moved
+        // apart (e.g. while standing still) are merged.
+        CompressedStates(const std::vector<State>& states);
+        
+        const std::vector<State>& uniqueStates() const;
+        const std::vector<int>& multiplicities() const;
+        // index of the unique state of each original state
+        const std::vector<size_t>& indices() const;
+        size_t size() const;
+        size_t numUnique() const;
+        
+        // The original states with the copies of each unique state next to each other
+        std::vector<State> expand() const;
+        
+        // Expands values computed for the unique states to the original states.
+        template<class T>
+        std::vector<T> expand(const std::vector<T>& valuesOfUnique) const{
+            std::vector<T> values;
+            values.reserve(mIndices.size());
+            for(size_t idx: mIndices){
+                values.push_back(valuesOfUnique.at(idx));
+            }
+            return values;
+        }
+        
+        // Same location and RSSI bias, on which the likelihood of a state depends
+        static bool isObservedIdentically(const State& s1, const State& s2);
+        
+    private:
+        std::vector<State> mUniqueStates;
+        std::vector<int> mMultiplicities;
+        std::vector<size_t> mIndices;
+    };
+}
+
+#endif /* CompressedStates_hpp */
@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <Eigen/Dense>
+#include "EnsembleKalmanUpdater.hpp"
+#include "LocException.hpp"
+
+namespace loc{
+    
+    static const int DIM = 4; // x, y, orientationBias, rssiBias
+    
+    EnsembleKalmanUpdater::EnsembleKalmanUpdater(std::shared_ptr<Model> model) : mModel(model){
+        if(!model){
+            BOOST_THROW_EXCEPTION(LocException("model is null"));
+        }
+    }
+    
+    EnsembleKalmanUpdater& EnsembleKalmanUpdater::jacobianStep(double step){
+        mJacobianStep = step;
+        return *this;
+    }
+    
+    double EnsembleKalmanUpdater::jacobianStep() const{
+        return mJacobianStep;
+    }
+    
+    EnsembleKalmanUpdater::Result EnsembleKalmanUpdater::update(std::vector<State>& ensemble, const Beacons& beacons, const Building& building, RandomGenerator& rand) const{
+        Result result;
+        size_t n = ensemble.size();
+        if(n<2){
+            return result;
+        }
+        
+        // Ensemble mean and anomalies. Orientation biases are unwrapped around the first member.
+        const State& ref = ensemble.front();
+        Eigen::MatrixXd Z(DIM, n);
+        for(size_t i=0; i<n; i++){
+            const State& s = ensemble.at(i);
+            Z(0,i) = s.x();
+            Z(1,i) = s.y();
+            Z(2,i) = ref.orientationBias() + Pose::normalizeOrientaion(s.orientationBias() - ref.orientationBias());
+            Z(3,i) = s.rssiBias();
+        }
+        Eigen::VectorXd zMean = Z.rowwise().mean();
+        Eigen::MatrixXd A = Z.colwise() - zMean;
+        Eigen::MatrixXd P = A*A.transpose()/(n-1);
+        // marginalized RSSI biases carry their own variance
+        double meanBiasVariance = 0;
+        for(const State& s: ensemble){
+            meanBiasVariance += s.rssiBiasVariance()/n;
+        }
+        P(3,3) += meanBiasVariance;
+        
+        // Linearize the RSSI model at the mean
+        State meanState(ref);
+        meanState.x(zMean(0)).y(zMean(1));
+        auto statsMean = mModel->predict(meanState, beacons);
+        size_t m = statsMean.size();
+        if(m==0){
+            return result;
+        }
+        double h = mJacobianStep;
+        State sxp(meanState), sxm(meanState), syp(meanState), sym(meanState);
+        sxp.x(zMean(0)+h);
+        sxm.x(zMean(0)-h);
+        syp.y(zMean(1)+h);
+        sym.y(zMean(1)-h);
+        auto statsXP = mModel->predict(sxp, beacons);
+        auto statsXM = mModel->predict(sxm, beacons);
+        auto statsYP = mModel->predict(syp, beacons);
+        auto statsYM = mModel->predict(sym, beacons);
+        
+        std::map<long, double> rssiMap;
+        for(const Beacon& b: beacons){
+            rssiMap[b.id()] = b.rssi();
+        }
+        Eigen::VectorXd y(m), hMean(m), stdevs(m);
+        Eigen::MatrixXd H = Eigen::MatrixXd::Zero(m, DIM);
+        size_t j = 0;
+        for(const auto& pair: statsMean){
+            long id = pair.first;
+            y(j) = rssiMap.at(id);
+            hMean(j) = pair.second.mean() + zMean(3);
+            stdevs(j) = pair.second.stdev();
+            H(j,0) = (statsXP.at(id).mean() - statsXM.at(id).mean())/(2*h);
+            H(j,1) = (statsYP.at(id).mean() - statsYM.at(id).mean())/(2*h);
+            H(j,3) = 1.0;
+            j++;
+        }
+        Eigen::MatrixXd S = H*P*H.transpose();
+        S.diagonal() += stdevs.cwiseProduct(stdevs);
+        auto ldlt = S.ldlt();
+        Eigen::VectorXd innovation = y - hMean;
+        result.nObservations = m;
+        result.normalizedInnovation = innovation.dot(ldlt.solve(innovation))/m;
+        // K = P H^T S^-1
+        Eigen::MatrixXd K = ldlt.solve(H*P).transpose();
+        double biasVarianceRatio = 1.0;
+        if(0<P(3,3)){
+            Eigen::MatrixXd KHP = K*H*P;
+            biasVarianceRatio = std::max(0.0, (P(3,3) - KHP(3,3))/P(3,3));
+        }
+        
+        // Update the members with perturbed observations
+        Eigen::VectorXd noise(m);
+        for(size_t i=0; i<n; i++){
+            for(size_t k=0; k<m; k++){
+                noise(k) = stdevs(k)*rand.nextGaussian();
+            }
+            Eigen::VectorXd dz = K*(y + noise - hMean - H*A.col(i));
+            State& s = ensemble.at(i);
+            State updated(s);
+            updated.x(s.x() + dz(0)).y(s.y() + dz(1));
+            s.weight(1.0/n);
+            if(!building.checkMovableRoute(s, updated)){
+                result.nRejected++;
+                continue;
+            }
+            s.x(updated.x()).y(updated.y());
+            s.orientationBias(s.orientationBias() + dz(2));
+            s.orientation(Pose::normalizeOrientaion(s.orientation() - dz(2)));
+            s.rssiBias(s.rssiBias() + dz(3));
+            s.rssiBiasVariance(s.rssiBiasVariance()*biasVarianceRatio);
+        }
+        return result;
+    }
+}
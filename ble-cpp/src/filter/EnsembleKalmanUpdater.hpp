@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef EnsembleKalmanUpdater_hpp
+#define EnsembleKalmanUpdater_hpp
+
+#include <stdio.h>
+#include "bleloc.h"
+#include "Building.hpp"
+#include "GaussianProcessLDPLMultiModel.hpp"
+#include "RandomGenerator.hpp"
+
+namespace loc{
+    
+    // Kalman update of an ensemble of states over (x, y, orientationBias, rssiBias).
+    // The covariance is estimated from the ensemble and the RSSI model is linearized at the ensemble mean
+    // (central differences in x and y). Each member is updated with perturbed observations, and a member
+    // that cannot move to its updated location through the building is left unchanged.
+    class EnsembleKalmanUpdater{
+    public:
+        using Ptr = std::shared_ptr<EnsembleKalmanUpdater>;
+        using Model = GaussianProcessLDPLMultiModel<State, Beacons>;
+        
+        class Result{
+        public:
+            size_t nObservations = 0;
+            // squared Mahalanobis norm of the innovation divided by nObservations (about 1 when consistent)
+            double normalizedInnovation = 0;
+            size_t nRejected = 0;
+        };
+        
+        EnsembleKalmanUpdater(std::shared_ptr<Model> model);
+        
+        EnsembleKalmanUpdater& jacobianStep(double step);
+        double jacobianStep() const;
+        
+        // Only beacons known to the model are used.
+        Result update(std::vector<State>& ensemble, const Beacons& beacons, const Building& building, RandomGenerator& rand) const;
+        
+    private:
+        std::shared_ptr<Model> mModel;
+        double mJacobianStep = 0.5; // [m]
+    };
+}
+
+#endif /* EnsembleKalmanUpdater_hpp */
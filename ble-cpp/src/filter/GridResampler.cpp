@@ -31,6 +31,22 @@ namespace loc{
         
         int n = (int) states.size();
         std::vector<Tstate>* statesResampled = new std::vector<Tstate>();
+        statesResampled->reserve(n);
+        
+        std::vector<int> counts(n);
+        offspringCounts(states, weights, counts.data());
+        for(int i=0; i<n; i++){
+            for(int j=0; j<counts[i]; j++){
+                Tstate stateCopied(states.at(i));
+                statesResampled->push_back(stateCopied);
+            }
+        }
+        return statesResampled;
+    }
+    
+    template<class Tstate> void GridResampler<Tstate>::offspringCounts(const std::vector<Tstate>& states, const double weights[], int counts[]){
+        
+        int n = (int) states.size();
         
         double d = rand.nextDouble();
         std::vector<double> grid(n);
@@ -52,15 +68,23 @@ namespace loc{
             }
             for( ; k<n; k++){
                 if(grid[k] < cumWeight){
-                    Tstate stateCopied(states.at(i));
-                    statesResampled->push_back(stateCopied);
                     numSample++;
                 }else{
                     break;
                 }
             }
+            counts[i] = numSample;
         }
-        return statesResampled;
+    }
+    
+    template<class Tstate>
+    void GridResampler<Tstate>::saveState(SnapshotOutputArchive& ar) const{
+        ar(cereal::make_nvp("randomGenerator", rand));
+    }
+    
+    template<class Tstate>
+    void GridResampler<Tstate>::loadState(SnapshotInputArchive& ar){
+        ar(cereal::make_nvp("randomGenerator", rand));
     }
     
     // Explicit instantiation
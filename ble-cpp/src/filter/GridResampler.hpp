@@ -27,15 +27,20 @@
 #include "bleloc.h"
 #include "Resampler.hpp"
 #include "RandomGenerator.hpp"
+#include "SnapshotUtils.hpp"
 
 namespace loc{
 
-    template<class Tstate> class GridResampler : public Resampler<Tstate>{
+    template<class Tstate> class GridResampler : public Resampler<Tstate>, public Snapshottable{
     
     public:
         ~GridResampler(){}
         
         std::vector<Tstate>* resample(const std::vector<Tstate>& states, const double weights[]);
+        void offspringCounts(const std::vector<Tstate>& states, const double weights[], int counts[]);
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
     
     private:
         enum GridType{SYSTEMATIC, STRATIFIED};
@@ -32,6 +32,9 @@ namespace loc{
     public:
         virtual ~Resampler(){}
         virtual std::vector<Tstate>* resample(const std::vector<Tstate> & states, const double weights[]) = 0;
+        // Writes the number of offspring of each state instead of copying the states, so that the
+        // offspring of an ancestor can be kept once with its multiplicity.
+        virtual void offspringCounts(const std::vector<Tstate> & states, const double weights[], int counts[]) = 0;
     };
     
 }
@@ -0,0 +1,773 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "GridPointMassFilter.hpp"
+#include "Logger.hpp"
+#include "LocException.hpp"
+
+namespace loc{
+    
+    double GridPointMassFilter::Parameters::resolution() const{
+        return resolution_;
+    }
+    
+    int GridPointMassFilter::Parameters::kernelRadius() const{
+        return kernelRadius_;
+    }
+    
+    int GridPointMassFilter::Parameters::maxConvolutions() const{
+        return maxConvolutions_;
+    }
+    
+    double GridPointMassFilter::Parameters::sigmaMove() const{
+        return sigmaMove_;
+    }
+    
+    double GridPointMassFilter::Parameters::sigmaStop() const{
+        return sigmaStop_;
+    }
+    
+    double GridPointMassFilter::Parameters::floorTransitionRate() const{
+        return floorTransitionRate_;
+    }
+    
+    double GridPointMassFilter::Parameters::uniformMixture() const{
+        return uniformMixture_;
+    }
+    
+    GridPointMassFilter::Parameters& GridPointMassFilter::Parameters::resolution(double resolution){
+        if(resolution<=0){
+            BOOST_THROW_EXCEPTION(LocException("resolution must be positive"));
+        }
+        resolution_ = resolution;
+        return *this;
+    }
+    
+    GridPointMassFilter::Parameters& GridPointMassFilter::Parameters::kernelRadius(int kernelRadius){
+        if(kernelRadius<1){
+            BOOST_THROW_EXCEPTION(LocException("kernelRadius must be at least 1"));
+        }
+        kernelRadius_ = kernelRadius;
+        return *this;
+    }
+    
+    GridPointMassFilter::Parameters& GridPointMassFilter::Parameters::maxConvolutions(int maxConvolutions){
+        if(maxConvolutions<1){
+            BOOST_THROW_EXCEPTION(LocException("maxConvolutions must be at least 1"));
+        }
+        maxConvolutions_ = maxConvolutions;
+        return *this;
+    }
+    
+    GridPointMassFilter::Parameters& GridPointMassFilter::Parameters::sigmaMove(double sigmaMove){
+        sigmaMove_ = sigmaMove;
+        return *this;
+    }
+    
+    GridPointMassFilter::Parameters& GridPointMassFilter::Parameters::sigmaStop(double sigmaStop){
+        sigmaStop_ = sigmaStop;
+        return *this;
+    }
+    
+    GridPointMassFilter::Parameters& GridPointMassFilter::Parameters::floorTransitionRate(double floorTransitionRate){
+        floorTransitionRate_ = floorTransitionRate;
+        return *this;
+    }
+    
+    GridPointMassFilter::Parameters& GridPointMassFilter::Parameters::uniformMixture(double uniformMixture){
+        uniformMixture_ = uniformMixture;
+        return *this;
+    }
+    
+    GridPointMassFilter::GridPointMassFilter() : mStatus(new Status()){
+        mStatus->states(std::make_shared<States>());
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::optVerbose(bool optVerbose){
+        mOptVerbose = optVerbose;
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::numStates(int numStates){
+        mNumStates = numStates;
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::alphaWeaken(double alphaWeaken){
+        mAlphaWeaken = alphaWeaken;
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::rssiBias(double rssiBias){
+        mRssiBias = rssiBias;
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::parameters(Parameters::Ptr params){
+        mParams = params;
+        discardGridIfMismatched();
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::building(Building::Ptr building){
+        mBuilding = building;
+        discardGridIfMismatched();
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::observationModel(ObservationModelPtr model){
+        mObservationModel = model;
+        discardGridIfMismatched();
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::beaconFilter(std::shared_ptr<BeaconFilter> beaconFilter){
+        mBeaconFilter = beaconFilter;
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::pedometer(Pedometer::Ptr pedometer){
+        mPedometer = pedometer;
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::orientationMeter(OrientationMeter::Ptr orientationMeter){
+        mOrientationMeter = orientationMeter;
+        return *this;
+    }
+    
+    GridPointMassFilter& GridPointMassFilter::grid(Grid::Ptr grid){
+        if(grid && !grid->isBuiltFor(mBuilding, *mParams, mObservationModel)){
+            BOOST_THROW_EXCEPTION(LocException("grid was built for another building, model or parameters"));
+        }
+        mGrid = grid;
+        mProbability.clear();
+        return *this;
+    }
+    
+    GridPointMassFilter::Grid::Ptr GridPointMassFilter::grid() const{
+        return mGrid;
+    }
+    
+    size_t GridPointMassFilter::numCells() const{
+        return mGrid ? mGrid->numCells() : 0;
+    }
+    
+    void GridPointMassFilter::discardGridIfMismatched(){
+        if(mGrid && !mGrid->isBuiltFor(mBuilding, *mParams, mObservationModel)){
+            mGrid.reset();
+            mProbability.clear();
+        }
+    }
+    
+    StreamLocalizer& GridPointMassFilter::updateHandler(void (*functionCalledAfterUpdate)(Status*)){
+        mFunctionCalledAfterUpdate = functionCalledAfterUpdate;
+        return *this;
+    }
+    
+    StreamLocalizer& GridPointMassFilter::updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData){
+        mFunctionCalledAfterUpdate2 = functionCalledAfterUpdate;
+        mUserData = inUserData;
+        return *this;
+    }
+    
+    void GridPointMassFilter::callback(Status* status){
+        if(mFunctionCalledAfterUpdate!=NULL){
+            mFunctionCalledAfterUpdate(status);
+        }
+        if(mFunctionCalledAfterUpdate2!=NULL){
+            mFunctionCalledAfterUpdate2(mUserData, status);
+        }
+    }
+    
+    GridPointMassFilter::Grid::Ptr GridPointMassFilter::Grid::build(Building::Ptr building, const Parameters& params, ObservationModelPtr model){
+        if(!building){
+            BOOST_THROW_EXCEPTION(LocException("building is not set to GridPointMassFilter"));
+        }
+        std::shared_ptr<Grid> grid(new Grid());
+        grid->mBuilding = building;
+        grid->mObservationModel = model;
+        grid->mResolution = params.resolution();
+        grid->mKernelRadius = params.kernelRadius();
+        grid->buildCells();
+        grid->predictCells();
+        return grid;
+    }
+    
+    bool GridPointMassFilter::Grid::isBuiltFor(const Building::Ptr& building, const Parameters& params, const ObservationModelPtr& model) const{
+        return mBuilding==building && mObservationModel==model
+        && mResolution==params.resolution() && mKernelRadius==params.kernelRadius();
+    }
+    
+    size_t GridPointMassFilter::Grid::numCells() const{
+        return mCells.size();
+    }
+    
+    void GridPointMassFilter::Grid::buildCells(){
+        auto start = std::chrono::steady_clock::now();
+        const Building& building = *mBuilding;
+        const double res = mResolution;
+        const int radius = mKernelRadius;
+        
+        // All floors share one lattice so that the cells of a transition area are aligned vertically.
+        double xmin = std::numeric_limits<double>::max();
+        double ymin = std::numeric_limits<double>::max();
+        double xmax = std::numeric_limits<double>::lowest();
+        double ymax = std::numeric_limits<double>::lowest();
+        for(int f=building.minFloor(); f<=building.maxFloor(); f++){
+            if(!building.hasFloor(f)){
+                continue;
+            }
+            const FloorMap& floorMap = building.getFloorAt(f);
+            Location lb = floorMap.lowerBound();
+            Location ub = floorMap.upperBound();
+            xmin = std::min(xmin, lb.x());
+            ymin = std::min(ymin, lb.y());
+            xmax = std::max(xmax, ub.x());
+            ymax = std::max(ymax, ub.y());
+        }
+        if(xmax<xmin || ymax<ymin){
+            BOOST_THROW_EXCEPTION(LocException("building has no floor"));
+        }
+        int nx = static_cast<int>(std::ceil((xmax-xmin)/res));
+        int ny = static_cast<int>(std::ceil((ymax-ymin)/res));
+        int nf = building.maxFloor() - building.minFloor() + 1;
+        auto lookupIndex = [&](int ix, int iy, int f){
+            return (static_cast<size_t>(f - building.minFloor())*ny + iy)*nx + ix;
+        };
+        
+        std::vector<int> lookup(static_cast<size_t>(nf)*nx*ny, -1);
+        std::vector<std::pair<int,int>> cellIndices;
+        mCells.clear();
+        for(int f=building.minFloor(); f<=building.maxFloor(); f++){
+            if(!building.hasFloor(f)){
+                continue;
+            }
+            const FloorMap& floorMap = building.getFloorAt(f);
+            Location lb = floorMap.lowerBound();
+            Location ub = floorMap.upperBound();
+            for(int iy=0; iy<ny; iy++){
+                for(int ix=0; ix<nx; ix++){
+                    double x = xmin + (ix+0.5)*res;
+                    double y = ymin + (iy+0.5)*res;
+                    if(x<lb.x() || ub.x()<x || y<lb.y() || ub.y()<y){
+                        continue;
+                    }
+                    Location loc(x, y, 0, f);
+                    if(!floorMap.isMovable(loc)){
+                        continue;
+                    }
+                    lookup[lookupIndex(ix, iy, f)] = static_cast<int>(mCells.size());
+                    mCells.push_back(Cell{x, y, f, floorMap.isTransitionArea(loc)});
+                    cellIndices.push_back(std::make_pair(ix, iy));
+                }
+            }
+        }
+        if(mCells.size()==0){
+            BOOST_THROW_EXCEPTION(LocException("building has no movable cell"));
+        }
+        
+        // Motion kernel support: cells within the radius that are reachable without crossing a wall.
+        mNeighbourBegin.assign(1, 0);
+        mNeighbourIndices.clear();
+        mNeighbourOffset2.clear();
+        mTransitionBegin.assign(1, 0);
+        mTransitionIndices.clear();
+        for(size_t i=0; i<mCells.size(); i++){
+            const Cell& c = mCells[i];
+            int ix = cellIndices[i].first;
+            int iy = cellIndices[i].second;
+            Location loc(c.x, c.y, 0, c.floor);
+            for(int dy=-radius; dy<=radius; dy++){
+                for(int dx=-radius; dx<=radius; dx++){
+                    int d2 = dx*dx + dy*dy;
+                    if(radius*radius < d2 || ix+dx<0 || nx<=ix+dx || iy+dy<0 || ny<=iy+dy){
+                        continue;
+                    }
+                    int j = lookup[lookupIndex(ix+dx, iy+dy, c.floor)];
+                    if(j<0){
+                        continue;
+                    }
+                    const Cell& cj = mCells[j];
+                    if(0<d2 && !building.checkMovableRoute(loc, Location(cj.x, cj.y, 0, cj.floor))){
+                        continue;
+                    }
+                    mNeighbourIndices.push_back(j);
+                    mNeighbourOffset2.push_back(d2);
+                }
+            }
+            mNeighbourBegin.push_back(mNeighbourIndices.size());
+            
+            if(c.isTransitionArea){
+                for(int df: {-1, 1}){
+                    int f = c.floor + df;
+                    if(f<building.minFloor() || building.maxFloor()<f){
+                        continue;
+                    }
+                    int j = lookup[lookupIndex(ix, iy, f)];
+                    if(0<=j && mCells[j].isTransitionArea){
+                        mTransitionIndices.push_back(j);
+                    }
+                }
+            }
+            mTransitionBegin.push_back(mTransitionIndices.size());
+        }
+        
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+        LOC_LOG_INFO(FILTER, "GridPointMassFilter built " << mCells.size() << " cells (" << nx << "x" << ny << "x" << nf
+                     << ", " << mNeighbourIndices.size() << " kernel entries, " << mTransitionIndices.size() << " transition links) in " << msec << "ms");
+    }
+    
+    void GridPointMassFilter::initializeGridIfEmpty(){
+        if(!mGrid){
+            mGrid = Grid::build(mBuilding, *mParams, mObservationModel);
+        }
+        if(mProbability.size()!=mGrid->numCells()){
+            const int radius = mParams->kernelRadius();
+            mKernel.assign(radius*radius+1, 0.0);
+            mWork.assign(mGrid->numCells(), 0.0);
+            mProbability.assign(mGrid->numCells(), 1.0/mGrid->numCells());
+            updateStatus(mStatus->timestamp(), Status::OTHER);
+        }
+    }
+    
+    Beacons GridPointMassFilter::filterBeacons(const Beacons& beacons) const{
+        const Beacons& beaconsCleansed = mCleansingBeaconFilter.filter(beacons);
+        Beacons beaconsFiltered = mBeaconFilter? mBeaconFilter->filter(beaconsCleansed) : beaconsCleansed;
+        beaconsFiltered.timestamp(beacons.timestamp());
+        return beaconsFiltered;
+    }
+    
+    // Predicts the RSSI of all the known beacons at every cell so that beacon updates only look them up.
+    // The GP prediction at a cell is made for all the beacons at once.
+    void GridPointMassFilter::Grid::predictCells(){
+        mCellPredictions.clear();
+        if(!mObservationModel || mCells.size()==0){
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        Beacons knownBeacons;
+        for(const BLEBeacon& ble: mObservationModel->bleBeacons()){
+            knownBeacons.push_back(Beacon(ble.major(), ble.minor(), 0));
+        }
+        for(const Beacon& b: knownBeacons){
+            CellPrediction& prediction = mCellPredictions[b.id()];
+            prediction.mean.reserve(mCells.size());
+            prediction.stdev.reserve(mCells.size());
+        }
+        for(const Cell& c: mCells){
+            State s;
+            s.x(c.x);
+            s.y(c.y);
+            s.z(0);
+            s.floor(c.floor);
+            auto rssiStats = mObservationModel->predict(s, knownBeacons);
+            for(auto& pair: mCellPredictions){
+                const NormalParameter& np = rssiStats.at(pair.first);
+                pair.second.mean.push_back(static_cast<float>(np.mean()));
+                pair.second.stdev.push_back(static_cast<float>(np.stdev()));
+            }
+        }
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+        LOC_LOG_INFO(FILTER, "GridPointMassFilter predicted RSSI of " << mCellPredictions.size() << " beacons at " << mCells.size() << " cells in " << msec << "ms");
+    }
+    
+    const GridPointMassFilter::Grid::CellPrediction* GridPointMassFilter::Grid::cellPrediction(long id) const{
+        auto iter = mCellPredictions.find(id);
+        return iter==mCellPredictions.end() ? NULL : &iter->second;
+    }
+    
+    std::vector<double> GridPointMassFilter::computeLogLikelihood(const Beacons& beacons){
+        if(!mObservationModel){
+            BOOST_THROW_EXCEPTION(LocException("observation model is not set to GridPointMassFilter"));
+        }
+        const size_t n = mGrid->numCells();
+        std::vector<double> logLikelihood(n, 0.0);
+        const auto& normFunc = mObservationModel->normFunc;
+        for(const Beacon& b: beacons){
+            // unknown beacons are not used
+            const Grid::CellPrediction* prediction = mGrid->cellPrediction(b.id());
+            if(prediction==NULL){
+                continue;
+            }
+            double rssi = b.rssi() - mRssiBias;
+            for(size_t i=0; i<n; i++){
+                logLikelihood[i] += normFunc(rssi, prediction->mean[i], prediction->stdev[i]);
+            }
+        }
+        for(auto& logLL: logLikelihood){
+            logLL *= mAlphaWeaken;
+        }
+        return logLikelihood;
+    }
+    
+    void GridPointMassFilter::applyMotion(){
+        const double res = mParams->resolution();
+        // Variances smaller than a cell are kept until they are large enough to move mass to the neighbours.
+        if(0.25*res*res <= mPendingVariance){
+            convolve(mPendingVariance);
+            mPendingVariance = 0;
+        }
+        transitFloors(mPendingWalkingTime);
+        mPendingWalkingTime = 0;
+    }
+    
+    void GridPointMassFilter::convolve(double variance){
+        const double res = mParams->resolution();
+        const int radius = mParams->kernelRadius();
+        // The kernel is truncated at two standard deviations. Larger variances are split into repeated applications.
+        double maxVariance = std::pow(0.5*radius*res, 2);
+        int nConv = static_cast<int>(std::ceil(variance/maxVariance));
+        nConv = std::max(1, std::min(nConv, mParams->maxConvolutions()));
+        double v = variance/nConv;
+        for(size_t m=0; m<mKernel.size(); m++){
+            mKernel[m] = std::exp(-0.5*m*res*res/v);
+        }
+        const size_t n = mGrid->numCells();
+        for(int k=0; k<nConv; k++){
+            std::fill(mWork.begin(), mWork.end(), 0.0);
+            for(size_t i=0; i<n; i++){
+                double p = mProbability[i];
+                if(p==0){
+                    continue;
+                }
+                size_t begin = mGrid->mNeighbourBegin[i];
+                size_t end = mGrid->mNeighbourBegin[i+1];
+                double sum = 0;
+                for(size_t e=begin; e<end; e++){
+                    sum += mKernel[mGrid->mNeighbourOffset2[e]];
+                }
+                double scale = p/sum;
+                for(size_t e=begin; e<end; e++){
+                    mWork[mGrid->mNeighbourIndices[e]] += scale*mKernel[mGrid->mNeighbourOffset2[e]];
+                }
+            }
+            mProbability.swap(mWork);
+        }
+    }
+    
+    void GridPointMassFilter::transitFloors(double walkingTime){
+        if(walkingTime<=0 || mParams->floorTransitionRate()<=0){
+            return;
+        }
+        double rate = 1.0 - std::exp(-mParams->floorTransitionRate()*walkingTime);
+        std::fill(mWork.begin(), mWork.end(), 0.0);
+        for(size_t i=0; i<mGrid->numCells(); i++){
+            size_t begin = mGrid->mTransitionBegin[i];
+            size_t end = mGrid->mTransitionBegin[i+1];
+            if(begin==end){
+                continue;
+            }
+            double moved = rate*mProbability[i];
+            mWork[i] -= moved;
+            for(size_t e=begin; e<end; e++){
+                mWork[mGrid->mTransitionIndices[e]] += moved/(end-begin);
+            }
+        }
+        for(size_t i=0; i<mGrid->numCells(); i++){
+            mProbability[i] += mWork[i];
+        }
+    }
+    
+    void GridPointMassFilter::multiplyLikelihood(const std::vector<double>& logLikelihood){
+        double maxLogLL = std::numeric_limits<double>::lowest();
+        for(size_t i=0; i<mGrid->numCells(); i++){
+            if(0<mProbability[i]){
+                maxLogLL = std::max(maxLogLL, logLikelihood[i]);
+            }
+        }
+        double sum = 0;
+        for(size_t i=0; i<mGrid->numCells(); i++){
+            mProbability[i] *= std::exp(logLikelihood[i] - maxLogLL);
+            sum += mProbability[i];
+        }
+        if(!(0<sum) || !std::isfinite(sum)){
+            LOC_LOG_WARN(FILTER, "GridPointMassFilter lost the probability mass. The grid was reinitialized by the likelihood.");
+            setUniformPrior();
+            maxLogLL = *std::max_element(logLikelihood.begin(), logLikelihood.end());
+            for(size_t i=0; i<mGrid->numCells(); i++){
+                mProbability[i] = std::exp(logLikelihood[i] - maxLogLL);
+            }
+        }
+        normalize();
+    }
+    
+    void GridPointMassFilter::setUniformPrior(){
+        std::fill(mProbability.begin(), mProbability.end(), 1.0/mGrid->numCells());
+    }
+    
+    void GridPointMassFilter::setGaussianPrior(const Location& mean, double stdevX, double stdevY, double rateUniform){
+        const double res = mParams->resolution();
+        double sx = std::max(stdevX, 0.5*res);
+        double sy = std::max(stdevY, 0.5*res);
+        int floor = static_cast<int>(std::round(mean.floor()));
+        double sum = 0;
+        for(size_t i=0; i<mGrid->numCells(); i++){
+            const Grid::Cell& c = mGrid->mCells[i];
+            double p = 0;
+            if(c.floor==floor){
+                double dx = (c.x - mean.x())/sx;
+                double dy = (c.y - mean.y())/sy;
+                p = std::exp(-0.5*(dx*dx + dy*dy));
+            }
+            mProbability[i] = p;
+            sum += p;
+        }
+        if(!(0<sum)){
+            LOC_LOG_WARN(FILTER, "No movable cell around (" << mean.x() << "," << mean.y() << "," << mean.floor() << "). Uniform prior was used.");
+            setUniformPrior();
+            return;
+        }
+        for(auto& p: mProbability){
+            p = (1.0-rateUniform)*p/sum + rateUniform/mGrid->numCells();
+        }
+    }
+    
+    void GridPointMassFilter::normalize(){
+        double sum = 0;
+        for(auto p: mProbability){
+            sum += p;
+        }
+        double eps = mParams->uniformMixture();
+        double uniform = eps/mGrid->numCells();
+        for(auto& p: mProbability){
+            p = (1.0-eps)*p/sum + uniform;
+        }
+    }
+    
+    void GridPointMassFilter::updateStatus(long timestamp, Status::Step step){
+        // The grid is reported as equally weighted states drawn by systematic sampling so that
+        // the summaries and the smoothing in BasicLocalizer work as with particle filters.
+        const double res = mParams->resolution();
+        double orientation = 0;
+        if(mOrientationMeter && mOrientationMeter->isUpdated()){
+            orientation = Pose::normalizeOrientaion(mOrientationMeter->getYaw());
+        }
+        StatesPtr states(new States());
+        states->reserve(mNumStates);
+        double step_u = 1.0/mNumStates;
+        double u = step_u*mRand.nextDouble();
+        double cumsum = 0;
+        size_t i = 0;
+        for(int k=0; k<mNumStates; k++){
+            while(i+1<mGrid->numCells() && cumsum + mProbability[i] < u){
+                cumsum += mProbability[i];
+                i++;
+            }
+            const Grid::Cell& c = mGrid->mCells[i];
+            State s;
+            s.x(c.x + res*(mRand.nextDouble()-0.5));
+            s.y(c.y + res*(mRand.nextDouble()-0.5));
+            s.z(0);
+            s.floor(c.floor);
+            if(!mBuilding->isMovable(s)){
+                s.x(c.x);
+                s.y(c.y);
+            }
+            s.orientation(orientation);
+            s.orientationBias(0);
+            s.rssiBias(mRssiBias);
+            s.weight(step_u);
+            states->push_back(s);
+            u += step_u;
+        }
+        mStatus->states(states, step);
+        mStatus->timestamp(timestamp);
+    }
+    
+    StreamLocalizer& GridPointMassFilter::putAcceleration(const Acceleration acceleration){
+        initializeGridIfEmpty();
+        mStatus->step(Status::OTHER);
+        if(!mPedometer){
+            BOOST_THROW_EXCEPTION(LocException("pedometer is not set to GridPointMassFilter"));
+        }
+        mPedometer->putAcceleration(acceleration);
+        if(!mPedometer->isUpdated()){
+            return *this;
+        }
+        long timestamp = acceleration.timestamp();
+        if(mPreviousTimestampMotion==0){
+            mPreviousTimestampMotion = timestamp;
+            return *this;
+        }
+        long interval = timestamp - mPreviousTimestampMotion;
+        if(0<=interval && interval<mTimestampIntervalLimit){
+            // The motion is only accumulated here and applied once per beacon update.
+            double dt = interval/1000.0;
+            bool isWalking = mPedometer->getNSteps() > 0;
+            double sigma = isWalking? mParams->sigmaMove() : mParams->sigmaStop();
+            mPendingVariance += sigma*sigma*dt;
+            if(isWalking){
+                mPendingWalkingTime += dt;
+            }
+        }else{
+            LOC_LOG_WARN(FILTER, "Interval between two timestamps is too large. The input at timestamp=" << timestamp << " was not used.");
+        }
+        mPreviousTimestampMotion = timestamp;
+        return *this;
+    }
+    
+    StreamLocalizer& GridPointMassFilter::putAttitude(const Attitude attitude){
+        if(mOrientationMeter){
+            mOrientationMeter->putAttitude(attitude);
+        }
+        return *this;
+    }
+    
+    StreamLocalizer& GridPointMassFilter::putLocalHeading(const LocalHeading heading){
+        return *this;
+    }
+    
+    StreamLocalizer& GridPointMassFilter::putAltimeter(const Altimeter altimeter){
+        // Floor transitions are driven by the transition areas and the beacons.
+        return *this;
+    }
+    
+    StreamLocalizer& GridPointMassFilter::putBeacons(const Beacons beacons){
+        initializeGridIfEmpty();
+        mStatus->step(Status::OTHER);
+        const Beacons& beaconsFiltered = filterBeacons(beacons);
+        if(beaconsFiltered.size()>0){
+            auto start = std::chrono::steady_clock::now();
+            applyMotion();
+            multiplyLikelihood(computeLogLikelihood(beaconsFiltered));
+            updateStatus(beacons.timestamp(), Status::FILTERING_WITH_RESAMPLING);
+            if(mOptVerbose){
+                auto usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count();
+                LOC_LOG_DEBUG(FILTER, "GridPointMassFilter update time=" << usec/1000.0 << "ms for " << mGrid->numCells() << " cells");
+            }
+        }else{
+            mStatus->step(Status::OBSERVATION_WITHOUT_FILTERING);
+            mStatus->timestamp(beacons.timestamp());
+        }
+        callback(mStatus.get());
+        return *this;
+    }
+    
+    Status* GridPointMassFilter::getStatus(){
+        return mStatus.get();
+    }
+    
+    bool GridPointMassFilter::resetStatus(){
+        initializeGridIfEmpty();
+        setUniformPrior();
+        mPendingVariance = 0;
+        mPendingWalkingTime = 0;
+        updateStatus(mStatus->timestamp(), Status::RESET);
+        callback(mStatus.get());
+        return true;
+    }
+    
+    bool GridPointMassFilter::resetStatus(Pose pose){
+        return resetStatus(pose, Pose(), 0.0);
+    }
+    
+    bool GridPointMassFilter::resetStatus(Pose meanPose, Pose stdevPose){
+        return resetStatus(meanPose, stdevPose, 0.0);
+    }
+    
+    bool GridPointMassFilter::resetStatus(Pose meanPose, Pose stdevPose, double rateContami){
+        initializeGridIfEmpty();
+        setGaussianPrior(meanPose, stdevPose.x(), stdevPose.y(), rateContami);
+        mPendingVariance = 0;
+        mPendingWalkingTime = 0;
+        LOC_LOG_INFO(FILTER, "GridPointMassFilter was reset around (" << meanPose.x() << "," << meanPose.y() << "," << meanPose.floor() << ")");
+        updateStatus(mStatus->timestamp(), Status::RESET);
+        callback(mStatus.get());
+        return true;
+    }
+    
+    bool GridPointMassFilter::resetStatus(const Beacons& beacons){
+        initializeGridIfEmpty();
+        const Beacons& beaconsFiltered = filterBeacons(beacons);
+        if(beaconsFiltered.size() == 0){
+            BOOST_THROW_EXCEPTION(LocException("beaconsFiltered.size==0 in resetStatus(beacons)."));
+        }
+        setUniformPrior();
+        mPendingVariance = 0;
+        mPendingWalkingTime = 0;
+        multiplyLikelihood(computeLogLikelihood(beaconsFiltered));
+        updateStatus(beacons.timestamp(), Status::RESET);
+        return false;
+    }
+    
+    bool GridPointMassFilter::resetStatus(const Location& location, const Beacons& beacons){
+        initializeGridIfEmpty();
+        const Beacons& beaconsFiltered = filterBeacons(beacons);
+        double stdev = mParams->kernelRadius()*mParams->resolution();
+        setGaussianPrior(location, stdev, stdev, 0.0);
+        mPendingVariance = 0;
+        mPendingWalkingTime = 0;
+        if(beaconsFiltered.size()>0){
+            multiplyLikelihood(computeLogLikelihood(beaconsFiltered));
+        }
+        updateStatus(beacons.timestamp(), Status::RESET);
+        return false;
+    }
+    
+    void GridPointMassFilter::saveState(SnapshotOutputArchive& ar) const{
+        long timestamp = mStatus->timestamp();
+        int step = mStatus->step();
+        int locationStatus = mStatus->locationStatus();
+        ar(CEREAL_NVP(timestamp), CEREAL_NVP(step), CEREAL_NVP(locationStatus));
+        ar(cereal::make_nvp("states", *mStatus->states()));
+        
+        // The grid itself is rebuilt from the building.
+        ar(CEREAL_NVP(mProbability), CEREAL_NVP(mPendingVariance), CEREAL_NVP(mPendingWalkingTime), CEREAL_NVP(mPreviousTimestampMotion));
+        ar(cereal::make_nvp("randomGenerator", mRand));
+        
+        saveComponentState(ar, mPedometer);
+        saveComponentState(ar, mOrientationMeter);
+    }
+    
+    void GridPointMassFilter::loadState(SnapshotInputArchive& ar){
+        initializeGridIfEmpty();
+        long timestamp = 0;
+        int step = Status::OTHER;
+        int locationStatus = Status::UNKNOWN;
+        ar(CEREAL_NVP(timestamp), CEREAL_NVP(step), CEREAL_NVP(locationStatus));
+        auto states = std::make_shared<States>();
+        ar(cereal::make_nvp("states", *states));
+        
+        std::vector<double> probability;
+        ar(cereal::make_nvp("mProbability", probability));
+        if(probability.size()!=mGrid->numCells()){
+            BOOST_THROW_EXCEPTION(LocException("snapshot does not match the grid of GridPointMassFilter"));
+        }
+        mProbability = probability;
+        ar(CEREAL_NVP(mPendingVariance), CEREAL_NVP(mPendingWalkingTime), CEREAL_NVP(mPreviousTimestampMotion));
+        ar(cereal::make_nvp("randomGenerator", mRand));
+        
+        loadComponentState(ar, mPedometer);
+        loadComponentState(ar, mOrientationMeter);
+        
+        mStatus.reset(new Status());
+        mStatus->timestamp(timestamp);
+        mStatus->states(states, static_cast<Status::Step>(step));
+        mStatus->locationStatus(static_cast<Status::LocationStatus>(locationStatus));
+    }
+}
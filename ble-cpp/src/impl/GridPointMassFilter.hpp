@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef GridPointMassFilter_hpp
+#define GridPointMassFilter_hpp
+
+#include <stdio.h>
+#include <map>
+#include "bleloc.h"
+#include "StreamLocalizer.hpp"
+
+#include "Building.hpp"
+#include "GaussianProcessLDPLMultiModel.hpp"
+#include "BeaconFilter.hpp"
+#include "CleansingBeaconFilter.hpp"
+#include "Pedometer.hpp"
+#include "OrientationMeter.hpp"
+#include "RandomGenerator.hpp"
+#include "SnapshotUtils.hpp"
+
+namespace loc {
+    
+    // Point-mass (grid) filter over the movable cells of a building.
+    // The cost of an update depends only on the number of cells, the kernel radius and the number of observed beacons.
+    class GridPointMassFilter : public StreamLocalizer, public Snapshottable{
+    public:
+        class Parameters{
+        protected:
+            double resolution_ = 1.0; // [m]
+            int kernelRadius_ = 3; // [cells]
+            int maxConvolutions_ = 4; // upper bound of kernel applications per update
+            double sigmaMove_ = 1.0; // [m/sqrt(s)]
+            double sigmaStop_ = 0.05; // [m/sqrt(s)]
+            double floorTransitionRate_ = 0.1; // [1/s] while walking in a transition area
+            double uniformMixture_ = 1.0e-4;
+            
+        public:
+            using Ptr = std::shared_ptr<Parameters>;
+            double resolution() const;
+            int kernelRadius() const;
+            int maxConvolutions() const;
+            double sigmaMove() const;
+            double sigmaStop() const;
+            double floorTransitionRate() const;
+            double uniformMixture() const;
+            Parameters& resolution(double);
+            Parameters& kernelRadius(int);
+            Parameters& maxConvolutions(int);
+            Parameters& sigmaMove(double);
+            Parameters& sigmaStop(double);
+            Parameters& floorTransitionRate(double);
+            Parameters& uniformMixture(double);
+            
+            template<class Archive>
+            void serialize(Archive & ar, std::uint32_t const version)
+            {
+                ar(CEREAL_NVP(resolution_));
+                ar(CEREAL_NVP(kernelRadius_));
+                ar(CEREAL_NVP(maxConvolutions_));
+                ar(CEREAL_NVP(sigmaMove_));
+                ar(CEREAL_NVP(sigmaStop_));
+                ar(CEREAL_NVP(floorTransitionRate_));
+                ar(CEREAL_NVP(uniformMixture_));
+            }
+        };
+        
+        using ObservationModelPtr = std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>>;
+        
+        // Movable cells of a building, the supports of the motion kernel and the RSSI of the known beacons predicted at the cells.
+        // A grid is not modified once built, so the filters of the sessions in a site share one (see SiteContext::grid).
+        class Grid{
+        public:
+            using Ptr = std::shared_ptr<const Grid>;
+            static Ptr build(Building::Ptr building, const Parameters& params, ObservationModelPtr model);
+            // Whether the grid was built for the building, the model and the resolution and kernel radius of params
+            bool isBuiltFor(const Building::Ptr& building, const Parameters& params, const ObservationModelPtr& model) const;
+            size_t numCells() const;
+            
+        private:
+            friend class GridPointMassFilter;
+            
+            struct Cell{
+                double x;
+                double y;
+                int floor;
+                bool isTransitionArea;
+            };
+            
+            // predicted RSSI of a beacon at each cell
+            struct CellPrediction{
+                std::vector<float> mean;
+                std::vector<float> stdev;
+            };
+            
+            Building::Ptr mBuilding;
+            ObservationModelPtr mObservationModel;
+            double mResolution = 0;
+            int mKernelRadius = 0;
+            
+            std::vector<Cell> mCells;
+            std::vector<size_t> mNeighbourBegin; // CSR offsets into mNeighbourIndices
+            std::vector<int> mNeighbourIndices;
+            std::vector<int> mNeighbourOffset2; // squared distance in cells
+            std::vector<size_t> mTransitionBegin; // CSR offsets into mTransitionIndices
+            std::vector<int> mTransitionIndices;
+            std::map<long, CellPrediction> mCellPredictions; // for all the beacons known to the observation model
+            
+            void buildCells();
+            void predictCells();
+            const CellPrediction* cellPrediction(long id) const;
+        };
+        
+        GridPointMassFilter();
+        ~GridPointMassFilter() = default;
+        
+        // setter
+        GridPointMassFilter& optVerbose(bool);
+        GridPointMassFilter& numStates(int);
+        GridPointMassFilter& alphaWeaken(double);
+        GridPointMassFilter& rssiBias(double);
+        GridPointMassFilter& parameters(Parameters::Ptr);
+        GridPointMassFilter& building(Building::Ptr);
+        GridPointMassFilter& observationModel(ObservationModelPtr);
+        GridPointMassFilter& beaconFilter(std::shared_ptr<BeaconFilter>);
+        GridPointMassFilter& pedometer(Pedometer::Ptr);
+        GridPointMassFilter& orientationMeter(OrientationMeter::Ptr);
+        
+        // Uses a grid built for the building, the parameters and the observation model of this filter.
+        GridPointMassFilter& grid(Grid::Ptr);
+        Grid::Ptr grid() const;
+        
+        size_t numCells() const;
+        // Builds the grid unless it is given or ready, and initializes the probabilities on it.
+        // Called at setup so that sensor inputs do not pay for it.
+        void initializeGridIfEmpty();
+        
+        StreamLocalizer& updateHandler(void (*functionCalledAfterUpdate)(Status*)) override;
+        StreamLocalizer& updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData) override;
+        
+        StreamLocalizer& putAcceleration(const Acceleration acceleration) override;
+        StreamLocalizer& putAttitude(const Attitude attitude) override;
+        StreamLocalizer& putBeacons(const Beacons beacons) override;
+        StreamLocalizer& putLocalHeading(const LocalHeading heading) override;
+        StreamLocalizer& putAltimeter(const Altimeter altimeter) override;
+        Status* getStatus() override;
+        
+        bool resetStatus() override;
+        bool resetStatus(Pose pose) override;
+        bool resetStatus(Pose meanPose, Pose stdevPose) override;
+        bool resetStatus(const Beacons& beacons) override;
+        bool resetStatus(const Location& location, const Beacons& beacons) override;
+        bool resetStatus(Pose meanPose, Pose stdevPose, double rateContami) override;
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
+        
+    private:
+        bool mOptVerbose = false;
+        int mNumStates = 1000;
+        double mAlphaWeaken = 1.0;
+        double mRssiBias = 0.0;
+        Parameters::Ptr mParams = std::make_shared<Parameters>();
+        Building::Ptr mBuilding;
+        ObservationModelPtr mObservationModel;
+        std::shared_ptr<BeaconFilter> mBeaconFilter;
+        CleansingBeaconFilter mCleansingBeaconFilter;
+        Pedometer::Ptr mPedometer;
+        OrientationMeter::Ptr mOrientationMeter;
+        RandomGenerator mRand;
+        
+        void (*mFunctionCalledAfterUpdate)(Status*) = NULL;
+        void (*mFunctionCalledAfterUpdate2)(void*, Status*) = NULL;
+        void* mUserData = NULL;
+        
+        // grid (built lazily from the building unless given)
+        Grid::Ptr mGrid;
+        std::vector<double> mWork;
+        std::vector<double> mKernel;
+        
+        // filter state
+        std::vector<double> mProbability;
+        double mPendingVariance = 0; // [m^2] accumulated by acceleration until the next beacon update
+        double mPendingWalkingTime = 0; // [s]
+        long mPreviousTimestampMotion = 0;
+        long mTimestampIntervalLimit = 2000; // 2.0[s]
+        std::shared_ptr<Status> mStatus;
+        
+        void discardGridIfMismatched();
+        Beacons filterBeacons(const Beacons& beacons) const;
+        std::vector<double> computeLogLikelihood(const Beacons& beacons);
+        void applyMotion();
+        void convolve(double variance);
+        void transitFloors(double walkingTime);
+        void multiplyLikelihood(const std::vector<double>& logLikelihood);
+        void setGaussianPrior(const Location& mean, double stdevX, double stdevY, double rateUniform);
+        void setUniformPrior();
+        void normalize();
+        void updateStatus(long timestamp, Status::Step step);
+        void callback(Status* status);
+    };
+}
+
+// assign version
+CEREAL_CLASS_VERSION(loc::GridPointMassFilter::Parameters, 0);
+#endif /* GridPointMassFilter_hpp */
@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "StatusInitializerImpl.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -41,6 +42,10 @@ namespace loc{
 
     
     State StatusInitializerImpl::perturbRssiBias(const State &state){
+        if(0<state.rssiBiasVariance()){
+            // marginalized bias
+            return state;
+        }
         State stateNew(state);
         double rssiBias = rand.nextTruncatedGaussian(state.rssiBias(), mStateProperty->diffusionRssiBias(), mStateProperty->minRssiBias(), mStateProperty->maxRssiBias());
         stateNew.rssiBias(rssiBias);
@@ -135,7 +140,7 @@ namespace loc{
         auto movableLocations = extractMovableLocations(uniqueLocations);
         size_t countNonMovable = uniqueLocations.size() - movableLocations.size();
         
-        std::cout << "Invalid " << countNonMovable << " points are not used for initialization." << std::endl;
+        LOC_LOG_INFO(FILTER, "Invalid " << countNonMovable << " points are not used for initialization.");
         
         // Random sampling
         Locations locs = randomSampleLocationsWithPerturbation(n, movableLocations);
@@ -191,9 +196,14 @@ namespace loc{
             State state(pose);
             
             double orientationBias = 2.0*M_PI*rand.nextDouble();
-            double rssiBias = rand.nextTruncatedGaussian(mStateProperty->meanRssiBias(), mStateProperty->stdRssiBias(), mStateProperty->minRssiBias(), mStateProperty->maxRssiBias());
-            
-            state.orientationBias(orientationBias).rssiBias(rssiBias);
+            state.orientationBias(orientationBias);
+            if(mStateProperty->marginalizesRssiBias()){
+                double stdRssiBias = mStateProperty->stdRssiBias();
+                state.rssiBias(mStateProperty->meanRssiBias()).rssiBiasVariance(stdRssiBias*stdRssiBias);
+            }else{
+                double rssiBias = rand.nextTruncatedGaussian(mStateProperty->meanRssiBias(), mStateProperty->stdRssiBias(), mStateProperty->minRssiBias(), mStateProperty->maxRssiBias());
+                state.rssiBias(rssiBias);
+            }
             state.weight(1.0/n);
             states[i]=state;
         }
@@ -369,5 +379,11 @@ namespace loc{
         return selectedLocations;
     }
     
+    void StatusInitializerImpl::saveState(SnapshotOutputArchive& ar) const{
+        ar(cereal::make_nvp("randomGenerator", rand));
+    }
     
+    void StatusInitializerImpl::loadState(SnapshotInputArchive& ar){
+        ar(cereal::make_nvp("randomGenerator", rand));
+    }
 }
@@ -30,13 +30,14 @@
 #include "RandomGenerator.hpp"
 #include "StatusInitializer.hpp"
 #include "DataStore.hpp"
+#include "SnapshotUtils.hpp"
 
 namespace loc{
     /**
      sampling points based status initializer
     **/
     
-    class StatusInitializerImpl : public StatusInitializer{
+    class StatusInitializerImpl : public StatusInitializer, public Snapshottable{
         
     private:
         RandomGenerator rand;
@@ -87,6 +88,9 @@ namespace loc{
         States initializeStatesFromLocations(const std::vector<Location>& locations);
         Locations extractLocationsCloseToBeacons(const std::vector<Beacon>& beacons, double radius2D) const;
         Locations generateLocationsCloseToBeaconsWithPerturbation(const std::vector<Beacon> &beacons, double radius2D);
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
     };
     
     // Implementation
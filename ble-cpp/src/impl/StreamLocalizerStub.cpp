@@ -23,6 +23,7 @@
 #include "bleloc.h"
 #include "StreamLocalizer.hpp"
 #include "StreamLocalizerStub.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -87,7 +88,7 @@ namespace loc{
     }
     
     bool StreamLocalizerStub::resetStatus(){
-        std::cout << "StreamLocalizer::resetStatus() is not supported." <<std::endl;
+        LOC_LOG_WARN(FILTER, "StreamLocalizer::resetStatus() is not supported.");
         return true;
     }
     
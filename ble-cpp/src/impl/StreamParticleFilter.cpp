@@ -23,6 +23,7 @@
 #include <thread>
 #include <queue>
 #include <functional>
+#include <chrono>
 
 #include "StreamParticleFilter.hpp"
 #include "StreamLocalizer.hpp"
@@ -31,14 +32,17 @@
 
 #include "Resampler.hpp"
 #include "GridResampler.hpp"
+#include "CompressedStates.hpp"
+#include "EnsembleKalmanUpdater.hpp"
 
 #include "StatusInitializer.hpp"
 
 #include "PoseRandomWalker.hpp"
 
 #include "ArrayUtils.hpp"
+#include "Logger.hpp"
 #include "DataStore.hpp"
-#include "DataLogger.hpp"
+#include "ParticleTraceRecorder.hpp"
 #include "BaseBeaconFilter.hpp"
 #include "CleansingBeaconFilter.hpp"
 
@@ -81,6 +85,215 @@ namespace loc{
         return *this;
     }
     
+    double StreamParticleFilter::TimeBudgetParameters::timeBudgetMS() const{
+        return timeBudgetMS_;
+    }
+    
+    double StreamParticleFilter::TimeBudgetParameters::minSubsampleRatio() const{
+        return minSubsampleRatio_;
+    }
+    
+    double StreamParticleFilter::TimeBudgetParameters::minNumStatesRatio() const{
+        return minNumStatesRatio_;
+    }
+    
+    double StreamParticleFilter::TimeBudgetParameters::numStatesReductionRate() const{
+        return numStatesReductionRate_;
+    }
+    
+    double StreamParticleFilter::TimeBudgetParameters::costSmoothingRate() const{
+        return costSmoothingRate_;
+    }
+    
+    StreamParticleFilter::TimeBudgetParameters& StreamParticleFilter::TimeBudgetParameters::timeBudgetMS(double budget){
+        timeBudgetMS_ = budget;
+        return *this;
+    }
+    
+    StreamParticleFilter::TimeBudgetParameters& StreamParticleFilter::TimeBudgetParameters::minSubsampleRatio(double ratio){
+        minSubsampleRatio_ = ratio;
+        return *this;
+    }
+    
+    StreamParticleFilter::TimeBudgetParameters& StreamParticleFilter::TimeBudgetParameters::minNumStatesRatio(double ratio){
+        minNumStatesRatio_ = ratio;
+        return *this;
+    }
+    
+    StreamParticleFilter::TimeBudgetParameters& StreamParticleFilter::TimeBudgetParameters::numStatesReductionRate(double rate){
+        numStatesReductionRate_ = rate;
+        return *this;
+    }
+    
+    StreamParticleFilter::TimeBudgetParameters& StreamParticleFilter::TimeBudgetParameters::costSmoothingRate(double rate){
+        costSmoothingRate_ = rate;
+        return *this;
+    }
+    
+    bool StreamParticleFilter::HybridTrackingParameters::enabled() const{
+        return enabled_;
+    }
+    
+    int StreamParticleFilter::HybridTrackingParameters::ensembleSize() const{
+        return ensembleSize_;
+    }
+    
+    double StreamParticleFilter::HybridTrackingParameters::collapseStdev2D() const{
+        return collapseStdev2D_;
+    }
+    
+    double StreamParticleFilter::HybridTrackingParameters::collapseFloorProbability() const{
+        return collapseFloorProbability_;
+    }
+    
+    int StreamParticleFilter::HybridTrackingParameters::minUpdatesBeforeCollapse() const{
+        return minUpdatesBeforeCollapse_;
+    }
+    
+    double StreamParticleFilter::HybridTrackingParameters::maxNormalizedInnovation() const{
+        return maxNormalizedInnovation_;
+    }
+    
+    int StreamParticleFilter::HybridTrackingParameters::maxInconsistentUpdates() const{
+        return maxInconsistentUpdates_;
+    }
+    
+    double StreamParticleFilter::HybridTrackingParameters::maxRejectedRatio() const{
+        return maxRejectedRatio_;
+    }
+    
+    double StreamParticleFilter::HybridTrackingParameters::expansionStdevScale() const{
+        return expansionStdevScale_;
+    }
+    
+    double StreamParticleFilter::HybridTrackingParameters::jacobianStep() const{
+        return jacobianStep_;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::enabled(bool value){
+        enabled_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::ensembleSize(int value){
+        ensembleSize_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::collapseStdev2D(double value){
+        collapseStdev2D_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::collapseFloorProbability(double value){
+        collapseFloorProbability_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::minUpdatesBeforeCollapse(int value){
+        minUpdatesBeforeCollapse_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::maxNormalizedInnovation(double value){
+        maxNormalizedInnovation_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::maxInconsistentUpdates(int value){
+        maxInconsistentUpdates_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::maxRejectedRatio(double value){
+        maxRejectedRatio_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::expansionStdevScale(double value){
+        expansionStdevScale_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::HybridTrackingParameters& StreamParticleFilter::HybridTrackingParameters::jacobianStep(double value){
+        jacobianStep_ = value;
+        return *this;
+    }
+    
+    bool StreamParticleFilter::DutyCycleParameters::enabled() const{
+        return enabled_;
+    }
+    
+    long StreamParticleFilter::DutyCycleParameters::stationaryIntervalMS() const{
+        return stationaryIntervalMS_;
+    }
+    
+    long StreamParticleFilter::DutyCycleParameters::maxSkipIntervalMS() const{
+        return maxSkipIntervalMS_;
+    }
+    
+    double StreamParticleFilter::DutyCycleParameters::noveltyThreshold() const{
+        return noveltyThreshold_;
+    }
+    
+    double StreamParticleFilter::DutyCycleParameters::missingBeaconPenalty() const{
+        return missingBeaconPenalty_;
+    }
+    
+    StreamParticleFilter::DutyCycleParameters& StreamParticleFilter::DutyCycleParameters::enabled(bool value){
+        enabled_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::DutyCycleParameters& StreamParticleFilter::DutyCycleParameters::stationaryIntervalMS(long value){
+        stationaryIntervalMS_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::DutyCycleParameters& StreamParticleFilter::DutyCycleParameters::maxSkipIntervalMS(long value){
+        maxSkipIntervalMS_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::DutyCycleParameters& StreamParticleFilter::DutyCycleParameters::noveltyThreshold(double value){
+        noveltyThreshold_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::DutyCycleParameters& StreamParticleFilter::DutyCycleParameters::missingBeaconPenalty(double value){
+        missingBeaconPenalty_ = value;
+        return *this;
+    }
+    
+    bool StreamParticleFilter::MotionIntegrationParameters::enabled() const{
+        return enabled_;
+    }
+    
+    long StreamParticleFilter::MotionIntegrationParameters::maxIntervalMS() const{
+        return maxIntervalMS_;
+    }
+    
+    StreamParticleFilter::MotionIntegrationParameters& StreamParticleFilter::MotionIntegrationParameters::enabled(bool value){
+        enabled_ = value;
+        return *this;
+    }
+    
+    StreamParticleFilter::MotionIntegrationParameters& StreamParticleFilter::MotionIntegrationParameters::maxIntervalMS(long value){
+        maxIntervalMS_ = value;
+        return *this;
+    }
+    
+    std::ostream& operator<<(std::ostream&os, const DutyCycleStatistics& stats){
+        os << "predictions=" << stats.predictions
+        << ",skippedPredictions=" << stats.skippedPredictions
+        << ",updates=" << stats.updates
+        << ",skippedUpdates=" << stats.skippedUpdates
+        << ",skippedMixings=" << stats.skippedMixings
+        << ",stationaryFrames=" << stats.stationaryFrames
+        << ",lowNoveltyFrames=" << stats.lowNoveltyFrames;
+        return os;
+    }
+    
     
     // Helper class implementations
     
@@ -244,7 +457,7 @@ namespace loc{
                     auto countWri = std::count(floorsWritten.begin(), floorsWritten.end(), floor);
                     ss << "("<<floor<<","<<weights.at(i)<<"," << countGen << "," <<countWri <<")," ;
                 }
-                std::cout << ss.str() << std::endl;
+                LOC_LOG_DEBUG(FILTER, ss.str());
                 
                 if(floors.size()>=2){
                     fsize = floors.size();
@@ -277,6 +490,53 @@ namespace loc{
         LocationStatusMonitorParameters::Ptr mLocStatusMonitorParams = std::make_shared<LocationStatusMonitorParameters>();
         long statusMonitorUnstableCounter = 0;
         
+        // for deadline-aware update
+        TimeBudgetParameters::Ptr mTimeBudgetParams = std::make_shared<TimeBudgetParameters>();
+        std::chrono::steady_clock::time_point mUpdateStart;
+        int mDegradations = Status::NO_DEGRADATION;
+        size_t mTargetNumStates = 0;
+        // smoothed costs [ms]
+        double mMixCostMS = 0;
+        double mLogLLCostPerStateMS = 0;
+        double mPostResampleCostMS = 0;
+        // posterior resampling skipped for lack of budget, run at the next update that can afford it
+        bool mPostResamplingDeferred = false;
+        
+        // keep the offspring of an ancestor as one state with its multiplicity
+        bool mCompressesStates = false;
+        StatesCompressionStatistics mCompressionStatistics;
+        // multiplicities of the resampled states, valid while the states are not replaced
+        std::vector<int> mGroupSizes;
+        StatesPtr mGroupedStates;
+        long mGroupedStatesVersion = -1;
+        
+        // hybrid particle filter / ensemble Kalman filter
+        HybridTrackingParameters::Ptr mHybridParams = std::make_shared<HybridTrackingParameters>();
+        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> mHybridModel;
+        // GP model giving the RSSI noise to the novelty of beacons (the hybrid tracking model or the observation model)
+        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> mNoveltyModel;
+        bool mKalmanTracking = false;
+        int mInconsistentUpdates = 0;
+        long mUpdatesSinceExpansion = 0;
+        
+        // duty-cycling while stationary or observing unchanged beacons
+        DutyCycleParameters::Ptr mDutyCycleParams = std::make_shared<DutyCycleParameters>();
+        DutyCycleStatistics mDutyCycleStatistics;
+        
+        // Motion accumulated since the last prediction in the motion integration mode
+        MotionIntegrationParameters::Ptr mMotionIntegrationParams = std::make_shared<MotionIntegrationParameters>();
+        long mMotionStartTimestamp = 0;
+        long mMotionLastTimestamp = 0;
+        double mMotionWalkingTime = 0;
+        double mMotionHeadingX = 0;
+        double mMotionHeadingY = 0;
+        int mMotionSamples = 0;
+        long mLastStepTimestamp = 0;
+        long mLastPredictionTimestamp = 0;
+        long mLastUpdateTimestamp = 0;
+        Beacons mLastUpdateBeacons;
+        bool mSkipsFrameMixing = false;
+        
         //std::queue<Pose> posesForReset;
         std::queue<std::function<void()>> functionsForReset;
 
@@ -334,6 +594,9 @@ namespace loc{
             
             mPedometer->putAcceleration(acceleration);
             accelerationIsUpdated = mPedometer->isUpdated();
+            if(mDutyCycleParams->enabled() && (mLastStepTimestamp==0 || mPedometer->getNSteps()>0)){
+                mLastStepTimestamp = acceleration.timestamp();
+            }
 
             // TODO (Tentative implementation)
             if(accelerationIsUpdated && attitudeIsUpdated){
@@ -363,22 +626,30 @@ namespace loc{
             SystemModelInput input;
             input.timestamp(timestamp);
             input.previousTimestamp(previousTimestampMotion);
-
-            std::shared_ptr<States> states = status->states();
             
             bool timestampIntervalIsValid = (input.timestamp() - input.previousTimestamp()) < timestampIntervalLimit;
             
+            if(mMotionIntegrationParams->enabled()){
+                if(timestampIntervalIsValid){
+                    accumulateMotion(input);
+                }else{
+                    flushMotion();
+                    LOC_LOG_WARN(FILTER, "Interval between two timestamps is too large. The input at timestamp=" << timestamp << " was not used.");
+                }
+                previousTimestampMotion = timestamp;
+                return;
+            }
+            
             if(timestampIntervalIsValid){
-                StatesPtr statesPredicted(new States(mRandomWalker->predict(*states.get(), input)));
-                status->states(statesPredicted, Status::PREDICTION);
+                predictStates(input);
             }else{
-                std::cout << "Interval between two timestamps is too large. The input at timestamp=" << timestamp << " was not used." << std::endl;
+                LOC_LOG_WARN(FILTER, "Interval between two timestamps is too large. The input at timestamp=" << timestamp << " was not used.");
             }
             
             status->timestamp(timestamp);
 
             if(mOptVerbose){
-                std::cout << "prediction at t=" << timestamp << std::endl;
+                LOC_LOG_DEBUG(FILTER, "prediction at t=" << timestamp);
             }
 
             if(status->step()==Status::PREDICTION){
@@ -388,6 +659,105 @@ namespace loc{
             previousTimestampMotion = timestamp;
         }
         
+        void predictStates(const SystemModelInput& input){
+            long timestamp = input.timestamp();
+            if(isStationary(timestamp) && timestamp - mLastPredictionTimestamp < mDutyCycleParams->maxSkipIntervalMS()){
+                mDutyCycleStatistics.skippedPredictions++;
+            }else{
+                std::shared_ptr<States> states = status->states();
+                StatesPtr statesPredicted;
+                if(hasGroupedStates()){
+                    statesPredicted.reset(new States(mRandomWalker->predictGrouped(*states.get(), mGroupSizes, input)));
+                    mCompressionStatistics.addPrediction(states->size(), mGroupSizes.size());
+                }else{
+                    statesPredicted.reset(new States(mRandomWalker->predict(*states.get(), input)));
+                }
+                clearGroupedStates();
+                status->states(statesPredicted, Status::PREDICTION);
+                mDutyCycleStatistics.predictions++;
+                mLastPredictionTimestamp = timestamp;
+            }
+        }
+        
+        bool hasGroupedStates() const{
+            return mGroupedStates && mGroupedStates==status->states() && mGroupedStatesVersion==status->statesVersion();
+        }
+        
+        void clearGroupedStates(){
+            mGroupSizes.clear();
+            mGroupedStates.reset();
+            mGroupedStatesVersion = -1;
+        }
+        
+        // Resamples the states into the compressed form and keeps the multiplicities for the next prediction.
+        StatesPtr resampleCompressed(const States& states, const std::vector<double>& weights){
+            std::vector<int> counts(states.size());
+            mResampler->offspringCounts(states, &weights[0], &counts[0]);
+            CompressedStates compressed(states, counts);
+            mGroupSizes = compressed.multiplicities();
+            mCompressionStatistics.addResampling(compressed.size(), compressed.numUnique());
+            if(mOptVerbose){
+                LOC_LOG_DEBUG(FILTER, "resampled states (unique/total)=" << compressed.numUnique() << "/" << compressed.size()
+                              << ", saved=" << mCompressionStatistics.lastSavedRatio());
+            }
+            return StatesPtr(new States(compressed.expand()));
+        }
+        
+        // Adds the motion between two pedometer updates to the summary. The heading is integrated
+        // only while walking so that the summary keeps the walked path's chord and length.
+        void accumulateMotion(const SystemModelInput& input){
+            if(mMotionSamples==0){
+                mMotionStartTimestamp = input.previousTimestamp();
+            }
+            if(mPedometer->getNSteps()>0){
+                double dt = (input.timestamp() - input.previousTimestamp())*input.timeUnit();
+                double yaw = mOrientationmeter->getYaw();
+                mMotionWalkingTime += dt;
+                mMotionHeadingX += dt*std::cos(yaw);
+                mMotionHeadingY += dt*std::sin(yaw);
+            }
+            mMotionSamples++;
+            mMotionLastTimestamp = input.timestamp();
+            
+            if(mMotionIntegrationParams->maxIntervalMS() <= mMotionLastTimestamp - mMotionStartTimestamp){
+                flushMotion();
+            }
+        }
+        
+        // Propagates the states once with the accumulated motion.
+        void flushMotion(){
+            if(mMotionSamples==0){
+                return;
+            }
+            SystemModelInput input;
+            input.previousTimestamp(mMotionStartTimestamp);
+            input.timestamp(mMotionLastTimestamp);
+            input.motionSummary(mMotionWalkingTime, mMotionHeadingX, mMotionHeadingY, mMotionSamples);
+            int samples = mMotionSamples;
+            discardMotion();
+            
+            status->step(Status::OTHER);
+            predictStates(input);
+            status->timestamp(input.timestamp());
+            
+            if(mOptVerbose){
+                LOC_LOG_DEBUG(FILTER, "prediction of " << samples << " motion updates at t=" << input.timestamp());
+            }
+            
+            if(status->step()==Status::PREDICTION){
+                callback(status.get());
+            }
+        }
+        
+        void discardMotion(){
+            mMotionStartTimestamp = 0;
+            mMotionLastTimestamp = 0;
+            mMotionWalkingTime = 0;
+            mMotionHeadingX = 0;
+            mMotionHeadingY = 0;
+            mMotionSamples = 0;
+        }
+        
         void putAltimeter(const Altimeter altimeter){
             if(mAltitudeManager){
                 mAltitudeManager->putAltimeter(altimeter);
@@ -464,15 +834,16 @@ namespace loc{
                     if(nMixed!=0){
                         ss << "(" << nMixed << " states in floor transition area were mixed.)";
                     }
-                    std::cout << ss.str() << std::endl;
+                    LOC_LOG_DEBUG(FILTER, ss.str());
                 }
             }
             return statesNew;
         }
 
-        void logStates(const States& states, const std::string& filename){
-            if(DataLogger::getInstance()){
-                DataLogger::getInstance()->log(filename, DataUtils::statesToCSV(states));
+        void traceStates(ParticleTraceRecord::Stage stage, long timestamp, const States& states,
+                         int step = -1, double ess = std::numeric_limits<double>::quiet_NaN()){
+            if(ParticleTraceRecorder::getInstance()){
+                ParticleTraceRecorder::getInstance()->record(stage, timestamp, states, step, mDegradations, ess);
             }
         }
         
@@ -585,7 +956,20 @@ namespace loc{
             long timestamp = beacons.timestamp();
             
             status->timestamp(timestamp);
+            
+            if(mKalmanTracking){
+                if(!doesFiltering || updateByKalmanFilter(beacons)){
+                    return;
+                }
+                // diverged and expanded to particles
+            }
+            // The published states are shared with the callers and are not modified in place.
+            // A filtering step works on new vectors and publishes them with status->states().
             std::shared_ptr<States> states = status->states();
+            if(doesFiltering && mPostResamplingDeferred){
+                states = std::make_shared<States>(*states);
+                runDeferredPostResampling(*states);
+            }
             
             bool passedMonitoringInterval = false;
             if(timestamp - previousTimestampMonitoring > mLocStatusMonitorParams->monitorIntervalMS() ){
@@ -597,20 +981,73 @@ namespace loc{
             std::vector<State> allMixStates;
             std::vector<double> allMixLogLLs;
             States statesMixed;
-            if(passedMonitoringInterval || mMixParams.mixtureProbability>0){
+            bool doesMix = passedMonitoringInterval || mMixParams.mixtureProbability>0;
+            if(doesMix && !passedMonitoringInterval && mSkipsFrameMixing){
+                doesMix = false;
+                mDegradations |= Status::SKIPPED_MIXING;
+                mDutyCycleStatistics.skippedMixings++;
+            }
+            if(doesMix && hasTimeBudget()){
+                double predictedMS = mMixCostMS + mLogLLCostPerStateMS*states->size() + postResampleCostMS();
+                if(remainingMS() < predictedMS){
+                    doesMix = false;
+                    mDegradations |= Status::SKIPPED_MIXING;
+                }
+            }
+            if(doesMix){
+                auto start = std::chrono::steady_clock::now();
                 statesMixed = mixStates(*states, beacons, mMixParams, passedMonitoringInterval, allMixStates, allMixLogLLs);
+                updateCost(mMixCostMS, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
             }else{
                 statesMixed = *states;
             }
             if(doesFiltering){
                 // Logging before weights updated
-                logStates(*states, "before_likelihood_states_"+std::to_string(timestamp)+".csv");
-                // Copy mixed states when apply filtering
-                *states = statesMixed;
+                traceStates(ParticleTraceRecord::BEFORE_LIKELIHOOD, timestamp, *states);
+                // Filter the mixed states in a new vector
+                states = std::make_shared<States>(std::move(statesMixed));
+                
+                // Evaluate likelihood on a subsample drawn in proportion to the weights.
+                // The sampled states have equal weights as importance correction.
+                if(hasTimeBudget() && 0 < mLogLLCostPerStateMS){
+                    size_t n = states->size();
+                    double availableMS = remainingMS() - postResampleCostMS();
+                    double nAffordable = availableMS/mLogLLCostPerStateMS;
+                    size_t nMin = std::max<size_t>(1, n*mTimeBudgetParams->minSubsampleRatio());
+                    if(nAffordable < n){
+                        size_t m = std::max(nMin, static_cast<size_t>(std::max(0.0, nAffordable)));
+                        std::vector<double> priorWeights(n);
+                        for(size_t i=0; i<n; i++){
+                            priorWeights[i] = states->at(i).weight();
+                        }
+                        states = std::make_shared<States>(sampleStates(*states, priorWeights, m));
+                        mDegradations |= Status::SUBSAMPLED_LIKELIHOOD;
+                        if(nAffordable < nMin){
+                            reduceTargetNumStates();
+                        }
+                    }
+                }
             }
             
             // Compute log likelihood
-            std::vector<std::vector<double>> vLogLLsAndMDists = mObservationModel->computeLogLikelihoodRelatedValues(*states, beacons);
+            auto startLogLL = std::chrono::steady_clock::now();
+            std::vector<std::vector<double>> vLogLLsAndMDists;
+            if(mCompressesStates){
+                // Copies of an ancestor stay next to each other, so the ones not moved apart are evaluated once.
+                CompressedStates compressed(*states);
+                vLogLLsAndMDists = compressed.expand(mObservationModel->computeLogLikelihoodRelatedValues(compressed.uniqueStates(), beacons));
+                mCompressionStatistics.addLikelihood(compressed.size(), compressed.numUnique());
+                if(mOptVerbose){
+                    LOC_LOG_DEBUG(FILTER, "likelihood evaluations (unique/total)=" << compressed.numUnique() << "/" << compressed.size()
+                                  << ", saved=" << mCompressionStatistics.lastLikelihoodSavedRatio());
+                }
+            }else{
+                vLogLLsAndMDists = mObservationModel->computeLogLikelihoodRelatedValues(*states, beacons);
+            }
+            if(0<states->size()){
+                double logLLCostMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startLogLL).count();
+                updateCost(mLogLLCostPerStateMS, logLLCostMS/states->size());
+            }
             std::vector<double> vLogLLs(states->size());
             std::vector<double> mDists(states->size());
             for(int i=0; i<states->size(); i++){
@@ -642,9 +1079,9 @@ namespace loc{
                     
                     auto locationStatus = status->locationStatus();
                     if(mOptVerbose){
-                        std::cout << "locationStatus = " << Status::locationStatusToString(locationStatus) << std::endl;
-                        std::cout << "Average logLikelihood (inStates,inMix)=(" << avgCurrentLogLL << "," << avgMixLogLL << "), weightAvgLogLL=" << weightAvgLogLL << ",wTol=" << wTol << std::endl;
-                        std::cout << "Max logLikelihood (inStates,inMix)=(" << maxCurrentLogLL << "," << maxMixLogLL << "), weightMaxLogLL=" << weightMaxLogLL << ",wTol=" << wTol << std::endl;
+                        LOC_LOG_DEBUG(FILTER, "locationStatus = " << Status::locationStatusToString(locationStatus));
+                        LOC_LOG_DEBUG(FILTER, "Average logLikelihood (inStates,inMix)=(" << avgCurrentLogLL << "," << avgMixLogLL << "), weightAvgLogLL=" << weightAvgLogLL << ",wTol=" << wTol);
+                        LOC_LOG_DEBUG(FILTER, "Max logLikelihood (inStates,inMix)=(" << maxCurrentLogLL << "," << maxMixLogLL << "), weightMaxLogLL=" << weightMaxLogLL << ",wTol=" << wTol);
                     }
                     
                     if(! heightIsChanging || ! mLocStatusMonitorParams->disableStatusChangeOnHeightChanging()){
@@ -668,30 +1105,21 @@ namespace loc{
                         status->locationStatus(locationStatus);
                     }else{
                         statusMonitorUnstableCounter = 0;
-                        std::cout << "status update was skipped because height is changing." << std::endl;
+                        LOC_LOG_INFO(FILTER, "status update was skipped because height is changing.");
                     }
                 }
             }
             
             if(doesFiltering){
-                // Apply alpha-weaken
-                vLogLLs = weakenLogLikelihoods(vLogLLs, mAlphaWeaken);
-                
-                // Set negative log-likelihoods
-                for(int i=0; i<vLogLLs.size(); i++){
-                    State& s = states->at(i);
-                    s.negativeLogLikelihood(-vLogLLs.at(i));
-                    s.mahalanobisDistance(mDists.at(i));
-                }
-                
-                std::vector<double> weights = ArrayUtils::computeWeightsFromLogLikelihood(vLogLLs);
-                double sumWeights = 0;
-                // Multiply loglikelihood-based weights and particle weights.
-                for(int i=0; i<weights.size(); i++){
-                    weights[i] = weights[i] * (states->at(i).weight());
-                    sumWeights += weights[i];
+                // Compute normalized weights (prior weights x alpha-weakened likelihoods) and ESS
+                size_t n = states->size();
+                std::vector<double> priorWeights(n);
+                for(size_t i=0; i<n; i++){
+                    priorWeights[i] = states->at(i).weight();
                 }
-                if(sumWeights<=0){
+                std::vector<double> weights(n);
+                auto weightStats = ArrayUtils::computeNormalizedWeights(vLogLLs.data(), priorWeights.data(), n, weights.data(), mAlphaWeaken, mEssThreshold);
+                if(!(weightStats.sumWeights>0)){
                     LocException ex("sum(weights) <= 0");
                     for(auto logLL: vLogLLs){
                         if(logLL == 0){
@@ -701,25 +1129,42 @@ namespace loc{
                     }
                     BOOST_THROW_EXCEPTION(ex);
                 }
-                // Renormalized
-                for(int i=0; i<weights.size(); i++){
-                    weights[i] = weights[i]/sumWeights;
-                    states->at(i).weight(weights[i]);
+                // Set negative log-likelihoods and weights
+                for(size_t i=0; i<n; i++){
+                    State& s = states->at(i);
+                    s.negativeLogLikelihood(-mAlphaWeaken*vLogLLs[i]);
+                    s.mahalanobisDistance(mDists[i]);
+                    s.weight(weights[i]);
+                    // posterior of the marginalized RSSI bias
+                    const auto& values = vLogLLsAndMDists[i];
+                    if(values.size()>5){
+                        s.rssiBias(values[4]).rssiBiasVariance(values[5]);
+                    }
                 }
                 
                 // Logging after weights updated
-                logStates(*states, "after_likelihood_states_"+std::to_string(timestamp)+".csv");
+                traceStates(ParticleTraceRecord::AFTER_LIKELIHOOD, timestamp, *states, -1, weightStats.ess);
                 
                 // Resampling step
-                double ess = computeESS(weights);
+                double ess = weightStats.ess;
                 if(mOptVerbose){
-                    std::cout << "ESS=" << ess << std::endl;
+                    LOC_LOG_DEBUG(FILTER, "ESS=" << ess);
                 }
                 StatesPtr statesNew;
                 Status::Step step;
                 
-                if(ess<=mEssThreshold){
-                    statesNew.reset(mResampler->resample(*states, &weights[0]));
+                clearGroupedStates();
+                size_t nOut = hasTimeBudget() ? targetNumStates() : states->size();
+                if(nOut!=states->size()){
+                    // The number of states is changed by subsampling or reduction.
+                    statesNew.reset(new States(sampleStates(*states, weights, nOut)));
+                    step = Status::FILTERING_WITH_RESAMPLING;
+                }else if(weightStats.needsResampling){
+                    if(mCompressesStates){
+                        statesNew = resampleCompressed(*states, weights);
+                    }else{
+                        statesNew.reset(mResampler->resample(*states, &weights[0]));
+                    }
                     // Assign equal weights after resampling
                     for(int i=0; i<weights.size(); i++){
                         double weight = 1.0/(weights.size());
@@ -731,17 +1176,50 @@ namespace loc{
                     step = Status::FILTERING_WITHOUT_RESAMPLING;
                 }
                 
+                if(hasTimeBudget() && nOut < static_cast<size_t>(mNumStates)){
+                    mDegradations |= Status::REDUCED_STATES;
+                }
+                
                 // Posterior-resampling
                 if(mPostResampler){
-                    *statesNew = mPostResampler->resample(*statesNew);
+                    if(hasTimeBudget() && remainingMS() < mPostResampleCostMS){
+                        mPostResamplingDeferred = true;
+                        mDegradations |= Status::DEFERRED_POSTERIOR_RESAMPLING;
+                    }else{
+                        auto start = std::chrono::steady_clock::now();
+                        *statesNew = mPostResampler->resample(*statesNew);
+                        updateCost(mPostResampleCostMS, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                    }
+                }
+                
+                // Adapt the number of states for the next update
+                if(hasTimeBudget()){
+                    double elapsed = elapsedMS();
+                    if(mTimeBudgetParams->timeBudgetMS() < elapsed){
+                        reduceTargetNumStates();
+                    }else if(elapsed < 0.5*mTimeBudgetParams->timeBudgetMS() && mDegradations==Status::NO_DEGRADATION){
+                        recoverTargetNumStates();
+                    }
                 }
                 
                 status->states(statesNew, step);
+                if(mCompressesStates && step==Status::FILTERING_WITH_RESAMPLING && !mGroupSizes.empty()){
+                    mGroupedStates = statesNew;
+                    mGroupedStatesVersion = status->statesVersion();
+                }else{
+                    clearGroupedStates();
+                }
                 if(mOptVerbose){
-                    std::cout << "resampling at t=" << beacons.timestamp() << std::endl;
+                    LOC_LOG_DEBUG(FILTER, "resampling at t=" << beacons.timestamp());
+                }
+                if(isHybridTrackingEnabled()){
+                    mUpdatesSinceExpansion++;
+                    if(step==Status::FILTERING_WITH_RESAMPLING && canCollapse()){
+                        collapseToEnsemble();
+                    }
                 }
                 // Logging after resampling
-                logStates(*statesNew, "resampled_states_"+std::to_string(timestamp)+".csv");
+                traceStates(ParticleTraceRecord::RESAMPLED, timestamp, *statesNew, step, weightStats.ess);
                 
                 // Notify registered instances of the update of particle fiter
                 this->notifyObservationUpdated();
@@ -754,13 +1232,190 @@ namespace loc{
             mRandomWalker->notifyObservationUpdated();
         }
         
-        double computeESS(std::vector<double> weights){
-            double val = 0;
-            for(double w : weights){
-                val += w*w;
+        bool isHybridTrackingEnabled() const{
+            return mHybridParams->enabled() && mHybridModel && mDataStore;
+        }
+        
+        bool canCollapse() const{
+            if(status->locationStatus()!=Status::STABLE || mUpdatesSinceExpansion < mHybridParams->minUpdatesBeforeCollapse()){
+                return false;
+            }
+            auto summary = status->summary();
+            const auto& floorMass = summary->floorMass();
+            double maxFloorMass = 0;
+            for(const auto& pair: floorMass){
+                maxFloorMass = std::max(maxFloorMass, pair.second);
+            }
+            return mHybridParams->collapseFloorProbability() <= maxFloorMass
+            && summary->stdev2D() <= mHybridParams->collapseStdev2D();
+        }
+        
+        // Replaces the particles by an ensemble drawn from the particles on the most probable floor.
+        void collapseToEnsemble(){
+            const States& states = *status->states();
+            auto summary = status->summary();
+            int floor = 0;
+            double maxFloorMass = -1;
+            for(const auto& pair: summary->floorMass()){
+                if(maxFloorMass < pair.second){
+                    maxFloorMass = pair.second;
+                    floor = pair.first;
+                }
             }
-            double ess = 1.0/val;
-            return ess;
+            States statesOnFloor;
+            std::vector<double> weights;
+            for(const State& s: states){
+                if(std::round(s.floor())==floor){
+                    statesOnFloor.push_back(s);
+                    weights.push_back(s.weight());
+                }
+            }
+            if(statesOnFloor.size()==0){
+                return;
+            }
+            StatesPtr ensemble(new States(sampleStates(statesOnFloor, weights, mHybridParams->ensembleSize())));
+            status->states(ensemble, status->step());
+            mKalmanTracking = true;
+            mInconsistentUpdates = 0;
+            LOC_LOG_INFO(FILTER, "collapsed " << states.size() << " particles to an ensemble of " << ensemble->size() << " states (stdev2D=" << summary->stdev2D() << ")");
+        }
+        
+        // Returns false when the ensemble diverged and was expanded to particles.
+        bool updateByKalmanFilter(const Beacons& beacons){
+            const States& states = *status->states();
+            for(const State& s: states){
+                if(s.floor()!=states.front().floor()){
+                    expandToParticles("the floors of the ensemble disagree");
+                    return false;
+                }
+            }
+            EnsembleKalmanUpdater updater(mHybridModel);
+            updater.jacobianStep(mHybridParams->jacobianStep());
+            StatesPtr statesNew(new States(states));
+            auto result = updater.update(*statesNew, beacons, mDataStore->getBuilding(), *mRand);
+            if(0<result.nObservations){
+                bool isInconsistent = mHybridParams->maxNormalizedInnovation() < result.normalizedInnovation;
+                mInconsistentUpdates = isInconsistent ? mInconsistentUpdates+1 : 0;
+                double rejectedRatio = static_cast<double>(result.nRejected)/statesNew->size();
+                if(mHybridParams->maxInconsistentUpdates() <= mInconsistentUpdates){
+                    expandToParticles("innovations are inconsistent");
+                    return false;
+                }
+                if(mHybridParams->maxRejectedRatio() < rejectedRatio){
+                    expandToParticles("updates are blocked by walls");
+                    return false;
+                }
+                if(mOptVerbose){
+                    LOC_LOG_DEBUG(FILTER, "Kalman update: #beacons=" << result.nObservations << ", normalizedInnovation=" << result.normalizedInnovation
+                                  << ", rejected=" << result.nRejected);
+                }
+            }
+            status->states(statesNew, Status::FILTERING_WITHOUT_RESAMPLING);
+            traceStates(ParticleTraceRecord::RESAMPLED, beacons.timestamp(), *statesNew, Status::FILTERING_WITHOUT_RESAMPLING);
+            this->notifyObservationUpdated();
+            return true;
+        }
+        
+        // Draws particles around the ensemble members. The spread of the ensemble is inflated by expansionStdevScale.
+        void expandToParticles(const std::string& reason){
+            const States& ensemble = *status->states();
+            size_t n = ensemble.size();
+            Location mean = Location::mean(ensemble);
+            double meanOrientationBias = 0;
+            double meanRssiBias = 0;
+            for(const State& s: ensemble){
+                meanOrientationBias += Pose::normalizeOrientaion(s.orientationBias() - ensemble.front().orientationBias())/n;
+                meanRssiBias += s.rssiBias()/n;
+            }
+            meanOrientationBias += ensemble.front().orientationBias();
+            double scale = std::sqrt(std::max(0.0, std::pow(mHybridParams->expansionStdevScale(), 2) - 1.0));
+            const Building& building = mDataStore->getBuilding();
+            StatesPtr states(new States());
+            states->reserve(mNumStates);
+            for(int i=0; i<mNumStates; i++){
+                // a member displaced by the deviation of another member from the mean
+                const State& s = ensemble.at(mRand->nextInt(static_cast<int>(n)-1));
+                const State& d = ensemble.at(mRand->nextInt(static_cast<int>(n)-1));
+                State sNew(s);
+                sNew.x(s.x() + scale*(d.x() - mean.x())).y(s.y() + scale*(d.y() - mean.y()));
+                if(!building.isMovable(sNew)){
+                    sNew = s;
+                }
+                double dOrientationBias = Pose::normalizeOrientaion(d.orientationBias() - meanOrientationBias);
+                sNew.orientationBias(s.orientationBias() + scale*dOrientationBias);
+                sNew.orientation(Pose::normalizeOrientaion(s.orientation() - scale*dOrientationBias));
+                sNew.rssiBias(s.rssiBias() + scale*(d.rssiBias() - meanRssiBias));
+                sNew.weight(1.0/mNumStates);
+                states->push_back(sNew);
+            }
+            status->states(states, Status::OTHER);
+            mKalmanTracking = false;
+            mInconsistentUpdates = 0;
+            mUpdatesSinceExpansion = 0;
+            LOC_LOG_INFO(FILTER, "expanded an ensemble of " << n << " states to " << mNumStates << " particles because " << reason);
+        }
+        
+        bool isStationary(long timestamp) const{
+            if(!mDutyCycleParams->enabled() || !mPedometer || mLastStepTimestamp==0){
+                return false;
+            }
+            if(timestamp - mLastStepTimestamp < mDutyCycleParams->stationaryIntervalMS()){
+                return false;
+            }
+            return !(mAltitudeManager && 0 < mAltitudeManager->heightChange());
+        }
+        
+        // Compares the RSSIs with the last processed frame. The differences are normalized by the noise of the
+        // observation model at the mean location (sqrt(2)*stdev for the difference of two observations).
+        bool isLowNovelty(const Beacons& beacons){
+            if(!mDutyCycleParams->enabled() || mLastUpdateBeacons.size()==0){
+                return false;
+            }
+            const auto& gpModel = mNoveltyModel;
+            if(!gpModel){
+                return false;
+            }
+            auto meanLoc = status->meanLocation();
+            State meanState;
+            meanState.x(meanLoc->x());
+            meanState.y(meanLoc->y());
+            meanState.z(meanLoc->z());
+            meanState.floor(std::round(meanLoc->floor()));
+            auto rssiStats = gpModel->predict(meanState, beacons);
+            
+            std::map<long, double> previousRssis;
+            for(const Beacon& b: mLastUpdateBeacons){
+                previousRssis[b.id()] = b.rssi();
+            }
+            double penalty = mDutyCycleParams->missingBeaconPenalty();
+            double sum = 0;
+            size_t count = 0;
+            for(const Beacon& b: beacons){
+                auto iter = previousRssis.find(b.id());
+                if(iter==previousRssis.end()){
+                    sum += penalty;
+                }else{
+                    bool isKnown = rssiStats.count(b.id())==1;
+                    if(isKnown){
+                        double d = (b.rssi() - iter->second)/(std::sqrt(2.0)*rssiStats.at(b.id()).stdev());
+                        sum += d*d;
+                    }
+                    previousRssis.erase(iter);
+                    if(!isKnown){
+                        continue; // unknown beacons do not change the likelihood
+                    }
+                }
+                count++;
+            }
+            sum += penalty*previousRssis.size();
+            count += previousRssis.size();
+            return 0<count && sum/count < mDutyCycleParams->noveltyThreshold();
+        }
+        
+        void endKalmanTracking(){
+            mKalmanTracking = false;
+            mInconsistentUpdates = 0;
+            mUpdatesSinceExpansion = 0;
         }
         
         Beacons filterBeacons(const Beacons& beacons){
@@ -770,7 +1425,7 @@ namespace loc{
             size_t nAfter = beaconsFiltered.size();
             if(mOptVerbose){
                 if(nAfter!=nBefore){
-                    std::cout << "BeaconFilter #beacons "<< nBefore << ">>" << nAfter <<std::endl;
+                    LOC_LOG_DEBUG(FILTER, "BeaconFilter #beacons "<< nBefore << ">>" << nAfter);
                 }
             }
             return beaconsFiltered;
@@ -796,7 +1451,7 @@ namespace loc{
                     beaconsFloorEst.push_back(b);
                 }
             }
-            std::cout << "floor_est=" << floor_est << ", #beacons " << beacons.size() << " -> " << beaconsFloorEst.size() << std::endl;
+            LOC_LOG_INFO(FILTER, "floor_est=" << floor_est << ", #beacons " << beacons.size() << " -> " << beaconsFloorEst.size());
             return beaconsFloorEst;
         }
         
@@ -818,13 +1473,28 @@ namespace loc{
         }
         
         void putBeacons(const Beacons& beacons){
+            mUpdateStart = std::chrono::steady_clock::now();
             initializeStatusIfZero();
+            flushMotion();
+            mDegradations = Status::NO_DEGRADATION;
             status->step(Status::OTHER);
             
             const Beacons& beaconsFiltered = filterBeacons(beacons);
-            if(beaconsFiltered.size()>0){
+            bool stationary = isStationary(beacons.timestamp());
+            bool lowNovelty = beaconsFiltered.size()>0 && isLowNovelty(beaconsFiltered);
+            bool withinSkipInterval = beacons.timestamp() - mLastUpdateTimestamp < mDutyCycleParams->maxSkipIntervalMS();
+            mDutyCycleStatistics.stationaryFrames += stationary;
+            mDutyCycleStatistics.lowNoveltyFrames += lowNovelty;
+            if(stationary && lowNovelty && withinSkipInterval && status->locationStatus()==Status::STABLE){
+                mDegradations |= Status::SKIPPED_UPDATE;
+                mDutyCycleStatistics.skippedUpdates++;
+                status->step(Status::OBSERVATION_WITHOUT_FILTERING);
+                if(mOptVerbose){
+                    LOC_LOG_DEBUG(FILTER, "update was skipped (stationary and unchanged beacons)");
+                }
+            }else if(beaconsFiltered.size()>0){
+                mSkipsFrameMixing = stationary || lowNovelty;
                 // Observation dependent floor update
-                std::shared_ptr<States> states = status->states();
                 bool tryFloorUpdate = false;
                 if(mEnablesFloorUpdate){
                     if(!mFloorUpdater){
@@ -835,14 +1505,16 @@ namespace loc{
                         mFloorUpdater->mVerbose = mOptVerbose;
                         mFloorUpdater->randomGenerator = mRand;
                     }
-                    tryFloorUpdate = checkTryFloorUpdate();
+                    tryFloorUpdate = !mKalmanTracking && checkTryFloorUpdate();
                     if(tryFloorUpdate){
+                        // The published states are not modified in place.
+                        StatesPtr states(new States(*status->states()));
                         mFloorUpdater->floorUpdate(*states, beaconsFiltered);
                         status->states(states);// update states to compute rep values.
                     }
                 }
                 // filtering
-                bool doesFiltering = checkIfDoFiltering(*states);
+                bool doesFiltering = checkIfDoFiltering(*status);
                 bool monitorsStatus = true;
                 
                 if(doesFiltering){
@@ -852,7 +1524,7 @@ namespace loc{
                 }else{
                     updateStatusByBeacons(beaconsFiltered, doesFiltering, monitorsStatus);
                     if(mOptVerbose){
-                        std::cout<<"filtering step was not applied."<<std::endl;
+                        LOC_LOG_DEBUG(FILTER, "filtering step was not applied.");
                     }
                     status->step(Status::OBSERVATION_WITHOUT_FILTERING);
                 }
@@ -861,20 +1533,98 @@ namespace loc{
                         status->wasFloorUpdated(true);
                     }
                 }
+                mSkipsFrameMixing = false;
+                mDutyCycleStatistics.updates++;
+                mLastUpdateTimestamp = beacons.timestamp();
+                mLastUpdateBeacons = beaconsFiltered;
             }else{
                 status->step(Status::OBSERVATION_WITHOUT_FILTERING);
             }
             status->timestamp(beacons.timestamp());
+            status->degradations(mDegradations);
+            if(mOptVerbose && hasTimeBudget()){
+                LOC_LOG_DEBUG(FILTER, "update time=" << elapsedMS() << "ms, budget=" << mTimeBudgetParams->timeBudgetMS()
+                << "ms, degradations=" << Status::degradationsToString(mDegradations));
+            }
             callback(status.get());
         };
-
-        static std::vector<double> weakenLogLikelihoods(std::vector<double> logLikelihoods, double alphaWeaken){
-            size_t n = logLikelihoods.size();
-            std::vector<double> weakenedLogLLs(n);
-            for(int i=0; i<n; i++){
-                weakenedLogLLs[i] = alphaWeaken*logLikelihoods[i];
+        
+        bool hasTimeBudget() const{
+            return 0 < mTimeBudgetParams->timeBudgetMS();
+        }
+        
+        double elapsedMS() const{
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mUpdateStart).count();
+        }
+        
+        double remainingMS() const{
+            return mTimeBudgetParams->timeBudgetMS() - elapsedMS();
+        }
+        
+        void updateCost(double& cost, double measured) const{
+            double rate = mTimeBudgetParams->costSmoothingRate();
+            cost = cost==0 ? measured : (1.0-rate)*cost + rate*measured;
+        }
+        
+        double postResampleCostMS() const{
+            return mPostResampler ? mPostResampleCostMS : 0.0;
+        }
+        
+        size_t targetNumStates(){
+            if(mTargetNumStates==0){
+                mTargetNumStates = mNumStates;
+            }
+            return mTargetNumStates;
+        }
+        
+        // Runs the posterior resampling deferred by an earlier update on the states before this update
+        // if the predicted cost of this update leaves room for it. Otherwise it stays queued.
+        void runDeferredPostResampling(States& states){
+            if(!mPostResampler){
+                mPostResamplingDeferred = false;
+                return;
+            }
+            double predictedMS = mMixCostMS + mLogLLCostPerStateMS*states.size() + 2.0*mPostResampleCostMS;
+            if(hasTimeBudget() && remainingMS() < predictedMS){
+                mDegradations |= Status::DEFERRED_POSTERIOR_RESAMPLING;
+                return;
+            }
+            auto start = std::chrono::steady_clock::now();
+            states = mPostResampler->resample(states);
+            updateCost(mPostResampleCostMS, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            mPostResamplingDeferred = false;
+        }
+        
+        void reduceTargetNumStates(){
+            size_t minNumStates = std::max<size_t>(1, mNumStates*mTimeBudgetParams->minNumStatesRatio());
+            size_t reduced = targetNumStates()*mTimeBudgetParams->numStatesReductionRate();
+            mTargetNumStates = std::max(minNumStates, reduced);
+        }
+        
+        void recoverTargetNumStates(){
+            size_t increased = std::ceil(targetNumStates()/mTimeBudgetParams->numStatesReductionRate());
+            mTargetNumStates = std::min<size_t>(mNumStates, increased);
+        }
+        
+        // Systematic sampling of n states with probabilities proportional to weights.
+        States sampleStates(const States& states, const std::vector<double>& weights, size_t n){
+            States sampled;
+            sampled.reserve(n);
+            double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+            double step = sum/n;
+            double u = step*mRand->nextDouble();
+            double cumsum = weights.at(0);
+            size_t j = 0;
+            for(size_t i=0; i<n; i++){
+                double target = u + i*step;
+                while(cumsum < target && j+1 < states.size()){
+                    j++;
+                    cumsum += weights.at(j);
+                }
+                sampled.push_back(states.at(j));
+                sampled.back().weight(1.0/n);
             }
-            return weakenedLogLLs;
+            return sampled;
         }
 
         void reset(){
@@ -887,6 +1637,8 @@ namespace loc{
             mOrientationmeter->reset();
             StatesPtr states(new States(mStatusInitializer->initializeStates(mNumStates)));
             updateStatus(states);
+            endKalmanTracking();
+            discardMotion();
         }
 
         void updateStatus(StatesPtr states){
@@ -929,14 +1681,16 @@ namespace loc{
         bool resetStatus(Pose pose){
             bool orientationWasUpdated = mOrientationmeter->isUpdated();
             if(orientationWasUpdated){
-                std::cout << "Orientation is updated. Reset succeeded." << std::endl;
+                LOC_LOG_INFO(FILTER, "Orientation is updated. Reset succeeded.");
                 double orientationMeasured = mOrientationmeter->getYaw();
                 StatesPtr states(new States(mStatusInitializer->resetStates(mNumStates, pose, orientationMeasured)));
                 status->states(states, Status::RESET);
+                endKalmanTracking();
+                discardMotion();
                 callback(status.get());
                 return true;
             }else{
-                std::cout << "Orientation has not been updated. Reset input is cached to be processed later." << std::endl;
+                LOC_LOG_INFO(FILTER, "Orientation has not been updated. Reset input is cached to be processed later.");
                 std::function<void()> func = [this,pose](){
                     return resetStatus(pose);
                 };
@@ -948,14 +1702,16 @@ namespace loc{
         bool resetStatus(Pose meanPose, Pose stdevPose){
             bool orientationWasUpdated = mOrientationmeter->isUpdated();
             if(orientationWasUpdated){
-                std::cout << "Orientation is updated. Reset succeeded." << std::endl;
+                LOC_LOG_INFO(FILTER, "Orientation is updated. Reset succeeded.");
                 double orientationMeasured = mOrientationmeter->getYaw();
                 StatesPtr states(new States(mStatusInitializer->resetStates(mNumStates, meanPose, stdevPose, orientationMeasured)));
                 status->states(states, Status::RESET);
+                endKalmanTracking();
+                discardMotion();
                 callback(status.get());
                 return true;
             }else{
-                std::cout << "Orientation has not been updated. Reset input is cached to be processed later." << std::endl;
+                LOC_LOG_INFO(FILTER, "Orientation has not been updated. Reset input is cached to be processed later.");
                 std::function<void()> func = [this,meanPose,stdevPose](){
                     return resetStatus(meanPose, stdevPose);
                 };
@@ -967,7 +1723,7 @@ namespace loc{
         bool resetStatus(Pose meanPose, Pose stdevPose, double rateContami){
             bool orientationWasUpdated = mOrientationmeter->isUpdated();
             if(orientationWasUpdated){
-                std::cout << "Orientation is updated. Reset(meanPose, stdevPose, rateContami) succeeded." << std::endl;
+                LOC_LOG_INFO(FILTER, "Orientation is updated. Reset(meanPose, stdevPose, rateContami) succeeded.");
                 double orientationMeasured = mOrientationmeter->getYaw();
                 auto statesTmp = mStatusInitializer->resetStates(mNumStates, meanPose, stdevPose, orientationMeasured);
                 for(auto& s: statesTmp){
@@ -981,10 +1737,12 @@ namespace loc{
                 }
                 StatesPtr states(new States(statesTmp));
                 status->states(states, Status::RESET);
+                endKalmanTracking();
+                discardMotion();
                 callback(status.get());
                 return true;
             }else{
-                std::cout << "Orientation has not been updated. Reset input is cached to be processed later." << std::endl;
+                LOC_LOG_INFO(FILTER, "Orientation has not been updated. Reset input is cached to be processed later.");
                 std::function<void()> func = [this,meanPose,stdevPose, rateContami](){
                     return resetStatus(meanPose, stdevPose, rateContami);
                 };
@@ -1008,13 +1766,15 @@ namespace loc{
             States statesTmp = sampleStatesByObservation(mNumStates, beaconsFiltered);
             StatesPtr statesNew(new States(statesTmp));
             status->states(statesNew, Status::RESET);
+            endKalmanTracking();
+            discardMotion();
             status->timestamp(beacons.timestamp());
             if(mMetro){
                 ss << "an ObservationDependentInitializer.";
             }else{
                 ss << "a StatusInitializer.";
             }
-            std::cout << ss.str() << std::endl;
+            LOC_LOG_INFO(FILTER, ss.str());
             return false;
         }
         
@@ -1028,7 +1788,7 @@ namespace loc{
                 std::vector<Location> locations(states.begin(), states.end());
                 statesNew = mStatusInitializer->initializeStatesFromLocations(locations);
                 for(int i=0; i<states.size(); i++){
-                    statesNew.at(i).rssiBias(states.at(i).rssiBias());
+                    statesNew.at(i).rssiBias(states.at(i).rssiBias()).rssiBiasVariance(states.at(i).rssiBiasVariance());
                 }
             }else{
                 statesNew = mStatusInitializer->resetStates(n, beaconsFiltered);
@@ -1044,13 +1804,15 @@ namespace loc{
             States statesTmp = sampleStatesByLocationAndObservation(mNumStates, location, beaconsFiltered);
             StatesPtr statesNew(new States(statesTmp));
             status->states(statesNew, Status::RESET);
+            endKalmanTracking();
+            discardMotion();
             status->timestamp(beacons.timestamp());
             if(mMetro){
                 ss << "an ObservationDependentInitializer.";
             }else{
                 ss << "a StatusInitializer.";
             }
-            std::cout << ss.str() << std::endl;
+            LOC_LOG_INFO(FILTER, ss.str());
             return false;
         }
         
@@ -1077,8 +1839,7 @@ namespace loc{
             const Beacons& beaconsFiltered = filterBeacons(beacons);
 
             if(beaconsFiltered.size()>0){
-                auto states = status->states();
-                if(checkIfDoFiltering(*states)){
+                if(checkIfDoFiltering(*status)){
                     doFiltering(beaconsFiltered);
                 }
             }
@@ -1087,6 +1848,8 @@ namespace loc{
             StatesPtr statesNew(new States(mStatusInitializer->initializeStatesFromLocations(locations)));
             status->timestamp(beacons.timestamp());
             status->states(statesNew, Status::RESET);
+            endKalmanTracking();
+            discardMotion();
             callback(status.get());
             return false;
         }
@@ -1098,24 +1861,24 @@ namespace loc{
                     std::function<void()> func = functionsForReset.back();
                     func();
                     functionsForReset.pop();
-                    std::cout << "Stored reset request was processed." << std::endl;
+                    LOC_LOG_INFO(FILTER, "Stored reset request was processed.");
                 }
             }
         }
 
-        bool checkIfDoFiltering(const States& states) const{
+        bool checkIfDoFiltering(const Status& st) const{
             double variance2DLowerBound = std::pow(mLocStdevLB.x(), 2)*std::pow(mLocStdevLB.y(),2);
             double stdZLB = mLocStdevLB.z();
             double stdFloorLB = mLocStdevLB.floor();
             
-            double variance2D = Location::compute2DVariance(states);
-            Location stdevLoc = Location::standardDeviation(states);
+            auto summary = st.summary();
+            double variance2D = summary->variance2D();
+            const Location& stdevLoc = summary->standardDeviation();
             
             if(mOptVerbose){
-                std::cout<<"var2D="<<variance2D<<","<<"var2DLB="<<variance2DLowerBound
+                LOC_LOG_DEBUG(FILTER, "var2D="<<variance2D<<","<<"var2DLB="<<variance2DLowerBound
                 << ",stdZ=" << stdevLoc.z() << ",stdZLB=" << stdZLB
-                << ",stdFloor=" << stdevLoc.floor() << ",stdFloorLB=" << stdFloorLB
-                << std::endl;
+                << ",stdFloor=" << stdevLoc.floor() << ",stdFloorLB=" << stdFloorLB);
             }
             if(variance2D <= variance2DLowerBound
                && stdevLoc.z() <= stdZLB
@@ -1126,12 +1889,107 @@ namespace loc{
             }
         }
 
+        void saveState(SnapshotOutputArchive& ar) const{
+            if(functionsForReset.size()>0){
+                LOC_LOG_WARN(FILTER, functionsForReset.size() << " pending reset request(s) are not included in the snapshot.");
+            }
+            long timestamp = status->timestamp();
+            int step = status->step();
+            int locationStatus = status->locationStatus();
+            bool wasFloorUpdated = status->wasFloorUpdated();
+            int degradations = status->degradations();
+            ar(CEREAL_NVP(timestamp), CEREAL_NVP(step), CEREAL_NVP(locationStatus), CEREAL_NVP(wasFloorUpdated), CEREAL_NVP(degradations));
+            ar(cereal::make_nvp("states", *status->states()));
+            // multiplicities of the resampled states for the next prediction
+            bool hasGroups = hasGroupedStates();
+            ar(CEREAL_NVP(hasGroups));
+            if(hasGroups){
+                ar(CEREAL_NVP(mGroupSizes));
+            }
+            
+            ar(CEREAL_NVP(previousTimestampMotion), CEREAL_NVP(previousTimestampMonitoring), CEREAL_NVP(statusMonitorUnstableCounter));
+            ar(CEREAL_NVP(mDegradations), CEREAL_NVP(mTargetNumStates));
+            ar(CEREAL_NVP(mMixCostMS), CEREAL_NVP(mLogLLCostPerStateMS), CEREAL_NVP(mPostResampleCostMS), CEREAL_NVP(mPostResamplingDeferred));
+            ar(CEREAL_NVP(accelerationIsUpdated), CEREAL_NVP(attitudeIsUpdated));
+            ar(CEREAL_NVP(mKalmanTracking), CEREAL_NVP(mInconsistentUpdates), CEREAL_NVP(mUpdatesSinceExpansion));
+            ar(CEREAL_NVP(mLastStepTimestamp), CEREAL_NVP(mLastPredictionTimestamp), CEREAL_NVP(mLastUpdateTimestamp));
+            ar(CEREAL_NVP(mMotionStartTimestamp), CEREAL_NVP(mMotionLastTimestamp), CEREAL_NVP(mMotionSamples));
+            ar(CEREAL_NVP(mMotionWalkingTime), CEREAL_NVP(mMotionHeadingX), CEREAL_NVP(mMotionHeadingY));
+            ar(cereal::make_nvp("lastUpdateBeacons", static_cast<const std::vector<Beacon>&>(mLastUpdateBeacons)));
+            ar(cereal::make_nvp("randomGenerator", *mRand));
+            
+            saveComponentState(ar, mPedometer);
+            saveComponentState(ar, mOrientationmeter);
+            saveComponentState(ar, mAltitudeManager);
+            saveComponentState(ar, mRandomWalker);
+            saveComponentState(ar, mResampler);
+            saveComponentState(ar, mStatusInitializer);
+            saveComponentState(ar, mMetro);
+            saveComponentState(ar, mPostResampler);
+        }
+        
+        void loadState(SnapshotInputArchive& ar){
+            long timestamp = 0;
+            int step = Status::OTHER;
+            int locationStatus = Status::UNKNOWN;
+            bool wasFloorUpdated = false;
+            int degradations = Status::NO_DEGRADATION;
+            ar(CEREAL_NVP(timestamp), CEREAL_NVP(step), CEREAL_NVP(locationStatus), CEREAL_NVP(wasFloorUpdated), CEREAL_NVP(degradations));
+            auto states = std::make_shared<States>();
+            ar(cereal::make_nvp("states", *states));
+            
+            std::shared_ptr<Status> statusNew(new Status());
+            statusNew->timestamp(timestamp);
+            statusNew->states(states, static_cast<Status::Step>(step));
+            statusNew->locationStatus(static_cast<Status::LocationStatus>(locationStatus));
+            statusNew->wasFloorUpdated(wasFloorUpdated);
+            statusNew->degradations(degradations);
+            bool hasGroups = false;
+            std::vector<int> groupSizes;
+            ar(CEREAL_NVP(hasGroups));
+            if(hasGroups){
+                ar(cereal::make_nvp("mGroupSizes", groupSizes));
+            }
+            
+            ar(CEREAL_NVP(previousTimestampMotion), CEREAL_NVP(previousTimestampMonitoring), CEREAL_NVP(statusMonitorUnstableCounter));
+            ar(CEREAL_NVP(mDegradations), CEREAL_NVP(mTargetNumStates));
+            ar(CEREAL_NVP(mMixCostMS), CEREAL_NVP(mLogLLCostPerStateMS), CEREAL_NVP(mPostResampleCostMS), CEREAL_NVP(mPostResamplingDeferred));
+            ar(CEREAL_NVP(accelerationIsUpdated), CEREAL_NVP(attitudeIsUpdated));
+            ar(CEREAL_NVP(mKalmanTracking), CEREAL_NVP(mInconsistentUpdates), CEREAL_NVP(mUpdatesSinceExpansion));
+            ar(CEREAL_NVP(mLastStepTimestamp), CEREAL_NVP(mLastPredictionTimestamp), CEREAL_NVP(mLastUpdateTimestamp));
+            ar(CEREAL_NVP(mMotionStartTimestamp), CEREAL_NVP(mMotionLastTimestamp), CEREAL_NVP(mMotionSamples));
+            ar(CEREAL_NVP(mMotionWalkingTime), CEREAL_NVP(mMotionHeadingX), CEREAL_NVP(mMotionHeadingY));
+            std::vector<Beacon> lastUpdateBeacons;
+            ar(cereal::make_nvp("lastUpdateBeacons", lastUpdateBeacons));
+            mLastUpdateBeacons.assign(lastUpdateBeacons.begin(), lastUpdateBeacons.end());
+            ar(cereal::make_nvp("randomGenerator", *mRand));
+            
+            loadComponentState(ar, mPedometer);
+            loadComponentState(ar, mOrientationmeter);
+            loadComponentState(ar, mAltitudeManager);
+            loadComponentState(ar, mRandomWalker);
+            loadComponentState(ar, mResampler);
+            loadComponentState(ar, mStatusInitializer);
+            loadComponentState(ar, mMetro);
+            loadComponentState(ar, mPostResampler);
+            
+            status = statusNew;
+            clearGroupedStates();
+            if(hasGroups){
+                mGroupSizes = groupSizes;
+                mGroupedStates = states;
+                mGroupedStatesVersion = status->statesVersion();
+            }
+            functionsForReset = std::queue<std::function<void()>>();
+        }
+
         void optVerbose(bool optVerbose){
             mOptVerbose = optVerbose;
         }
 
         void numStates(int numStates){
             mNumStates = numStates;
+            mTargetNumStates = 0;
         }
 
         void alphaWeaken(double alphaWeaken){
@@ -1172,6 +2030,7 @@ namespace loc{
 
         void observationModel(std::shared_ptr<ObservationModel<State, Beacons>> observationModel){
             mObservationModel = observationModel;
+            resolveNoveltyModel();
         }
 
         void resampler(std::shared_ptr<Resampler<State>> resampler){
@@ -1205,6 +2064,49 @@ namespace loc{
         void locationStatusMonitorParameters(LocationStatusMonitorParameters::Ptr params){
             mLocStatusMonitorParams = params;
         }
+        
+        void timeBudgetParameters(TimeBudgetParameters::Ptr params){
+            mTimeBudgetParams = params;
+        }
+        
+        void compressesStates(bool compresses){
+            mCompressesStates = compresses;
+        }
+        
+        void hybridTrackingParameters(HybridTrackingParameters::Ptr params){
+            mHybridParams = params;
+        }
+        
+        void hybridTrackingModel(std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> model){
+            mHybridModel = model;
+            resolveNoveltyModel();
+        }
+        
+        // The observation model may wrap the GP model (e.g. BatchedObservationModel), so the hybrid tracking model is preferred.
+        void resolveNoveltyModel(){
+            mNoveltyModel = mHybridModel ? mHybridModel : std::dynamic_pointer_cast<GaussianProcessLDPLMultiModel<State, Beacons>>(mObservationModel);
+        }
+        
+        void dutyCycleParameters(DutyCycleParameters::Ptr params){
+            mDutyCycleParams = params;
+        }
+        
+        DutyCycleStatistics dutyCycleStatistics() const{
+            return mDutyCycleStatistics;
+        }
+        
+        void motionIntegrationParameters(MotionIntegrationParameters::Ptr params){
+            mMotionIntegrationParams = params;
+            discardMotion();
+        }
+        
+        bool isKalmanTracking() const{
+            return mKalmanTracking;
+        }
+        
+        StatesCompressionStatistics statesCompressionStatistics() const{
+            return mCompressionStatistics;
+        }
     };
 
 
@@ -1284,6 +2186,14 @@ namespace loc{
     bool StreamParticleFilter::refineStatus(const Beacons& beacons){
         return impl->refineStatus(beacons);
     }
+    
+    void StreamParticleFilter::saveState(SnapshotOutputArchive& ar) const{
+        impl->saveState(ar);
+    }
+    
+    void StreamParticleFilter::loadState(SnapshotInputArchive& ar){
+        impl->loadState(ar);
+    }
 
     StreamParticleFilter& StreamParticleFilter::optVerbose(bool optVerbose){
         impl->optVerbose(optVerbose);
@@ -1388,4 +2298,46 @@ namespace loc{
         impl->locationStatusMonitorParameters(params);
         return * this;
     }
+    
+    StreamParticleFilter& StreamParticleFilter::compressesStates(bool compresses){
+        impl->compressesStates(compresses);
+        return * this;
+    }
+    
+    StatesCompressionStatistics StreamParticleFilter::statesCompressionStatistics() const{
+        return impl->statesCompressionStatistics();
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::hybridTrackingParameters(HybridTrackingParameters::Ptr params){
+        impl->hybridTrackingParameters(params);
+        return * this;
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::hybridTrackingModel(std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> model){
+        impl->hybridTrackingModel(model);
+        return * this;
+    }
+    
+    bool StreamParticleFilter::isKalmanTracking() const{
+        return impl->isKalmanTracking();
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::dutyCycleParameters(DutyCycleParameters::Ptr params){
+        impl->dutyCycleParameters(params);
+        return * this;
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::motionIntegrationParameters(MotionIntegrationParameters::Ptr params){
+        impl->motionIntegrationParameters(params);
+        return * this;
+    }
+    
+    DutyCycleStatistics StreamParticleFilter::dutyCycleStatistics() const{
+        return impl->dutyCycleStatistics();
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::timeBudgetParameters(TimeBudgetParameters::Ptr params){
+        impl->timeBudgetParameters(params);
+        return * this;
+    }
 }
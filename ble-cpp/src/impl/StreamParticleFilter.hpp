@@ -36,6 +36,9 @@
 
 #include "BeaconFilter.hpp"
 #include "AltitudeManager.hpp"
+#include "SnapshotUtils.hpp"
+#include "CompressedStates.hpp"
+#include "GaussianProcessLDPLMultiModel.hpp"
 
 namespace loc {
     
@@ -100,8 +103,22 @@ namespace loc {
         }
     };
     
+    // Counters of the work skipped by the duty-cycling mode
+    class DutyCycleStatistics{
+    public:
+        long predictions = 0;
+        long skippedPredictions = 0;
+        long updates = 0;
+        long skippedUpdates = 0;
+        long skippedMixings = 0;
+        long stationaryFrames = 0;
+        long lowNoveltyFrames = 0;
+        
+        friend std::ostream& operator<<(std::ostream&os, const DutyCycleStatistics& stats);
+    };
+    
     //template<class Tsys, class Tobs>
-    class StreamParticleFilter : public StreamLocalizer{
+    class StreamParticleFilter : public StreamLocalizer, public Snapshottable{
     public:
         class MixtureParameters{
             double mRejectFloorDifference=0.5; // Threshold of the probability that the floor of the states and a state to be mixed is different.
@@ -146,6 +163,157 @@ namespace loc {
             }
         };
         
+        // Parameters for deadline-aware updates. When an update is predicted to exceed the time budget,
+        // the following degradations are applied in order: skip mixing, subsample likelihood evaluation,
+        // reduce the number of states and defer posterior resampling to the next update that can afford it.
+        class TimeBudgetParameters{
+        protected:
+            double timeBudgetMS_ = 0; // <=0 disables degradations
+            double minSubsampleRatio_ = 0.2;
+            double minNumStatesRatio_ = 0.25;
+            double numStatesReductionRate_ = 0.8;
+            double costSmoothingRate_ = 0.2;
+            
+        public:
+            using Ptr = std::shared_ptr<TimeBudgetParameters>;
+            double timeBudgetMS() const;
+            double minSubsampleRatio() const;
+            double minNumStatesRatio() const;
+            double numStatesReductionRate() const;
+            double costSmoothingRate() const;
+            TimeBudgetParameters& timeBudgetMS(double);
+            TimeBudgetParameters& minSubsampleRatio(double);
+            TimeBudgetParameters& minNumStatesRatio(double);
+            TimeBudgetParameters& numStatesReductionRate(double);
+            TimeBudgetParameters& costSmoothingRate(double);
+            
+            template<class Archive>
+            void serialize(Archive & ar, std::uint32_t const version)
+            {
+                ar(CEREAL_NVP(timeBudgetMS_));
+                ar(CEREAL_NVP(minSubsampleRatio_));
+                ar(CEREAL_NVP(minNumStatesRatio_));
+                ar(CEREAL_NVP(numStatesReductionRate_));
+                ar(CEREAL_NVP(costSmoothingRate_));
+            }
+        };
+        
+        // Parameters for the hybrid mode. When the particles are concentrated on one floor in a STABLE status,
+        // they are replaced by a small ensemble updated by an ensemble Kalman filter. The ensemble is predicted
+        // by the system model (including the wall check) and is expanded to particles again when the innovations
+        // are inconsistent for consecutive updates, when many updates hit walls or when the floors disagree.
+        class HybridTrackingParameters{
+        protected:
+            bool enabled_ = false;
+            int ensembleSize_ = 50;
+            double collapseStdev2D_ = 1.0; // [m]
+            double collapseFloorProbability_ = 0.99;
+            int minUpdatesBeforeCollapse_ = 10;
+            double maxNormalizedInnovation_ = 4.0;
+            int maxInconsistentUpdates_ = 3;
+            double maxRejectedRatio_ = 0.5;
+            double expansionStdevScale_ = 2.0;
+            double jacobianStep_ = 0.5; // [m]
+            
+        public:
+            using Ptr = std::shared_ptr<HybridTrackingParameters>;
+            bool enabled() const;
+            int ensembleSize() const;
+            double collapseStdev2D() const;
+            double collapseFloorProbability() const;
+            int minUpdatesBeforeCollapse() const;
+            double maxNormalizedInnovation() const;
+            int maxInconsistentUpdates() const;
+            double maxRejectedRatio() const;
+            double expansionStdevScale() const;
+            double jacobianStep() const;
+            HybridTrackingParameters& enabled(bool);
+            HybridTrackingParameters& ensembleSize(int);
+            HybridTrackingParameters& collapseStdev2D(double);
+            HybridTrackingParameters& collapseFloorProbability(double);
+            HybridTrackingParameters& minUpdatesBeforeCollapse(int);
+            HybridTrackingParameters& maxNormalizedInnovation(double);
+            HybridTrackingParameters& maxInconsistentUpdates(int);
+            HybridTrackingParameters& maxRejectedRatio(double);
+            HybridTrackingParameters& expansionStdevScale(double);
+            HybridTrackingParameters& jacobianStep(double);
+            
+            template<class Archive>
+            void serialize(Archive & ar, std::uint32_t const version)
+            {
+                ar(CEREAL_NVP(enabled_));
+                ar(CEREAL_NVP(ensembleSize_));
+                ar(CEREAL_NVP(collapseStdev2D_));
+                ar(CEREAL_NVP(collapseFloorProbability_));
+                ar(CEREAL_NVP(minUpdatesBeforeCollapse_));
+                ar(CEREAL_NVP(maxNormalizedInnovation_));
+                ar(CEREAL_NVP(maxInconsistentUpdates_));
+                ar(CEREAL_NVP(maxRejectedRatio_));
+                ar(CEREAL_NVP(expansionStdevScale_));
+                ar(CEREAL_NVP(jacobianStep_));
+            }
+        };
+        
+        // Parameters for the duty-cycling mode. The user is stationary when the pedometer has not counted a step
+        // for stationaryIntervalMS and the altitude manager (if any) does not detect a height change. A beacon frame
+        // has low novelty when its RSSI differences from the last processed frame are within the model noise.
+        // While stationary, predictions are skipped; per-frame mixing is skipped when stationary or the frame has
+        // low novelty; the whole update is skipped when both hold. No stage is skipped for longer than maxSkipIntervalMS.
+        class DutyCycleParameters{
+        protected:
+            bool enabled_ = false;
+            long stationaryIntervalMS_ = 3000;
+            long maxSkipIntervalMS_ = 10000;
+            double noveltyThreshold_ = 1.0; // mean squared normalized RSSI difference
+            double missingBeaconPenalty_ = 4.0; // squared normalized difference assigned to a beacon in only one frame
+            
+        public:
+            using Ptr = std::shared_ptr<DutyCycleParameters>;
+            bool enabled() const;
+            long stationaryIntervalMS() const;
+            long maxSkipIntervalMS() const;
+            double noveltyThreshold() const;
+            double missingBeaconPenalty() const;
+            DutyCycleParameters& enabled(bool);
+            DutyCycleParameters& stationaryIntervalMS(long);
+            DutyCycleParameters& maxSkipIntervalMS(long);
+            DutyCycleParameters& noveltyThreshold(double);
+            DutyCycleParameters& missingBeaconPenalty(double);
+            
+            template<class Archive>
+            void serialize(Archive & ar, std::uint32_t const version)
+            {
+                ar(CEREAL_NVP(enabled_));
+                ar(CEREAL_NVP(stationaryIntervalMS_));
+                ar(CEREAL_NVP(maxSkipIntervalMS_));
+                ar(CEREAL_NVP(noveltyThreshold_));
+                ar(CEREAL_NVP(missingBeaconPenalty_));
+            }
+        };
+        
+        // Parameters for the motion integration mode. Instead of predicting the states at every pedometer update,
+        // the walking time and the heading are accumulated and the states are predicted once per beacon frame
+        // (or when maxIntervalMS has elapsed) with a motion model input summarizing the interval.
+        class MotionIntegrationParameters{
+        protected:
+            bool enabled_ = false;
+            long maxIntervalMS_ = 1000;
+            
+        public:
+            using Ptr = std::shared_ptr<MotionIntegrationParameters>;
+            bool enabled() const;
+            long maxIntervalMS() const;
+            MotionIntegrationParameters& enabled(bool);
+            MotionIntegrationParameters& maxIntervalMS(long);
+            
+            template<class Archive>
+            void serialize(Archive & ar, std::uint32_t const version)
+            {
+                ar(CEREAL_NVP(enabled_));
+                ar(CEREAL_NVP(maxIntervalMS_));
+            }
+        };
+        
         StreamParticleFilter();
         ~StreamParticleFilter();
         
@@ -159,6 +327,15 @@ namespace loc {
         StreamParticleFilter& enablesFloorUpdate(bool);
         StreamParticleFilter& floorUpdateMode(FloorUpdateMode);
         StreamParticleFilter& locationStatusMonitorParameters(LocationStatusMonitorParameters::Ptr);
+        StreamParticleFilter& timeBudgetParameters(TimeBudgetParameters::Ptr);
+        // Evaluate the likelihood once for each group of identical states (e.g. copies made by resampling
+        // that have not been perturbed by prediction yet) and share it between the copies.
+        StreamParticleFilter& compressesStates(bool);
+        StreamParticleFilter& hybridTrackingParameters(HybridTrackingParameters::Ptr);
+        // RSSI model linearized in the hybrid mode
+        StreamParticleFilter& hybridTrackingModel(std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>>);
+        StreamParticleFilter& dutyCycleParameters(DutyCycleParameters::Ptr);
+        StreamParticleFilter& motionIntegrationParameters(MotionIntegrationParameters::Ptr);
         
         StreamParticleFilter& locationStandardDeviationLowerBound(Location loc);
         
@@ -200,6 +377,16 @@ namespace loc {
         // Call this function to search initial location
         bool refineStatus(const Beacons& beacons);
         
+        StatesCompressionStatistics statesCompressionStatistics() const;
+        // true while the states are an ensemble of the hybrid mode
+        bool isKalmanTracking() const;
+        DutyCycleStatistics dutyCycleStatistics() const;
+        
+        // Saves/restores the particles and the runtime state of the components (sensor windows, random generators).
+        // Parameters and models are not included; restore into a filter configured in the same way.
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
+        
     private:
         class Impl;
         std::shared_ptr<Impl> impl;
@@ -209,4 +396,8 @@ namespace loc {
 // assign version
 CEREAL_CLASS_VERSION(loc::LocationStatusMonitorParameters, 1);
 CEREAL_CLASS_VERSION(loc::StreamParticleFilter::FloorTransitionParameters, 0);
+CEREAL_CLASS_VERSION(loc::StreamParticleFilter::TimeBudgetParameters, 0);
+CEREAL_CLASS_VERSION(loc::StreamParticleFilter::HybridTrackingParameters, 0);
+CEREAL_CLASS_VERSION(loc::StreamParticleFilter::DutyCycleParameters, 0);
+CEREAL_CLASS_VERSION(loc::StreamParticleFilter::MotionIntegrationParameters, 0);
 #endif /* StreamParticleFilter_hpp */
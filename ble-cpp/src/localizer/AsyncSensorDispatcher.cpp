@@ -0,0 +1,250 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "AsyncSensorDispatcher.hpp"
+#include "Logger.hpp"
+
+namespace loc{
+    
+    SensorEvent::SensorEvent(const Acceleration& acc) : type(ACCELERATION), timestamp(acc.timestamp()), acceleration(acc){}
+    SensorEvent::SensorEvent(const Attitude& att) : type(ATTITUDE), timestamp(att.timestamp()), attitude(att){}
+    SensorEvent::SensorEvent(const Altimeter& alt) : type(ALTIMETER), timestamp(alt.timestamp()), altimeter(alt){}
+    SensorEvent::SensorEvent(const Heading& head) : type(HEADING), timestamp(head.timestamp()), heading(head){}
+    SensorEvent::SensorEvent(const Beacons& bs) : type(BEACONS), timestamp(bs.timestamp()), beacons(bs){}
+    
+    std::ostream& operator<<(std::ostream&os, const AsyncSensorStatistics& stats){
+        os << "pushed=" << stats.pushed << ",processed=" << stats.processed
+        << ",dropped=" << stats.dropped << ",coalesced=" << stats.coalesced << ",rejected=" << stats.rejected
+        << ",outOfOrder=" << stats.outOfOrder << ",depth=" << stats.depth << ",maxDepth=" << stats.maxDepth
+        << ",meanLatency=" << stats.meanLatencyMS << "ms,maxLatency=" << stats.maxLatencyMS << "ms";
+        return os;
+    }
+    
+    AsyncSensorDispatcher::AsyncSensorDispatcher(const AsyncSensorParameters& params, Handler handler)
+    : mParams(params), mHandler(handler), mQueue(params.queueCapacity){
+    }
+    
+    AsyncSensorDispatcher::~AsyncSensorDispatcher(){
+        stop();
+    }
+    
+    void AsyncSensorDispatcher::start(){
+        if(mActive.exchange(true)){
+            return;
+        }
+        mRunning.store(true);
+        mAccepting.store(true);
+        mWorker = std::thread(&AsyncSensorDispatcher::run, this);
+    }
+    
+    void AsyncSensorDispatcher::stop(){
+        if(!mAccepting.exchange(false)){
+            return;
+        }
+        // A push that saw mAccepting==true is counted in mPushesInFlight until its event is published.
+        while(0<mPushesInFlight.load()){
+            std::this_thread::yield();
+        }
+        mRunning.store(false);
+        mWakeUp.notify_one();
+        if(mWorker.joinable()){
+            mWorker.join();
+        }
+        mFlushed.notify_all();
+        mActive.store(false);
+    }
+    
+    bool AsyncSensorDispatcher::isActive() const{
+        return mActive.load();
+    }
+    
+    void AsyncSensorDispatcher::flush(){
+        if(isWorkerThread()){
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mFlushMutex);
+        while(mRunning.load() && 0<mPending.load()){
+            mFlushed.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+    
+    bool AsyncSensorDispatcher::push(SensorEvent&& event){
+        mPushed++;
+        mPushesInFlight++;
+        if(!mAccepting.load()){
+            mPushesInFlight--;
+            mRejected++;
+            return false;
+        }
+        event.enqueuedAt = std::chrono::steady_clock::now();
+        SensorEvent::Type type = event.type;
+        bool pushed = false;
+        mPending++;
+        if(mQueue.tryPush(std::move(event))){
+            pushed = true;
+        }else if(mParams.overflowPolicy==COALESCE){
+            CoalescingSlot& slot = mCoalescing[type];
+            // A producer writing to the same slot or the worker taking the event out holds busy.
+            // The event is dropped in that case instead of waiting.
+            if(!slot.busy.exchange(true, std::memory_order_acquire)){
+                bool replaced = slot.full.load(std::memory_order_relaxed);
+                slot.event = std::move(event);
+                slot.full.store(true, std::memory_order_relaxed);
+                slot.busy.store(false, std::memory_order_release);
+                if(replaced){
+                    mPending--;
+                    mCoalescedCount++;
+                }
+                pushed = true;
+            }
+        }
+        if(pushed){
+            signal();
+        }else{
+            mPending--;
+            mDropped++;
+        }
+        mPushesInFlight--;
+        return pushed;
+    }
+    
+    void AsyncSensorDispatcher::signal(){
+        mSignals++;
+        // The mutex is not taken so that producers never block. A wake-up missed between the check
+        // of the predicate and the wait of the worker is bounded by maxIdleWaitMicroseconds.
+        if(mIdle.load()){
+            mWakeUp.notify_one();
+        }
+    }
+    
+    bool AsyncSensorDispatcher::isWorkerThread() const{
+        return mWorkerId.load() == std::this_thread::get_id();
+    }
+    
+    AsyncSensorStatistics AsyncSensorDispatcher::statistics() const{
+        AsyncSensorStatistics stats;
+        stats.pushed = mPushed.load();
+        stats.processed = mProcessed.load();
+        stats.dropped = mDropped.load();
+        stats.coalesced = mCoalescedCount.load();
+        stats.rejected = mRejected.load();
+        stats.outOfOrder = mOutOfOrder.load();
+        stats.depth = std::max(0L, mPending.load());
+        stats.maxDepth = mMaxDepth.load();
+        stats.meanLatencyMS = stats.processed>0 ? mLatencySumUS.load()/1000.0/stats.processed : 0.0;
+        stats.maxLatencyMS = mLatencyMaxUS.load()/1000.0;
+        return stats;
+    }
+    
+    void AsyncSensorDispatcher::run(){
+        mWorkerId.store(std::this_thread::get_id());
+        while(mRunning.load()){
+            bool collected = collect();
+            bool released = release(false);
+            if(!collected && !released){
+                waitForEvents();
+            }
+        }
+        // drain
+        collect();
+        release(true);
+        mWorkerId.store(std::thread::id());
+    }
+    
+    // Waits until an event is pushed or the oldest held event leaves the reorder window.
+    void AsyncSensorDispatcher::waitForEvents(){
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(mParams.maxIdleWaitMicroseconds);
+        if(!mReorderBuffer.empty()){
+            deadline = std::min(deadline, mReorderBuffer.top().enqueuedAt + std::chrono::milliseconds(mParams.reorderWindowMS));
+        }
+        std::unique_lock<std::mutex> lock(mWakeUpMutex);
+        mIdle.store(true);
+        mWakeUp.wait_until(lock, deadline, [this]{
+            return 0<mSignals.load() || !mRunning.load();
+        });
+        mIdle.store(false);
+    }
+    
+    bool AsyncSensorDispatcher::collect(){
+        mSignals.store(0);
+        size_t depth = mQueue.sizeApprox();
+        if(mMaxDepth.load() < depth){
+            mMaxDepth.store(depth);
+        }
+        bool collected = false;
+        SensorEvent event;
+        while(mQueue.tryPop(event)){
+            mReorderBuffer.push(std::move(event));
+            collected = true;
+        }
+        for(auto& slot: mCoalescing){
+            // A slot being written is collected at the next signal of its producer.
+            if(slot.full.load(std::memory_order_relaxed) && !slot.busy.exchange(true, std::memory_order_acquire)){
+                if(slot.full.load(std::memory_order_relaxed)){
+                    mReorderBuffer.push(std::move(slot.event));
+                    slot.full.store(false, std::memory_order_relaxed);
+                    collected = true;
+                }
+                slot.busy.store(false, std::memory_order_release);
+            }
+        }
+        return collected;
+    }
+    
+    bool AsyncSensorDispatcher::release(bool all){
+        bool released = false;
+        auto window = std::chrono::milliseconds(mParams.reorderWindowMS);
+        while(!mReorderBuffer.empty()){
+            const SensorEvent& top = mReorderBuffer.top();
+            if(!all && std::chrono::steady_clock::now() - top.enqueuedAt < window){
+                break;
+            }
+            SensorEvent event = top;
+            mReorderBuffer.pop();
+            process(event);
+            released = true;
+        }
+        return released;
+    }
+    
+    void AsyncSensorDispatcher::process(const SensorEvent& event){
+        long long latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - event.enqueuedAt).count();
+        mLatencySumUS += latency;
+        if(mLatencyMaxUS.load() < latency){
+            mLatencyMaxUS.store(latency);
+        }
+        if(event.timestamp < mLastTimestamp){
+            mOutOfOrder++;
+        }else{
+            mLastTimestamp = event.timestamp;
+        }
+        try{
+            mHandler(event);
+        }catch(std::exception& e){
+            LOC_LOG_ERROR(LOCALIZER, "Exception in AsyncSensorDispatcher: " << e.what());
+        }
+        mProcessed++;
+        if(--mPending<=0){
+            mFlushed.notify_all();
+        }
+    }
+}
@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef AsyncSensorDispatcher_hpp
+#define AsyncSensorDispatcher_hpp
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <queue>
+
+#include "bleloc.h"
+#include "Altimeter.hpp"
+#include "Heading.hpp"
+#include "BoundedMPSCQueue.hpp"
+#include "SerializeUtils.hpp"
+
+namespace loc{
+    
+    class SensorEvent{
+    public:
+        enum Type{
+            ACCELERATION = 0,
+            ATTITUDE,
+            ALTIMETER,
+            HEADING,
+            BEACONS,
+            N_TYPES
+        };
+        
+        Type type = ACCELERATION;
+        long timestamp = 0;
+        std::chrono::steady_clock::time_point enqueuedAt;
+        
+        Acceleration acceleration{0, 0, 0, 0};
+        Attitude attitude{0, 0, 0, 0};
+        Altimeter altimeter{0, 0, 0};
+        Heading heading{0, 0, 0, 0};
+        Beacons beacons;
+        
+        SensorEvent() = default;
+        SensorEvent(const Acceleration&);
+        SensorEvent(const Attitude&);
+        SensorEvent(const Altimeter&);
+        SensorEvent(const Heading&);
+        SensorEvent(const Beacons&);
+    };
+    
+    typedef enum{
+        DROP_NEWEST, // incoming events are dropped when the queue is full
+        COALESCE     // incoming events overwrite the pending event of the same type when the queue is full
+    } OverflowPolicy;
+    
+    class AsyncSensorParameters{
+    public:
+        int queueCapacity = 1024;
+        OverflowPolicy overflowPolicy = COALESCE;
+        // events are held for this period to be sorted by timestamp before processing
+        long reorderWindowMS = 20;
+        // The idle worker is woken by producers. This bounds its wait if a wake-up is missed.
+        long maxIdleWaitMicroseconds = 10000;
+        
+        template<class Archive>
+        void serialize(Archive & ar){
+            ar(CEREAL_NVP(queueCapacity));
+            ar(CEREAL_NVP(overflowPolicy));
+            ar(CEREAL_NVP(reorderWindowMS));
+            ar(CEREAL_NVP(maxIdleWaitMicroseconds));
+        }
+    };
+    
+    class AsyncSensorStatistics{
+    public:
+        long pushed = 0;
+        long processed = 0;
+        long dropped = 0;
+        long coalesced = 0;
+        long rejected = 0; // events pushed while the dispatcher was stopping or stopped
+        long outOfOrder = 0; // events processed after an event with a newer timestamp
+        size_t depth = 0;
+        size_t maxDepth = 0;
+        double meanLatencyMS = 0;
+        double maxLatencyMS = 0;
+        
+        friend std::ostream& operator<<(std::ostream&os, const AsyncSensorStatistics& stats);
+    };
+    
+    // Sensor events are pushed by any thread without blocking and processed in timestamp order by a single worker thread.
+    // The dispatcher must outlive the threads pushing events. Pushes after stop() are rejected and counted.
+    class AsyncSensorDispatcher{
+    public:
+        using Ptr = std::shared_ptr<AsyncSensorDispatcher>;
+        using Handler = std::function<void(const SensorEvent&)>;
+        
+        AsyncSensorDispatcher(const AsyncSensorParameters& params, Handler handler);
+        ~AsyncSensorDispatcher();
+        
+        AsyncSensorDispatcher(const AsyncSensorDispatcher&) = delete;
+        AsyncSensorDispatcher& operator=(const AsyncSensorDispatcher&) = delete;
+        
+        void start();
+        // Rejects further pushes, waits for the pushes in progress, processes the remaining events
+        // and stops the worker thread.
+        void stop();
+        // True from start() until stop() returns
+        bool isActive() const;
+        // Blocks until all pushed events are processed.
+        void flush();
+        
+        bool push(SensorEvent&& event);
+        bool isWorkerThread() const;
+        AsyncSensorStatistics statistics() const;
+        
+    private:
+        struct EventOrder{
+            bool operator()(const SensorEvent& e1, const SensorEvent& e2) const{
+                return e1.timestamp > e2.timestamp;
+            }
+        };
+        
+        // Preallocated slot holding the latest event of a type that did not fit in the queue
+        struct CoalescingSlot{
+            std::atomic<bool> busy{false};
+            std::atomic<bool> full{false};
+            SensorEvent event;
+        };
+        
+        AsyncSensorParameters mParams;
+        Handler mHandler;
+        BoundedMPSCQueue<SensorEvent> mQueue;
+        CoalescingSlot mCoalescing[SensorEvent::N_TYPES];
+        std::priority_queue<SensorEvent, std::vector<SensorEvent>, EventOrder> mReorderBuffer;
+        
+        std::thread mWorker;
+        std::atomic<bool> mActive{false};
+        std::atomic<bool> mAccepting{false};
+        std::atomic<bool> mRunning{false};
+        std::atomic<long> mPushesInFlight{0};
+        std::atomic<std::thread::id> mWorkerId;
+        
+        // wake-up of the idle worker
+        std::mutex mWakeUpMutex;
+        std::condition_variable mWakeUp;
+        std::atomic<bool> mIdle{false};
+        std::atomic<long> mSignals{0}; // events published since the last collect
+        
+        std::mutex mFlushMutex;
+        std::condition_variable mFlushed;
+        
+        std::atomic<long> mPending{0};
+        std::atomic<long> mPushed{0};
+        std::atomic<long> mProcessed{0};
+        std::atomic<long> mDropped{0};
+        std::atomic<long> mCoalescedCount{0};
+        std::atomic<long> mRejected{0};
+        std::atomic<long> mOutOfOrder{0};
+        std::atomic<size_t> mMaxDepth{0};
+        std::atomic<long long> mLatencySumUS{0};
+        std::atomic<long long> mLatencyMaxUS{0};
+        long mLastTimestamp = 0;
+        
+        void run();
+        void signal();
+        void waitForEvents();
+        bool collect();
+        bool release(bool all);
+        void process(const SensorEvent& event);
+    };
+}
+
+#endif /* AsyncSensorDispatcher_hpp */
@@ -27,10 +27,12 @@
 #include <iostream>
 #include <chrono>
 #include "LogUtil.hpp"
+#include "Logger.hpp"
 #include "WeakPoseRandomWalker.hpp"
 #include "AltitudeManagerSimple.hpp"
 
 #include "TransformedOrientationMeterAverage.hpp"
+#include "SiteContext.hpp"
 
 namespace loc{
     // BasicLocalizer
@@ -38,12 +40,13 @@ namespace loc{
         //pfFloorTransParams = StreamParticleFilter::FloorTransitionParameters::Ptr(new StreamParticleFilter::FloorTransitionParameters);
     }
     BasicLocalizer::~BasicLocalizer(){
+        stopAsyncSensorInput();
     }
     
     StreamLocalizer& BasicLocalizer::updateHandler(void (*functionCalledAfterUpdate)(Status*)) {
         mFunctionCalledAfterUpdate = functionCalledAfterUpdate;
-        if (mLocalizer) {
-            mLocalizer->updateHandler(mFunctionCalledAfterUpdate);
+        if (mEngine) {
+            mEngine->updateHandler(mFunctionCalledAfterUpdate);
         }
         return *this;
     }
@@ -69,8 +72,8 @@ namespace loc{
         
         mUserDataBridge = &userDataBridge;
         
-        if (mLocalizer) {
-            mLocalizer->updateHandler(bridgeFunctionCalledAfterUpdate2, mUserDataBridge);
+        if (mEngine) {
+            mEngine->updateHandler(bridgeFunctionCalledAfterUpdate2, mUserDataBridge);
         }
         return *this;
     }
@@ -81,10 +84,82 @@ namespace loc{
         return *this;
     }
     
+    bool BasicLocalizer::dispatchesAsync() const{
+        return mAsyncDispatcher && mAsyncDispatcher->isActive() && !mAsyncDispatcher->isWorkerThread();
+    }
+    
+    void BasicLocalizer::handleSensorEvent(const SensorEvent& event){
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        switch(event.type){
+            case(SensorEvent::ACCELERATION):
+                putAcceleration(event.acceleration);
+                break;
+            case(SensorEvent::ATTITUDE):
+                putAttitude(event.attitude);
+                break;
+            case(SensorEvent::ALTIMETER):
+                putAltimeter(event.altimeter);
+                break;
+            case(SensorEvent::HEADING):
+                putHeading(event.heading);
+                break;
+            case(SensorEvent::BEACONS):
+                putBeacons(event.beacons);
+                break;
+            default:
+                break;
+        }
+    }
+    
+    void BasicLocalizer::startAsyncSensorInput(){
+        if(!mAsyncDispatcher){
+            mAsyncDispatcher = std::make_shared<AsyncSensorDispatcher>(asyncSensorParameters, [this](const SensorEvent& event){
+                handleSensorEvent(event);
+            });
+        }
+        mAsyncDispatcher->start();
+    }
+    
+    // The dispatcher is not destroyed here because sensor threads may still be calling put* methods.
+    void BasicLocalizer::stopAsyncSensorInput(){
+        if(mAsyncDispatcher){
+            mAsyncDispatcher->stop();
+            if(isVerboseLocalizer){
+                LOC_LOG_INFO(LOCALIZER, "AsyncSensorStatistics: " << mAsyncDispatcher->statistics());
+            }
+        }
+    }
+    
+    void BasicLocalizer::flushAsyncSensorInput(){
+        if(mAsyncDispatcher){
+            mAsyncDispatcher->flush();
+        }
+    }
+    
+    AsyncSensorStatistics BasicLocalizer::asyncSensorStatistics() const{
+        return mAsyncDispatcher ? mAsyncDispatcher->statistics() : AsyncSensorStatistics();
+    }
+    
+    std::recursive_mutex& BasicLocalizer::engineMutex() const{
+        return mEngineMutex;
+    }
+    
+    StatesCompressionStatistics BasicLocalizer::statesCompressionStatistics() const{
+        return mLocalizer ? mLocalizer->statesCompressionStatistics() : StatesCompressionStatistics();
+    }
+    
+    DutyCycleStatistics BasicLocalizer::dutyCycleStatistics() const{
+        return mLocalizer ? mLocalizer->dutyCycleStatistics() : DutyCycleStatistics();
+    }
+    
     StreamLocalizer& BasicLocalizer::putAttitude(const Attitude attitude) {
         if (!isReady) {
             return *this;
         }
+        if (dispatchesAsync()) {
+            mAsyncDispatcher->push(SensorEvent(attitude));
+            return *this;
+        }
         if (mFunctionCalledToLog) {
             mFunctionCalledToLog(mUserDataToLog, LogUtil::toString(attitude));
         }
@@ -98,7 +173,7 @@ namespace loc{
             double drift = yawDriftAdjuster->getCurrentDrift();
             double driftRate = yawDriftAdjuster->getCurrentDriftRate();
             if(isVerboseLocalizer){
-                std::cout << "EstimatedYawDrift(timestamp,drift,driftRate,isApplied): "<< attitude.timestamp() << "," << drift << "," << driftRate << "," << applysYawDriftAdjust << std::endl;
+                LOC_LOG_DEBUG(LOCALIZER, "EstimatedYawDrift(timestamp,drift,driftRate,isApplied): "<< attitude.timestamp() << "," << drift << "," << driftRate << "," << applysYawDriftAdjust);
             }
             if(applysYawDriftAdjust){
                 altTmp = altAdj;
@@ -107,13 +182,17 @@ namespace loc{
         if (!isTrackingLocalizer()) {
             return *this;
         }
-        mLocalizer->putAttitude(altTmp);
+        mEngine->putAttitude(altTmp);
         return *this;
     }
     StreamLocalizer& BasicLocalizer::putAcceleration(const Acceleration acceleration) {
         if (!isReady) {
             return *this;
         }
+        if (dispatchesAsync()) {
+            mAsyncDispatcher->push(SensorEvent(acceleration));
+            return *this;
+        }
         if (mFunctionCalledToLog) {
             mFunctionCalledToLog(mUserDataToLog, LogUtil::toString(acceleration));
         }
@@ -126,7 +205,7 @@ namespace loc{
                 accTmp.ax(0.0)->ay(0.0)->az(0.0);
             }
             if(mLocationStatus==Status::STABLE or mLocationStatus==Status::UNSTABLE){
-                mLocalizer->putAcceleration(accTmp);
+                mEngine->putAcceleration(accTmp);
             }
         }
         return *this;
@@ -139,6 +218,10 @@ namespace loc{
     
     
     StreamLocalizer& BasicLocalizer::putHeading(const Heading heading) {
+        if (dispatchesAsync()) {
+            mAsyncDispatcher->push(SensorEvent(heading));
+            return *this;
+        }
         auto cvt = latLngConverter();
         if(cvt){
             auto localHeading = cvt->headingGlobalToLocal(heading);
@@ -154,12 +237,16 @@ namespace loc{
         if (!isReady) {
             return *this;
         }
+        if (dispatchesAsync()) {
+            mAsyncDispatcher->push(SensorEvent(altimeter));
+            return *this;
+        }
         if (!isTrackingLocalizer()) {
             return *this;
         }
         else{
             if(mLocationStatus==Status::STABLE or mLocationStatus==Status::UNSTABLE){
-                mLocalizer->putAltimeter(altimeter);
+                mEngine->putAltimeter(altimeter);
             }
         }
         return *this;
@@ -205,7 +292,7 @@ namespace loc{
     bool checkStatesInStdev2D(const std::vector<State>& states, double stdevLimit){
         double var2D = Location::compute2DVariance(states);
         double stdev2D = std::pow(var2D, 1.0/4.0);
-        std::cout << "stdev2D = " << stdev2D << std::endl;
+        LOC_LOG_DEBUG(LOCALIZER, "stdev2D = " << stdev2D);
         if(stdev2D < stdevLimit){
             return true;
         }else{
@@ -218,11 +305,15 @@ namespace loc{
         if (!isReady) {
             return *this;
         }
+        if (dispatchesAsync()) {
+            mAsyncDispatcher->push(SensorEvent(beacons));
+            return *this;
+        }
         if (mFunctionCalledToLog) {
             mFunctionCalledToLog(mUserDataToLog, LogUtil::toString(beacons));
         }
         if (beaconFilter->filter(beacons).size() ==0){
-            std::cout << "The number of strong beacon is zero." << std::endl;
+            LOC_LOG_WARN(LOCALIZER, "The number of strong beacon is zero.");
             return *this;
         }
         Beacons beaconsTmp = beacons;
@@ -236,38 +327,35 @@ namespace loc{
         /*
             switch(mState) {
                 case UNKNOWN:
-                    mLocalizer->resetStatus(beacons);
+                    mEngine->resetStatus(beacons);
                     break;
                 case LOCATING:
-                    mLocalizer->resetStatus(beacons);
+                    mEngine->resetStatus(beacons);
                     break;
                 case TRACKING:
-                    mLocalizer->putBeacons(beacons);
+                    mEngine->putBeacons(beacons);
                     break;
             }
         */
         
         if(isVerboseLocalizer){
-            if(mTrackedStatus){
-                std::cout << "mTrackedStatus exists" << std::endl;
+            if(mTrackedMoments){
+                LOC_LOG_DEBUG(LOCALIZER, "mTrackedMoments exists");
             }else{
-                std::cout << "mTrackedStatus does not exist" << std::endl;
+                LOC_LOG_DEBUG(LOCALIZER, "mTrackedMoments does not exist");
             }
         }
         
-        mLocalizer->getStatus()->locationStatus(mLocationStatus); // ensure innerStatus == mLocationStatus before put method
+        mEngine->getStatus()->locationStatus(mLocationStatus); // ensure innerStatus == mLocationStatus before put method
         
         if(isTrackingLocalizer()){
             switch(mLocationStatus){
                 case(Status::UNKNOWN): case(Status::LOCATING):
-                    mLocalizer->resetStatus(beaconsTmp);
+                    mEngine->resetStatus(beaconsTmp);
                     break;
                 case(Status::STABLE): case(Status::UNSTABLE):
-                    mLocalizer->putBeacons(beaconsTmp);
-                    if(!mTrackedStatus){
-                        mTrackedStatus = std::make_shared<Status>();
-                    }
-                    *mTrackedStatus = *mLocalizer->getStatus();
+                    mEngine->putBeacons(beaconsTmp);
+                    mTrackedMoments = mEngine->getStatus()->moments();
                     break;
                 case(Status::NIL):
                     BOOST_THROW_EXCEPTION(LocException("location status is not set (NIL)"));
@@ -276,7 +364,7 @@ namespace loc{
         }else{
             switch(mLocationStatus){
                 case(Status::UNKNOWN): case(Status::LOCATING): case(Status::STABLE): case(Status::UNSTABLE):
-                    mLocalizer->resetStatus(beaconsTmp);
+                    mEngine->resetStatus(beaconsTmp);
                     break;
                 case(Status::NIL):
                     BOOST_THROW_EXCEPTION(LocException("location status is not set (NIL)"));
@@ -295,14 +383,9 @@ namespace loc{
         std::function<NormalParameter()> computeNormalParameterForInit = [&]{
             double ori;
             double oridev;
-            if(mTrackedStatus){
+            if(mTrackedMoments){
                 auto yaw = orientationMeter->getYaw(); // orientationMeter is always updated in putAttitude.
-                auto trackedStates = mTrackedStatus->states();
-                std::vector<double> orientations;
-                for(const auto& s: *trackedStates){
-                    orientations.push_back(s.orientationBias());
-                }
-                auto wnp = MathUtils::computeWrappedNormalParameters(orientations);
+                auto wnp = mTrackedMoments->orientationBiasParameter();
                 ori = yaw - wnp.mean();
                 oridev = wnp.stdev();
             }else{
@@ -320,23 +403,20 @@ namespace loc{
             
             NormalParameter wnp(ori, oridev);
             if(isVerboseLocalizer){
-                if(mTrackedStatus){
-                    std::cout << "orientation updated by tracked states (mu,sigma)=" << wnp.mean() << "," << wnp.stdev() << ")" << std::endl;
+                if(mTrackedMoments){
+                    LOC_LOG_DEBUG(LOCALIZER, "orientation updated by tracked states (mu,sigma)=" << wnp.mean() << "," << wnp.stdev() << ")");
                 }else{
-                    std::cout << "orientation updated by device heading (mu,sigma)=" << wnp.mean() << "," << wnp.stdev() << ")" << std::endl;
+                    LOC_LOG_DEBUG(LOCALIZER, "orientation updated by device heading (mu,sigma)=" << wnp.mean() << "," << wnp.stdev() << ")");
                 }
             }
             return wnp;
         };
         
         
-        auto statusLatest = mLocalizer->getStatus();
+        auto statusLatest = mEngine->getStatus();
         auto mResult = std::make_shared<Status>(); // local
+        int nSmoothTmp = nSmooth;
         if (smoothType == SMOOTH_LOCATION) {
-            *mResult = *statusLatest;
-            ////loc::Status *status = new loc::Status(*statusLatest);
-            
-            int nSmoothTmp;
             //if (isTrackingLocalizer() && mLocationStatus==Status::STABLE) {
             if (mLocationStatus==Status::STABLE || mLocationStatus==Status::UNSTABLE) {
                 nSmoothTmp = nSmoothTracking;
@@ -344,34 +424,35 @@ namespace loc{
                 nSmoothTmp = nSmooth;
             }
             
-            status_list[(smooth_count++)%std::min(N_SMOOTH_MAX,nSmoothTmp)] = *statusLatest->states();
+            // Only the moments of each update are kept. Merging them gives the same summary as concatenating the states.
+            // The published states are not modified by the next update and are shared with the result.
+            auto statesLatest = statusLatest->states();
+            int slot = (smooth_count++)%std::min(N_SMOOTH_MAX,nSmoothTmp);
+            moments_list[slot] = statusLatest->moments();
             
-            std::shared_ptr<States> states (new std::vector<loc::State>);
-            double meanBias = 0;
+            StatesMoments moments;
             for(int i = 0; i < N_SMOOTH_MAX && i < smooth_count && i < nSmoothTmp; i++) {
-                for(auto& s: status_list[i]) {
-                    states->push_back(s);
-                    meanBias += s.rssiBias();
+                if(moments_list[i]){
+                    moments += *moments_list[i];
                 }
             }
-            mEstimatedRssiBias = meanBias / states->size();
+            mEstimatedRssiBias = moments.meanRssiBias();
+            auto summary = std::make_shared<StatesSummary>(moments);
             
             // update orientation by heading or tracked orientation
             bool headingConfidenceIsActive = 0.0<headingConfidenceForOrientationInit_ && headingConfidenceForOrientationInit_<=1.0;
             if(headingConfidenceIsActive){
                 auto wnp = computeNormalParameterForInit();
-                RandomGenerator randGen;
-                double contamiRate =  std::max(1.0-headingConfidenceForOrientationInit_, 0.0);
-                for(auto& s: *states){
-                    if(randGen.nextDouble() < contamiRate || std::isinf(wnp.stdev())){
-                        s.orientation(Pose::normalizeOrientaion(2.0*M_PI*randGen.nextDouble()));
-                    }else{
-                        s.orientation(randGen.nextWrappedNormal(wnp.mean(), wnp.stdev()));
-                    }
+                Pose meanPose = summary->meanPose();
+                if(!std::isinf(wnp.stdev())){
+                    meanPose.orientation(wnp.mean());
                 }
+                summary->meanPose(meanPose);
             }
             
-            mResult->states(states, Status::RESET);
+            mResult->timestamp(statusLatest->timestamp());
+            mResult->states(statesLatest, Status::RESET);
+            mResult->summary(summary);
             mResult->locationStatus(mLocationStatus);
             
             updateLocationStatus(mResult.get());
@@ -397,13 +478,14 @@ namespace loc{
         }
         //if (isTrackingLocalizer() && isStatesConverged && mLocationStatus!=Status::STABLE) {
         if (isTrackingLocalizer() && isStatesConverged) {
+            // The closest state is searched among the latest states.
             Pose refPose = *mResult->meanPose();
-            std::vector<State> states = *mResult->states();
+            const std::vector<State>& states = *mResult->states();
             int idx = Location::findClosestLocationIndex(refPose, states);
             Location locClosest = states.at(idx);
             refPose.copyLocation(locClosest);
 
-            auto std = loc::Location::standardDeviation(*mResult->states());
+            auto std = mResult->summary()->standardDeviation();
             refPose.floor(roundf(refPose.floor()));
             loc::Pose stdevPose;
             double largeOridev = 10*M_PI;
@@ -418,28 +500,28 @@ namespace loc{
                 refPose.orientation(wnp.mean());
                 stdevPose.orientation(wnp.stdev());
                 double contamiRate =  std::max(1.0-headingConfidenceForOrientationInit_, 0.0);
-                mLocalizer->getStatus()->locationStatus(mLocationStatus);// must overwrite locationStatus before resetStatus because the callback function is called in resetStatus.
-                mLocalizer->resetStatus(refPose, stdevPose, contamiRate);
-                std::cout << "Reset=" << refPose << ", STD=" << std
-                            << " with orientation(" << refPose.orientation() << "," << stdevPose.orientation() << ")" << std::endl;
+                mEngine->getStatus()->locationStatus(mLocationStatus);// must overwrite locationStatus before resetStatus because the callback function is called in resetStatus.
+                mEngine->resetStatus(refPose, stdevPose, contamiRate);
+                LOC_LOG_INFO(LOCALIZER, "Reset=" << refPose << ", STD=" << std
+                            << " with orientation(" << refPose.orientation() << "," << stdevPose.orientation() << ")");
             }else{
-                mLocalizer->getStatus()->locationStatus(mLocationStatus);
-                mLocalizer->resetStatus(refPose, stdevPose);
-                std::cout << "Reset=" << refPose << ", STD=" << std << std::endl;
+                mEngine->getStatus()->locationStatus(mLocationStatus);
+                mEngine->resetStatus(refPose, stdevPose);
+                LOC_LOG_INFO(LOCALIZER, "Reset=" << refPose << ", STD=" << std);
             }
         }
         
         return *this;
     }
     
-    Status::LocationStatus transitLocationStatus(const Status::LocationStatus& tempLocStatus, const States& states, const LocationStatusMonitorParameters& params){
+    Status::LocationStatus transitLocationStatus(const Status::LocationStatus& tempLocStatus, const StatesSummary& summary, const LocationStatusMonitorParameters& params){
 
         double std2DExitStable = params.stdev2DExitStable();
         double std2DEnterStable = params.stdev2DEnterStable();
         double std2DEnterLocating = params.stdev2DEnterLocating();
         double std2DExitLocating = params.stdev2DExitLocating();
         
-        double std2D = std::pow(Location::compute2DVariance(states), 1.0/4.0);
+        double std2D = summary.stdev2D();
         
         Status::LocationStatus newLocStatus = tempLocStatus;
         switch(tempLocStatus){
@@ -482,11 +564,12 @@ namespace loc{
             newLocStatus = midLocStatus;
         } else {
             if(this->isVerboseLocalizer){
-                double std2D = std::pow(Location::compute2DVariance(*status->states()), 1.0/4.0);
-                auto stdLoc = Location::standardDeviation(*status->states());
-                std::cout << "std2D=" << std2D << ",stdX="<< stdLoc.x() << ",stdY=" << stdLoc.y()  << std::endl;
+                auto summary = status->summary();
+                double std2D = summary->stdev2D();
+                const auto& stdLoc = summary->standardDeviation();
+                LOC_LOG_DEBUG(LOCALIZER, "std2D=" << std2D << ",stdX="<< stdLoc.x() << ",stdY=" << stdLoc.y());
             }
-            auto tmpLocStatus = transitLocationStatus(midLocStatus, *status->states(), *locationStatusMonitorParameters);
+            auto tmpLocStatus = transitLocationStatus(midLocStatus, *status->summary(), *locationStatusMonitorParameters);
             if(midLocStatus==Status::LOCATING && tmpLocStatus==Status::STABLE){
                 if(smooth_count>=nSmooth){
                     newLocStatus = Status::STABLE;
@@ -503,7 +586,7 @@ namespace loc{
         
         // check if location status changed
         if(oldLocStatus!=mLocationStatus){
-            std::cout << "locationStatus changed from " << Status::locationStatusToString(oldLocStatus) << " to " << Status::locationStatusToString(newLocStatus) << std::endl;
+            LOC_LOG_INFO(LOCALIZER, "locationStatus changed from " << Status::locationStatusToString(oldLocStatus) << " to " << Status::locationStatusToString(newLocStatus));
             if(mLocationStatus==Status::UNKNOWN){ // when locationStatus becomes UNKNOWN
                 //TODO (this block can be moved to a public method)
                 smooth_count = 0;
@@ -515,160 +598,74 @@ namespace loc{
     }
     
     void BasicLocalizer::overwriteLocationStatus(Status::LocationStatus locStatus){
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
         this->getStatus()->locationStatus(locStatus);
         updateLocationStatus(this->getStatus());
     }
     
     Status* BasicLocalizer::getStatus() {
-        return mLocalizer->getStatus();
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        return mEngine->getStatus();
     }
     
     bool BasicLocalizer::resetStatus() {
-        return mLocalizer->resetStatus();
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        return mEngine->resetStatus();
     }
     bool BasicLocalizer::resetStatus(Pose pose) {
-        return mLocalizer->resetStatus(pose);
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        return mEngine->resetStatus(pose);
     }
     bool BasicLocalizer::resetStatus(Pose meanPose, Pose stdevPose) {
-        return mLocalizer->resetStatus(meanPose, stdevPose);
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        return mEngine->resetStatus(meanPose, stdevPose);
     }
     bool BasicLocalizer::resetStatus(Pose meanPose, Pose stdevPose, double rateContami) {
-        return mLocalizer->resetStatus(meanPose, stdevPose, rateContami);
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        return mEngine->resetStatus(meanPose, stdevPose, rateContami);
     }
     bool BasicLocalizer::resetStatus(const Beacons& beacons) {
-        return mLocalizer->resetStatus(beacons);
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        return mEngine->resetStatus(beacons);
     }
     
     bool BasicLocalizer::resetStatus(const Location& location, const Beacons& beacons) {
-        bool ret = mLocalizer->resetStatus(location, beacons);
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        bool ret = mEngine->resetStatus(location, beacons);
         double meanBias = 0;
-        for(loc::State s: *mLocalizer->getStatus()->states()) {
+        for(loc::State s: *mEngine->getStatus()->states()) {
             meanBias += s.rssiBias();
         }
-        mEstimatedRssiBias = meanBias / mLocalizer->getStatus()->states()->size();
+        mEstimatedRssiBias = meanBias / mEngine->getStatus()->states()->size();
 
         return ret;
     }
     
-    const picojson::value &get(const picojson::value::object &obj, std::string key){
-        auto itr = obj.find(key);
-        if (itr != obj.end()) {
-            return itr->second;
+    BasicLocalizer& BasicLocalizer::setModel(std::string modelPath, std::string workingDir) {
+        if (isReady) { // TODO support multiple models
+            LOC_LOG_WARN(LOCALIZER, "Already model was set");
+            return *this;
         }
-        throw "not found";
+        return siteContext(SiteContext::load(modelPath, workingDir, *this, basicLocalizerOptions, forceTraining));
     }
     
-    const std::string &getString(const picojson::value::object &obj, std::string key) {
-        auto& value = get(obj, key);
-        if (value.is<std::string>()) {
-            return value.get<std::string>();
-        }
-        throw "non string value";
-    }
-    double getDouble(const picojson::value::object &obj, std::string key) {
-        auto& value = get(obj, key);
-        if (value.is<double>()) {
-            return value.get<double>();
-        }
-        throw "non double value";
-    }
-    const picojson::value::object &getObject(const picojson::value::object &obj, std::string key) {
-        auto& value = get(obj, key);
-        if (value.is<picojson::value::object>()) {
-            return value.get<picojson::value::object>();
-        }
-        throw "non object value";
-    }
-    const picojson::value::array &getArray(const picojson::value::object &obj, std::string key) {
-        auto& value = get(obj, key);
-        if (value.is<picojson::value::array>()) {
-            return value.get<picojson::value::array>();
-        }
-        throw "non array value";
-    }
-
-    BasicLocalizer& BasicLocalizer::setModel(std::string modelPath, std::string workingDir) {
+    BasicLocalizer& BasicLocalizer::siteContext(std::shared_ptr<const SiteContext> site) {
         auto s = std::chrono::system_clock::now();
-        std::cerr << "start setModel" << std::endl;
-        if (isReady) { // TODO support multiple models
-            std::cerr << "Already model was set" << std::endl;
+        LOC_LOG_INFO(LOCALIZER, "start setModel");
+        if (isReady) {
+            LOC_LOG_WARN(LOCALIZER, "Already model was set");
             return *this;
         }
         
-        std::ifstream file;
-        file.open(modelPath, std::ios::in);
-        std::istreambuf_iterator<char> input(file);
-        
-        picojson::value v;
-        std::string err;
-        picojson::parse(v, input, std::istreambuf_iterator<char>(), &err);
-        if (!err.empty()) {
-            throw err+" with reading "+modelPath;
-        }
-        if (!v.is<picojson::object>()) {
-            throw "invalid JSON";
-        }
-        file.close();
-        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "parse JSON: " << msec << "ms" << std::endl;
-        
-        picojson::value::object& json = v.get<picojson::object>();
-        
-        auto& anchor = getObject(json, "anchor");
-        this->anchor.latlng.lat = getDouble(anchor, "latitude");
-        this->anchor.latlng.lng = getDouble(anchor, "longitude");
-        this->anchor.rotate = getDouble(anchor, "rotate");
-        latLngConverter_ = std::make_shared<LatLngConverter>(this->anchor);
+        // Random generators of the components built below take their streams from randomSeed.
+        RandomGenerator::SeedScope seedScope(randomSeed);
         
-        deserializedModel = std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> (new GaussianProcessLDPLMultiModel<State, Beacons>());
-        
-        bool doTraining = true;
-        try{
-            try {
-                auto& str = getString(json, "ObservationModelParameters");
-                if (/* DISABLES CODE */ (false)) {
-                    std::string omppath = DataUtils::stringToFile(str, workingDir, "ObservationModelParameters");
-                    
-                    msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-                    std::cerr << "save deserialized model: " << msec << "ms" << std::endl;
-                    
-                    std::cerr << omppath << std::endl;
-                    //std::istringstream ompss(str);
-                    std::ifstream ompss(omppath);
-                    //if (ompss) {
-                    std::cout << "loading" << std::endl;
-                    deserializedModel->load(ompss);
-                    std::cout << "loaded" << std::endl;
-                    //}
-                } else {
-                    std::istringstream ompss(str);
-                    if (ompss) {
-                        std::cout << "loading" << std::endl;
-                        deserializedModel->load(ompss);
-                        std::cout << "loaded" << std::endl;
-                    }
-                }
-                msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-                std::cerr << "load deserialized model: " << msec << "ms" << std::endl;
-                doTraining = false;
-            } catch(LocException& e){
-                throw e;
-            } catch(const std::exception& e) {
-                LocException ex(std::string(e.what()));
-                BOOST_THROW_EXCEPTION(ex);
-            } catch(const char* ch){
-                //LocException ex((std::string(ch)));
-                //BOOST_THROW_EXCEPTION(ex);
-            } catch(...){
-                BOOST_THROW_EXCEPTION(LocException("..."));
-            }
-        }catch(LocException& e){
-            e << boost::error_info<struct err_info, std::string>("exception at loading ObservationModelParameters");
-            throw e;
-        }
-        
-        // update observation model
-        deserializedModel->coeffDiffFloorStdev(coeffDiffFloorStdev);
+        // The building, the observation model and the data store are shared with other localizers using the same site.
+        mSiteContext = site;
+        anchor = site->anchor();
+        latLngConverter_ = site->latLngConverter();
+        deserializedModel = site->observationModel();
+        dataStore = site->dataStore();
         
         mLocalizer = std::shared_ptr<StreamParticleFilter>(new StreamParticleFilter());
         if (mFunctionCalledAfterUpdate2 && mUserData) {
@@ -686,142 +683,8 @@ namespace loc{
         mLocalizer->optVerbose(isVerboseLocalizer);
         mLocalizer->effectiveSampleSizeThreshold(effectiveSampleSizeThreshold);
         mLocalizer->enablesFloorUpdate(enablesFloorUpdate);
-        
-        std::cout << "Create data store" << std::endl << std::endl;
-        // Create data store
-        dataStore = std::shared_ptr<DataStoreImpl> (new DataStoreImpl());
         mLocalizer->dataStore(dataStore);
         
-        // Building - change read order to reduce memory usage peak
-        //ImageHolder::setMode(ImageHolderMode(heavy));
-        BuildingBuilder buildingBuilder;
-        
-        auto& buildings = getArray(json, "layers");
-        
-        for(int floor_num = 0; floor_num < buildings.size(); floor_num++) {
-            auto& building = buildings.at(floor_num).get<picojson::value::object>();
-            auto& param = getObject(building, "param");
-            double ppmx = getDouble(param, "ppmx");
-            double ppmy = getDouble(param, "ppmy");
-            double ppmz = getDouble(param, "ppmz");
-            double originx = getDouble(param, "originx");
-            double originy = getDouble(param, "originy");
-            double originz = getDouble(param, "originz");
-            CoordinateSystemParameters coordSysParams(ppmx, ppmy, ppmz, originx, originy, originz);
-
-            auto& data = getString(building, "data");
-            std::ostringstream ostr;
-            ostr << floor_num << "floor.png";
-            
-            std::string path = DataUtils::stringToFile(data, workingDir, ostr.str());
-            
-            int fn = floor_num;
-            if (!get(param, "floor").is<picojson::null>()) {
-                fn = (int)getDouble(param, "floor");
-            }
-            
-            buildingBuilder.addFloorCoordinateSystemParametersAndImagePath(fn, coordSysParams, path);
-            
-            msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-            std::cerr << "prepare floor model[" << floor_num << "]: " << msec << "ms" << std::endl;
-        }
-        dataStore->building(buildingBuilder.build());
-        
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "build floor model: " << msec << "ms" << std::endl;
-        
-        // Sampling data
-        
-        // Samples samples;
-        try{
-            auto& samples = getArray(json, "samples");
-            for(int i = 0; i < samples.size(); i++) {
-                auto& sample = samples.at(i).get<picojson::value::object>();
-                auto& data = getString(sample, "data");
-                
-                //std::string samplepath = DataUtils::stringToFile(data, workingDir);
-                //std::ifstream is(samplepath);
-                std::istringstream is(data);
-                dataStore->readSamples(is);
-            }
-            {
-                std::cerr << dataStore->getSamples().size() << " samples have been loaded" << std::endl;
-            }
-        }catch(const char* ch){
-            std::cerr << "samples have not been loaded." << std::endl;
-        }
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "load sample data: " << msec << "ms" << std::endl;
-        
-        // set unique locations to data store 
-        if(dataStore->getSamples().size() != 0){
-            const auto& uniLocs = Sample::extractUniqueLocations(dataStore->getSamples());
-            dataStore->locations(uniLocs);
-        }
-        
-        
-        // set sample locations
-        try{
-            auto& locationsJarray = getArray(json, "locations");
-            Locations locations;
-            for(int i = 0; i < locationsJarray.size(); i++) {
-                auto& locationsJobj = locationsJarray.at(i).get<picojson::value::object>();
-                auto& data = getString(locationsJobj, "data");
-                std::istringstream is(data);
-                DataUtils::csvLocationsToLocations(is, locations);
-            }
-            dataStore->locations(locations);
-            {
-                std::cerr << dataStore->getLocations().size() << " locations have been loaded" << std::endl;
-            }
-        }catch(const char* ch){
-            {
-                std::cerr << "locations have not been loaded" << std::endl;
-            }
-        }
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "load location data: " << msec << "ms" << std::endl;
-        
-        if(dataStore->getLocations().size()==0){
-            BOOST_THROW_EXCEPTION(LocException("Neither samples nor locations have been loaded"));
-        }
-        
-        
-        // set BLE beacon locations
-        BLEBeacons bleBeacons;
-        auto& beacons = getArray(json, "beacons");
-        for(int i = 0; i < beacons.size(); i++) {
-            auto& beacon = beacons.at(i).get<picojson::value::object>();
-            auto& data = getString(beacon, "data");
-            
-            std::istringstream is(data);
-            BLEBeacons bleBeaconsTmp = DataUtils::csvBLEBeaconsToBLEBeacons(is);
-            bleBeacons.insert(bleBeacons.end(), bleBeaconsTmp.begin(), bleBeaconsTmp.end());
-        }
-        dataStore->bleBeacons(bleBeacons);
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "load beacon data: " << msec << "ms" << std::endl;
-        
-        if(doTraining || forceTraining){
-            std::cerr << "Training will be processed" << std::endl;
-            // Train observation model
-            std::shared_ptr<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>obsModelTrainer( new GaussianProcessLDPLMultiModelTrainer<State, Beacons>());
-            obsModelTrainer->setGPType(basicLocalizerOptions.gpType);
-            obsModelTrainer->dataStore(dataStore);
-            std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel( obsModelTrainer->train());
-            //localizer->observationModel(obsModel);
-            
-            std::ostringstream oss;
-            obsModel->save(oss);
-            
-            json["ObservationModelParameters"] = (picojson::value)oss.str();
-            
-            std::ofstream of;
-            of.open(modelPath);
-            of << v.serialize();
-            of.close();
-        }
-        
         // Instantiate sensor data processors
         // Orientation
         orientationMeterAverageParameters.interval(0.1);
@@ -869,6 +732,7 @@ namespace loc{
         
         stateProperty->stdRssiBias(stdRssiBias);
         stateProperty->diffusionRssiBias(diffusionRssiBias);
+        stateProperty->marginalizesRssiBias(marginalizesRssiBias);
         stateProperty->diffusionOrientationBias(diffusionOrientationBias/180.0*M_PI);
         
         // END TODO
@@ -896,8 +760,7 @@ namespace loc{
         prwBuildingProperty->velocityRateEscalator(velocityRateEscalator);
         prwBuildingProperty->relativeVelocityEscalator(relativeVelocityEscalator);
         
-        Building building = dataStore->getBuilding();
-        Building::Ptr buildingPtr(new Building(building));
+        Building::Ptr buildingPtr = site->building();
         poseRandomWalkerInBuilding = std::shared_ptr<PoseRandomWalkerInBuilding>(new PoseRandomWalkerInBuilding());
         poseRandomWalkerInBuilding->poseRandomWalker(poseRandomWalker);
         poseRandomWalkerInBuilding->building(buildingPtr);
@@ -924,7 +787,8 @@ namespace loc{
             RandomWalkerMotion<State, SystemModelInput>::Ptr randomWalkerMotion(new RandomWalkerMotion<State, SystemModelInput>);
             randomWalkerMotion->setProperty(randomWalkerMotionProperty);
             // Setup SystemModelInBuilding
-            SystemModelInBuilding<State, SystemModelInput>::Ptr rwMotionBldg(new SystemModelInBuilding<State, SystemModelInput>(randomWalkerMotion, buildingPtr, prwBuildingProperty) );
+            using RandomWalkerMotionInBuilding = SystemModelInBuilding<State, SystemModelInput, RandomWalkerMotion<State, SystemModelInput>>;
+            RandomWalkerMotionInBuilding::Ptr rwMotionBldg(new RandomWalkerMotionInBuilding(randomWalkerMotion, buildingPtr, prwBuildingProperty) );
             mLocalizer->systemModel(rwMotionBldg);
         }
         else if (localizeMode == RANDOM_WALK) {
@@ -942,12 +806,13 @@ namespace loc{
             wPRWproperty->poseRandomWalkRate(poseRandomWalkRate);
             wPRWproperty->randomWalkRate(randomWalkRate);
             wPRW->setWeakPoseRandomWalkerProperty(wPRWproperty);
-            SystemModelInBuilding<State, SystemModelInput>::Ptr wPRWBldg(new SystemModelInBuilding<State, SystemModelInput>(wPRW, buildingPtr, prwBuildingProperty) );
+            using WeakPoseRandomWalkerInBuilding = SystemModelInBuilding<State, SystemModelInput, WeakPoseRandomWalker<State, SystemModelInput>>;
+            WeakPoseRandomWalkerInBuilding::Ptr wPRWBldg(new WeakPoseRandomWalkerInBuilding(wPRW, buildingPtr, prwBuildingProperty) );
             mLocalizer->systemModel(wPRWBldg);
         }
         
         // set resampler
-        resampler = std::shared_ptr<Resampler<State>>(new GridResampler<State>());
+        resampler = std::make_shared<AncestorResampler<State>>(resamplingParams);
         mLocalizer->resampler(resampler);
         // Set status initializer
         ////PoseProperty poseProperty;
@@ -998,14 +863,65 @@ namespace loc{
         mLocalizer->mixtureParameters(mixParams);
         
         mLocalizer->floorTransitionParameters(pfFloorTransParams);
+        mLocalizer->timeBudgetParameters(pfTimeBudgetParams);
+        mLocalizer->compressesStates(pfCompressesStates);
+        mLocalizer->hybridTrackingParameters(pfHybridTrackingParams);
+        mLocalizer->hybridTrackingModel(deserializedModel);
+        mLocalizer->dutyCycleParameters(pfDutyCycleParams);
+        mLocalizer->motionIntegrationParameters(pfMotionIntegrationParams);
         mLocalizer->locationStatusMonitorParameters(locationStatusMonitorParameters);
         
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "finish setModel: " << msec << "ms" << std::endl;
+        if(localizeMode == GRID_POINT_MASS){
+            mGridFilter = std::make_shared<GridPointMassFilter>();
+            mGridFilter->optVerbose(isVerboseLocalizer)
+            .numStates(nStates)
+            .alphaWeaken(alphaWeaken)
+            .rssiBias(meanRssiBias_)
+            .parameters(gridParams)
+            .building(buildingPtr)
+            .observationModel(deserializedModel)
+            .beaconFilter(beaconFilter)
+            .pedometer(pedometer)
+            .orientationMeter(orientationMeter);
+            // Sessions with the grid parameters of the site share its grid.
+            auto siteGrid = site->grid();
+            if(siteGrid && siteGrid->isBuiltFor(buildingPtr, *gridParams, deserializedModel)){
+                mGridFilter->grid(siteGrid);
+            }
+            mGridFilter->initializeGridIfEmpty();
+            if (mFunctionCalledAfterUpdate2 && mUserData) {
+                mGridFilter->updateHandler(bridgeFunctionCalledAfterUpdate2, mUserDataBridge);
+            }
+            if (mFunctionCalledAfterUpdate) {
+                mGridFilter->updateHandler(mFunctionCalledAfterUpdate);
+            }
+            mEngine = mGridFilter;
+        }else{
+            mEngine = mLocalizer;
+        }
+        
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        LOC_LOG_INFO(LOCALIZER, "finish setModel: " << msec << "ms");
         isReady = true;
+        if(usesAsyncSensorInput){
+            startAsyncSensorInput();
+        }
         return *this;
     }
     
+    void BasicLocalizer::filterObservationModel(std::shared_ptr<ObservationModel<State, Beacons>> model){
+        if(!mLocalizer){
+            BOOST_THROW_EXCEPTION(LocException("model has not been set"));
+        }
+        mLocalizer->observationModel(model);
+        if(mGridFilter){
+            auto gpModel = std::dynamic_pointer_cast<GaussianProcessLDPLMultiModel<State, Beacons>>(model);
+            if(gpModel){
+                mGridFilter->observationModel(gpModel);
+            }
+        }
+    }
+    
     double BasicLocalizer::estimatedRssiBias() {
         return mEstimatedRssiBias;
     }
@@ -1045,6 +961,13 @@ namespace loc{
     */
 
     void BasicLocalizer::normalFunction(NormalFunction type, double option) {
+        // The observation model belongs to the site. It can be changed only while no other localizer uses the site.
+        if (!mSiteContext) {
+            BOOST_THROW_EXCEPTION(LocException("normalFunction must be called after the model is set"));
+        }
+        if (1 < mSiteContext.use_count()) {
+            BOOST_THROW_EXCEPTION(LocException("normalFunction cannot change the observation model of a site shared with other localizers"));
+        }
         if (type == NORMAL) {
             deserializedModel->normFunc = MathUtils::logProbaNormal;
         }
@@ -1069,6 +992,104 @@ namespace loc{
         mDisableAcceleration = disable;
     }
     
+    // snapshot
+    static const std::uint32_t SNAPSHOT_MAGIC = 0x4e534c42; // "BLSN"
+    static const std::uint32_t SNAPSHOT_VERSION = 8;
+    
+    static void saveMoments(SnapshotOutputArchive& ar, const std::shared_ptr<const StatesMoments>& moments){
+        bool hasMoments = moments!=nullptr;
+        ar(CEREAL_NVP(hasMoments));
+        if(hasMoments){
+            ar(cereal::make_nvp("moments", *moments));
+        }
+    }
+    
+    static std::shared_ptr<const StatesMoments> loadMoments(SnapshotInputArchive& ar){
+        bool hasMoments = false;
+        ar(CEREAL_NVP(hasMoments));
+        if(!hasMoments){
+            return nullptr;
+        }
+        auto moments = std::make_shared<StatesMoments>();
+        ar(cereal::make_nvp("moments", *moments));
+        return moments;
+    }
+    
+    void BasicLocalizer::saveSnapshot(std::ostream& os){
+        if(!isReady){
+            BOOST_THROW_EXCEPTION(LocException("a snapshot can be saved only after the model was set"));
+        }
+        auto engine = std::dynamic_pointer_cast<Snapshottable>(mEngine);
+        if(!engine){
+            BOOST_THROW_EXCEPTION(LocException("the localizer does not support snapshots"));
+        }
+        flushAsyncSensorInput();
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        
+        SnapshotOutputArchive ar(os);
+        std::uint32_t magic = SNAPSHOT_MAGIC;
+        std::uint32_t version = SNAPSHOT_VERSION;
+        int localizeModeSaved = localizeMode;
+        int nSmoothMax = N_SMOOTH_MAX;
+        ar(CEREAL_NVP(magic), CEREAL_NVP(version), CEREAL_NVP(localizeModeSaved), CEREAL_NVP(nSmoothMax));
+        
+        engine->saveState(ar);
+        
+        int locationStatus = mLocationStatus;
+        ar(CEREAL_NVP(smooth_count), CEREAL_NVP(mEstimatedRssiBias), CEREAL_NVP(locationStatus));
+        ar(CEREAL_NVP(mDisableAcceleration), CEREAL_NVP(headingConfidenceForOrientationInit_));
+        saveMoments(ar, mTrackedMoments);
+        for(int i=0; i<N_SMOOTH_MAX; i++){
+            saveMoments(ar, moments_list[i]);
+            ar(cereal::make_nvp("beacons", beacons_list[i]));
+        }
+        mLocalHeadingBuffer.saveState(ar);
+        saveComponentState(ar, yawDriftAdjuster);
+    }
+    
+    void BasicLocalizer::loadSnapshot(std::istream& is){
+        if(!isReady){
+            BOOST_THROW_EXCEPTION(LocException("a snapshot can be loaded only after the model was set"));
+        }
+        auto engine = std::dynamic_pointer_cast<Snapshottable>(mEngine);
+        if(!engine){
+            BOOST_THROW_EXCEPTION(LocException("the localizer does not support snapshots"));
+        }
+        flushAsyncSensorInput();
+        std::lock_guard<std::recursive_mutex> lock(mEngineMutex);
+        
+        try{
+            SnapshotInputArchive ar(is);
+            std::uint32_t magic = 0;
+            std::uint32_t version = 0;
+            int localizeModeSaved = 0;
+            int nSmoothMax = 0;
+            ar(CEREAL_NVP(magic), CEREAL_NVP(version), CEREAL_NVP(localizeModeSaved), CEREAL_NVP(nSmoothMax));
+            if(magic!=SNAPSHOT_MAGIC || version!=SNAPSHOT_VERSION){
+                BOOST_THROW_EXCEPTION(LocException("unsupported snapshot format"));
+            }
+            if(localizeModeSaved!=localizeMode || nSmoothMax!=N_SMOOTH_MAX){
+                BOOST_THROW_EXCEPTION(LocException("snapshot does not match the configuration of the localizer"));
+            }
+            
+            engine->loadState(ar);
+            
+            int locationStatus = Status::UNKNOWN;
+            ar(CEREAL_NVP(smooth_count), CEREAL_NVP(mEstimatedRssiBias), CEREAL_NVP(locationStatus));
+            mLocationStatus = static_cast<Status::LocationStatus>(locationStatus);
+            ar(CEREAL_NVP(mDisableAcceleration), CEREAL_NVP(headingConfidenceForOrientationInit_));
+            mTrackedMoments = loadMoments(ar);
+            for(int i=0; i<N_SMOOTH_MAX; i++){
+                moments_list[i] = loadMoments(ar);
+                ar(cereal::make_nvp("beacons", beacons_list[i]));
+            }
+            mLocalHeadingBuffer.loadState(ar);
+            loadComponentState(ar, yawDriftAdjuster);
+        }catch(cereal::Exception& e){
+            BOOST_THROW_EXCEPTION(LocException(std::string("failed to read snapshot: ") + e.what()));
+        }
+    }
+    
     //LocalHeadingBuffer
     LocalHeadingBuffer::LocalHeadingBuffer(size_t n){
         buffer_ = boost::circular_buffer<LocalHeading>(n);
@@ -1091,5 +1112,19 @@ namespace loc{
     size_t LocalHeadingBuffer::size(){
         return buffer_.size();
     }
+    void LocalHeadingBuffer::saveState(SnapshotOutputArchive& ar) const{
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::vector<LocalHeading> headings(buffer_.begin(), buffer_.end());
+        ar(CEREAL_NVP(headings));
+    }
+    void LocalHeadingBuffer::loadState(SnapshotInputArchive& ar){
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::vector<LocalHeading> headings;
+        ar(CEREAL_NVP(headings));
+        buffer_.clear();
+        for(const auto& h: headings){
+            buffer_.push_back(h);
+        }
+    }
     
 }
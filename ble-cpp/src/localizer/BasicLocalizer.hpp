@@ -25,16 +25,19 @@
 
 #include <iostream>
 #include <string>
+#include <mutex>
 
 #include <boost/circular_buffer.hpp>
 
 #include "StreamLocalizer.hpp"
 #include "StreamParticleFilter.hpp"
+#include "GridPointMassFilter.hpp"
 
 #include "PoseRandomWalker.hpp"
 #include "WeakPoseRandomWalker.hpp"
 
 #include "GridResampler.hpp"
+#include "AncestorResampler.hpp"
 #include "StatusInitializerStub.hpp"
 #include "StatusInitializerImpl.hpp"
 
@@ -59,8 +62,10 @@
 
 #include "ObservationDependentInitializer.hpp"
 #include "MetropolisSampler.hpp"
+#include "AsyncSensorDispatcher.hpp"
 
 #include "SerializeUtils.hpp"
+#include "SnapshotUtils.hpp"
 #include "LatLngConverter.hpp"
 
 #define N_SMOOTH_MAX 10
@@ -70,6 +75,7 @@ namespace loc {
     class BasicLocalizerParameters;
     class BasicLocalizerOptions;
     class BasicLocalizer;
+    class SiteContext;
     
     typedef struct {
         BasicLocalizer* localizer;
@@ -80,7 +86,8 @@ namespace loc {
         RANDOM_WALK = 1,
         RANDOM_WALK_ACC = 2,
         RANDOM_WALK_ACC_ATT = 3,
-        WEAK_POSE_RANDOM_WALKER = 4
+        WEAK_POSE_RANDOM_WALKER = 4,
+        GRID_POINT_MASS = 5
     } LocalizeMode;
     
     /*
@@ -105,10 +112,10 @@ namespace loc {
         TRANSFORMED_AVERAGE
     } OrientationMeterType;
     
-    class LocalHeadingBuffer{
+    class LocalHeadingBuffer : public Snapshottable{
     protected:
         boost::circular_buffer<LocalHeading> buffer_;
-        std::mutex mtx_;
+        mutable std::mutex mtx_;
     public:
         LocalHeadingBuffer(size_t);
         ~LocalHeadingBuffer() = default;
@@ -117,6 +124,9 @@ namespace loc {
         void push_back(const LocalHeading&);
         LocalHeading& back();
         size_t size();
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
     };
     
     
@@ -150,6 +160,8 @@ namespace loc {
         double diffusionRssiBias = 0.2;
         double stdOrientation = 3.0;
         double diffusionOrientationBias = 10;
+        // Marginalize the RSSI bias of each state analytically (Rao-Blackwellisation) instead of sampling it.
+        bool marginalizesRssiBias = false;
         
         double angularVelocityLimit = 30;
         // Parametes for PoseRandomWalker
@@ -191,18 +203,32 @@ namespace loc {
         double coeffDiffFloorStdev = 5.0;
         
         OrientationMeterType orientationMeterType = RAW_AVERAGE;
+        
+        // Seed of all random generators of the localizer (negative: default-seeded generators)
+        long randomSeed = -1;
 
         // parameter objects
         PoseProperty::Ptr poseProperty = std::make_shared<PoseProperty>();
         StateProperty::Ptr stateProperty = std::make_shared<StateProperty>();
         
         StreamParticleFilter::FloorTransitionParameters::Ptr pfFloorTransParams = std::make_shared<StreamParticleFilter::FloorTransitionParameters>();
+        StreamParticleFilter::TimeBudgetParameters::Ptr pfTimeBudgetParams = std::make_shared<StreamParticleFilter::TimeBudgetParameters>();
+        bool pfCompressesStates = false; // share likelihoods between identical states
+        StreamParticleFilter::HybridTrackingParameters::Ptr pfHybridTrackingParams = std::make_shared<StreamParticleFilter::HybridTrackingParameters>();
+        StreamParticleFilter::DutyCycleParameters::Ptr pfDutyCycleParams = std::make_shared<StreamParticleFilter::DutyCycleParameters>();
+        StreamParticleFilter::MotionIntegrationParameters::Ptr pfMotionIntegrationParams = std::make_shared<StreamParticleFilter::MotionIntegrationParameters>();
+        ResamplingParameters::Ptr resamplingParams = std::make_shared<ResamplingParameters>();
+        GridPointMassFilter::Parameters::Ptr gridParams = std::make_shared<GridPointMassFilter::Parameters>(); // used in GRID_POINT_MASS mode
         LocationStatusMonitorParameters::Ptr locationStatusMonitorParameters = std::make_shared<LocationStatusMonitorParameters>();
         SystemModelInBuildingProperty::Ptr prwBuildingProperty = std::make_shared<SystemModelInBuildingProperty>();
         
         // yaw drift adjuster
         bool applysYawDriftAdjust = false;
         
+        // asynchronous sensor input
+        bool usesAsyncSensorInput = false;
+        AsyncSensorParameters asyncSensorParameters;
+        
     protected:
         double meanRssiBias_ = 0.0;
         double minRssiBias_ = -10;
@@ -298,6 +324,37 @@ namespace loc {
             if(1<=version){
                 ar(CEREAL_NVP(applysYawDriftAdjust));
             }
+            if(2<=version){
+                ar(CEREAL_NVP(usesAsyncSensorInput));
+                ar(CEREAL_NVP(asyncSensorParameters));
+            }
+            if(3<=version){
+                ar(CEREAL_NVP(*pfTimeBudgetParams));
+            }
+            if(4<=version){
+                ar(CEREAL_NVP(marginalizesRssiBias));
+            }
+            if(5<=version){
+                ar(CEREAL_NVP(pfCompressesStates));
+            }
+            if(6<=version){
+                ar(CEREAL_NVP(*pfHybridTrackingParams));
+            }
+            if(7<=version){
+                ar(CEREAL_NVP(*gridParams));
+            }
+            if(8<=version){
+                ar(CEREAL_NVP(*pfDutyCycleParams));
+            }
+            if(9<=version){
+                ar(CEREAL_NVP(*pfMotionIntegrationParams));
+            }
+            if(10<=version){
+                ar(CEREAL_NVP(*resamplingParams));
+            }
+            if(11<=version){
+                ar(CEREAL_NVP(randomSeed));
+            }
         }
         
     };
@@ -311,7 +368,10 @@ namespace loc {
         
     private:
         std::shared_ptr<StreamParticleFilter> mLocalizer;
+        std::shared_ptr<GridPointMassFilter> mGridFilter;
+        std::shared_ptr<StreamLocalizer> mEngine; // mLocalizer or mGridFilter depending on localizeMode
         std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> deserializedModel;
+        std::shared_ptr<const SiteContext> mSiteContext;
         UserData userData;
         double isReady = false;
         
@@ -325,9 +385,10 @@ namespace loc {
         void *mUserDataBridge = NULL;
         
         //std::shared_ptr<loc::Status> mResult;
-        std::shared_ptr<Status> mTrackedStatus;
+        std::shared_ptr<const StatesMoments> mTrackedMoments;
         
-        std::vector<loc::State> status_list[N_SMOOTH_MAX];
+        // moments of the states in the smoothing window
+        std::shared_ptr<const StatesMoments> moments_list[N_SMOOTH_MAX];
         std::vector<loc::Beacon> beacons_list[N_SMOOTH_MAX];
         
         int smooth_count = 0;
@@ -341,6 +402,7 @@ namespace loc {
                 case RANDOM_WALK_ACC:
                 case RANDOM_WALK_ACC_ATT:
                 case WEAK_POSE_RANDOM_WALKER:
+                case GRID_POINT_MASS:
                 default:
                     return true;
             }
@@ -357,6 +419,15 @@ namespace loc {
         
         bool mDisableAcceleration = false;
         
+        // Created once and kept until destruction so that late pushes from sensor threads are rejected
+        // by the stopped dispatcher instead of accessing a destroyed one.
+        AsyncSensorDispatcher::Ptr mAsyncDispatcher;
+        // Taken by the worker thread while it processes an event and by the methods accessing
+        // the filter from other threads.
+        mutable std::recursive_mutex mEngineMutex;
+        bool dispatchesAsync() const;
+        void handleSensorEvent(const SensorEvent& event);
+        
     public:
         BasicLocalizer();
         ~BasicLocalizer();
@@ -371,6 +442,8 @@ namespace loc {
         
         std::shared_ptr<DataStoreImpl> dataStore;
         
+        // normalFunction changes the observation model of the site, so it throws LocException when the site
+        // is shared with other localizers (e.g. sessions of SessionEngine). It must be called after setModel.
         void normalFunction(NormalFunction type, double option);
         void meanRssiBias(double b);
         void maxRssiBias(double b);
@@ -434,12 +507,18 @@ namespace loc {
         bool resetStatus(const Location& location, const Beacons& beacons) override;
 
         BasicLocalizer& setModel(std::string modelPath, std::string workingDir);
+        // Sets up the localizer on a site loaded by SiteContext::load. The site is shared, not copied.
+        BasicLocalizer& siteContext(std::shared_ptr<const SiteContext> site);
+        std::shared_ptr<const SiteContext> siteContext() const{
+            return mSiteContext;
+        }
         
         bool tracksOrientation(){
             switch(localizeMode) {
                 case ONESHOT:
                 case RANDOM_WALK:
                 case RANDOM_WALK_ACC:
+                case GRID_POINT_MASS:
                     return false;
                 case RANDOM_WALK_ACC_ATT:
                 case WEAK_POSE_RANDOM_WALKER:
@@ -452,6 +531,9 @@ namespace loc {
         std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> observationModel() const{
             return deserializedModel;
         };
+        // Replaces the observation model used for filter updates after the model was set
+        // (e.g. with a model evaluating likelihoods in batches across sessions).
+        void filterObservationModel(std::shared_ptr<ObservationModel<State, Beacons>> model);
         
         // for orientation initialization
         void headingConfidenceForOrientationInit(double confidence);
@@ -464,9 +546,27 @@ namespace loc {
         
         // control disable/enable acceleration
         void disableAcceleration(bool);
+        
+        // asynchronous sensor input (enabled by usesAsyncSensorInput)
+        // put* methods only enqueue events and callbacks are called on the worker thread.
+        // Hold engineMutex() while using the Status returned by getStatus() in this mode.
+        void startAsyncSensorInput();
+        void stopAsyncSensorInput();
+        void flushAsyncSensorInput();
+        AsyncSensorStatistics asyncSensorStatistics() const;
+        std::recursive_mutex& engineMutex() const;
+        
+        StatesCompressionStatistics statesCompressionStatistics() const;
+        DutyCycleStatistics dutyCycleStatistics() const;
+        
+        // Checkpoint/restore of a session: particles, location status, sensor windows, yaw drift adjuster,
+        // smoothing buffers and random generator states. The site and the parameters are not included;
+        // restore into a localizer set up with the same model and parameters.
+        void saveSnapshot(std::ostream& os);
+        void loadSnapshot(std::istream& is);
     };
 }
 
 // assign version
-CEREAL_CLASS_VERSION(loc::BasicLocalizerParameters, 1);
+CEREAL_CLASS_VERSION(loc::BasicLocalizerParameters, 11);
 #endif /* BasicLocalizerBuilder_hpp */
@@ -0,0 +1,249 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "SessionEngine.hpp"
+#include "LocException.hpp"
+#include "Logger.hpp"
+
+namespace loc{
+    
+    SiteContext::Ptr SessionEngine::loadSite(const std::string& siteId, const std::string& modelPath, const std::string& workingDir, const BasicLocalizerParameters& params, const BasicLocalizerOptions& options){
+        SiteContext::Ptr site = SiteContext::load(modelPath, workingDir, params, options);
+        addSite(siteId, site);
+        return site;
+    }
+    
+    SessionEngine& SessionEngine::addSite(const std::string& siteId, SiteContext::Ptr site){
+        if(!site){
+            BOOST_THROW_EXCEPTION(LocException("site is null"));
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSites[siteId] = site;
+        mSchedulers.erase(siteId);
+        return *this;
+    }
+    
+    bool SessionEngine::removeSite(const std::string& siteId){
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSchedulers.erase(siteId);
+        return mSites.erase(siteId)==1;
+    }
+    
+    SiteContext::Ptr SessionEngine::site(const std::string& siteId) const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mSites.find(siteId);
+        if(iter==mSites.end()){
+            BOOST_THROW_EXCEPTION(LocException("unknown site id: "+siteId));
+        }
+        return iter->second;
+    }
+    
+    size_t SessionEngine::numSites() const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mSites.size();
+    }
+    
+    SessionEngine& SessionEngine::updateHandler(UpdateHandler handler){
+        std::lock_guard<std::mutex> lock(mMutex);
+        mUpdateHandler = handler;
+        return *this;
+    }
+    
+    SessionEngine& SessionEngine::batchesLikelihoods(bool batches){
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBatchesLikelihoods = batches;
+        return *this;
+    }
+    
+    SessionEngine& SessionEngine::likelihoodBatchParameters(const LikelihoodBatchParameters& params){
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLikelihoodBatchParams = params;
+        mSchedulers.clear();
+        return *this;
+    }
+    
+    LikelihoodBatchStatistics SessionEngine::likelihoodBatchStatistics(const std::string& siteId) const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mSchedulers.find(siteId);
+        if(iter==mSchedulers.end()){
+            return LikelihoodBatchStatistics();
+        }
+        return iter->second->statistics();
+    }
+    
+    void SessionEngine::sessionUpdated(void* userData, Status* status){
+        Session* session = static_cast<Session*>(userData);
+        if(session->handler){
+            session->handler(session->id, status);
+        }
+    }
+    
+    SessionEngine::SessionId SessionEngine::createSession(const std::string& siteId){
+        SiteContext::Ptr siteContext = site(siteId);
+        
+        auto session = std::make_shared<Session>();
+        session->siteId = siteId;
+        LikelihoodBatchScheduler::Ptr scheduler;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            session->id = mNextId++;
+            session->handler = mUpdateHandler;
+            if(mBatchesLikelihoods){
+                auto& schedulerRef = mSchedulers[siteId];
+                if(!schedulerRef){
+                    schedulerRef = std::make_shared<LikelihoodBatchScheduler>(siteContext->observationModel(), mLikelihoodBatchParams);
+                }
+                scheduler = schedulerRef;
+            }
+        }
+        // The localizer is set up outside the engine lock because it is the costly part.
+        session->localizer = std::make_shared<BasicLocalizer>(siteContext->sessionParameters());
+        session->localizer->updateHandler(sessionUpdated, session.get());
+        session->localizer->siteContext(siteContext);
+        if(scheduler){
+            session->localizer->filterObservationModel(scheduler->observationModel());
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mSessions[session->id] = session;
+        }
+        LOC_LOG_DEBUG(LOCALIZER, "session " << session->id << " was created on site " << siteId);
+        return session->id;
+    }
+    
+    bool SessionEngine::destroySession(SessionId id){
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto iter = mSessions.find(id);
+            if(iter==mSessions.end()){
+                return false;
+            }
+            session = iter->second;
+            mSessions.erase(iter);
+        }
+        // wait for the event in process
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->localizer->stopAsyncSensorInput();
+        LOC_LOG_DEBUG(LOCALIZER, "session " << id << " was destroyed");
+        return true;
+    }
+    
+    bool SessionEngine::hasSession(SessionId id) const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mSessions.count(id)==1;
+    }
+    
+    size_t SessionEngine::numSessions() const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mSessions.size();
+    }
+    
+    std::shared_ptr<SessionEngine::Session> SessionEngine::findSession(SessionId id) const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mSessions.find(id);
+        if(iter==mSessions.end()){
+            BOOST_THROW_EXCEPTION(LocException("unknown session id: "+std::to_string(id)));
+        }
+        return iter->second;
+    }
+    
+    void SessionEngine::putAttitude(SessionId id, const Attitude& attitude){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->localizer->putAttitude(attitude);
+    }
+    
+    void SessionEngine::putAcceleration(SessionId id, const Acceleration& acceleration){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->localizer->putAcceleration(acceleration);
+    }
+    
+    void SessionEngine::putBeacons(SessionId id, const Beacons& beacons){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->localizer->putBeacons(beacons);
+    }
+    
+    void SessionEngine::putLocalHeading(SessionId id, const LocalHeading& heading){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->localizer->putLocalHeading(heading);
+    }
+    
+    void SessionEngine::putHeading(SessionId id, const Heading& heading){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->localizer->putHeading(heading);
+    }
+    
+    void SessionEngine::putAltimeter(SessionId id, const Altimeter& altimeter){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->localizer->putAltimeter(altimeter);
+    }
+    
+    bool SessionEngine::resetStatus(SessionId id){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        return session->localizer->resetStatus();
+    }
+    
+    bool SessionEngine::resetStatus(SessionId id, const Pose& meanPose, const Pose& stdevPose){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        return session->localizer->resetStatus(meanPose, stdevPose);
+    }
+    
+    bool SessionEngine::resetStatus(SessionId id, const Beacons& beacons){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        return session->localizer->resetStatus(beacons);
+    }
+    
+    Status SessionEngine::getStatus(SessionId id){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        return *session->localizer->getStatus();
+    }
+    
+    void SessionEngine::snapshotSession(SessionId id, std::ostream& os){
+        auto session = findSession(id);
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->localizer->saveSnapshot(os);
+    }
+    
+    SessionEngine::SessionId SessionEngine::restoreSession(const std::string& siteId, std::istream& is){
+        SessionId id = createSession(siteId);
+        auto session = findSession(id);
+        try{
+            std::lock_guard<std::mutex> lock(session->mtx);
+            session->localizer->loadSnapshot(is);
+        }catch(...){
+            destroySession(id);
+            throw;
+        }
+        LOC_LOG_DEBUG(LOCALIZER, "session " << id << " was restored on site " << siteId);
+        return id;
+    }
+}
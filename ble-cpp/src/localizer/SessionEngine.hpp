@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef SessionEngine_hpp
+#define SessionEngine_hpp
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <functional>
+
+#include "BasicLocalizer.hpp"
+#include "SiteContext.hpp"
+#include "LikelihoodBatchScheduler.hpp"
+
+namespace loc{
+    
+    // Hosts many localization sessions (users) on shared sites.
+    // Each session holds only its filter state and sensor processors. The building, the observation model and the
+    // data store are loaded once per site and shared by all its sessions.
+    // Events of different sessions can be put concurrently. Events of the same session are processed one at a time.
+    class SessionEngine{
+    public:
+        using Ptr = std::shared_ptr<SessionEngine>;
+        using SessionId = long;
+        using UpdateHandler = std::function<void(SessionId, Status*)>;
+        
+        SessionEngine() = default;
+        ~SessionEngine() = default;
+        
+        SessionEngine(const SessionEngine&) = delete;
+        SessionEngine& operator=(const SessionEngine&) = delete;
+        
+        SiteContext::Ptr loadSite(const std::string& siteId, const std::string& modelPath, const std::string& workingDir, const BasicLocalizerParameters& params, const BasicLocalizerOptions& options = BasicLocalizerOptions());
+        SessionEngine& addSite(const std::string& siteId, SiteContext::Ptr site);
+        // Sessions created on the removed site keep using it until they are destroyed.
+        bool removeSite(const std::string& siteId);
+        SiteContext::Ptr site(const std::string& siteId) const;
+        size_t numSites() const;
+        
+        // The handler is called after each update of a session on the thread that put the event
+        // (or on the session's worker thread when usesAsyncSensorInput is set). It applies to sessions created afterwards.
+        SessionEngine& updateHandler(UpdateHandler handler);
+        
+        // When enabled, the likelihoods of the sessions on the same site are evaluated in batches.
+        // It applies to sessions created afterwards.
+        SessionEngine& batchesLikelihoods(bool batches);
+        SessionEngine& likelihoodBatchParameters(const LikelihoodBatchParameters& params);
+        LikelihoodBatchStatistics likelihoodBatchStatistics(const std::string& siteId) const;
+        
+        SessionId createSession(const std::string& siteId);
+        bool destroySession(SessionId id);
+        bool hasSession(SessionId id) const;
+        size_t numSessions() const;
+        
+        void putAttitude(SessionId id, const Attitude& attitude);
+        void putAcceleration(SessionId id, const Acceleration& acceleration);
+        void putBeacons(SessionId id, const Beacons& beacons);
+        void putLocalHeading(SessionId id, const LocalHeading& heading);
+        void putHeading(SessionId id, const Heading& heading);
+        void putAltimeter(SessionId id, const Altimeter& altimeter);
+        
+        bool resetStatus(SessionId id);
+        bool resetStatus(SessionId id, const Pose& meanPose, const Pose& stdevPose);
+        bool resetStatus(SessionId id, const Beacons& beacons);
+        
+        // Returns a copy of the latest status of the session.
+        Status getStatus(SessionId id);
+        
+        // Writes a snapshot of the session (see BasicLocalizer::saveSnapshot).
+        void snapshotSession(SessionId id, std::ostream& os);
+        // Creates a session on the site and restores it from a snapshot taken on a session of the same site.
+        SessionId restoreSession(const std::string& siteId, std::istream& is);
+        
+    private:
+        struct Session{
+            SessionId id;
+            std::string siteId;
+            UpdateHandler handler;
+            std::mutex mtx;
+            std::shared_ptr<BasicLocalizer> localizer;
+        };
+        
+        mutable std::mutex mMutex;
+        std::map<std::string, SiteContext::Ptr> mSites;
+        std::map<SessionId, std::shared_ptr<Session>> mSessions;
+        SessionId mNextId = 1;
+        UpdateHandler mUpdateHandler;
+        
+        bool mBatchesLikelihoods = false;
+        LikelihoodBatchParameters mLikelihoodBatchParams;
+        std::map<std::string, LikelihoodBatchScheduler::Ptr> mSchedulers;
+        
+        std::shared_ptr<Session> findSession(SessionId id) const;
+        static void sessionUpdated(void* userData, Status* status);
+    };
+}
+
+#endif /* SessionEngine_hpp */
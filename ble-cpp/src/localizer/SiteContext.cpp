@@ -0,0 +1,340 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "SiteContext.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include "Logger.hpp"
+
+namespace loc{
+    
+    const picojson::value &get(const picojson::value::object &obj, std::string key){
+        auto itr = obj.find(key);
+        if (itr != obj.end()) {
+            return itr->second;
+        }
+        throw "not found";
+    }
+    
+    const std::string &getString(const picojson::value::object &obj, std::string key) {
+        auto& value = get(obj, key);
+        if (value.is<std::string>()) {
+            return value.get<std::string>();
+        }
+        throw "non string value";
+    }
+    double getDouble(const picojson::value::object &obj, std::string key) {
+        auto& value = get(obj, key);
+        if (value.is<double>()) {
+            return value.get<double>();
+        }
+        throw "non double value";
+    }
+    const picojson::value::object &getObject(const picojson::value::object &obj, std::string key) {
+        auto& value = get(obj, key);
+        if (value.is<picojson::value::object>()) {
+            return value.get<picojson::value::object>();
+        }
+        throw "non object value";
+    }
+    const picojson::value::array &getArray(const picojson::value::object &obj, std::string key) {
+        auto& value = get(obj, key);
+        if (value.is<picojson::value::array>()) {
+            return value.get<picojson::value::array>();
+        }
+        throw "non array value";
+    }    
+    // Parameter objects are held by shared_ptr. They are copied so that sites and sessions do not share mutable objects.
+    static void copyParameterObjects(BasicLocalizerParameters& params){
+        params.poseProperty = std::make_shared<PoseProperty>(*params.poseProperty);
+        params.stateProperty = std::make_shared<StateProperty>(*params.stateProperty);
+        params.pfFloorTransParams = std::make_shared<StreamParticleFilter::FloorTransitionParameters>(*params.pfFloorTransParams);
+        params.pfTimeBudgetParams = std::make_shared<StreamParticleFilter::TimeBudgetParameters>(*params.pfTimeBudgetParams);
+        params.locationStatusMonitorParameters = std::make_shared<LocationStatusMonitorParameters>(*params.locationStatusMonitorParameters);
+        params.prwBuildingProperty = std::make_shared<SystemModelInBuildingProperty>(*params.prwBuildingProperty);
+        params.gridParams = std::make_shared<GridPointMassFilter::Parameters>(*params.gridParams);
+    }
+    
+    SiteContext::Ptr SiteContext::load(const std::string& modelPath, const std::string& workingDir, const BasicLocalizerParameters& params, const BasicLocalizerOptions& options, bool forceTraining){
+        auto s = std::chrono::system_clock::now();
+        LOC_LOG_INFO(LOCALIZER, "start loading site");
+        
+        std::shared_ptr<SiteContext> site(new SiteContext());
+        site->mParameters = params;
+        copyParameterObjects(site->mParameters);
+        
+        std::ifstream file;
+        file.open(modelPath, std::ios::in);
+        std::istreambuf_iterator<char> input(file);
+        
+        picojson::value v;
+        std::string err;
+        picojson::parse(v, input, std::istreambuf_iterator<char>(), &err);
+        if (!err.empty()) {
+            throw err+" with reading "+modelPath;
+        }
+        if (!v.is<picojson::object>()) {
+            throw "invalid JSON";
+        }
+        file.close();
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        LOC_LOG_INFO(LOCALIZER, "parse JSON: " << msec << "ms");
+        
+        picojson::value::object& json = v.get<picojson::object>();
+        
+        auto& anchorJobj = getObject(json, "anchor");
+        site->mAnchor.latlng.lat = getDouble(anchorJobj, "latitude");
+        site->mAnchor.latlng.lng = getDouble(anchorJobj, "longitude");
+        site->mAnchor.rotate = getDouble(anchorJobj, "rotate");
+        site->mLatLngConverter = std::make_shared<LatLngConverter>(site->mAnchor);
+        
+        site->mObservationModel = std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> (new GaussianProcessLDPLMultiModel<State, Beacons>());
+        
+        bool doTraining = true;
+        try{
+            try {
+                auto& str = getString(json, "ObservationModelParameters");
+                if (/* DISABLES CODE */ (false)) {
+                    std::string omppath = DataUtils::stringToFile(str, workingDir, "ObservationModelParameters");
+                    
+                    msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+                    LOC_LOG_INFO(LOCALIZER, "save deserialized model: " << msec << "ms");
+                    
+                    LOC_LOG_INFO(LOCALIZER, omppath);
+                    //std::istringstream ompss(str);
+                    std::ifstream ompss(omppath);
+                    //if (ompss) {
+                    LOC_LOG_INFO(LOCALIZER, "loading");
+                    site->mObservationModel->load(ompss);
+                    LOC_LOG_INFO(LOCALIZER, "loaded");
+                    //}
+                } else {
+                    std::istringstream ompss(str);
+                    if (ompss) {
+                        LOC_LOG_INFO(LOCALIZER, "loading");
+                        site->mObservationModel->load(ompss);
+                        LOC_LOG_INFO(LOCALIZER, "loaded");
+                    }
+                }
+                msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+                LOC_LOG_INFO(LOCALIZER, "load deserialized model: " << msec << "ms");
+                doTraining = false;
+            } catch(LocException& e){
+                throw e;
+            } catch(const std::exception& e) {
+                LocException ex(std::string(e.what()));
+                BOOST_THROW_EXCEPTION(ex);
+            } catch(const char* ch){
+                //LocException ex((std::string(ch)));
+                //BOOST_THROW_EXCEPTION(ex);
+            } catch(...){
+                BOOST_THROW_EXCEPTION(LocException("..."));
+            }
+        }catch(LocException& e){
+            e << boost::error_info<struct err_info, std::string>("exception at loading ObservationModelParameters");
+            throw e;
+        }
+        
+        // update observation model
+        site->mObservationModel->coeffDiffFloorStdev(params.coeffDiffFloorStdev);
+        
+        LOC_LOG_INFO(LOCALIZER, "Create data store");
+        // Create data store
+        auto dataStore = std::shared_ptr<DataStoreImpl> (new DataStoreImpl());
+        
+        // Building - change read order to reduce memory usage peak
+        //ImageHolder::setMode(ImageHolderMode(heavy));
+        BuildingBuilder buildingBuilder;
+        
+        auto& buildings = getArray(json, "layers");
+        
+        for(int floor_num = 0; floor_num < buildings.size(); floor_num++) {
+            auto& building = buildings.at(floor_num).get<picojson::value::object>();
+            auto& param = getObject(building, "param");
+            double ppmx = getDouble(param, "ppmx");
+            double ppmy = getDouble(param, "ppmy");
+            double ppmz = getDouble(param, "ppmz");
+            double originx = getDouble(param, "originx");
+            double originy = getDouble(param, "originy");
+            double originz = getDouble(param, "originz");
+            CoordinateSystemParameters coordSysParams(ppmx, ppmy, ppmz, originx, originy, originz);
+
+            auto& data = getString(building, "data");
+            std::ostringstream ostr;
+            ostr << floor_num << "floor.png";
+            
+            std::string path = DataUtils::stringToFile(data, workingDir, ostr.str());
+            
+            int fn = floor_num;
+            if (!get(param, "floor").is<picojson::null>()) {
+                fn = (int)getDouble(param, "floor");
+            }
+            
+            buildingBuilder.addFloorCoordinateSystemParametersAndImagePath(fn, coordSysParams, path);
+            
+            msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+            LOC_LOG_INFO(LOCALIZER, "prepare floor model[" << floor_num << "]: " << msec << "ms");
+        }
+        dataStore->building(buildingBuilder.build());
+        
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        LOC_LOG_INFO(LOCALIZER, "build floor model: " << msec << "ms");
+        
+        // Sampling data
+        
+        // Samples samples;
+        try{
+            auto& samples = getArray(json, "samples");
+            for(int i = 0; i < samples.size(); i++) {
+                auto& sample = samples.at(i).get<picojson::value::object>();
+                auto& data = getString(sample, "data");
+                
+                //std::string samplepath = DataUtils::stringToFile(data, workingDir);
+                //std::ifstream is(samplepath);
+                std::istringstream is(data);
+                dataStore->readSamples(is);
+            }
+            {
+                LOC_LOG_INFO(LOCALIZER, dataStore->getSamples().size() << " samples have been loaded");
+            }
+        }catch(const char* ch){
+            LOC_LOG_WARN(LOCALIZER, "samples have not been loaded.");
+        }
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        LOC_LOG_INFO(LOCALIZER, "load sample data: " << msec << "ms");
+        
+        // set unique locations to data store 
+        if(dataStore->getSamples().size() != 0){
+            const auto& uniLocs = Sample::extractUniqueLocations(dataStore->getSamples());
+            dataStore->locations(uniLocs);
+        }
+        
+        
+        // set sample locations
+        try{
+            auto& locationsJarray = getArray(json, "locations");
+            Locations locations;
+            for(int i = 0; i < locationsJarray.size(); i++) {
+                auto& locationsJobj = locationsJarray.at(i).get<picojson::value::object>();
+                auto& data = getString(locationsJobj, "data");
+                std::istringstream is(data);
+                DataUtils::csvLocationsToLocations(is, locations);
+            }
+            dataStore->locations(locations);
+            {
+                LOC_LOG_INFO(LOCALIZER, dataStore->getLocations().size() << " locations have been loaded");
+            }
+        }catch(const char* ch){
+            {
+                LOC_LOG_WARN(LOCALIZER, "locations have not been loaded");
+            }
+        }
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        LOC_LOG_INFO(LOCALIZER, "load location data: " << msec << "ms");
+        
+        if(dataStore->getLocations().size()==0){
+            BOOST_THROW_EXCEPTION(LocException("Neither samples nor locations have been loaded"));
+        }
+        
+        
+        // set BLE beacon locations
+        BLEBeacons bleBeacons;
+        auto& beacons = getArray(json, "beacons");
+        for(int i = 0; i < beacons.size(); i++) {
+            auto& beacon = beacons.at(i).get<picojson::value::object>();
+            auto& data = getString(beacon, "data");
+            
+            std::istringstream is(data);
+            BLEBeacons bleBeaconsTmp = DataUtils::csvBLEBeaconsToBLEBeacons(is);
+            bleBeacons.insert(bleBeacons.end(), bleBeaconsTmp.begin(), bleBeaconsTmp.end());
+        }
+        dataStore->bleBeacons(bleBeacons);
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        LOC_LOG_INFO(LOCALIZER, "load beacon data: " << msec << "ms");
+        
+        if(doTraining || forceTraining){
+            LOC_LOG_INFO(LOCALIZER, "Training will be processed");
+            // Train observation model
+            std::shared_ptr<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>obsModelTrainer( new GaussianProcessLDPLMultiModelTrainer<State, Beacons>());
+            obsModelTrainer->setGPType(options.gpType);
+            obsModelTrainer->dataStore(dataStore);
+            std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel( obsModelTrainer->train());
+            //localizer->observationModel(obsModel);
+            
+            std::ostringstream oss;
+            obsModel->save(oss);
+            
+            json["ObservationModelParameters"] = (picojson::value)oss.str();
+            
+            std::ofstream of;
+            of.open(modelPath);
+            of << v.serialize();
+            of.close();
+        }        
+        site->mDataStore = dataStore;
+        site->mBuilding = std::make_shared<Building>(dataStore->getBuilding());
+        // The cells and the RSSI predicted at them take beacons x cells of memory, so they are built once for all the sessions.
+        if(params.localizeMode==GRID_POINT_MASS){
+            site->mGrid = GridPointMassFilter::Grid::build(site->mBuilding, *site->mParameters.gridParams, site->mObservationModel);
+        }
+        
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        LOC_LOG_INFO(LOCALIZER, "finish loading site: " << msec << "ms");
+        return site;
+    }
+    
+    const BasicLocalizerParameters& SiteContext::parameters() const{
+        return mParameters;
+    }
+    
+    BasicLocalizerParameters SiteContext::sessionParameters() const{
+        BasicLocalizerParameters params(mParameters);
+        copyParameterObjects(params);
+        return params;
+    }
+    
+    const Anchor& SiteContext::anchor() const{
+        return mAnchor;
+    }
+    
+    LatLngConverter::Ptr SiteContext::latLngConverter() const{
+        return mLatLngConverter;
+    }
+    
+    DataStoreImpl::Ptr SiteContext::dataStore() const{
+        return mDataStore;
+    }
+    
+    Building::Ptr SiteContext::building() const{
+        return mBuilding;
+    }
+    
+    SiteContext::ObservationModelPtr SiteContext::observationModel() const{
+        return mObservationModel;
+    }
+    
+    GridPointMassFilter::Grid::Ptr SiteContext::grid() const{
+        return mGrid;
+    }
+}
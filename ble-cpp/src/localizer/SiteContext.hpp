@@ -0,0 +1,67 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef SiteContext_hpp
+#define SiteContext_hpp
+
+#include <string>
+#include <memory>
+
+#include "BasicLocalizer.hpp"
+
+namespace loc{
+    
+    // Read-only data of a site (building, observation model, beacons, samples and parameters) loaded once from a model file.
+    // A site is shared by the localizers of all sessions in the site, so it must not be modified after loading.
+    class SiteContext{
+    public:
+        using Ptr = std::shared_ptr<const SiteContext>;
+        using ObservationModelPtr = std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>>;
+        
+        static Ptr load(const std::string& modelPath, const std::string& workingDir, const BasicLocalizerParameters& params, const BasicLocalizerOptions& options = BasicLocalizerOptions(), bool forceTraining = false);
+        
+        const BasicLocalizerParameters& parameters() const;
+        // A copy of parameters with its own parameter objects for a new session
+        BasicLocalizerParameters sessionParameters() const;
+        
+        const Anchor& anchor() const;
+        LatLngConverter::Ptr latLngConverter() const;
+        DataStoreImpl::Ptr dataStore() const;
+        Building::Ptr building() const;
+        ObservationModelPtr observationModel() const;
+        // The grid of GRID_POINT_MASS mode built with the parameters of the site. Null in the other modes.
+        GridPointMassFilter::Grid::Ptr grid() const;
+        
+    private:
+        SiteContext() = default;
+        
+        BasicLocalizerParameters mParameters;
+        Anchor mAnchor;
+        LatLngConverter::Ptr mLatLngConverter;
+        DataStoreImpl::Ptr mDataStore;
+        Building::Ptr mBuilding;
+        ObservationModelPtr mObservationModel;
+        GridPointMassFilter::Grid::Ptr mGrid;
+    };
+}
+
+#endif /* SiteContext_hpp */
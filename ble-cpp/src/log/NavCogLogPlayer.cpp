@@ -21,13 +21,14 @@
  *******************************************************************************/
 
 #include "NavCogLogPlayer.hpp"
+#include "Logger.hpp"
 
 namespace loc{
 
     void NavCogLogPlayer::run(){
         std::ifstream ifs(mFilePath);
         if(! ifs.is_open()){
-            std::cout << mFilePath << " is not open." << std::endl;
+            LOC_LOG_WARN(DATA, mFilePath << " is not open.");
         }
         std::string strBuffer;
         
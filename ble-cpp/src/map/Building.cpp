@@ -44,6 +44,8 @@ namespace loc{
         
         minFloor_ = *twin_data.first;
         maxFloor_ = *twin_data.second;
+        
+        mTransitionTable = TransitionTable::build(this->floors);
     }
     
     const FloorMap& Building::getFloorAt(int floor_num) const{
@@ -168,6 +170,10 @@ namespace loc{
         return maxFloor_;
     }
 
+    bool Building::hasFloor(int floor) const{
+        return floors.count(floor)==1;
+    }
+    
     bool Building::isValidFloor(int floor){
         if(minFloor()<=floor
            && floor<=maxFloor()){
@@ -188,6 +194,16 @@ namespace loc{
         return floorMap.estimateWallAngle(start, end);
     }
     
+    bool Building::usesTransitionTable = true;
+    
+    TransitionTable::Ptr Building::transitionTable() const{
+        return usesTransitionTable ? mTransitionTable : nullptr;
+    }
+    
+    void Building::setUsesTransitionTable(bool usesTable){
+        usesTransitionTable = usesTable;
+    }
+    
     /**
      Implementation of building builder
      **/
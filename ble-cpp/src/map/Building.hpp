@@ -27,6 +27,7 @@
 #include <map>
 #include "Location.hpp"
 #include "FloorMap.hpp"
+#include "TransitionTable.hpp"
 #ifdef ANDROID_STL_EXT
 #include "string_ext.hpp"
 #endif /* ANDROID_STL_EXT */
@@ -37,6 +38,8 @@ namespace loc {
         int minFloor_;
         int maxFloor_;
         std::map<int, FloorMap> floors;
+        TransitionTable::Ptr mTransitionTable;
+        static bool usesTransitionTable;
         
     public:
         using Ptr = std::shared_ptr<Building>;
@@ -66,8 +69,14 @@ namespace loc {
         int minFloor() const;
         int maxFloor() const;
         bool isValidFloor(int floor);
+        bool hasFloor(int floor) const;
         
         double estimateWallAngle(const Location& start, const Location &end) const;
+        
+        // Precomputed landing floors of vertical moves (null if unavailable for this building)
+        TransitionTable::Ptr transitionTable() const;
+        // Vertical moves fall back to the rejection loops if disabled
+        static void setUsesTransitionTable(bool usesTable);
     };
     
     class BuildingBuilder{
@@ -22,6 +22,8 @@
 
 #include "FloorMap.hpp"
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
 namespace loc{
 
@@ -38,16 +40,174 @@ namespace loc{
     using namespace color;
     
     const std::vector<Color> colorTransitionArea{colorStairs, colorElevator, colorEscalator};
+    
+    // Transition area pixels bucketed into square cells for exact nearest neighbor queries
+    class TransitionAreaIndex{
+        static const int cellSize = 16;
+        int gridRows_;
+        int gridCols_;
+        std::vector<size_t> cellStart_;
+        ImageHolder::Points points_;
+        
+    public:
+        TransitionAreaIndex(int rows, int cols, const ImageHolder::Points& points){
+            gridRows_ = (rows + cellSize - 1)/cellSize;
+            gridCols_ = (cols + cellSize - 1)/cellSize;
+            size_t nCells = static_cast<size_t>(gridRows_)*gridCols_;
+            std::vector<size_t> counts(nCells, 0);
+            ImageHolder::Points inside;
+            for(const auto& p: points){
+                if(0<=p.x && p.x<cols && 0<=p.y && p.y<rows){
+                    inside.push_back(p);
+                    counts[cellOf(p.y/cellSize, p.x/cellSize)]++;
+                }
+            }
+            cellStart_.assign(nCells+1, 0);
+            for(size_t i=0; i<nCells; i++){
+                cellStart_[i+1] = cellStart_[i] + counts[i];
+            }
+            points_.resize(inside.size());
+            std::vector<size_t> next(cellStart_.begin(), cellStart_.end()-1);
+            for(const auto& p: inside){
+                points_[next[cellOf(p.y/cellSize, p.x/cellSize)]++] = p;
+            }
+        }
+        
+        size_t cellOf(int cy, int cx) const{
+            return static_cast<size_t>(cy)*gridCols_ + cx;
+        }
+        
+        bool findClosest(const ImageHolder::Point& q, ImageHolder::Point& closest) const{
+            if(points_.size()==0){
+                return false;
+            }
+            int cx = q.x>=0 ? q.x/cellSize : -((cellSize-1-q.x)/cellSize);
+            int cy = q.y>=0 ? q.y/cellSize : -((cellSize-1-q.y)/cellSize);
+            int rMax = std::max(std::max(std::abs(cx), std::abs(cx-gridCols_)), std::max(std::abs(cy), std::abs(cy-gridRows_)));
+            double best = std::numeric_limits<double>::infinity();
+            for(int r=0; r<=rMax; r++){
+                // Cells in ring r are at least (r-1)*cellSize away from q.
+                double bound = static_cast<double>(r-1)*cellSize;
+                if(0<bound && bound*bound>=best){
+                    break;
+                }
+                for(int y=cy-r; y<=cy+r; y++){
+                    if(y<0 || gridRows_<=y){
+                        continue;
+                    }
+                    int step = (y==cy-r || y==cy+r) ? 1 : 2*r;
+                    for(int x=cx-r; x<=cx+r; x+=std::max(step, 1)){
+                        if(x<0 || gridCols_<=x){
+                            continue;
+                        }
+                        size_t c = cellOf(y, x);
+                        for(size_t i=cellStart_[c]; i<cellStart_[c+1]; i++){
+                            const auto& p = points_[i];
+                            double d = static_cast<double>(p.x-q.x)*(p.x-q.x) + static_cast<double>(p.y-q.y)*(p.y-q.y);
+                            if(d<best){
+                                best = d;
+                                closest = p;
+                            }
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+    };
         
     FloorMap::FloorMap(ImageHolder image, CoordinateSystem coordSys){
         mImage = image;
         mCoordSys = coordSys;
+        setUpMasks();
         
         //for(const Color&c : colorTransitionArea){
         //    mImage.setUpIndexForColor(c);
         //}
     }
 
+    void FloorMap::setUpMasks(){
+        int rows = mImage.rows();
+        int cols = mImage.cols();
+        ImageHolder::Points walls = mImage.getPoints(color::colorWall);
+        ImageHolder::Points escalators = mImage.getPoints(color::colorEscalator);
+        mWalls = std::make_shared<const OccupancyBitmask>(rows, cols, walls);
+        mEscalators = std::make_shared<const OccupancyBitmask>(rows, cols, escalators);
+        mEscalatorEnds = std::make_shared<const OccupancyBitmask>(rows, cols, mImage.getPoints(color::colorEscalatorEnd));
+        escalators.insert(escalators.end(), walls.begin(), walls.end());
+        mWallsAndEscalators = std::make_shared<const OccupancyBitmask>(rows, cols, escalators);
+        ImageHolder::Points transitions;
+        for(const Color& c: colorTransitionArea){
+            auto points = mImage.getPoints(c);
+            transitions.insert(transitions.end(), points.begin(), points.end());
+        }
+        mTransitionIndex = std::make_shared<const TransitionAreaIndex>(rows, cols, transitions);
+        setUpDistanceFields();
+    }
+    
+    void FloorMap::setUpDistanceFields(){
+        int rows = mImage.rows();
+        int cols = mImage.cols();
+        if(rows<=0 || cols<=0){
+            mClearance.reset();
+            mWallTangent.reset();
+            return;
+        }
+        std::vector<double> grid = mWalls->distanceTransform();
+        auto clearance = std::make_shared<std::vector<uint8_t>>(grid.size());
+        for(size_t i=0; i<grid.size(); i++){
+            (*clearance)[i] = static_cast<uint8_t>(std::min(std::floor(grid[i]), 255.0));
+        }
+        mClearance = clearance;
+        
+        // Wall tangents from the Sobel gradient of the distance to the nearest wall.
+        auto tangent = std::make_shared<std::vector<uint8_t>>(grid.size(), noWallTangent);
+        auto distAt = [&](int y, int x){
+            y = std::min(std::max(y, 0), rows-1);
+            x = std::min(std::max(x, 0), cols-1);
+            return std::min(grid[static_cast<size_t>(y)*cols + x], static_cast<double>(wallTangentRadius+2));
+        };
+        for(int y=0; y<rows; y++){
+            for(int x=0; x<cols; x++){
+                double dist = grid[static_cast<size_t>(y)*cols + x];
+                if(dist==0 || wallTangentRadius<dist){
+                    continue;
+                }
+                double gx = (distAt(y-1,x+1) + 2*distAt(y,x+1) + distAt(y+1,x+1)) - (distAt(y-1,x-1) + 2*distAt(y,x-1) + distAt(y+1,x-1));
+                double gy = (distAt(y+1,x-1) + 2*distAt(y+1,x) + distAt(y+1,x+1)) - (distAt(y-1,x-1) + 2*distAt(y-1,x) + distAt(y-1,x+1));
+                if(gx*gx + gy*gy < 1e-6){
+                    continue;
+                }
+                double theta = std::atan2(gy, gx) + M_PI/2;
+                theta = std::fmod(theta + 2*M_PI, M_PI);
+                int bin = static_cast<int>(std::round(theta/M_PI*wallTangentBins)) % wallTangentBins;
+                (*tangent)[static_cast<size_t>(y)*cols + x] = static_cast<uint8_t>(bin);
+            }
+        }
+        mWallTangent = tangent;
+    }
+    
+    // A sampled pixel of a ray of the given length starting at (x0, y0) lies within
+    // length + sqrt(2) of the start pixel because of rounding at both ends, so the ray
+    // cannot hit a wall when the clearance at the start pixel exceeds that.
+    bool FloorMap::isClearOfWalls(double x0, double y0, double length) const{
+        if(!mClearance){
+            return false;
+        }
+        int x = doubleToImageCoordinate(x0);
+        int y = doubleToImageCoordinate(y0);
+        if(!mImage.checkValid(y, x)){
+            return false;
+        }
+        double clearance = (*mClearance)[static_cast<size_t>(y)*mImage.cols() + x];
+        return length + 1.5 < clearance;
+    }
+    
+    bool FloorMap::testMask(const OccupancyBitmask& mask, const Location& location) const{
+        Location localCoord = mCoordSys.worldToLocalState(location);
+        return mask.test(getY(localCoord), getX(localCoord));
+    }
+    
     Color FloorMap::getColor(const Location& location) const{
         if(isInsideFloor(location)){
             Location localCoord = mCoordSys.worldToLocalState(location);
@@ -120,7 +280,7 @@ namespace loc{
     }
 
     bool FloorMap::isWall(const Location& location) const{
-        return checkColor(location, color::colorWall);
+        return testMask(*mWalls, location);
     }
 
     bool FloorMap::isStairs(const Location& location) const {
@@ -132,11 +292,11 @@ namespace loc{
     }
 
     bool FloorMap::isEscalator(const Location& location) const{
-        return checkColor(location, color::colorEscalator);
+        return testMask(*mEscalators, location);
     }
     
     bool FloorMap::isEscalatorEnd(const Location& location) const{
-        return checkColor(location, color::colorEscalatorEnd);
+        return testMask(*mEscalatorEnds, location);
     }
 
     double FloorMap::wallCrossingRatio(const Location& start, const Location& end) const{
@@ -150,37 +310,17 @@ namespace loc{
 
         double norm = sqrt(pow(x1-x0,2)+pow(y1-y0,2));
 
+        if(isClearOfWalls(x0, y0, norm) && !isEscalatorEnd(start)){
+            return 1.0;
+        }
+
         int norm_int = static_cast<int>(norm) + 1;
 
         double dx = (x1-x0)/norm_int;
         double dy = (y1-y0)/norm_int;
 
-        double x = x0;
-        double y = y0;
-        
-        bool startIsEscEnd = isEscalatorEnd(start);
-
-        int count=0;
-        while(count<=norm_int){
-            int yInt = doubleToImageCoordinate(y);
-            int xInt = doubleToImageCoordinate(x);
-            Color c = color::colorFloor;
-            bool pixelIsValid = mImage.checkValid(yInt, xInt);
-            if(pixelIsValid){
-                c = mImage.get(yInt, xInt);
-            }else{
-                c = color::colorFloor;
-            }
-            if(c.equals(color::colorWall)){
-                return ((double)count-1)/norm_int;
-            }
-            if(startIsEscEnd && c.equals(color::colorEscalator)){
-                return ((double)count-1)/norm_int;
-            }
-            x+=dx;
-            y+=dy;
-            count++;
-        }
+        const OccupancyBitmask& mask = isEscalatorEnd(start) ? *mWallsAndEscalators : *mWalls;
+        int count = mask.castRay(x0, y0, dx, dy, norm_int);
         return ((double)count-1)/norm_int;
     }
 
@@ -189,7 +329,62 @@ namespace loc{
         return ratio < 1.0;
     }
     
+    const int FloorMap::wallTangentBins;
+    const uint8_t FloorMap::noWallTangent;
+    const int FloorMap::wallTangentRadius;
+    bool FloorMap::usesWallTangentField = true;
+    
+    void FloorMap::setUsesWallTangentField(bool usesField){
+        usesWallTangentField = usesField;
+    }
+    
     double FloorMap::estimateWallAngle(const Location &start, const Location& end) const{
+        if(usesWallTangentField){
+            double angle = lookUpWallAngle(start, end);
+            if(!std::isnan(angle)){
+                return angle;
+            }
+        }
+        return sweepWallAngle(start, end);
+    }
+    
+    double FloorMap::lookUpWallAngle(const Location &start, const Location& end) const{
+        if(!mWallTangent){
+            return std::numeric_limits<float>::quiet_NaN();
+        }
+        double r = wallCrossingRatio(start, end);
+        double dx = end.x() - start.x();
+        double dy = end.y() - start.y();
+        Location nearWall(start);
+        nearWall.x(start.x() + dx * r);
+        nearWall.y(start.y() + dy * r);
+        Location local = mCoordSys.worldToLocalState(nearWall);
+        int x = getX(local);
+        int y = getY(local);
+        if(!mImage.checkValid(y, x)){
+            return std::numeric_limits<float>::quiet_NaN();
+        }
+        uint8_t bin = (*mWallTangent)[static_cast<size_t>(y)*mImage.cols() + x];
+        if(bin==noWallTangent){
+            return std::numeric_limits<float>::quiet_NaN();
+        }
+        // Map the tangent from image to world coordinates and orient it along the motion.
+        double theta = bin*M_PI/wallTangentBins;
+        Location tip(local);
+        tip.x(local.x() + std::cos(theta));
+        tip.y(local.y() + std::sin(theta));
+        Location tipWorld = mCoordSys.localToWorldState(tip);
+        Location baseWorld = mCoordSys.localToWorldState(local);
+        double tx = tipWorld.x() - baseWorld.x();
+        double ty = tipWorld.y() - baseWorld.y();
+        if(tx*dx + ty*dy < 0){
+            tx = -tx;
+            ty = -ty;
+        }
+        return std::atan2(ty, tx);
+    }
+    
+    double FloorMap::sweepWallAngle(const Location &start, const Location& end) const{
         
         double r = wallCrossingRatio(start, end);
         double dx = end.x() - start.x();
@@ -229,6 +424,18 @@ namespace loc{
         return mCoordSys;
     }
     
+    Location FloorMap::lowerBound() const{
+        Location p0 = mCoordSys.localToWorldState(Location(-0.5, -0.5, 0, 0));
+        Location p1 = mCoordSys.localToWorldState(Location(mImage.cols()-0.5, mImage.rows()-0.5, 0, 0));
+        return Location(std::min(p0.x(), p1.x()), std::min(p0.y(), p1.y()), 0, 0);
+    }
+    
+    Location FloorMap::upperBound() const{
+        Location p0 = mCoordSys.localToWorldState(Location(-0.5, -0.5, 0, 0));
+        Location p1 = mCoordSys.localToWorldState(Location(mImage.cols()-0.5, mImage.rows()-0.5, 0, 0));
+        return Location(std::max(p0.x(), p1.x()), std::max(p0.y(), p1.y()), 0, 0);
+    }
+    
     bool FloorMap::isTransitionArea(const Location& location) const{
         if(isEscalator(location) || isElevator(location) || isStairs(location)){
             return true;
@@ -242,20 +449,8 @@ namespace loc{
         ImageHolder::Point pIm = getPoint(location);
         ImageHolder::Point pClosest;
         
-        double dmin = std::numeric_limits<double>::max();
-        for(auto& c: colorTransitionArea){
-            auto psRet = mImage.findClosestPoints(c, pIm);
-            if(psRet.size()==0) continue;
-        
-            auto pRet = psRet.at(0);
-            double dist = ImageHolder::Point::distance(pIm, pRet);
-            if(dist < dmin){
-                dmin = dist;
-                pClosest = pRet;
-            }
-        }
         std::vector<Location> locsRet;
-        if(std::numeric_limits<double>::max()<=dmin){
+        if(!mTransitionIndex || !mTransitionIndex->findClosest(pIm, pClosest)){
             return locsRet;
         }
         
@@ -266,4 +461,16 @@ namespace loc{
         locsRet.push_back(locRet);
         return locsRet;
     }
+    
+    ImageHolder::Points FloorMap::transitionAreaPoints(TransitionType type) const{
+        switch(type){
+            case ELEVATOR_TRANSITION:
+                return mImage.getPoints(color::colorElevator);
+            case STAIR_TRANSITION:
+                return mImage.getPoints(color::colorStairs);
+            case ESCALATOR_TRANSITION:
+                return mImage.getPoints(color::colorEscalator);
+        }
+        BOOST_THROW_EXCEPTION(LocException("Unknown TransitionType."));
+    }
 }
@@ -24,16 +24,41 @@
 #define FloorMap_hpp
 
 #include <stdio.h>
+#include <memory>
+#include <vector>
 
 #include "CoordinateSystem.hpp"
 #include "ImageHolder.hpp"
+#include "OccupancyBitmask.hpp"
 #include "State.hpp"
 
 namespace loc{
+    typedef enum {
+        ELEVATOR_TRANSITION = 0,
+        STAIR_TRANSITION = 1,
+        ESCALATOR_TRANSITION = 2
+    } TransitionType;
+    
+    class TransitionAreaIndex;
+    
     class FloorMap{
+        static const int wallTangentBins = 254;
+        static const uint8_t noWallTangent = 255;
+        static const int wallTangentRadius = 10;
+        static bool usesWallTangentField;
+        
     protected:
         CoordinateSystem mCoordSys;
         ImageHolder mImage;
+        // Distance in pixels (floored, capped at 255) from each pixel to the nearest wall pixel.
+        std::shared_ptr<const std::vector<uint8_t>> mClearance;
+        // Wall tangent orientation modulo pi quantized to wallTangentBins, or noWallTangent.
+        std::shared_ptr<const std::vector<uint8_t>> mWallTangent;
+        std::shared_ptr<const OccupancyBitmask> mWalls = std::make_shared<const OccupancyBitmask>();
+        std::shared_ptr<const OccupancyBitmask> mWallsAndEscalators = std::make_shared<const OccupancyBitmask>();
+        std::shared_ptr<const OccupancyBitmask> mEscalators = std::make_shared<const OccupancyBitmask>();
+        std::shared_ptr<const OccupancyBitmask> mEscalatorEnds = std::make_shared<const OccupancyBitmask>();
+        std::shared_ptr<const TransitionAreaIndex> mTransitionIndex;
 
         Color getColor(const Location& location) const;
         bool checkColor(const Location& location, const Color& color) const;
@@ -41,6 +66,10 @@ namespace loc{
         int getY(const Location& location) const;
         ImageHolder::Point getPoint(const Location& location) const;
         int doubleToImageCoordinate(double x) const;
+        void setUpMasks();
+        void setUpDistanceFields();
+        bool testMask(const OccupancyBitmask& mask, const Location& location) const;
+        bool isClearOfWalls(double x0, double y0, double length) const;
 
     public:
         FloorMap() = default;
@@ -62,11 +91,20 @@ namespace loc{
         bool checkCrossingWall(const Location& start, const Location& end) const;
 
         double estimateWallAngle(const Location&start, const Location& end) const;
+        // Wall angle from the precomputed tangent field (NaN if unavailable at the hit point)
+        double lookUpWallAngle(const Location&start, const Location& end) const;
+        // Wall angle by sweeping rays around the hit point
+        double sweepWallAngle(const Location&start, const Location& end) const;
+        static void setUsesWallTangentField(bool usesField);
         
         const CoordinateSystem& coordinateSystem() const;
+        // world coordinates of the corners of the floor image
+        Location lowerBound() const;
+        Location upperBound() const;
         
         bool isTransitionArea(const Location& location) const;
         std::vector<Location> findClosestTransitionAreaLocations(const Location& location) const;
+        ImageHolder::Points transitionAreaPoints(TransitionType type) const;
         
     protected:
         bool isInsideFloor(const Location& location) const;
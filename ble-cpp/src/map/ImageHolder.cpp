@@ -24,6 +24,7 @@
 #include <boost/bimap.hpp>
 #include "ImageHolder.hpp"
 #include "LocException.hpp"
+#include "Logger.hpp"
 #include <opencv2/flann/flann.hpp>
 #include <opencv2/opencv.hpp>
 
@@ -382,10 +383,10 @@ namespace loc{
     
     ImageHolder::ImageHolder(const std::string& filepath, const std::string& name){
         if(mode_ == light){
-            std::cout << "ImageHolder::ImplLight is instantiated." << std::endl;
+            LOC_LOG_DEBUG(MAP, "ImageHolder::ImplLight is instantiated.");
             impl.reset(new ImplLight(filepath, name));
         }else if (mode_ == heavy){
-            std::cout << "ImageHolder::ImplHeavy is instantiated." << std::endl;
+            LOC_LOG_DEBUG(MAP, "ImageHolder::ImplHeavy is instantiated.");
             impl.reset(new ImplHeavy(filepath, name));
         }else{
             BOOST_THROW_EXCEPTION(LocException("Unknown ImageHolderMode."));
@@ -0,0 +1,212 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "OccupancyBitmask.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace loc{
+    
+    static inline int tileBit(int y, int x){
+        return ((y & 7) << 3) | (x & 7);
+    }
+    
+    static inline int roundToPixel(double x){
+        return static_cast<int>(std::round(x));
+    }
+    
+    OccupancyBitmask::OccupancyBitmask(int rows, int cols, const ImageHolder::Points& points){
+        rows_ = rows;
+        cols_ = cols;
+        int levelRows = (rows + 7) >> 3;
+        int levelCols = (cols + 7) >> 3;
+        levelCols_.push_back(levelCols);
+        levels_.push_back(std::vector<uint64_t>(static_cast<size_t>(levelRows)*levelCols, 0));
+        for(const auto& p: points){
+            if(0<=p.y && p.y<rows && 0<=p.x && p.x<cols){
+                levels_[0][static_cast<size_t>(p.y>>3)*levelCols + (p.x>>3)] |= uint64_t(1) << tileBit(p.y, p.x);
+            }
+        }
+        while(1<levelRows || 1<levelCols){
+            int childRows = levelRows;
+            int childCols = levelCols;
+            levelRows = (levelRows + 7) >> 3;
+            levelCols = (levelCols + 7) >> 3;
+            std::vector<uint64_t> level(static_cast<size_t>(levelRows)*levelCols, 0);
+            const std::vector<uint64_t>& child = levels_.back();
+            for(int r=0; r<childRows; r++){
+                for(int c=0; c<childCols; c++){
+                    if(child[static_cast<size_t>(r)*childCols + c] != 0){
+                        level[static_cast<size_t>(r>>3)*levelCols + (c>>3)] |= uint64_t(1) << tileBit(r, c);
+                    }
+                }
+            }
+            levelCols_.push_back(levelCols);
+            levels_.push_back(std::move(level));
+        }
+    }
+    
+    int OccupancyBitmask::rows() const{
+        return rows_;
+    }
+    
+    int OccupancyBitmask::cols() const{
+        return cols_;
+    }
+    
+    bool OccupancyBitmask::empty() const{
+        return levels_.size()==0;
+    }
+    
+    bool OccupancyBitmask::test(int y, int x) const{
+        if(y<0 || rows_<=y || x<0 || cols_<=x){
+            return false;
+        }
+        uint64_t word = levels_[0][static_cast<size_t>(y>>3)*levelCols_[0] + (x>>3)];
+        return (word >> tileBit(y, x)) & 1;
+    }
+    
+    int OccupancyBitmask::emptyBlockShift(int y, int x) const{
+        uint64_t word = levels_[0][static_cast<size_t>(y>>3)*levelCols_[0] + (x>>3)];
+        if(word != 0){
+            return ((word >> tileBit(y, x)) & 1) ? -1 : 0;
+        }
+        int shift = 3;
+        for(size_t l=1; l<levels_.size(); l++){
+            int s = shift + 3;
+            if(levels_[l][static_cast<size_t>(y>>s)*levelCols_[l] + (x>>s)] != 0){
+                break;
+            }
+            shift = s;
+        }
+        return shift;
+    }
+    
+    int OccupancyBitmask::castRay(double x0, double y0, double dx, double dy, int n) const{
+        double x = x0;
+        double y = y0;
+        int count = 0;
+        while(count<=n){
+            int xInt = roundToPixel(x);
+            int yInt = roundToPixel(y);
+            if(0<=yInt && yInt<rows_ && 0<=xInt && xInt<cols_){
+                int shift = emptyBlockShift(yInt, xInt);
+                if(shift<0){
+                    return count;
+                }
+                if(0<shift){
+                    // Samples are advanced exactly as in the pixel walk but not tested
+                    // while they stay in the empty block.
+                    int bx = xInt >> shift;
+                    int by = yInt >> shift;
+                    do{
+                        x+=dx;
+                        y+=dy;
+                        count++;
+                    }while(count<=n && (roundToPixel(x) >> shift)==bx && (roundToPixel(y) >> shift)==by);
+                    continue;
+                }
+            }
+            x+=dx;
+            y+=dy;
+            count++;
+        }
+        return count;
+    }
+    
+    // One-dimensional squared Euclidean distance transform (Felzenszwalb and Huttenlocher).
+    static void distanceTransform1D(const std::vector<double>& f, std::vector<double>& d, std::vector<int>& v, std::vector<double>& z){
+        int n = static_cast<int>(f.size());
+        const double inf = std::numeric_limits<double>::infinity();
+        int k = 0;
+        v[0] = 0;
+        z[0] = -inf;
+        z[1] = inf;
+        for(int q=1; q<n; q++){
+            if(f[q]==inf){
+                continue;
+            }
+            while(true){
+                int r = v[k];
+                double s = f[r]==inf ? -inf : ((f[q]+static_cast<double>(q)*q)-(f[r]+static_cast<double>(r)*r))/(2.0*(q-r));
+                if(s<=z[k] && 0<k){
+                    k--;
+                }else if(s<=z[k]){
+                    v[0] = q;
+                    z[0] = -inf;
+                    z[1] = inf;
+                    break;
+                }else{
+                    k++;
+                    v[k] = q;
+                    z[k] = s;
+                    z[k+1] = inf;
+                    break;
+                }
+            }
+        }
+        k = 0;
+        for(int q=0; q<n; q++){
+            while(z[k+1]<q){
+                k++;
+            }
+            int r = v[k];
+            d[q] = f[r]==inf ? inf : static_cast<double>(q-r)*(q-r) + f[r];
+        }
+    }
+    
+    std::vector<double> OccupancyBitmask::distanceTransform() const{
+        const double inf = std::numeric_limits<double>::infinity();
+        std::vector<double> grid(static_cast<size_t>(rows_)*cols_, inf);
+        for(int y=0; y<rows_; y++){
+            for(int x=0; x<cols_; x++){
+                if(test(y, x)){
+                    grid[static_cast<size_t>(y)*cols_ + x] = 0;
+                }
+            }
+        }
+        int n = std::max(rows_, cols_);
+        std::vector<double> f(n), d(n), z(n+1);
+        std::vector<int> v(n);
+        f.resize(rows_); d.resize(rows_);
+        for(int x=0; x<cols_; x++){
+            for(int y=0; y<rows_; y++){
+                f[y] = grid[static_cast<size_t>(y)*cols_ + x];
+            }
+            distanceTransform1D(f, d, v, z);
+            for(int y=0; y<rows_; y++){
+                grid[static_cast<size_t>(y)*cols_ + x] = d[y];
+            }
+        }
+        f.resize(cols_); d.resize(cols_);
+        for(int y=0; y<rows_; y++){
+            size_t offset = static_cast<size_t>(y)*cols_;
+            std::copy(grid.begin()+offset, grid.begin()+offset+cols_, f.begin());
+            distanceTransform1D(f, d, v, z);
+            for(int x=0; x<cols_; x++){
+                grid[offset+x] = std::sqrt(d[x]);
+            }
+        }
+        return grid;
+    }
+}
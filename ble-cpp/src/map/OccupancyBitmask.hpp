@@ -0,0 +1,67 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef OccupancyBitmask_hpp
+#define OccupancyBitmask_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+
+#include "ImageHolder.hpp"
+
+namespace loc{
+    
+    // 1-bit raster of the pixels of one color. Pixels are packed in 8x8 tiles so that
+    // a 64-bit word holds one tile, and each coarser level keeps one bit per non-empty
+    // word of the level below (blocks of 64x64, 512x512, ... pixels).
+    class OccupancyBitmask{
+        int rows_ = 0;
+        int cols_ = 0;
+        std::vector<int> levelCols_;
+        std::vector<std::vector<uint64_t>> levels_;
+        
+    public:
+        OccupancyBitmask() = default;
+        ~OccupancyBitmask() = default;
+        OccupancyBitmask(int rows, int cols, const ImageHolder::Points& points);
+        
+        int rows() const;
+        int cols() const;
+        bool empty() const;
+        
+        bool test(int y, int x) const;
+        // Returns -1 if pixel (y, x) is set, otherwise log2 of the side of the largest
+        // aligned block around it that contains no set pixel.
+        int emptyBlockShift(int y, int x) const;
+        
+        // Walks the same samples as FloorMap::wallCrossingRatio (local pixel coordinates)
+        // and returns the index of the first sample that hits a set pixel, or n+1.
+        int castRay(double x0, double y0, double dx, double dy, int n) const;
+        
+        // Euclidean distance in pixels from each pixel (row major) to the nearest set pixel, or infinity
+        // if no pixel is set. Squared distances stay exact in double also for images over 4096 pixels.
+        std::vector<double> distanceTransform() const;
+    };
+}
+
+#endif /* OccupancyBitmask_hpp */
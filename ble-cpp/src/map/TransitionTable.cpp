@@ -0,0 +1,122 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "TransitionTable.hpp"
+#include <bitset>
+#include <cmath>
+
+namespace loc{
+    
+    static bool sameProjection(const CoordinateSystemParameters& a, const CoordinateSystemParameters& b){
+        return a.punit_x==b.punit_x && a.punit_y==b.punit_y && a.x_origin==b.x_origin && a.y_origin==b.y_origin;
+    }
+    
+    TransitionTable::Ptr TransitionTable::build(const std::map<int, FloorMap>& floors){
+        if(floors.size()==0){
+            return nullptr;
+        }
+        int minFloor = floors.begin()->first;
+        int maxFloor = floors.rbegin()->first;
+        if(maxFloors <= maxFloor - minFloor){
+            return nullptr;
+        }
+        const CoordinateSystem& coordSys = floors.begin()->second.coordinateSystem();
+        long stride = 0;
+        for(const auto& pair: floors){
+            if(!sameProjection(coordSys.parameters(), pair.second.coordinateSystem().parameters())){
+                return nullptr;
+            }
+            for(int t=ELEVATOR_TRANSITION; t<=ESCALATOR_TRANSITION; t++){
+                for(const auto& p: pair.second.transitionAreaPoints(static_cast<TransitionType>(t))){
+                    stride = std::max(stride, static_cast<long>(p.x)+1);
+                }
+            }
+        }
+        
+        std::shared_ptr<TransitionTable> table(new TransitionTable);
+        table->minFloor_ = minFloor;
+        table->maxFloor_ = maxFloor;
+        table->stride_ = stride;
+        table->coordSys_ = coordSys;
+        for(const auto& pair: floors){
+            uint64_t bit = table->floorBit(pair.first);
+            for(int t=ELEVATOR_TRANSITION; t<=ESCALATOR_TRANSITION; t++){
+                auto& masks = table->masks_[t];
+                for(const auto& p: pair.second.transitionAreaPoints(static_cast<TransitionType>(t))){
+                    masks[static_cast<long>(p.y)*stride + p.x] |= bit;
+                }
+            }
+        }
+        return table;
+    }
+    
+    long TransitionTable::keyOf(const Location& location) const{
+        Location local = coordSys_.worldToLocalState(location);
+        long x = static_cast<int>(std::round(local.x()));
+        long y = static_cast<int>(std::round(local.y()));
+        if(x<0 || stride_<=x || y<0){
+            return -1;
+        }
+        return y*stride_ + x;
+    }
+    
+    int TransitionTable::minFloor() const{
+        return minFloor_;
+    }
+    
+    int TransitionTable::maxFloor() const{
+        return maxFloor_;
+    }
+    
+    uint64_t TransitionTable::floorMask(TransitionType type, const Location& location) const{
+        long key = keyOf(location);
+        if(key<0){
+            return 0;
+        }
+        const auto& masks = masks_[type];
+        auto iter = masks.find(key);
+        return iter==masks.end() ? 0 : iter->second;
+    }
+    
+    uint64_t TransitionTable::floorBit(int floor) const{
+        if(floor<minFloor_ || maxFloor_<floor){
+            return 0;
+        }
+        return uint64_t(1) << (floor - minFloor_);
+    }
+    
+    int TransitionTable::countFloors(uint64_t mask){
+        return static_cast<int>(std::bitset<64>(mask).count());
+    }
+    
+    int TransitionTable::nthFloor(uint64_t mask, int n) const{
+        for(int i=0; i<maxFloors; i++){
+            if((mask >> i) & 1){
+                if(n==0){
+                    return minFloor_ + i;
+                }
+                n--;
+            }
+        }
+        BOOST_THROW_EXCEPTION(LocException("n is larger than the number of floors in the mask."));
+    }
+}
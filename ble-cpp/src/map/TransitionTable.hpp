@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef TransitionTable_hpp
+#define TransitionTable_hpp
+
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+#include "FloorMap.hpp"
+
+namespace loc{
+    
+    // Floors that a vertical move can land on from each pixel of the transition areas.
+    // A vertical move keeps x and y, so the table is only built when all floors share the
+    // same coordinate system and a pixel lands on the same pixel of the other floors.
+    class TransitionTable{
+        static const int maxFloors = 64;
+        
+        int minFloor_;
+        int maxFloor_;
+        long stride_;
+        CoordinateSystem coordSys_;
+        std::unordered_map<long, uint64_t> masks_[3];
+        
+        long keyOf(const Location& location) const;
+        
+    public:
+        using Ptr = std::shared_ptr<const TransitionTable>;
+        
+        // Returns null when the floors do not share a coordinate system or there are too many floors.
+        static Ptr build(const std::map<int, FloorMap>& floors);
+        
+        int minFloor() const;
+        int maxFloor() const;
+        
+        // Bit (floor - minFloor()) is set for every floor whose pixel at the location is of the given type.
+        uint64_t floorMask(TransitionType type, const Location& location) const;
+        uint64_t floorBit(int floor) const;
+        static int countFloors(uint64_t mask);
+        // Floor of the n-th (0-based) set bit of the mask
+        int nthFloor(uint64_t mask, int n) const;
+    };
+}
+
+#endif /* TransitionTable_hpp */
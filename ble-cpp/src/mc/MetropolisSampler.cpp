@@ -21,6 +21,7 @@
 *******************************************************************************/
 
 #include "MetropolisSampler.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -56,7 +57,7 @@ namespace loc{
         }
         locations = Location::filterLocationsOnFlatFloor(locations); // Remove locations with an unusual z value.
         if(locations.size()==0){
-            std::cerr << "All locations were removed at filtering step in sampler.　Not filtered locations are used." << std::endl;
+            LOC_LOG_WARN(SAMPLER, "All locations were removed at filtering step in sampler.　Not filtered locations are used.");
             if (mParams.initType == INIT_WITH_SAMPLE_LOCATIONS) {
                 locations = mStatusInitializer->extractLocationsCloseToBeacons(mInput, mParams.radius2D);
             } else if (mParams.initType == INIT_WITH_BEACON_LOCATIONS){
@@ -71,7 +72,7 @@ namespace loc{
         Tstate locMaxLL = states.at(index);
         
         if(isVerbose){
-            std::cout << "findInitialMaxLikelihoodState: states.size=" << states.size() << "max state=" << locMaxLL << std::endl;
+            LOC_LOG_DEBUG(SAMPLER, "findInitialMaxLikelihoodState: states.size=" << states.size() << "max state=" << locMaxLL);
         }
         
         return locMaxLL;
@@ -162,7 +163,7 @@ namespace loc{
             }
         }
         
-        std::cout << "M-H acceptance rate = " << (double)countAccepted / (double) count << " (" << countAccepted << "/" << count << ")" << std::endl;
+        LOC_LOG_DEBUG(SAMPLER, "M-H acceptance rate = " << (double)countAccepted / (double) count << " (" << countAccepted << "/" << count << ")");
         
         return sampledStates;
         */
@@ -196,7 +197,7 @@ namespace loc{
         }
         
         if(isVerbose){
-            std::cout << "M-H acceptance rate = " << (double)countAccepted / (double) count << " (" << countAccepted << "/" << count << ")" << std::endl;
+            LOC_LOG_DEBUG(SAMPLER, "M-H acceptance rate = " << (double)countAccepted / (double) count << " (" << countAccepted << "/" << count << ")");
         }
         
         if(! withOrderging){
@@ -258,7 +259,7 @@ namespace loc{
             }
         }
         
-        std::cout << "M-H acceptance rate = " << (double)countAccepted / (double) count << " (" << countAccepted << "/" << count << ")" << std::endl;
+        LOC_LOG_DEBUG(SAMPLER, "M-H acceptance rate = " << (double)countAccepted / (double) count << " (" << countAccepted << "/" << count << ")");
         
         return sampledStates;
     }
@@ -293,9 +294,19 @@ namespace loc{
     template <class Tstate, class Tinput>
     void MetropolisSampler<Tstate, Tinput>::print() const{
         double averageLogLL = std::accumulate(allLogLLs.begin(), allLogLLs.end(), 0.0)/(allLogLLs.size());
-        std::cout << "allStates.size()=" << allStates.size()
+        LOC_LOG_INFO(SAMPLER, "allStates.size()=" << allStates.size()
                 << ",allLogLLs.size()=" << allLogLLs.size()
-                << ",averageLogLL=" << averageLogLL << std::endl;
+                << ",averageLogLL=" << averageLogLL);
+    }
+    
+    template <class Tstate, class Tinput>
+    void MetropolisSampler<Tstate, Tinput>::saveState(SnapshotOutputArchive& ar) const{
+        ar(CEREAL_NVP(randGen));
+    }
+    
+    template <class Tstate, class Tinput>
+    void MetropolisSampler<Tstate, Tinput>::loadState(SnapshotInputArchive& ar){
+        ar(CEREAL_NVP(randGen));
     }
     
     // explicit instantiation
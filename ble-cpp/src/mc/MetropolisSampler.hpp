@@ -41,7 +41,7 @@ namespace loc{
     // This class generates samples following p(state|observation) by using the Metropolis algorithm.
     // When withOrdering is set to true, sampling(int n) function returns n largest log-likelihood states from the all generated samples. When withOrdering is false, the latest n samples with the defined interval are returned.
     template<class Tstate, class Tinput>
-    class MetropolisSampler : public ObservationDependentInitializer<Tstate, Tinput>{
+    class MetropolisSampler : public ObservationDependentInitializer<Tstate, Tinput>, public Snapshottable{
     public:
         class Parameters{
         public:
@@ -101,6 +101,8 @@ namespace loc{
         
         void print() const;
         
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
     };
     
     
@@ -23,6 +23,7 @@
 #include "GaussianProcess.hpp"
 #include "ArrayUtils.hpp"
 #include "SerializeUtils.hpp"
+#include "Logger.hpp"
 
 namespace loc{
 
@@ -155,6 +156,25 @@ namespace loc{
         return kstar;
     }
     
+    Eigen::MatrixXd GaussianProcess::computeKstarMatrix(const Eigen::MatrixXd& Xstar) const{
+        using RowMajorMatrixXd = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+        size_t n = X_.rows();
+        size_t m = Xstar.rows();
+        
+        // row-major copies to pass each point to the kernel function as a contiguous array
+        const RowMajorMatrixXd Xr = X_;
+        const RowMajorMatrixXd Xs = Xstar;
+        
+        Eigen::MatrixXd Kstar(m, n);
+        for(int j=0; j<n; j++){
+            const double* x_j = Xr.row(j).data();
+            for(int i=0; i<m; i++){
+                Kstar(i,j) = mGaussianKernel.computeKernel(Xs.row(i).data(), x_j);
+            }
+        }
+        return Kstar;
+    }
+    
     Eigen::VectorXd GaussianProcess::predict(double x[]) const{
         Eigen::VectorXd kstar = computeKstar(x);
         return predict(kstar);
@@ -187,6 +207,15 @@ namespace loc{
         return ypreds;
     }
     
+    Eigen::MatrixXd GaussianProcess::predictBatch(const Eigen::MatrixXd& Xstar, const std::vector<int>& indices) const{
+        size_t m = indices.size();
+        Eigen::MatrixXd W(Weights_.rows(), m);
+        for(int i=0; i<m; i++){
+            W.col(i) = Weights_.col(indices.at(i));
+        }
+        return computeKstarMatrix(Xstar)*W;
+    }
+    
     Eigen::VectorXd GaussianProcess::predictVarianceF(double x[]) const{
         Eigen::VectorXd kstar = computeKstar(x);
         return predictVarianceF(kstar);
@@ -333,12 +362,11 @@ namespace loc{
             this->fit(X,Y,Actives);
             
             double looMSE = this->leaveOneOutMSE();
-            std::cout << "LOOMSE=" << looMSE;
-            std::cout << ", (kernel parameters=" << gkParams.toString() << "," << sigma_n << std::endl;
+            LOC_LOG_DEBUG(MODEL, "LOOMSE=" << looMSE << ", (kernel parameters=" << gkParams.toString() << "," << sigma_n);
             if(looMSE < minValue){
                 minValue = looMSE;
                 indexMinError = i;
-                std::cout << "Min LOOMSE updated." << std::endl;
+                LOC_LOG_DEBUG(MODEL, "Min LOOMSE updated.");
             }
         }
         
@@ -96,6 +96,8 @@ namespace loc{
         
         virtual Eigen::MatrixXd computeKernelMatrix(const Eigen::MatrixXd& X);
         virtual Eigen::VectorXd computeKstar(double x[]) const;
+        // k* of the points in the rows of Xstar (Xstar.rows() x X.rows())
+        virtual Eigen::MatrixXd computeKstarMatrix(const Eigen::MatrixXd& Xstar) const;
         
         virtual Eigen::VectorXd predict(double x[]) const;
         virtual Eigen::VectorXd predict(const Eigen::VectorXd& kstar) const;
@@ -103,6 +105,8 @@ namespace loc{
         virtual double predict(double x[], int index);
         virtual std::vector<double> predict(double x[], const std::vector<int>& indices) const;
         virtual std::vector<double> predict(const Eigen::VectorXd& kstar, const std::vector<int>& indices) const;
+        // predictions for the points in the rows of Xstar (Xstar.rows() x indices.size())
+        virtual Eigen::MatrixXd predictBatch(const Eigen::MatrixXd& Xstar, const std::vector<int>& indices) const;
         virtual Eigen::VectorXd predictVarianceF(double x[]) const;
         virtual Eigen::VectorXd predictVarianceF(const Eigen::VectorXd& kstar) const;
         
@@ -26,6 +26,7 @@
 #include "DataLogger.hpp"
 
 #include "GaussianProcessLight.hpp"
+#include "Logger.hpp"
 
 //#include "ExtendedDataUtils.hpp"
 
@@ -128,7 +129,7 @@ namespace loc{
     template<class Tstate, class Tinput>
     std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::fitITUModel(Samples samples){
         std::vector<Sample> samplesAveraged = Sample::mean(Sample::splitSamplesToConsecutiveSamples(samples)); // averaging consecutive samples
-        std::cout << "#samplesAveraged = " << samplesAveraged.size() << std::endl;
+        LOC_LOG_INFO(MODEL, "#samplesAveraged = " << samplesAveraged.size());
         if(samplesAveraged.size()==0){
             throw std::runtime_error("No valid sample [samplesAveraged.size()==0]");
         }
@@ -221,7 +222,7 @@ namespace loc{
             Eigen::VectorXd b = Phi.transpose()*Ytmp;
             params0 = A.colPivHouseholderQr().solve(b);
         }
-        std::cout << "Initial value of ITU parameters = " << params0.transpose() <<std::endl;
+        LOC_LOG_INFO(MODEL, "Initial value of ITU parameters = " << params0.transpose());
         
         // Fit parameters for each BLE beacon
         std::vector<std::vector<double>> ITUParameters(m);
@@ -303,13 +304,13 @@ namespace loc{
                 }
             }
             if(!wasConverged){
-                std::cout << "ITU parameters were not converged." << std::endl;
+                LOC_LOG_WARN(MODEL, "ITU parameters were not converged.");
             }
-            std::cout << "mean(parameters) = " << params0.transpose() << std::endl;
+            LOC_LOG_INFO(MODEL, "mean(parameters) = " << params0.transpose());
             //std::cout << "parameters = " << paramsMatrix << std::endl;
             for(auto & ble: mBLEBeacons){
                 int index = mBeaconIdIndexMap.at(ble.id());
-                std::cout << "parameters(" << ble.major() << "," << ble.minor() << ") = " <<paramsMatrix.row(index) << std::endl;
+                LOC_LOG_DEBUG(MODEL, "parameters(" << ble.major() << "," << ble.minor() << ") = " <<paramsMatrix.row(index));
             }
             
             // Update ITUParameters by optimized parameters
@@ -338,7 +339,7 @@ namespace loc{
         }
         
         std::vector<Sample> samplesAveraged = Sample::mean(Sample::splitSamplesToConsecutiveSamples(samples)); // averaging consecutive samples
-        std::cout << "#samplesAveraged = " << samplesAveraged.size() << std::endl;
+        LOC_LOG_INFO(MODEL, "#samplesAveraged = " << samplesAveraged.size());
         
         // construct beacon id to index map
         if(mBLEBeacons.size() <= 0){
@@ -410,7 +411,7 @@ namespace loc{
         for(auto& ble: mBLEBeacons){
             long id = ble.id();
             int index = mBeaconIdIndexMap.at(id);
-            std::cout << "stdev(" <<ble.major() << "," << ble.minor() << ") = " << mRssiStandardDeviations.at(index) <<std::endl;
+            LOC_LOG_DEBUG(MODEL, "stdev(" <<ble.major() << "," << ble.minor() << ") = " << mRssiStandardDeviations.at(index));
         }
         
         if(mStdevRssiForUnknownBeacon==0){
@@ -468,7 +469,7 @@ namespace loc{
             int index = mBeaconIdIndexMap.at(id);
             double var = indexRssiSum[index] /(indexCount[index]);
             if (isnan(var)) {
-                std::cerr << "Stdev is NaN for beacon(" << ble.major() << ", " << ble.minor() << ")" << std::endl;
+                LOC_LOG_WARN(MODEL, "Stdev is NaN for beacon(" << ble.major() << ", " << ble.minor() << ")");
             }
             double stdev = sqrt(var);
             stdevs.push_back(stdev);
@@ -520,12 +521,16 @@ namespace loc{
     
     template<class Tstate, class Tinput>
     std::map<long, NormalParameter>  GaussianProcessLDPLMultiModel<Tstate, Tinput>::predict(const Tstate& state, const Tinput& input) const{
-        //Assuming Tinput = Beacons
-        std::map<long, NormalParameter> beaconIdRssiStatsMap;
-        
         std::vector<double> xvec = MLAdapter::locationToVec(state);
         std::vector<int> indices = extractKnownBeaconIndices(input);
         std::vector<double> dypreds = mGP->predict(xvec.data(), indices);
+        return predict(state, input, dypreds);
+    }
+    
+    template<class Tstate, class Tinput>
+    std::map<long, NormalParameter>  GaussianProcessLDPLMultiModel<Tstate, Tinput>::predict(const Tstate& state, const Tinput& input, const std::vector<double>& dypreds) const{
+        //Assuming Tinput = Beacons
+        std::map<long, NormalParameter> beaconIdRssiStatsMap;
         
         int idx_local=0;
         for(auto iter=input.begin(); iter!=input.end(); iter++){
@@ -568,19 +573,27 @@ namespace loc{
     
     template<class Tstate, class Tinput>
     std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input){
+        auto beaconIdRssiStatsMap = this->predict(state, input);
+        return computeLogLikelihoodRelatedValues(state, input, beaconIdRssiStatsMap);
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input, const std::map<long, NormalParameter>& beaconIdRssiStatsMap){
         //Assuming Tinput = Beacons
+        const State* pStateMarginal = dynamic_cast<const State*>(&state);
+        if(pStateMarginal && 0<pStateMarginal->rssiBiasVariance()){
+            return computeLogLikelihoodRelatedValuesMarginalizingRssiBias(*pStateMarginal, input, beaconIdRssiStatsMap);
+        }
         
         std::vector<double> returnValues(4); // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons
         
-        auto beaconIdRssiStatsMap = this->predict(state, input);
-        
         std::vector<int> indices = extractKnownBeaconIndices(input);
         
         size_t countKnown = indices.size();
         size_t countUnknown = input.size() - indices.size();
 
         if(countKnown==0){
-            std::cout << "ObservationModel does not know the input data." << std::endl;
+            LOC_LOG_WARN(MODEL, "ObservationModel does not know the input data.");
         }
         
         double jointLogLL = 0;
@@ -598,7 +611,7 @@ namespace loc{
             
             // RSSI of known beacons are predicted by a model.
             if(mBeaconIdIndexMap.count(id)==1){
-                auto rssiStats = beaconIdRssiStatsMap[id];
+                const auto& rssiStats = beaconIdRssiStatsMap.at(id);
                 double ypred = rssiStats.mean();
                 double stdev = rssiStats.stdev();
                 
@@ -608,7 +621,7 @@ namespace loc{
                 
                 if(applyLowestLogLikelihood){
                     double enlargedStdev = mStdevRssiForUnknownBeacon * mCoeffDiffFloorStdev;
-                    auto idx = mBeaconIdIndexMap[b.id()];
+                    auto idx = mBeaconIdIndexMap.at(b.id());
                     auto ble = mBLEBeacons.at(idx);
                     if(ble.floor()!=state.floor()){
                         double lowestlogLL = normFunc(0, 0, enlargedStdev);
@@ -641,6 +654,75 @@ namespace loc{
         return returnValues;
     }
     
+    // rssi = ypred + bias + noise with bias ~ N(mean, variance) and noise ~ N(0, stdev^2).
+    // The beacons are processed one by one as scalar Kalman updates of the bias. The sum of the log predictive
+    // densities is the exact log marginal likelihood of the beacons (independent of the order).
+    // Normal densities are used regardless of normFunc because the marginal has a closed form only for them.
+    template<class Tstate, class Tinput>
+    std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValuesMarginalizingRssiBias(const State& state, const Tinput& input, const std::map<long, NormalParameter>& beaconIdRssiStatsMap){
+        std::vector<double> returnValues(6); // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons, mean and variance of bias
+        
+        std::vector<int> indices = extractKnownBeaconIndices(input);
+        size_t countKnown = indices.size();
+        size_t countUnknown = input.size() - indices.size();
+        if(countKnown==0){
+            LOC_LOG_WARN(MODEL, "ObservationModel does not know the input data.");
+        }
+        
+        double biasMean = state.rssiBias();
+        double biasVariance = state.rssiBiasVariance();
+        double jointLogLL = 0;
+        double sumMahaDist = 0;
+        for(const Beacon& b: input){
+            double rssi = b.rssi();
+            long id = b.id();
+            double ypred;
+            double stdev;
+            bool isOutlier = false;
+            double lowestLogLL = 0;
+            if(mBeaconIdIndexMap.count(id)==1){
+                const auto& rssiStats = beaconIdRssiStatsMap.at(id);
+                ypred = rssiStats.mean();
+                stdev = rssiStats.stdev();
+                if(applyLowestLogLikelihood){
+                    const auto& ble = mBLEBeacons.at(mBeaconIdIndexMap.at(id));
+                    if(ble.floor()!=state.floor()){
+                        double enlargedStdev = mStdevRssiForUnknownBeacon * mCoeffDiffFloorStdev;
+                        lowestLogLL = MathUtils::logProbaNormal(0, 0, enlargedStdev);
+                        isOutlier = true;
+                    }
+                }
+            }else if(mFillsUnknownBeaconRssi){
+                ypred = BeaconConfig::minRssi();
+                stdev = mStdevRssiForUnknownBeacon;
+            }else{
+                continue;
+            }
+            double predictiveVariance = stdev*stdev + biasVariance;
+            double predictiveStdev = std::sqrt(predictiveVariance);
+            double predictiveMean = ypred + biasMean;
+            double logLL = MathUtils::logProbaNormal(rssi, predictiveMean, predictiveStdev);
+            sumMahaDist += MathUtils::mahalanobisDistance(rssi, predictiveMean, predictiveStdev);
+            
+            // A beacon floored to the lowest log-likelihood is treated as an outlier and does not update the bias.
+            if(isOutlier && logLL < lowestLogLL){
+                jointLogLL += lowestLogLL;
+                continue;
+            }
+            jointLogLL += logLL;
+            double gain = biasVariance/predictiveVariance;
+            biasMean += gain*(rssi - predictiveMean);
+            biasVariance *= stdev*stdev/predictiveVariance;
+        }
+        returnValues[0] = jointLogLL;
+        returnValues[1] = sumMahaDist;
+        returnValues[2] = countKnown;
+        returnValues[3] = countUnknown;
+        returnValues[4] = biasMean;
+        returnValues[5] = biasVariance;
+        return returnValues;
+    }
+    
     template<class Tstate, class Tinput>
     std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihood(const std::vector<Tstate> & states, const Tinput & input) {
         int n = (int) states.size();
@@ -663,6 +745,65 @@ namespace loc{
         return values;
     }
     
+    template<class Tstate, class Tinput>
+    std::vector<std::vector<std::vector<double>>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const std::vector<const std::vector<Tstate>*>& statesList, const std::vector<const Tinput*>& inputs){
+        size_t nSets = statesList.size();
+        assert(nSets==inputs.size());
+        
+        // union of the known beacons in the inputs
+        std::vector<std::vector<int>> indicesList(nSets);
+        std::map<int, int> indexToColumn;
+        size_t nRows = 0;
+        for(int s=0; s<nSets; s++){
+            indicesList[s] = extractKnownBeaconIndices(*inputs[s]);
+            for(int index: indicesList[s]){
+                indexToColumn.insert(std::make_pair(index, 0));
+            }
+            nRows += statesList[s]->size();
+        }
+        std::vector<int> unionIndices;
+        for(auto& pair: indexToColumn){
+            pair.second = (int) unionIndices.size();
+            unionIndices.push_back(pair.first);
+        }
+        
+        const int nx = 4; // x, y, z, floor (MLAdapter::locationToVec)
+        Eigen::MatrixXd Xstar(nRows, nx);
+        int row = 0;
+        for(int s=0; s<nSets; s++){
+            for(const auto& state: *statesList[s]){
+                std::vector<double> xvec = MLAdapter::locationToVec(state);
+                for(int j=0; j<nx; j++){
+                    Xstar(row, j) = xvec[j];
+                }
+                row++;
+            }
+        }
+        Eigen::MatrixXd dYpred = mGP->predictBatch(Xstar, unionIndices);
+        
+        std::vector<std::vector<std::vector<double>>> valuesList(nSets);
+        row = 0;
+        for(int s=0; s<nSets; s++){
+            const auto& states = *statesList[s];
+            const auto& input = *inputs[s];
+            std::vector<int> columns;
+            for(int index: indicesList[s]){
+                columns.push_back(indexToColumn.at(index));
+            }
+            std::vector<double> dypreds(columns.size());
+            auto& values = valuesList[s];
+            values.resize(states.size());
+            for(int i=0; i<states.size(); i++, row++){
+                for(int k=0; k<columns.size(); k++){
+                    dypreds[k] = dYpred(row, columns[k]);
+                }
+                auto beaconIdRssiStatsMap = this->predict(states[i], input, dypreds);
+                values[i] = computeLogLikelihoodRelatedValues(states[i], input, beaconIdRssiStatsMap);
+            }
+        }
+        return valuesList;
+    }
+    
     template<class Tstate, class Tinput>
     GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::fillsUnknownBeaconRssi(bool fills){
         mFillsUnknownBeaconRssi = fills;
@@ -691,6 +832,11 @@ namespace loc{
         return *this;
     }
     
+    template<class Tstate, class Tinput>
+    const BLEBeacons& GaussianProcessLDPLMultiModel<Tstate, Tinput>::bleBeacons() const{
+        return mBLEBeacons;
+    }
+    
     // CEREAL function
     template<class Tstate, class Tinput>
     template<class Archive>
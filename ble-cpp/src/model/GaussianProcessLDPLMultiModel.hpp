@@ -33,6 +33,7 @@
 #include "GaussianProcess.hpp"
 #include "ObservationModel.hpp"
 #include "ObservationModelTrainer.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -115,6 +116,7 @@ namespace loc{
         std::vector<std::vector<double>> fitITUModel(Samples samples);
         std::vector<double> computeRssiStandardDeviations(Samples samples);
         std::vector<int> extractKnownBeaconIndices(const Tinput& beacons) const;
+        std::vector<double> computeLogLikelihoodRelatedValuesMarginalizingRssiBias(const State& state, const Tinput& input, const std::map<long, NormalParameter>& beaconIdRssiStatsMap);
         
         friend class GaussianProcessLDPLMultiModelTrainer<Tstate, Tinput>;
         int version = 2;
@@ -127,7 +129,7 @@ namespace loc{
         std::function<double(double, double, double)> normFunc = MathUtils::logProbaNormal;
         
         std::vector<Tstate>* update(const std::vector<Tstate> & states, const Tinput & input) override {
-            std::cout << "GaussianProcessLDPLMultiModel::update is not supported." << std::endl;
+            LOC_LOG_WARN(MODEL, "GaussianProcessLDPLMultiModel::update is not supported.");
             std::vector<Tstate>* statesCopy = new std::vector<Tstate>(states);
             return statesCopy;
         }
@@ -135,12 +137,21 @@ namespace loc{
         Tinput convertInput(const Tinput& input);
         // predict mean and stdev given state for input beacon id
         std::map<long, NormalParameter> predict(const Tstate& state, const Tinput& input) const;
+        // same as above with GP predictions of the known beacons in input (dypreds) given
+        std::map<long, NormalParameter> predict(const Tstate& state, const Tinput& input, const std::vector<double>& dypreds) const;
         
         double computeLogLikelihood(const Tstate& state, const Tinput& input);
         std::vector<double> computeLogLikelihood(const std::vector<Tstate> & states, const Tinput& input) override;
         
         std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input);
         std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput& input) override;
+        // Returns logLikelihood, mahalanobisDistance, #knownBeacons and #unknownBeacons.
+        // For a state with a marginalized RSSI bias (0<rssiBiasVariance), the log marginal likelihood is returned
+        // followed by the mean and variance of the posterior of the bias.
+        std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input, const std::map<long, NormalParameter>& beaconIdRssiStatsMap);
+        // Evaluates several pairs of states and input at once.
+        // k* of all the states are computed as one matrix and the GP predictions are made by one matrix product.
+        std::vector<std::vector<std::vector<double>>> computeLogLikelihoodRelatedValues(const std::vector<const std::vector<Tstate>*>& statesList, const std::vector<const Tinput*>& inputs);
         
         GaussianProcessLDPLMultiModel& fillsUnknownBeaconRssi(bool fills);
         bool fillsUnknownBeaconRssi() const;
@@ -150,6 +161,8 @@ namespace loc{
         
         GaussianProcessLDPLMultiModel& coeffDiffFloorStdev(double);
         
+        const BLEBeacons& bleBeacons() const;
+        
         template<class Archive>
         void save(Archive& ar) const;
         template<class Archive>
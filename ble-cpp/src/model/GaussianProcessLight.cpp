@@ -24,21 +24,26 @@
 #include <random>
 
 #include "GaussianProcessLight.hpp"
+#include "Logger.hpp"
 
 void loc::GaussianProcessLight::CentroidBasedClusteringResult::printSummary() const {
     for (auto i=0; i < nCluster(); i++) {
-        std::cout << "cluster_" << i << ": " << centers[i].transpose() << ", XCrows=" << XC[i].rows() << std::endl;
+        LOC_LOG_DEBUG(MODEL, "cluster_" << i << ": " << centers[i].transpose() << ", XCrows=" << XC[i].rows());
     }
 }
 void loc::GaussianProcessLight::CentroidBasedClusteringResult::printAll() const {
-    std::cout << "CLUSTER_ID,X,Y,Z,F," << std::endl;
+    if (!LOC_LOG_ENABLED(TRACE, MODEL)) {
+        return;
+    }
+    LOC_LOG_TRACE(MODEL, "CLUSTER_ID,X,Y,Z,F,");
     for (auto i=0; i < nCluster(); i++) {
         for (auto j=0; j < XC.at(i).rows(); j++) {
-            std::cout << i << ",";
+            std::stringstream ss;
+            ss << i << ",";
             for (auto k=0; k < XC.at(i).cols(); k++) {
-                std::cout << XC.at(i)(j,k) << ",";
+                ss << XC.at(i)(j,k) << ",";
             }
-            std::cout << std::endl;
+            LOC_LOG_TRACE(MODEL, ss.str());
         }
     }
 }
@@ -51,7 +56,7 @@ loc::GaussianProcessLight::kMeansClustering(const Eigen::MatrixXd& X,
     assert(X.rows()==Y.rows());
     assert(X.cols()==N_FEATURES);
     assert(X.rows()>=TARGET_N_CLUSTER);
-    std::cout << "TARGET_N_CLUSTER=" << TARGET_N_CLUSTER << std::endl;
+    LOC_LOG_DEBUG(MODEL, "TARGET_N_CLUSTER=" << TARGET_N_CLUSTER);
     
     std::vector<Eigen::VectorXd> centers;
     
@@ -101,9 +106,11 @@ loc::GaussianProcessLight::kMeansClustering(const Eigen::MatrixXd& X,
             const size_t iNearestCluster = std::distance(d.begin(), it_nearest);
             labels.at(iNearestCluster).push_back(i);
         }
-        std::cout << "sqdist_sum[" << r << "]= " << sqdist_sum << std::endl;
-        for (auto l : labels) { std::cout << l.size() << ","; }
-        std::cout << std::endl;
+        if (LOC_LOG_ENABLED(DEBUG, MODEL)) {
+            std::stringstream ss;
+            for (auto l : labels) { ss << l.size() << ","; }
+            LOC_LOG_DEBUG(MODEL, "sqdist_sum[" << r << "]= " << sqdist_sum << ", clusterSizes=" << ss.str());
+        }
         
         //calculate cluster centers
         for (auto k=0; k < labels.size(); k++) {
@@ -142,7 +149,7 @@ loc::GaussianProcessLight::clusteringGreedyWithMagicThreshold(const Eigen::Matri
 {
     assert(X.rows()==Y.rows());
     assert(X.cols()==N_FEATURES);
-    std::cout << "MAGIC_W_THRESHOLD=" << MAGIC_W_THRESHOLD << std::endl;
+    LOC_LOG_DEBUG(MODEL, "MAGIC_W_THRESHOLD=" << MAGIC_W_THRESHOLD);
     CentroidBasedClusteringResult res;
     for (int is=0; is < X.rows(); is++) {
         double x[N_FEATURES];
@@ -198,8 +205,8 @@ loc::GaussianProcessLight::improveWithOverlap(CentroidBasedClusteringResult& cr,
                                               const Eigen::MatrixXd& X,
                                               const Eigen::MatrixXd& Y) const
 {
-    std::cout << "improve clusters with overlaps" << std::endl;
-    std::cout << "OVERLAP_SCALE=" << OVERLAP_SCALE << std::endl;
+    LOC_LOG_INFO(MODEL, "improve clusters with overlaps");
+    LOC_LOG_DEBUG(MODEL, "OVERLAP_SCALE=" << OVERLAP_SCALE);
     const size_t k = 3;
     const size_t n = cr.nCluster();
     std::vector<Eigen::VectorXd> empty;
@@ -230,7 +237,7 @@ loc::GaussianProcessLight::improveWithOverlap(CentroidBasedClusteringResult& cr,
     Xbuf.erase(remove_if(Xbuf.begin(), Xbuf.end(), is_empty), Xbuf.end());
     Ybuf.erase(remove_if(Ybuf.begin(), Ybuf.end(), is_empty), Ybuf.end());
     const size_t n_aft = Xbuf.size();
-    std::cout << "n_cluster: " << n_bef << " -> " << n_aft << std::endl;
+    LOC_LOG_INFO(MODEL, "n_cluster: " << n_bef << " -> " << n_aft);
     
     //replace clusters to improved ones
     assert(Xbuf.size() == Ybuf.size());
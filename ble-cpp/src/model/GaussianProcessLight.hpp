@@ -30,6 +30,7 @@
 #include "KernelFunction.hpp"
 #include "GaussianProcess.hpp"
 #include "SerializeUtils.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -85,7 +86,7 @@ namespace loc{
             
             const size_t MIN_FEASIBLE_CLUSTER_SIZE = 50;
             if (MAX_CLUSTER_SIZE < MIN_FEASIBLE_CLUSTER_SIZE) {
-                std::cout << "WARNING: MAX_CLUSTER_SIZE=" << MAX_CLUSTER_SIZE << " is less than MIN_FEASIBLE_CLUSTER_SIZE=" << MIN_FEASIBLE_CLUSTER_SIZE << std::endl;
+                LOC_LOG_WARN(MODEL, "WARNING: MAX_CLUSTER_SIZE=" << MAX_CLUSTER_SIZE << " is less than MIN_FEASIBLE_CLUSTER_SIZE=" << MIN_FEASIBLE_CLUSTER_SIZE);
             }
             return MAX_CLUSTER_SIZE;
         }
@@ -110,7 +111,7 @@ namespace loc{
             cr.printSummary();
             }
                 
-            std::cout << "clustered into " << cr.nCluster() << " local models" << std::endl;
+            LOC_LOG_INFO(MODEL, "clustered into " << cr.nCluster() << " local models");
             
             centers_ = cr.centers;
             
@@ -173,6 +174,22 @@ namespace loc{
             return ypreds;
         }
 
+        Eigen::MatrixXd predictBatch(const Eigen::MatrixXd& Xstar, const std::vector<int>& indices) const
+        {
+            Eigen::MatrixXd Ypred(Xstar.rows(), indices.size());
+            std::vector<double> x(Xstar.cols());
+            for (auto i=0; i < Xstar.rows(); i++) {
+                for (auto j=0; j < Xstar.cols(); j++) {
+                    x[j] = Xstar(i,j);
+                }
+                std::vector<double> ypreds = predict(x.data(), indices);
+                for (auto k=0; k < indices.size(); k++) {
+                    Ypred(i,k) = ypreds[k];
+                }
+            }
+            return Ypred;
+        }
+        
         /**
          * Estimate parameters as preparation
          */
@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "LikelihoodBatchScheduler.hpp"
+
+namespace loc{
+    
+    std::ostream& operator<<(std::ostream&os, const LikelihoodBatchStatistics& stats){
+        os << "batches=" << stats.batches
+        << ",requests=" << stats.requests
+        << ",states=" << stats.states
+        << ",meanRequestsPerBatch=" << stats.meanRequestsPerBatch
+        << ",meanWaitMS=" << stats.meanWaitMS
+        << ",maxWaitMS=" << stats.maxWaitMS
+        << ",meanEvaluationMS=" << stats.meanEvaluationMS
+        << ",statesPerSecond=" << stats.statesPerSecond;
+        return os;
+    }
+    
+    LikelihoodBatchScheduler::LikelihoodBatchScheduler(std::shared_ptr<Model> model, const LikelihoodBatchParameters& params)
+    : mModel(model), mParams(params){
+    }
+    
+    std::shared_ptr<LikelihoodBatchScheduler::Model> LikelihoodBatchScheduler::model() const{
+        return mModel;
+    }
+    
+    bool LikelihoodBatchScheduler::isBatchFull() const{
+        return mParams.maxBatchRequests <= mPending.size() || mParams.maxBatchStates <= mPendingStates;
+    }
+    
+    std::vector<std::vector<double>> LikelihoodBatchScheduler::computeLogLikelihoodRelatedValues(const std::vector<State>& states, const Beacons& input){
+        Request request;
+        request.states = &states;
+        request.input = &input;
+        request.requestedAt = std::chrono::steady_clock::now();
+        
+        std::unique_lock<std::mutex> lock(mMutex);
+        mPending.push_back(&request);
+        mPendingStates += states.size();
+        
+        if(mCollecting){
+            // a batch is being collected by another caller
+            mCondition.notify_all();
+            mCondition.wait(lock, [&request]{return request.done;});
+        }else{
+            mCollecting = true;
+            auto deadline = request.requestedAt + std::chrono::microseconds(mParams.windowMicroseconds);
+            mCondition.wait_until(lock, deadline, [this]{return isBatchFull();});
+            
+            std::vector<Request*> batch(mPending.begin(), mPending.end());
+            mPending.clear();
+            mPendingStates = 0;
+            mCollecting = false;
+            
+            // requests arriving from now are collected into the next batch while this batch is evaluated.
+            lock.unlock();
+            evaluate(batch);
+            lock.lock();
+        }
+        if(request.exception){
+            std::rethrow_exception(request.exception);
+        }
+        return std::move(request.values);
+    }
+    
+    void LikelihoodBatchScheduler::evaluate(std::vector<Request*>& batch){
+        auto start = std::chrono::steady_clock::now();
+        
+        std::vector<const std::vector<State>*> statesList;
+        std::vector<const Beacons*> inputs;
+        long nStates = 0;
+        for(auto request: batch){
+            statesList.push_back(request->states);
+            inputs.push_back(request->input);
+            nStates += request->states->size();
+        }
+        
+        std::vector<std::vector<std::vector<double>>> valuesList;
+        std::exception_ptr exception;
+        try{
+            valuesList = mModel->computeLogLikelihoodRelatedValues(statesList, inputs);
+        }catch(...){
+            exception = std::current_exception();
+        }
+        auto end = std::chrono::steady_clock::now();
+        
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBatches++;
+        mRequests += batch.size();
+        mStates += nStates;
+        mEvaluationSumMS += std::chrono::duration<double, std::milli>(end - start).count();
+        for(int i=0; i<batch.size(); i++){
+            Request* request = batch[i];
+            double waitMS = std::chrono::duration<double, std::milli>(start - request->requestedAt).count();
+            mWaitSumMS += waitMS;
+            mWaitMaxMS = std::max(mWaitMaxMS, waitMS);
+            if(exception){
+                request->exception = exception;
+            }else{
+                request->values = std::move(valuesList[i]);
+            }
+            request->done = true;
+        }
+        mCondition.notify_all();
+    }
+    
+    LikelihoodBatchStatistics LikelihoodBatchScheduler::statistics() const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        LikelihoodBatchStatistics stats;
+        stats.batches = mBatches;
+        stats.requests = mRequests;
+        stats.states = mStates;
+        if(0<mBatches){
+            stats.meanRequestsPerBatch = static_cast<double>(mRequests)/mBatches;
+            stats.meanEvaluationMS = mEvaluationSumMS/mBatches;
+        }
+        if(0<mRequests){
+            stats.meanWaitMS = mWaitSumMS/mRequests;
+        }
+        stats.maxWaitMS = mWaitMaxMS;
+        if(0<mEvaluationSumMS){
+            stats.statesPerSecond = mStates/(mEvaluationSumMS/1000.0);
+        }
+        return stats;
+    }
+    
+    ObservationModel<State, Beacons>::Ptr LikelihoodBatchScheduler::observationModel(){
+        return std::make_shared<BatchedObservationModel>(shared_from_this());
+    }
+    
+    // BatchedObservationModel
+    BatchedObservationModel::BatchedObservationModel(LikelihoodBatchScheduler::Ptr scheduler)
+    : mScheduler(scheduler){
+    }
+    
+    std::vector<State>* BatchedObservationModel::update(const std::vector<State> & states, const Beacons & input){
+        return mScheduler->model()->update(states, input);
+    }
+    
+    std::vector<double> BatchedObservationModel::computeLogLikelihood(const std::vector<State> & states, const Beacons & input){
+        std::vector<std::vector<double>> values = mScheduler->computeLogLikelihoodRelatedValues(states, input);
+        std::vector<double> logLLs(values.size());
+        for(int i=0; i<values.size(); i++){
+            logLLs[i] = values[i].at(0);
+        }
+        return logLLs;
+    }
+    
+    std::vector<std::vector<double>> BatchedObservationModel::computeLogLikelihoodRelatedValues(const std::vector<State> & states, const Beacons& input){
+        return mScheduler->computeLogLikelihoodRelatedValues(states, input);
+    }
+}
@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef LikelihoodBatchScheduler_hpp
+#define LikelihoodBatchScheduler_hpp
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+
+#include "State.hpp"
+#include "Beacon.hpp"
+#include "ObservationModel.hpp"
+#include "GaussianProcessLDPLMultiModel.hpp"
+#include "SerializeUtils.hpp"
+
+namespace loc{
+    
+    class LikelihoodBatchParameters{
+    public:
+        // requests arriving within this window after the first pending request are evaluated together
+        long windowMicroseconds = 1000;
+        // a batch is started without waiting for the window when either limit is reached
+        int maxBatchRequests = 64;
+        int maxBatchStates = 100000;
+        
+        template<class Archive>
+        void serialize(Archive & ar){
+            ar(CEREAL_NVP(windowMicroseconds));
+            ar(CEREAL_NVP(maxBatchRequests));
+            ar(CEREAL_NVP(maxBatchStates));
+        }
+    };
+    
+    class LikelihoodBatchStatistics{
+    public:
+        long batches = 0;
+        long requests = 0;
+        long states = 0;
+        double meanRequestsPerBatch = 0;
+        // latency added by batching (from the request to the start of its batch)
+        double meanWaitMS = 0;
+        double maxWaitMS = 0;
+        // time to evaluate a batch
+        double meanEvaluationMS = 0;
+        // states evaluated per second of evaluation time
+        double statesPerSecond = 0;
+        
+        friend std::ostream& operator<<(std::ostream&os, const LikelihoodBatchStatistics& stats);
+    };
+    
+    // Collects likelihood evaluations requested by the filters of many sessions sharing an observation model
+    // and evaluates them as one batch. The first caller of a batch waits for the window and evaluates the batch
+    // on its own thread, the other callers block until their results are ready. No thread is created.
+    class LikelihoodBatchScheduler: public std::enable_shared_from_this<LikelihoodBatchScheduler>{
+    public:
+        using Ptr = std::shared_ptr<LikelihoodBatchScheduler>;
+        using Model = GaussianProcessLDPLMultiModel<State, Beacons>;
+        
+        LikelihoodBatchScheduler(std::shared_ptr<Model> model, const LikelihoodBatchParameters& params = LikelihoodBatchParameters());
+        
+        LikelihoodBatchScheduler(const LikelihoodBatchScheduler&) = delete;
+        LikelihoodBatchScheduler& operator=(const LikelihoodBatchScheduler&) = delete;
+        
+        // Returns the same values as Model::computeLogLikelihoodRelatedValues(states, input).
+        std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<State>& states, const Beacons& input);
+        
+        // An observation model for a filter which routes its evaluations to this scheduler
+        ObservationModel<State, Beacons>::Ptr observationModel();
+        
+        std::shared_ptr<Model> model() const;
+        LikelihoodBatchStatistics statistics() const;
+        
+    private:
+        struct Request{
+            const std::vector<State>* states;
+            const Beacons* input;
+            std::chrono::steady_clock::time_point requestedAt;
+            std::vector<std::vector<double>> values;
+            std::exception_ptr exception;
+            bool done = false;
+        };
+        
+        std::shared_ptr<Model> mModel;
+        LikelihoodBatchParameters mParams;
+        
+        mutable std::mutex mMutex;
+        std::condition_variable mCondition;
+        std::deque<Request*> mPending;
+        size_t mPendingStates = 0;
+        bool mCollecting = false;
+        
+        long mBatches = 0;
+        long mRequests = 0;
+        long mStates = 0;
+        double mWaitSumMS = 0;
+        double mWaitMaxMS = 0;
+        double mEvaluationSumMS = 0;
+        
+        bool isBatchFull() const;
+        void evaluate(std::vector<Request*>& batch);
+    };
+    
+    class BatchedObservationModel: public ObservationModel<State, Beacons>{
+    public:
+        BatchedObservationModel(LikelihoodBatchScheduler::Ptr scheduler);
+        
+        std::vector<State>* update(const std::vector<State> & states, const Beacons & input) override;
+        std::vector<double> computeLogLikelihood(const std::vector<State> & states, const Beacons & input) override;
+        std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<State> & states, const Beacons& input) override;
+        
+    private:
+        LikelihoodBatchScheduler::Ptr mScheduler;
+    };
+}
+
+#endif /* LikelihoodBatchScheduler_hpp */
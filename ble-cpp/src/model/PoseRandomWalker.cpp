@@ -42,51 +42,82 @@ namespace loc{
     
     std::vector<State> PoseRandomWalker::predict(std::vector<State> states, SystemModelInput input){
         std::vector<State> statesPredicted(states.size());
+        startPredictions(states, input);
         for(int i=0; i<states.size(); i++){
             statesPredicted[i]= predict(states[i], input);
         }
+        endPredictions(states, input);
         return statesPredicted;
     }
     
+    void PoseRandomWalker::startPredictions(const std::vector<State>& states, const SystemModelInput& input){
+        predictionStreams.begin(randomGenerator);
+    }
+    
+    void PoseRandomWalker::endPredictions(const std::vector<State>& states, const SystemModelInput& input){
+        predictionStreams.end();
+    }
+    
     State PoseRandomWalker::predict(State state, SystemModelInput input){
         
         //long timestamp = input.timestamp;
         //long previousTimestamp = input.previousTimestamp;
         double dTime = (input.timestamp()-input.previousTimestamp())/(1000.0); //[s] Difference in time
         
+        RandomGenerator& rand = predictionStreams.next(randomGenerator);
         double movLevel = movingLevel();
         double nSteps = mProperty->pedometer()->getNSteps();
         double yaw = mProperty->orientationMeter()->getYaw();
         
+        // A coalesced input summarizes several pedometer updates. The noises below are linear in time,
+        // so they are scaled to have the same variance as the sum of the noises of the summarized updates.
+        bool coalesced = input.hasMotionSummary() && !isUnderControll;
+        double dTimeNoise = dTime;
+        if(coalesced){
+            nSteps = 0<input.walkingTime() ? 1.0 : 0.0;
+            dTimeNoise = dTime/std::sqrt(std::max(1, input.samples()));
+        }
+        
         //std::cout << "predict: dTime=" << dTime << ", nSteps=" << nSteps << std::endl;
         
         // Perturb variables in State
         if(nSteps>0 || mProperty->doesUpdateWhenStopping() ){
-            state.orientationBias(state.orientationBias() + stateProperty->diffusionOrientationBias()*randomGenerator.nextGaussian()*dTime );
-            state.rssiBias(randomGenerator.nextTruncatedGaussian(state.rssiBias(),
-                                                                 stateProperty->diffusionRssiBias()*dTime,
-                                                                 stateProperty->minRssiBias(),
-                                                                 stateProperty->maxRssiBias()));
+            state.orientationBias(state.orientationBias() + stateProperty->diffusionOrientationBias()*rand.nextGaussian()*dTimeNoise );
+            if(0<state.rssiBiasVariance()){
+                double stdDiffusion = stateProperty->diffusionRssiBias()*dTimeNoise;
+                state.rssiBiasVariance(state.rssiBiasVariance() + stdDiffusion*stdDiffusion);
+            }else{
+                state.rssiBias(rand.nextTruncatedGaussian(state.rssiBias(),
+                                                                     stateProperty->diffusionRssiBias()*dTimeNoise,
+                                                                     stateProperty->minRssiBias(),
+                                                                     stateProperty->maxRssiBias()));
+            }
         }
         
         // Update orientation
         double previousOrientation = state.orientation();
+        double oriNoise = poseProperty->stdOrientation()*rand.nextGaussian()*dTimeNoise;
         double orientationActual = yaw - state.orientationBias();
-        orientationActual += poseProperty->stdOrientation()*randomGenerator.nextGaussian()*dTime;
+        orientationActual += oriNoise;
         orientationActual = Pose::normalizeOrientaion(orientationActual);
         state.orientation(orientationActual);
         
         // Reduce velocity when turning
-        double oriDiff = Pose::computeOrientationDifference(previousOrientation, orientationActual);
-        double angularVelocityLimit = mProperty->angularVelocityLimit();
-        double turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(oriDiff/angularVelocityLimit,2)));
+        // (turns within a coalesced interval shorten the walking displacement instead)
+        double turningVelocityRate = 1.0;
+        if(!coalesced){
+            double oriDiff = Pose::computeOrientationDifference(previousOrientation, orientationActual);
+            double angularVelocityLimit = mProperty->angularVelocityLimit();
+            turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(oriDiff/angularVelocityLimit,2)));
+        }
         
         // Perturb variables in Pose
-        double v = 0.0;
+        double vWalk = 0.0;
+        double vRel = 0.0;
         double nV = state.normalVelocity();
         if(nSteps >0 || mProperty->doesUpdateWhenStopping()){
-            nV = randomGenerator.nextTruncatedGaussian(state.normalVelocity(),
-                                                          poseProperty->diffusionVelocity()*dTime,
+            nV = rand.nextTruncatedGaussian(state.normalVelocity(),
+                                                          poseProperty->diffusionVelocity()*dTimeNoise,
                                                           poseProperty->minVelocity(),
                                                           poseProperty->maxVelocity());
             state.normalVelocity(nV);
@@ -94,19 +125,25 @@ namespace loc{
         
         // Update velocity at the moment
         if(nSteps > 0){
-            v = nV * velocityRate() * turningVelocityRate;
+            vWalk = nV * velocityRate() * turningVelocityRate;
         }
         if(relativeVelocity()>0){
-            v += randomGenerator.nextTruncatedGaussian(relativeVelocity(),
-                                                 poseProperty->diffusionVelocity()*dTime,
+            vRel = rand.nextTruncatedGaussian(relativeVelocity(),
+                                                 poseProperty->diffusionVelocity()*dTimeNoise,
                                                  poseProperty->minVelocity(),
                                                  poseProperty->maxVelocity());
         }
-        state.velocity(v);
+        state.velocity(vWalk + vRel);
         
         // Update in-plane coordinate.
         double x = state.x() + state.vx() * dTime;
         double y = state.y() + state.vy() * dTime;
+        if(coalesced){
+            double oriWalk = input.meanWalkingYaw() - state.orientationBias() + oriNoise;
+            double tWalk = input.effectiveWalkingTime();
+            x = state.x() + vWalk*std::cos(oriWalk)*tWalk + vRel*std::cos(orientationActual)*dTime;
+            y = state.y() + vWalk*std::sin(oriWalk)*tWalk + vRel*std::sin(orientationActual)*dTime;
+        }
         
         State statePred(state);
         statePred.x(x);
@@ -124,4 +161,16 @@ namespace loc{
         }
     }
     
+    void PoseRandomWalker::saveState(SnapshotOutputArchive& ar) const{
+        ar(CEREAL_NVP(randomGenerator));
+        ar(CEREAL_NVP(velocityRate_), CEREAL_NVP(relativeVelocity_));
+        ar(CEREAL_NVP(isUnderControll), CEREAL_NVP(mMovement));
+    }
+    
+    void PoseRandomWalker::loadState(SnapshotInputArchive& ar){
+        ar(CEREAL_NVP(randomGenerator));
+        ar(CEREAL_NVP(velocityRate_), CEREAL_NVP(relativeVelocity_));
+        ar(CEREAL_NVP(isUnderControll), CEREAL_NVP(mMovement));
+    }
+    
 }
@@ -74,10 +74,12 @@ namespace loc{
         }
     };
     
-    class PoseRandomWalker: public SystemModel<State, SystemModelInput>, public SystemModelVelocityAdjustable, public SystemModelMovementControllable{
+    class PoseRandomWalker: public SystemModel<State, SystemModelInput>, public SystemModelVelocityAdjustable, public SystemModelMovementControllable, public Snapshottable{
 
     protected:        
         RandomGenerator randomGenerator;
+        // Each prediction in a pass draws from its own substream of randomGenerator
+        SubstreamSequence predictionStreams;
         PoseProperty::Ptr poseProperty = PoseProperty::Ptr(new PoseProperty);
         StateProperty::Ptr stateProperty = StateProperty::Ptr(new StateProperty);
         PoseRandomWalkerProperty::Ptr mProperty = PoseRandomWalkerProperty::Ptr(new PoseRandomWalkerProperty);
@@ -93,8 +95,13 @@ namespace loc{
         
         virtual std::vector<State> predict(std::vector<State> poses, SystemModelInput input) override;
         virtual State predict(State state, SystemModelInput input) override;
+        virtual void startPredictions(const std::vector<State>& states, const SystemModelInput& input) override;
+        virtual void endPredictions(const std::vector<State>& states, const SystemModelInput& input) override;
         
         virtual double movingLevel();
+        
+        virtual void saveState(SnapshotOutputArchive& ar) const override;
+        virtual void loadState(SnapshotInputArchive& ar) override;
     };
     
 }
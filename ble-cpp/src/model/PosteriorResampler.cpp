@@ -71,5 +71,15 @@ namespace loc{
         return statesNew;
     }
     
+    template<class Tstate>
+    void OrientationPosteriorResampler<Tstate>::saveState(SnapshotOutputArchive& ar) const{
+        ar(cereal::make_nvp("randomGenerator", *mRand));
+    }
+    
+    template<class Tstate>
+    void OrientationPosteriorResampler<Tstate>::loadState(SnapshotInputArchive& ar){
+        ar(cereal::make_nvp("randomGenerator", *mRand));
+    }
+    
     template class OrientationPosteriorResampler<State>;
 }
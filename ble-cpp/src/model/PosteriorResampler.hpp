@@ -27,6 +27,7 @@
 #include <memory>
 #include "RandomGenerator.hpp"
 #include "State.hpp"
+#include "SnapshotUtils.hpp"
 
 namespace loc {
     
@@ -40,7 +41,7 @@ namespace loc {
     };
     
     template<class Tstate>
-    class OrientationPosteriorResampler : public PosteriorResampler<Tstate>{
+    class OrientationPosteriorResampler : public PosteriorResampler<Tstate>, public Snapshottable{
         
     private:
         std::shared_ptr<RandomGenerator> mRand;
@@ -55,6 +56,9 @@ namespace loc {
         std::vector<Tstate> resample(const std::vector<Tstate>&);
         void probabilityParametric(double);
         double probabilityParametric() const;
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
     };
 }
 
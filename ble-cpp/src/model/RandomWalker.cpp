@@ -45,8 +45,9 @@ namespace loc{
         double z = loc.z();
         double floor = loc.floor();
         
-        x += mRWProperty->sigma * mRandGen->nextGaussian();
-        y += mRWProperty->sigma * mRandGen->nextGaussian();
+        RandomGenerator& rand = mPredictionStreams.next(*mRandGen);
+        x += mRWProperty->sigma * rand.nextGaussian();
+        y += mRWProperty->sigma * rand.nextGaussian();
         
         State locNew;
         locNew.x(x).y(y).z(z).floor(floor);
@@ -65,6 +66,26 @@ namespace loc{
         return locsNew;
     }
     
+    template<class Ts, class Tin>
+    void RandomWalker<Ts, Tin>::startPredictions(const std::vector<Ts>& states, const Tin& input){
+        mPredictionStreams.begin(*mRandGen);
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalker<Ts, Tin>::endPredictions(const std::vector<Ts>& states, const Tin& input){
+        mPredictionStreams.end();
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalker<Ts, Tin>::saveState(SnapshotOutputArchive& ar) const{
+        ar(cereal::make_nvp("randomGenerator", *mRandGen));
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalker<Ts, Tin>::loadState(SnapshotInputArchive& ar){
+        ar(cereal::make_nvp("randomGenerator", *mRandGen));
+    }
+    
     // Explicit instantiation
     template class RandomWalker<State, RandomWalkerInput>;
 }
@@ -43,7 +43,7 @@ namespace loc{
     };
     
     template<class Ts=State, class Tin=SystemModelInput>
-    class RandomWalker : public SystemModel<Ts, Tin>{
+    class RandomWalker : public SystemModel<Ts, Tin>, public Snapshottable{
     
     public:
         RandomWalker(){
@@ -59,10 +59,17 @@ namespace loc{
         virtual RandomWalker<Ts, Tin>& setProperty(RandomWalkerProperty::Ptr property);
         virtual Ts predict(Ts state, Tin input) override;
         virtual std::vector<Ts> predict(std::vector<Ts> states, Tin input) override;
+        virtual void startPredictions(const std::vector<Ts>& states, const Tin& input) override;
+        virtual void endPredictions(const std::vector<Ts>& states, const Tin& input) override;
+        
+        virtual void saveState(SnapshotOutputArchive& ar) const override;
+        virtual void loadState(SnapshotInputArchive& ar) override;
         
     protected:
         RandomWalkerProperty::Ptr mRWProperty;
         std::shared_ptr<RandomGenerator> mRandGen;
+        // Each prediction in a pass draws from its own substream of mRandGen
+        SubstreamSequence mPredictionStreams;
     };
     
 }
@@ -22,12 +22,12 @@
 
 #include "RandomWalkerMotion.hpp"
 #include "PoseRandomWalker.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
     template<class Ts, class Tin>
     Ts RandomWalkerMotion<Ts, Tin>::predict(Ts state, Tin input){
-        auto& mRandGen = RandomWalker<Ts, Tin>::mRandGen;
         const auto& mPedometer = mRWMotionProperty->pedometer();
         const auto& mOrientationMeter = mRWMotionProperty->orientationMeter();
         
@@ -36,12 +36,13 @@ namespace loc{
         double dt = (t_cur-t_pre)*input.timeUnit();
         
         if(dt < 0){
-            std::cerr << "Inconsistent timestamp found in RandomWalkerMotion. Location was not updated." << std::endl;
+            LOC_LOG_WARN(MODEL, "Inconsistent timestamp found in RandomWalkerMotion. Location was not updated.");
             return state;
         }
         
         if(mPedometer && mOrientationMeter){
             double movLevel = movingLevel();
+            bool coalesced = input.hasMotionSummary() && !this->isUnderControll;
             double x = state.x();
             double y = state.y();
             double z = state.z();
@@ -52,7 +53,7 @@ namespace loc{
             }
             
             // Compute velocity rate to reduce velocity when turning
-            if(mRWMotionProperty->usesAngularVelocityLimit()){
+            if(mRWMotionProperty->usesAngularVelocityLimit() && !coalesced){
                 double yaw =  Pose::normalizeOrientaion(mOrientationMeter->getYaw());
                 if(!wasYawUpdated){
                     currentTimestamp = t_cur;
@@ -88,8 +89,17 @@ namespace loc{
             // Multyply sigma by turning velocity rate
             sigma = sigma * turningVelocityRate;
             
-            double nx = mRandGen->nextGaussian();
-            double ny = mRandGen->nextGaussian();
+            if(coalesced){
+                // displacement over the interval with the moving sigma while walking and the stopping sigma otherwise
+                double sigmaMove = mRWMotionProperty->sigmaMove;
+                double sigmaStop = mRWMotionProperty->sigmaStop;
+                double tStop = std::max(0.0, dt - input.walkingTime());
+                sigma = velocityRate() * std::sqrt(sigmaMove*sigmaMove*input.walkingTime() + sigmaStop*sigmaStop*tStop) / dt;
+            }
+            
+            RandomGenerator& rand = this->mPredictionStreams.next(*this->mRandGen);
+            double nx = rand.nextGaussian();
+            double ny = rand.nextGaussian();
             double theta = std::atan2(ny, nx);
             
             double vx = sigma * nx;
@@ -129,6 +139,22 @@ namespace loc{
         }
     }
     
+    template<class Ts, class Tin>
+    void RandomWalkerMotion<Ts, Tin>::saveState(SnapshotOutputArchive& ar) const{
+        RandomWalker<Ts, Tin>::saveState(ar);
+        ar(CEREAL_NVP(velocityRate_), CEREAL_NVP(relativeVelocity_));
+        ar(CEREAL_NVP(isUnderControll), CEREAL_NVP(mMovement));
+        ar(CEREAL_NVP(turningVelocityRate), CEREAL_NVP(currentTimestamp), CEREAL_NVP(currentYaw), CEREAL_NVP(wasYawUpdated));
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalkerMotion<Ts, Tin>::loadState(SnapshotInputArchive& ar){
+        RandomWalker<Ts, Tin>::loadState(ar);
+        ar(CEREAL_NVP(velocityRate_), CEREAL_NVP(relativeVelocity_));
+        ar(CEREAL_NVP(isUnderControll), CEREAL_NVP(mMovement));
+        ar(CEREAL_NVP(turningVelocityRate), CEREAL_NVP(currentTimestamp), CEREAL_NVP(currentYaw), CEREAL_NVP(wasYawUpdated));
+    }
+    
     // Explicit instantiation
     template class RandomWalkerMotion<State, RandomWalkerInput>;
 }
@@ -86,6 +86,9 @@ namespace loc{
         
         virtual Ts predict(Ts state, Tin input) override;
         virtual RandomWalkerMotion& setProperty(RandomWalkerMotionProperty::Ptr);
+        
+        virtual void saveState(SnapshotOutputArchive& ar) const override;
+        virtual void loadState(SnapshotInputArchive& ar) override;
 
     protected:
         RandomWalkerMotionProperty::Ptr mRWMotionProperty;
@@ -26,8 +26,10 @@
 #include <stdio.h>
 #include <vector>
 #include <memory>
+#include <cmath>
 
 #include "Location.hpp"
+#include "SnapshotUtils.hpp"
 
 namespace loc{
     
@@ -35,6 +37,13 @@ class SystemModelInput{
     long timestamp_;
     long previousTimestamp_;
     static constexpr double timeUnit_ = 0.001; // ms to s
+    
+    // Motion accumulated over several pedometer updates when predictions are coalesced
+    bool hasMotionSummary_ = false;
+    double walkingTime_ = 0; // [s]
+    double headingX_ = 0; // sum of dt*cos(yaw) while walking [s]
+    double headingY_ = 0; // sum of dt*sin(yaw) while walking [s]
+    int samples_ = 1; // number of pedometer updates in the summary
         
 public:
     void timestamp(long timestamp){
@@ -54,6 +63,30 @@ public:
     double timeUnit() const{
         return timeUnit_;
     }
+    
+    void motionSummary(double walkingTime, double headingX, double headingY, int samples){
+        hasMotionSummary_ = true;
+        walkingTime_ = walkingTime;
+        headingX_ = headingX;
+        headingY_ = headingY;
+        samples_ = samples;
+    }
+    bool hasMotionSummary() const{
+        return hasMotionSummary_;
+    }
+    double walkingTime() const{
+        return walkingTime_;
+    }
+    // Walking time projected on the mean heading. It is shorter than walkingTime when the user turned.
+    double effectiveWalkingTime() const{
+        return std::sqrt(headingX_*headingX_ + headingY_*headingY_);
+    }
+    double meanWalkingYaw() const{
+        return std::atan2(headingY_, headingX_);
+    }
+    int samples() const{
+        return samples_;
+    }
 };
     
     template<class Ts, class Tin> class SystemModel{
@@ -68,6 +101,13 @@ public:
         virtual std::vector<Ts> predict(std::vector<Ts> states, Tin input)  = 0;
         //virtual std::vector<Ts>* predict(std::vector<Ts> states) = 0;
         
+        // Predicts states stored as groups of copies: groupSizes[k] consecutive states share the location
+        // of the k-th group (e.g. the offspring of an ancestor after resampling). Models can do the work
+        // that depends only on the location once per group. The predicted states are returned in the same order.
+        virtual std::vector<Ts> predictGrouped(std::vector<Ts> states, const std::vector<int>& groupSizes, Tin input){
+            return predict(states, input);
+        }
+        
         virtual void startPredictions(const std::vector<Ts>& states, const Tin& input){
             // Do nothing in a default method
         }
@@ -20,6 +20,9 @@
  * THE SOFTWARE.
  *******************************************************************************/
 
+#include <typeinfo>
+#include <cmath>
+#include <algorithm>
 #include "SystemModelInBuilding.hpp"
 
 namespace loc{
@@ -193,52 +196,91 @@ namespace loc{
     }
     
     
+    // An input summarizing several pedometer updates stands for that many
+    // transition opportunities, so the per-update probabilities are compounded.
+    template<class Tinput>
+    static int transitionCount(const Tinput& input){
+        return input.hasMotionSummary() ? std::max(1, input.samples()) : 1;
+    }
+    
+    template<class Tinput>
+    static void compoundTransition(double& pUp, double& pDown, double& pStay, const Tinput& input){
+        int n = transitionCount(input);
+        if(n==1 || 1.0<=pStay){
+            return;
+        }
+        double pStayN = std::pow(pStay, n);
+        double scale = (1.0 - pStayN)/(1.0 - pStay);
+        pUp *= scale;
+        pDown *= scale;
+        pStay = pStayN;
+    }
+    
     // Function definitions
     
-    template<class Tstate, class Tinput>
-    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::systemModel(typename SystemModelT::Ptr sysModel){
+    template<class Tstate, class Tinput, class Tsys>
+    SystemModelInBuilding<Tstate, Tinput, Tsys>& SystemModelInBuilding<Tstate, Tinput, Tsys>::systemModel(std::shared_ptr<Tsys> sysModel){
+        // predict of Tsys is called without virtual dispatch, so an override in a derived class would be ignored.
+        if(!std::is_abstract<Tsys>::value && sysModel && typeid(*sysModel)!=typeid(Tsys)){
+            BOOST_THROW_EXCEPTION(LocException("The type of the system model does not match the type of SystemModelInBuilding."));
+        }
         mSysModel = sysModel;
+        mSysVelAdj = std::dynamic_pointer_cast<SystemModelVelocityAdjustable>(sysModel);
+        mSysCtrl = std::dynamic_pointer_cast<SystemModelMovementControllable>(sysModel);
         return *this;
     }
     
-    template<class Tstate, class Tinput>
-    SystemModelInBuilding<Tstate, Tinput>::SystemModelInBuilding(typename SystemModelT::Ptr sysModel, Building::Ptr building, SystemModelInBuildingProperty::Ptr property){
-        mSysModel = sysModel;
+    template<class Tstate, class Tinput, class Tsys>
+    SystemModelInBuilding<Tstate, Tinput, Tsys>::SystemModelInBuilding(std::shared_ptr<Tsys> sysModel, Building::Ptr building, SystemModelInBuildingProperty::Ptr property){
+        systemModel(sysModel);
         mBuilding = building;
         mProperty = property;
     }
         
-    template<class Tstate, class Tinput>
-    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::building(Building::Ptr building){
+    template<class Tstate, class Tinput, class Tsys>
+    SystemModelInBuilding<Tstate, Tinput, Tsys>& SystemModelInBuilding<Tstate, Tinput, Tsys>::building(Building::Ptr building){
         mBuilding = building;
         return *this;
     }
     
-    template<class Tstate, class Tinput>
-    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::property(SystemModelInBuildingProperty::Ptr property){
+    template<class Tstate, class Tinput, class Tsys>
+    SystemModelInBuilding<Tstate, Tinput, Tsys>& SystemModelInBuilding<Tstate, Tinput, Tsys>::property(SystemModelInBuildingProperty::Ptr property){
         mProperty = property;
         return *this;
     }
     
-    template<class Tstate, class Tinput>
-    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::altitudeManager(AltitudeManager::Ptr altManager){
+    template<class Tstate, class Tinput, class Tsys>
+    SystemModelInBuilding<Tstate, Tinput, Tsys>& SystemModelInBuilding<Tstate, Tinput, Tsys>::altitudeManager(AltitudeManager::Ptr altManager){
         mAltManager = altManager;
         return *this;
     }
     
-    template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnElevator(const Tstate& state, Tinput input){
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::moveOnElevator(const Tstate& state, Tinput input){
         int f_min = mBuilding->minFloor();
         int f_max = mBuilding->maxFloor();
         int f_current = std::round(state.floor());
         
         // pUp and pDown are currently not used.
-        double pStay = mProperty->probabilityStayElevator();
+        double pStay = std::pow(mProperty->probabilityStayElevator(), transitionCount(input));
         
         Tstate stateNew(state);
         if(f_min == f_max){
             return stateNew;
         }
+        if(auto table = mBuilding->transitionTable()){
+            // Same distribution as the rejection loop below: stay with weight pStay or
+            // move to each of the k elevator floors with weight (1-pStay)/(f_max-f_min).
+            uint64_t targets = table->floorMask(ELEVATOR_TRANSITION, state) & ~table->floorBit(f_current);
+            int k = TransitionTable::countFloors(targets);
+            double wMove = (1.0 - pStay) * k / (f_max - f_min);
+            if(0 < k && pStay < mRandomGenerator.nextDouble() * (pStay + wMove)){
+                stateNew.floor(table->nthFloor(targets, mRandomGenerator.nextInt(k-1)));
+            }else{
+                stateNew.floor(f_current);
+            }
+            return stateNew;
+        }
         while(true){
             double p = mRandomGenerator.nextDouble();
             if(p<=pStay){
@@ -267,8 +309,31 @@ namespace loc{
         return stateNew;
     }
     
-    template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnEscalator(const Tstate& state, Tinput input){
+    // Samples the floor after an up/down/stay move, renormalizing the probabilities over the
+    // floors that have the same type of transition area at the location. This is the
+    // distribution the rejection loops in moveOnEscalator and moveOnStair converge to.
+    template<class Tstate, class Tinput, class Tsys>
+    int SystemModelInBuilding<Tstate, Tinput, Tsys>::sampleVerticalMove(const TransitionTable& table, TransitionType type, const Tstate& state, int f, double pUp, double pDown, double pStay){
+        uint64_t mask = table.floorMask(type, state);
+        double wUp = (mask & table.floorBit(f+1)) ? pUp : 0.0;
+        double wDown = (mask & table.floorBit(f-1)) ? pDown : 0.0;
+        double wStay = (mask & table.floorBit(f)) ? pStay : 0.0;
+        double sum = wUp + wDown + wStay;
+        if(sum <= 0){
+            return f;
+        }
+        double p = mRandomGenerator.nextDouble() * sum;
+        if(p < wUp){
+            return f+1;
+        }else if(p - wUp < wDown){
+            return f-1;
+        }else{
+            return f;
+        }
+    }
+    
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::moveOnEscalator(const Tstate& state, Tinput input){
         // TODO: many duplications with moveOnStair
         int f_min = mBuilding->minFloor();
         int f_max = mBuilding->maxFloor();
@@ -288,8 +353,14 @@ namespace loc{
             pUp = 0;
             pStay = 1 - pDown;
         }
+        compoundTransition(pUp, pDown, pStay, input);
         
         Tstate stateNew(state);
+        if(auto table = mBuilding->transitionTable()){
+            f_new = sampleVerticalMove(*table, ESCALATOR_TRANSITION, state, f, pUp, pDown, pStay);
+            stateNew.floor(f_new);
+            return stateNew;
+        }
         while(true){
             double p = mRandomGenerator.nextDouble();
             if(p < pUp){
@@ -311,8 +382,8 @@ namespace loc{
     }
     
     
-    template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnStair(const Tstate& state, Tinput input){
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::moveOnStair(const Tstate& state, Tinput input){
         int f_min = mBuilding->minFloor();
         int f_max = mBuilding->maxFloor();
         int f = state.floor();
@@ -331,8 +402,14 @@ namespace loc{
             pUp = 0;
             pStay = 1 - pDown;
         }
+        compoundTransition(pUp, pDown, pStay, input);
         
         Tstate stateNew(state);
+        if(auto table = mBuilding->transitionTable()){
+            f_new = sampleVerticalMove(*table, STAIR_TRANSITION, state, f, pUp, pDown, pStay);
+            stateNew.floor(f_new);
+            return stateNew;
+        }
         while(true){
             double p = mRandomGenerator.nextDouble();
             if(p < pUp){
@@ -368,22 +445,38 @@ namespace loc{
         return stateNew;
     }
 
-    template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnFloor(const Tstate& state, Tinput input){
-        if(! mBuilding->isMovable(state)){
+    template<class Tstate, class Tinput, class Tsys>
+    typename SystemModelInBuilding<Tstate, Tinput, Tsys>::LocationClass SystemModelInBuilding<Tstate, Tinput, Tsys>::classify(const Tstate& state) const{
+        LocationClass cls;
+        cls.movable = mBuilding->isMovable(state);
+        cls.elevator = cls.movable && mBuilding->isElevator(state);
+        cls.escalator = cls.movable && mBuilding->isEscalator(state);
+        cls.stair = cls.movable && mBuilding->isStair(state);
+        cls.escalatorGroup = cls.movable && mBuilding->isEscalatorGroup(state);
+        return cls;
+    }
+    
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::moveOnFloor(const Tstate& state, Tinput input){
+        return moveOnFloor(state, input, classify(state));
+    }
+    
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::moveOnFloor(const Tstate& state, Tinput input, const LocationClass& cls){
+        if(! cls.movable){
             BOOST_THROW_EXCEPTION(LocException("building->isMovable(state) is false"));
         }
         Tstate stateNew(state);
         
-        auto sysVelAdj = std::dynamic_pointer_cast<SystemModelVelocityAdjustable>(mSysModel);
-        auto sysCtrl = std::dynamic_pointer_cast<SystemModelMovementControllable>(mSysModel);
+        SystemModelVelocityAdjustable* sysVelAdj = mSysVelAdj.get();
+        SystemModelMovementControllable* sysCtrl = mSysCtrl.get();
         if(sysVelAdj!=NULL){
              // Change field velocity
-             if(mBuilding->isElevator(state)){
+             if(cls.elevator){
                  sysVelAdj->velocityRate(mProperty->velocityRateElevator());
-             }else if(mBuilding->isStair(state)){
+             }else if(cls.stair){
                  sysVelAdj->velocityRate(mProperty->velocityRateStair());
-             }else if(mBuilding->isEscalatorGroup(state)){
+             }else if(cls.escalatorGroup){
                  sysVelAdj->velocityRate(mProperty->velocityRateEscalator());
                  sysVelAdj->relativeVelocity(mProperty->relativeVelocityEscalator());
              }else{
@@ -391,13 +484,13 @@ namespace loc{
              }
         }
         if(sysCtrl!=NULL){
-            if(mBuilding->isEscalatorGroup(state)){
+            if(cls.escalatorGroup){
                 sysCtrl->forceMove();
             }
         }
         // Update state
         for(int i=0; i<mProperty->maxTrial() ; i++){
-            stateNew = mSysModel->predict(state, input);
+            stateNew = predictBySystemModel(state, input);
             if(mBuilding->checkMovableRoute(state, stateNew)){
                 break;
             }else if(i==mProperty->maxTrial()-1){
@@ -424,8 +517,8 @@ namespace loc{
         return stateNew;
     }
     
-    template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnFloorRetry(const Tstate& state, const Tstate& stateNew, Tinput input){
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::moveOnFloorRetry(const Tstate& state, const Tstate& stateNew, Tinput input){
         Tstate stateTmp(stateNew);
         if( mRandomGenerator.nextDouble() < mProperty->wallCrossingAliveRate()){
             double orientation = atan2(stateNew.y() - state.y(), stateNew.x() - state.x());
@@ -450,8 +543,8 @@ namespace loc{
         return stateTmp;
     }
     
-    template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveFloorJump(const Tstate& state, Tinput input){
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::moveFloorJump(const Tstate& state, Tinput input){
         int f_min = mBuilding->minFloor();
         int f_max = mBuilding->maxFloor();
         Tstate stateNew(state);
@@ -468,33 +561,39 @@ namespace loc{
         return stateNew;
     }
     
-    template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::predict(Tstate state, Tinput input){
-        if(! mBuilding->isMovable(state)){
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::predict(Tstate state, Tinput input){
+        return predict(state, input, classify(state));
+    }
+    
+    template<class Tstate, class Tinput, class Tsys>
+    Tstate SystemModelInBuilding<Tstate, Tinput, Tsys>::predict(const Tstate& state, const Tinput& input, const LocationClass& cls){
+        if(! cls.movable){
             BOOST_THROW_EXCEPTION(LocException("building->isMovable(state) == false"));
         }
         try{
             // Jumping move
-            if(mRandomGenerator.nextDouble() < mProperty->probabilityFloorJump()){
+            double pJump = 1.0 - std::pow(1.0 - mProperty->probabilityFloorJump(), transitionCount(input));
+            if(mRandomGenerator.nextDouble() < pJump){
                 Tstate stateTmp = moveFloorJump(state, input);
                 return moveOnFloor(stateTmp, input);
             }
             // Standard move
-            if(mBuilding->isElevator(state)){
+            if(cls.elevator){
                 Tstate stateTmp = moveOnElevator(state, input);
                 if(Location::floorDifference(state, stateTmp)==0){
                     return moveOnFloor(stateTmp, input);
                 }else{
                     return stateTmp;
                 }
-            }else if(mBuilding->isEscalator(state)){ // escalator move is not allowed on escalator end
+            }else if(cls.escalator){ // escalator move is not allowed on escalator end
                 State stateTmp = moveOnEscalator(state, input);
                 return moveOnFloor(stateTmp, input);
-            }else if(mBuilding->isStair(state)){
+            }else if(cls.stair){
                 State stateTmp = moveOnStair(state, input);
                 return moveOnFloor(stateTmp, input);
             }else{
-                return moveOnFloor(state, input);
+                return moveOnFloor(state, input, cls);
             }
         }catch(LocException& ex){
             ex << boost::error_info<struct err_info, std::string>("Failed prediction at a given location (" + static_cast<Location>(state).toString() + ")");
@@ -502,8 +601,8 @@ namespace loc{
         }
     }
 
-    template<class Tstate, class Tinput>
-    std::vector<Tstate> SystemModelInBuilding<Tstate, Tinput>::predict(std::vector<Tstate> states, Tinput input){
+    template<class Tstate, class Tinput, class Tsys>
+    std::vector<Tstate> SystemModelInBuilding<Tstate, Tinput, Tsys>::predict(std::vector<Tstate> states, Tinput input){
         std::vector<Tstate> statesPredicted(states.size());
         mSysModel->startPredictions(states, input);
         for(int i=0; i<states.size(); i++){
@@ -514,11 +613,51 @@ namespace loc{
         return statesPredicted;
     }
     
-    template<class Tstate, class Tinput>
-    void SystemModelInBuilding<Tstate, Tinput>::notifyObservationUpdated(){
+    // Gives the same states as predict(states, input) for the same random numbers.
+    template<class Tstate, class Tinput, class Tsys>
+    std::vector<Tstate> SystemModelInBuilding<Tstate, Tinput, Tsys>::predictGrouped(std::vector<Tstate> states, const std::vector<int>& groupSizes, Tinput input){
+        std::vector<Tstate> statesPredicted(states.size());
+        mSysModel->startPredictions(states, input);
+        size_t i = 0;
+        for(int groupSize: groupSizes){
+            if(states.size() < i + groupSize){
+                BOOST_THROW_EXCEPTION(LocException("groupSizes do not match the number of states"));
+            }
+            if(groupSize<=0){
+                continue;
+            }
+            LocationClass cls = classify(states[i]);
+            for(size_t end = i + groupSize; i<end; i++){
+                statesPredicted[i] = predict(states[i], input, cls);
+            }
+        }
+        for(; i<states.size(); i++){
+            statesPredicted[i] = predict(states[i], input);
+        }
+        mSysModel->endPredictions(states, input);
+        return statesPredicted;
+    }
+    
+    template<class Tstate, class Tinput, class Tsys>
+    void SystemModelInBuilding<Tstate, Tinput, Tsys>::notifyObservationUpdated(){
         mSysModel->notifyObservationUpdated();
     }
     
+    template<class Tstate, class Tinput, class Tsys>
+    void SystemModelInBuilding<Tstate, Tinput, Tsys>::saveState(SnapshotOutputArchive& ar) const{
+        ar(CEREAL_NVP(mRandomGenerator));
+        saveComponentState(ar, mSysModel);
+    }
+    
+    template<class Tstate, class Tinput, class Tsys>
+    void SystemModelInBuilding<Tstate, Tinput, Tsys>::loadState(SnapshotInputArchive& ar){
+        ar(CEREAL_NVP(mRandomGenerator));
+        loadComponentState(ar, mSysModel);
+    }
+    
     // Explicit instantiation
     template class SystemModelInBuilding<State, SystemModelInput>;
+    template class SystemModelInBuilding<State, SystemModelInput, PoseRandomWalker>;
+    template class SystemModelInBuilding<State, SystemModelInput, RandomWalkerMotion<State, SystemModelInput>>;
+    template class SystemModelInBuilding<State, SystemModelInput, WeakPoseRandomWalker<State, SystemModelInput>>;
 }
@@ -26,6 +26,8 @@
 #include <stdio.h>
 #include "RandomWalker.hpp"
 #include "RandomWalkerMotion.hpp"
+#include "PoseRandomWalker.hpp"
+#include "WeakPoseRandomWalker.hpp"
 #include "Building.hpp"
 #include "AltitudeManager.hpp"
 #include "SerializeUtils.hpp"
@@ -146,8 +148,10 @@ namespace loc{
         }
     };
     
-    template<class Tstate, class Tinput>
-    class SystemModelInBuilding: public SystemModel<Tstate, Tinput>{
+    // Tsys is the type of the wrapped system model. When a concrete model type is given, its per-state predict is
+    // called without virtual dispatch so that it can be inlined into the loop over states.
+    template<class Tstate, class Tinput, class Tsys = SystemModel<Tstate, Tinput>>
+    class SystemModelInBuilding: public SystemModel<Tstate, Tinput>, public Snapshottable{
         
     public:
         using SystemModelT = SystemModel<Tstate, Tinput>;
@@ -155,15 +159,40 @@ namespace loc{
         
     private:
         RandomGenerator mRandomGenerator;
-        typename SystemModel<Tstate, Tinput>::Ptr mSysModel;
+        std::shared_ptr<Tsys> mSysModel;
+        // optional interfaces of mSysModel resolved when it is set
+        std::shared_ptr<SystemModelVelocityAdjustable> mSysVelAdj;
+        std::shared_ptr<SystemModelMovementControllable> mSysCtrl;
         Building::Ptr mBuilding;
         SystemModelInBuildingProperty::Ptr mProperty;
         AltitudeManager::Ptr mAltManager;
         
+        template<class T = Tsys>
+        typename std::enable_if<std::is_abstract<T>::value, Tstate>::type predictBySystemModel(const Tstate& state, const Tinput& input){
+            return mSysModel->predict(state, input);
+        }
+        template<class T = Tsys>
+        typename std::enable_if<!std::is_abstract<T>::value, Tstate>::type predictBySystemModel(const Tstate& state, const Tinput& input){
+            return mSysModel->T::predict(state, input);
+        }
+        
+        // Map lookups at a location on which a prediction depends. Computed once per group of copies.
+        struct LocationClass{
+            bool movable;
+            bool elevator;
+            bool escalator;
+            bool stair;
+            bool escalatorGroup;
+        };
+        LocationClass classify(const Tstate& state) const;
+        Tstate predict(const Tstate& state, const Tinput& input, const LocationClass& cls);
+        
         Tstate moveOnElevator(const Tstate& state, Tinput input);
         Tstate moveOnStair(const Tstate& state, Tinput input);
         Tstate moveOnEscalator(const Tstate& state, Tinput input);
+        int sampleVerticalMove(const TransitionTable& table, TransitionType type, const Tstate& state, int f, double pUp, double pDown, double pStay);
         Tstate moveOnFloor(const Tstate& state, Tinput input);
+        Tstate moveOnFloor(const Tstate& state, Tinput input, const LocationClass& cls);
         Tstate moveOnFloorRetry(const Tstate& state, const Tstate& stateNew,  Tinput input);
         Tstate moveFloorJump(const Tstate& state, Tinput input);
         
@@ -172,24 +201,28 @@ namespace loc{
         SystemModelInBuilding() = default;
         virtual ~SystemModelInBuilding() = default;
         
-        SystemModelInBuilding(typename SystemModelT::Ptr poseRandomWalker, Building::Ptr building, SystemModelInBuildingProperty::Ptr property);
+        SystemModelInBuilding(std::shared_ptr<Tsys> poseRandomWalker, Building::Ptr building, SystemModelInBuildingProperty::Ptr property);
         
-        SystemModelInBuilding& systemModel(typename SystemModelT::Ptr sysModel);
+        SystemModelInBuilding& systemModel(std::shared_ptr<Tsys> sysModel);
         SystemModelInBuilding& building(Building::Ptr building);
         SystemModelInBuilding& property(SystemModelInBuildingProperty::Ptr property);
         SystemModelInBuilding& altitudeManager(AltitudeManager::Ptr altManager);
         
         Tstate predict(Tstate state, Tinput input) override;
         std::vector<Tstate> predict(std::vector<Tstate> states, Tinput input) override;
+        std::vector<Tstate> predictGrouped(std::vector<Tstate> states, const std::vector<int>& groupSizes, Tinput input) override;
         
         virtual void notifyObservationUpdated() override;
         
+        // Includes the state of the wrapped system model.
+        virtual void saveState(SnapshotOutputArchive& ar) const override;
+        virtual void loadState(SnapshotInputArchive& ar) override;
     };
     
     // This class is retained for compatibility.
     using PoseRandomWalkerInBuildingProperty = SystemModelInBuildingProperty;
     
-    class PoseRandomWalkerInBuilding: public SystemModelInBuilding<State, SystemModelInput>{
+    class PoseRandomWalkerInBuilding: public SystemModelInBuilding<State, SystemModelInput, PoseRandomWalker>{
         
     public:
         using Ptr = std::shared_ptr<PoseRandomWalkerInBuilding>;
@@ -197,11 +230,11 @@ namespace loc{
         virtual ~PoseRandomWalkerInBuilding() = default;
         
         virtual void poseRandomWalkerInBuildingProperty(SystemModelInBuildingProperty::Ptr property){
-            SystemModelInBuilding<State, SystemModelInput>::property(property);
+            SystemModelInBuilding<State, SystemModelInput, PoseRandomWalker>::property(property);
         }
         
-        virtual void poseRandomWalker(typename SystemModel<State, SystemModelInput>::Ptr sysModel){
-            SystemModelInBuilding<State, SystemModelInput>::systemModel(sysModel);
+        virtual void poseRandomWalker(std::shared_ptr<PoseRandomWalker> sysModel){
+            SystemModelInBuilding<State, SystemModelInput, PoseRandomWalker>::systemModel(sysModel);
         }
         
     };
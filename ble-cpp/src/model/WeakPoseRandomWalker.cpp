@@ -21,12 +21,12 @@
  *******************************************************************************/
 
 #include "WeakPoseRandomWalker.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
     template<class Ts, class Tin>
     Ts WeakPoseRandomWalker<Ts, Tin>::predict(Ts state, Tin input){
-        auto& mRandGen = RandomWalker<Ts, Tin>::mRandGen;
         auto& mRWMotionProperty = RandomWalkerMotion<Ts,Tin>::mRWMotionProperty;
         const auto& mPedometer = mRWMotionProperty->pedometer();
         const auto& mOrientationMeter = mRWMotionProperty->orientationMeter();
@@ -37,7 +37,7 @@ namespace loc{
         double sqdt = std::sqrt(dt);
         
         if(dt < 0){
-            std::cerr << "Inconsistent timestamp found in WeakPoseRandomWalker. Location was not updated." << std::endl;
+            LOC_LOG_WARN(MODEL, "Inconsistent timestamp found in WeakPoseRandomWalker. Location was not updated.");
             return state;
         }
         
@@ -45,12 +45,18 @@ namespace loc{
             double nSteps = mPedometer->getNSteps();
             double movLevel = RandomWalkerMotion<Ts,Tin>::movingLevel();
             double yaw = mOrientationMeter->getYaw();
+            bool coalesced = input.hasMotionSummary() && !this->isUnderControll;
+            if(coalesced){
+                nSteps = 0<input.walkingTime() ? 1.0 : 0.0;
+                movLevel = nSteps;
+            }
             
             if(dt<input.timeUnit()){
                 throw std::runtime_error("Time increment is too small in WeakPoseRandomWalker.");
             }
             // Compute velocity rate to reduce velocity when turning
-            if(mRWMotionProperty->usesAngularVelocityLimit()){
+            // (turns within a coalesced interval shorten the walking displacement instead)
+            if(mRWMotionProperty->usesAngularVelocityLimit() && !coalesced){
                 if(!wasYawUpdated){ // for the initial loop
                     currentTimestamp = t_cur;
                     currentYaw = yaw;
@@ -75,6 +81,8 @@ namespace loc{
                 turningVelocityRate = 1.0;
             }
             
+            RandomGenerator& rand = this->mPredictionStreams.next(*this->mRandGen);
+            
             // Compute sigma for RandomWalkerMotion
             double sigma = movLevel>0 ? mRWMotionProperty->sigmaMove : mRWMotionProperty->sigmaStop;
             // Multiply sigma by velocity rate and turning velocity rate
@@ -95,18 +103,23 @@ namespace loc{
                     double sqdt_long = std::sqrt(dt_long);
                     // Perturb variables in State (orientationBias, rssiBias)
                     double oriTmp;
-                    if( mRandGen->nextDouble() < wPRWProperty->probabilityOrientationBiasJump()){
-                        oriTmp = Pose::normalizeOrientaion( 2.0 * M_PI * (mRandGen->nextDouble()-0.5));
+                    if( rand.nextDouble() < wPRWProperty->probabilityOrientationBiasJump()){
+                        oriTmp = Pose::normalizeOrientaion( 2.0 * M_PI * (rand.nextDouble()-0.5));
                     }else{
-                        oriTmp = mRandGen->nextWrappedNormal(state.orientationBias(),
+                        oriTmp = rand.nextWrappedNormal(state.orientationBias(),
                                                              mStateProperty->diffusionOrientationBias() * sqdt_long );
                     }
                     state.orientationBias(oriTmp);
-                    state.rssiBias(mRandGen->nextTruncatedGaussian(state.rssiBias(), mStateProperty->diffusionRssiBias() * sqdt_long , mStateProperty->minRssiBias(), mStateProperty->maxRssiBias()));
+                    if(0<state.rssiBiasVariance()){
+                        double stdDiffusion = mStateProperty->diffusionRssiBias() * sqdt_long;
+                        state.rssiBiasVariance(state.rssiBiasVariance() + stdDiffusion*stdDiffusion);
+                    }else{
+                        state.rssiBias(rand.nextTruncatedGaussian(state.rssiBias(), mStateProperty->diffusionRssiBias() * sqdt_long , mStateProperty->minRssiBias(), mStateProperty->maxRssiBias()));
+                    }
                     
                     // Perturb variables in Pose (normal velocity)
                     double nV = state.normalVelocity();
-                    nV = mRandGen->nextTruncatedGaussian(state.normalVelocity(),
+                    nV = rand.nextTruncatedGaussian(state.normalVelocity(),
                                                          mPoseProperty->diffusionVelocity() * sqdt_long,
                                                          mPoseProperty->minVelocity(),
                                                          mPoseProperty->maxVelocity());
@@ -114,7 +127,7 @@ namespace loc{
                     
                     // Assign orientationAlignment
                     state.orientationAlignment(0.0);
-                    if( mRandGen->nextDouble() < wPRWProperty->probabilityBackwardMove()){
+                    if( rand.nextDouble() < wPRWProperty->probabilityBackwardMove()){
                         double oriBW = M_PI;
                         state.orientationAlignment(oriBW);
                     }
@@ -125,26 +138,27 @@ namespace loc{
             double orientationActual = yaw - state.orientationBias();
             if(movLevel>0 ){
                 // Add noise to orientation
-                orientationActual = mRandGen->nextWrappedNormal(orientationActual, mPoseProperty->stdOrientation() * sqdt);
-                if( mRandGen->nextDouble() < wPRWProperty->probabilityOrientationJump() ){
-                    orientationActual = Pose::normalizeOrientaion( 2.0 * M_PI * (mRandGen->nextDouble() - 0.5));
+                orientationActual = rand.nextWrappedNormal(orientationActual, mPoseProperty->stdOrientation() * sqdt);
+                if( rand.nextDouble() < wPRWProperty->probabilityOrientationJump() ){
+                    orientationActual = Pose::normalizeOrientaion( 2.0 * M_PI * (rand.nextDouble() - 0.5));
                 }
             }
             state.orientation(orientationActual);
             
             // Update velocity
-            double v = 0.0;
+            double vWalk = 0.0;
+            double vRel = 0.0;
             if(nSteps > 0){
                 double nV = state.normalVelocity();
-                v = nV * velocityRate() * turningVelocityRate;
+                vWalk = nV * velocityRate() * turningVelocityRate;
             }
             if(relativeVelocity() > 0){
-                v += mRandGen->nextTruncatedGaussian(relativeVelocity(),
-                                                     mPoseProperty->diffusionVelocity()*sqdt,
-                                                     mPoseProperty->minVelocity(),
-                                                     mPoseProperty->maxVelocity());
+                vRel = rand.nextTruncatedGaussian(relativeVelocity(),
+                                                       mPoseProperty->diffusionVelocity()*sqdt,
+                                                       mPoseProperty->minVelocity(),
+                                                       mPoseProperty->maxVelocity());
             }
-            state.velocity(v);
+            state.velocity(vWalk + vRel);
             
             // consider orientation alignment
             double oriActAl = Pose::normalizeOrientaion(orientationActual + state.orientationAlignment());
@@ -152,9 +166,23 @@ namespace loc{
             // Update in-plane coordinate.
             double dx_v = state.velocity()*std::cos(oriActAl) * dt;
             double dy_v = state.velocity()*std::sin(oriActAl) * dt;
+            double noiseStdev = sigma * sqdt;
+            if(coalesced){
+                // Walk along the mean heading of the interval with the orientation noise of this state.
+                double oriNoise = Pose::computeOrientationDifference(yaw - state.orientationBias(), orientationActual);
+                double oriWalk = input.meanWalkingYaw() - state.orientationBias() + oriNoise + state.orientationAlignment();
+                double tWalk = input.effectiveWalkingTime();
+                dx_v = vWalk*std::cos(oriWalk)*tWalk + vRel*std::cos(oriActAl)*dt;
+                dy_v = vWalk*std::sin(oriWalk)*tWalk + vRel*std::sin(oriActAl)*dt;
+                // random walk with the moving sigma while walking and the stopping sigma otherwise
+                double sigmaMove = mRWMotionProperty->sigmaMove;
+                double sigmaStop = mRWMotionProperty->sigmaStop;
+                double tStop = std::max(0.0, dt - input.walkingTime());
+                noiseStdev = velocityRate() * std::sqrt(sigmaMove*sigmaMove*input.walkingTime() + sigmaStop*sigmaStop*tStop);
+            }
             
-            double dx_noise = sigma * mRandGen->nextGaussian() * sqdt;
-            double dy_noise = sigma * mRandGen->nextGaussian() * sqdt;
+            double dx_noise = noiseStdev * rand.nextGaussian();
+            double dy_noise = noiseStdev * rand.nextGaussian();
             
             double poseRwr = wPRWProperty->poseRandomWalkRate();
             double rwr = wPRWProperty->randomWalkRate();
@@ -178,6 +206,7 @@ namespace loc{
     
     template<class Ts, class Tin>
     void WeakPoseRandomWalker<Ts, Tin>::startPredictions(const std::vector<Ts>& states, const Tin& input){
+        RandomWalkerMotion<Ts, Tin>::startPredictions(states, input);
         enabledPredictions = true;
         if(previousTimestampResample==0){
             previousTimestampResample = input.timestamp();
@@ -187,6 +216,7 @@ namespace loc{
     
     template<class Ts, class Tin>
     void WeakPoseRandomWalker<Ts, Tin>::endPredictions(const std::vector<Ts>& states, const Tin& input){
+        RandomWalkerMotion<Ts, Tin>::endPredictions(states, input);
         if(wasFiltered){
             previousTimestampResample = input.timestamp();
         }
@@ -199,6 +229,18 @@ namespace loc{
         wasFiltered = true;
     }
     
+    template<class Ts, class Tin>
+    void WeakPoseRandomWalker<Ts, Tin>::saveState(SnapshotOutputArchive& ar) const{
+        RandomWalkerMotion<Ts, Tin>::saveState(ar);
+        ar(CEREAL_NVP(enabledPredictions), CEREAL_NVP(wasFiltered), CEREAL_NVP(previousTimestampResample));
+    }
+    
+    template<class Ts, class Tin>
+    void WeakPoseRandomWalker<Ts, Tin>::loadState(SnapshotInputArchive& ar){
+        RandomWalkerMotion<Ts, Tin>::loadState(ar);
+        ar(CEREAL_NVP(enabledPredictions), CEREAL_NVP(wasFiltered), CEREAL_NVP(previousTimestampResample));
+    }
+    
     template class WeakPoseRandomWalker<State, SystemModelInput>;
     
 }
@@ -128,6 +128,9 @@ namespace loc {
         virtual void endPredictions(const std::vector<Ts>& states, const Tin&) override;
         virtual void notifyObservationUpdated() override;
         
+        virtual void saveState(SnapshotOutputArchive& ar) const override;
+        virtual void loadState(SnapshotInputArchive& ar) override;
+        
         virtual void setWeakPoseRandomWalkerProperty(WeakPoseRandomWalkerProperty::Ptr wPRWProperty){
             this->wPRWProperty = wPRWProperty;
         }
@@ -24,6 +24,7 @@
 #define Altimeter_hpp
 
 #include <stdio.h>
+#include <cereal/cereal.hpp>
 
 namespace loc{
     class Altimeter{
@@ -40,6 +41,13 @@ namespace loc{
         long timestamp() const;
         double relativeAltitude() const;
         double pressure() const;
+        
+        template<class Archive>
+        void serialize(Archive& ar){
+            ar(CEREAL_NVP(timestamp_));
+            ar(CEREAL_NVP(relativeAltitude_));
+            ar(CEREAL_NVP(pressure_));
+        }
     };
 }
 #endif /* Altimeter_hpp */
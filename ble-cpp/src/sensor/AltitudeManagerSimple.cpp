@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "AltitudeManagerSimple.hpp"
+#include "Logger.hpp"
 #include <sstream>
 #include <valarray>
 
@@ -44,7 +45,7 @@ namespace loc{
         auto last = altimeterQueue.back();
         if(std::abs(last.timestamp() - alt.timestamp()) > mParams->timestampIntervalLimit()){
             if(verbose()){
-                std::cout << "timestamp interval between two altimeters is too large. altitudeManager was reset." << std::endl;
+                LOC_LOG_INFO(SENSOR, "timestamp interval between two altimeters is too large. altitudeManager was reset.");
             }
             altimeterQueue.clear();
         }
@@ -89,10 +90,18 @@ namespace loc{
             retVal =  1.0;
         }
         if(verbose()){
-            std::cout << ss.str() << std::endl;
+            LOC_LOG_DEBUG(SENSOR, ss.str());
         }
         return retVal;
     }
+    
+    void AltitudeManagerSimple::saveState(SnapshotOutputArchive& ar) const{
+        std::lock_guard<std::mutex> lock(mtx_);
+        ar(CEREAL_NVP(altimeterQueue));
+    }
+    
+    void AltitudeManagerSimple::loadState(SnapshotInputArchive& ar){
+        std::lock_guard<std::mutex> lock(mtx_);
+        ar(CEREAL_NVP(altimeterQueue));
+    }
 }
-
-
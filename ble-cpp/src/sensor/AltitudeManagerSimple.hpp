@@ -30,10 +30,11 @@
 #include <deque>
 #include <mutex>
 #include "AltitudeManager.hpp"
+#include "SnapshotUtils.hpp"
 
 namespace loc{
     
-    class AltitudeManagerSimple: public AltitudeManager{
+    class AltitudeManagerSimple: public AltitudeManager, public Snapshottable{
     public:
         using Ptr = std::shared_ptr<AltitudeManagerSimple>;
         
@@ -66,13 +67,16 @@ namespace loc{
         void parameters(std::shared_ptr<Parameters> params);
         void verbose(bool);
         bool verbose() const;
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
     
     protected:
         std::shared_ptr<Parameters> mParams = std::shared_ptr<Parameters>(new Parameters);
         std::deque<Altimeter> altimeterQueue;
         bool verbose_ = false;
     private:
-        std::mutex mtx_;
+        mutable std::mutex mtx_;
     };
 }
 
@@ -30,6 +30,8 @@
 
 #include "Attitude.hpp"
 #include "Heading.hpp"
+#include "Logger.hpp"
+#include "SnapshotUtils.hpp"
 
 #define degToRad(deg) (deg*M_PI/180.0)
 #define radToDeg(rad) (rad*180.0/M_PI)
@@ -37,7 +39,7 @@
 namespace loc{
     
     // start
-    class OrientationDriftAdjusterSimple{
+    class OrientationDriftAdjusterSimple : public Snapshottable{
     public:
         
         class Parameters{
@@ -65,8 +67,8 @@ namespace loc{
         using Ptr = std::shared_ptr<OrientationDriftAdjusterSimple>;
         
     private:
-        std::mutex mtx_;
-        std::mutex mtxHead_;
+        mutable std::mutex mtx_;
+        mutable std::mutex mtxHead_;
     protected:
         std::deque<Attitude> attitudeQueue;
         double driftCoeffAveraged = 0.0;
@@ -164,7 +166,7 @@ namespace loc{
             std::lock_guard<std::mutex> lock(mtx_);
             if(attitudeQueue.size() < (mParams->queueLimit)){
                 if(verbose){
-                    std::cout << "attitudeQueue.size <= queueLimit: timestamp=" << attitude.timestamp() << std::endl;
+                    LOC_LOG_DEBUG(SENSOR, "attitudeQueue.size <= queueLimit: timestamp=" << attitude.timestamp());
                 }
                 attitudeQueue.push_back(attitude);
                 return attitude;
@@ -179,7 +181,7 @@ namespace loc{
             
             if(std::abs(last.timestamp() - att.timestamp()) > mParams->timestampIntervalLimit){
                 if(verbose){
-                    std::cout << "timestamp interval between two attitude is too large. orientationAdjuster was reset." << std::endl;
+                    LOC_LOG_INFO(SENSOR, "timestamp interval between two attitude is too large. orientationAdjuster was reset.");
                 }
                 this->reset();
                 attitudeQueue.push_back(att);
@@ -194,7 +196,7 @@ namespace loc{
             double instantDrift = (att.yaw() - front.yaw())/dt_long;
             
             if(verbose){
-                std::cout << "instantDrift," << instantDrift << std::endl;
+                LOC_LOG_DEBUG(SENSOR, "instantDrift," << instantDrift);
             }
             if(std::abs(instantDrift) < mParams->maxYawRate){
                 if(mParams->usesHeading){
@@ -206,8 +208,8 @@ namespace loc{
                     double h_acc_current = hCurrent.stdev();
                     double vHeading = (h_current - h_front)/dt_long;
                     if(verbose){
-                        std::cout << "vHeading=" << vHeading << ", hFront=" << h_front << ", hCurrent=" << h_current <<
-                        ",hFrontACC=" << h_acc_front << ",hCurrenAcc=" << h_acc_current << std::endl;
+                        LOC_LOG_DEBUG(SENSOR, "vHeading=" << vHeading << ", hFront=" << h_front << ", hCurrent=" << h_current <<
+                        ",hFrontACC=" << h_acc_front << ",hCurrenAcc=" << h_acc_current);
                     }
                     if(std::abs(vHeading) < mParams->maxHeadingRate
                        && 0<=h_acc_front && h_acc_front<mParams->maxHeadingAccuracy
@@ -239,8 +241,8 @@ namespace loc{
             attAdj.yaw(yawAdj);
             
             if(verbose){
-                std::cout << "YawAdjustement: timestamp=" << att.timestamp() <<", yaw=" << att.yaw() << ", yawAdj=" << yawAdj <<", currentDrift=" << currentDrift
-                << ", dt_long=" << dt_long << ",dt_short=" << dt_short  << ",queue.size=" << attitudeQueue.size() << std::endl;
+                LOC_LOG_DEBUG(SENSOR, "YawAdjustement: timestamp=" << att.timestamp() <<", yaw=" << att.yaw() << ", yawAdj=" << yawAdj <<", currentDrift=" << currentDrift
+                << ", dt_long=" << dt_long << ",dt_short=" << dt_short  << ",queue.size=" << attitudeQueue.size());
             }
             
             return attAdj;
@@ -281,7 +283,7 @@ namespace loc{
                 if(std::abs(last.timestamp() - heading.timestamp()) > mParams->timestampIntervalLimit){
                     this->reset();
                     if(verbose){
-                        std::cout << "timestamp interval between two heading is too large. orientationAdjuster was reset." << std::endl;
+                        LOC_LOG_INFO(SENSOR, "timestamp interval between two heading is too large. orientationAdjuster was reset.");
                     }
                 }
                 if(mParams->headingQueueLimit < headingQueue.size()){
@@ -295,6 +297,20 @@ namespace loc{
                 }
             }
         }
+        
+        void saveState(SnapshotOutputArchive& ar) const override{
+            std::lock_guard<std::mutex> lock(mtx_);
+            std::lock_guard<std::mutex> lockHead(mtxHead_);
+            ar(CEREAL_NVP(attitudeQueue), CEREAL_NVP(driftCoeffAveraged), CEREAL_NVP(currentDrift));
+            ar(CEREAL_NVP(headingQueue));
+        }
+        
+        void loadState(SnapshotInputArchive& ar) override{
+            std::lock_guard<std::mutex> lock(mtx_);
+            std::lock_guard<std::mutex> lockHead(mtxHead_);
+            ar(CEREAL_NVP(attitudeQueue), CEREAL_NVP(driftCoeffAveraged), CEREAL_NVP(currentDrift));
+            ar(CEREAL_NVP(headingQueue));
+        }
     };
 }
 #endif /* OrientationAdjuster_hpp */
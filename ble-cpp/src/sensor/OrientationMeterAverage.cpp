@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "OrientationMeterAverage.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -60,7 +61,7 @@ namespace loc{
             theta = attitude.yaw();
         }
         if(timestamp < prevTimestamp){
-            std::cout << "Inconsistent timestamp was found in OrientationMeter. OrientationMeter status was resetted." << std::endl;
+            LOC_LOG_WARN(SENSOR, "Inconsistent timestamp was found in OrientationMeter. OrientationMeter status was resetted.");
             this->reset();
         }
         
@@ -99,4 +100,12 @@ namespace loc{
         count = 1;
     }
     
+    void OrientationMeterAverage::saveState(SnapshotOutputArchive& ar) const{
+        ar(CEREAL_NVP(prevTimestamp), CEREAL_NVP(theta), CEREAL_NVP(isUpdated_), CEREAL_NVP(count));
+    }
+    
+    void OrientationMeterAverage::loadState(SnapshotInputArchive& ar){
+        ar(CEREAL_NVP(prevTimestamp), CEREAL_NVP(theta), CEREAL_NVP(isUpdated_), CEREAL_NVP(count));
+    }
+    
 }
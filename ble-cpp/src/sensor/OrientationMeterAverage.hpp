@@ -28,6 +28,7 @@
 
 #include "bleloc.h"
 #include "OrientationMeter.hpp"
+#include "SnapshotUtils.hpp"
 
 namespace loc{
     
@@ -56,7 +57,7 @@ namespace loc{
         
     };
     
-    class OrientationMeterAverage : public OrientationMeter{
+    class OrientationMeterAverage : public OrientationMeter, public Snapshottable{
     
     private:
         long prevTimestamp = 0;
@@ -81,6 +82,9 @@ namespace loc{
         bool isUpdated() override;
         double getYaw() override;
         void reset() override;
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
     };
 }
 
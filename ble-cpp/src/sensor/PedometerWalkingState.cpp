@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "PedometerWalkingState.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -37,7 +38,7 @@ namespace loc{
         }
         
         if(timestamp < prevUpdateTime){
-            std::cout << "Inconsistent timestamp was found in Pedometer. Pedometer status was resetted." << std::endl;
+            LOC_LOG_WARN(SENSOR, "Inconsistent timestamp was found in Pedometer. Pedometer status was resetted.");
             this->reset();
         }
         
@@ -104,5 +105,15 @@ namespace loc{
         amplitudesQueue.clear();
     }
     
+    void PedometerWalkingState::saveState(SnapshotOutputArchive& ar) const{
+        ar(CEREAL_NVP(prevUpdateTime), CEREAL_NVP(isUpdated_), CEREAL_NVP(nSteps));
+        ar(CEREAL_NVP(amplitudesQueue));
+    }
+    
+    void PedometerWalkingState::loadState(SnapshotInputArchive& ar){
+        ar(CEREAL_NVP(prevUpdateTime), CEREAL_NVP(isUpdated_), CEREAL_NVP(nSteps));
+        ar(CEREAL_NVP(amplitudesQueue));
+    }
+    
     
 }
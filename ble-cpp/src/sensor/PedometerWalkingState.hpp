@@ -27,6 +27,7 @@
 #include <deque>
 #include <mutex>
 #include "Pedometer.hpp"
+#include "SnapshotUtils.hpp"
 
 namespace loc{
     
@@ -68,7 +69,7 @@ namespace loc{
     };
     
     
-    class PedometerWalkingState : public Pedometer{
+    class PedometerWalkingState : public Pedometer, public Snapshottable{
         
     private:
         long prevUpdateTime = 0;
@@ -95,6 +96,9 @@ namespace loc{
         bool isUpdated() override;
         double getNSteps() override;
         void reset() override;
+        
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
     };
     
 }
@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "TransformedOrientationMeterAverage.hpp"
+#include "Logger.hpp"
 
 namespace loc{
     
@@ -109,7 +110,7 @@ namespace loc{
             theta = thetaNew;
         }
         if(timestamp < prevTimestamp){
-            std::cout << "Inconsistent timestamp was found in OrientationMeter. OrientationMeter status was resetted." << std::endl;
+            LOC_LOG_WARN(SENSOR, "Inconsistent timestamp was found in OrientationMeter. OrientationMeter status was resetted.");
             this->reset();
         }
         
@@ -147,4 +148,12 @@ namespace loc{
         count = 1;
     }
     
+    void TransformedOrientationMeterAverage::saveState(SnapshotOutputArchive& ar) const{
+        ar(CEREAL_NVP(prevTimestamp), CEREAL_NVP(theta), CEREAL_NVP(isUpdated_), CEREAL_NVP(count));
+    }
+    
+    void TransformedOrientationMeterAverage::loadState(SnapshotInputArchive& ar){
+        ar(CEREAL_NVP(prevTimestamp), CEREAL_NVP(theta), CEREAL_NVP(isUpdated_), CEREAL_NVP(count));
+    }
+    
 }
@@ -28,13 +28,14 @@
 
 #include "bleloc.h"
 #include "OrientationMeter.hpp"
+#include "SnapshotUtils.hpp"
 #include "OrientationMeterAverage.hpp"
 
 namespace loc{
     
     using TransformedOrientationMeterAverageParameters = OrientationMeterAverageParameters;
     
-    class TransformedOrientationMeterAverage : public OrientationMeter{
+    class TransformedOrientationMeterAverage : public OrientationMeter, public Snapshottable{
         
     private:
         long prevTimestamp = 0;
@@ -60,6 +61,9 @@ namespace loc{
         double getYaw() override;
         void reset() override;
         
+        void saveState(SnapshotOutputArchive& ar) const override;
+        void loadState(SnapshotInputArchive& ar) override;
+        
         static double transformOrientation(const Attitude& attitude);
     };
 }
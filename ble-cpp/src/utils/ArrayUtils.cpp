@@ -38,20 +38,110 @@ std::vector<double> ArrayUtils::arrayToVector(double *array){
     return std::vector<double>(array, array + size);
 }
 
-std::vector<double> ArrayUtils::computeWeightsFromLogLikelihood(std::vector<double> logLikelihoods){
+std::vector<double> ArrayUtils::computeWeightsFromLogLikelihood(const std::vector<double>& logLikelihoods){
     size_t n = logLikelihoods.size();
     std::vector<double> weights(n);
-    double maxLogLL = *std::max_element(logLikelihoods.begin(), logLikelihoods.end());
+    if(n==0){
+        return weights;
+    }
+    computeNormalizedWeights(logLikelihoods.data(), nullptr, n, weights.data());
+    return weights;
+}
+
+namespace{
+    // Number of independent accumulators used in reductions.
+    // Reductions with a single accumulator are not vectorized without reassociation of floating point operations.
+    const size_t kLanes = 4;
+    // Weights are computed and accumulated block by block while the block is in L1 cache.
+    const size_t kBlock = 64;
+    
+    inline void computeUnnormalizedWeights(const double* logLikelihoods, const double* priorWeights, size_t begin, size_t end,
+                                           double* weights, double alpha, double maxLogLL){
+        if(priorWeights){
+            for(size_t i=begin; i<end; i++){
+                weights[i] = ArrayUtils::expNonPositive(alpha*(logLikelihoods[i] - maxLogLL))*priorWeights[i];
+            }
+        }else{
+            for(size_t i=begin; i<end; i++){
+                weights[i] = ArrayUtils::expNonPositive(alpha*(logLikelihoods[i] - maxLogLL));
+            }
+        }
+    }
+}
+
+ArrayUtils::WeightStatistics ArrayUtils::computeNormalizedWeights(const double* logLikelihoods, const double* priorWeights, size_t n,
+                                                                  double* weights, double alpha, double essThreshold){
+    WeightStatistics stats;
+    if(n==0){
+        return stats;
+    }
+    
+    // Pass 1: max of log-likelihoods
+    const size_t nLanes = n - n%kLanes;
+    double maxLanes[kLanes];
+    for(size_t k=0; k<kLanes; k++){
+        maxLanes[k] = -std::numeric_limits<double>::infinity();
+    }
+    for(size_t i=0; i<nLanes; i+=kLanes){
+        for(size_t k=0; k<kLanes; k++){
+            double l = logLikelihoods[i+k];
+            maxLanes[k] = l > maxLanes[k] ? l : maxLanes[k];
+        }
+    }
+    double maxLogLL = -std::numeric_limits<double>::infinity();
+    for(size_t i=nLanes; i<n; i++){
+        maxLogLL = std::max(maxLogLL, logLikelihoods[i]);
+    }
+    for(size_t k=0; k<kLanes; k++){
+        maxLogLL = std::max(maxLogLL, maxLanes[k]);
+    }
+    stats.maxLogLikelihood = maxLogLL;
+    if(!std::isfinite(maxLogLL)){
+        // weights cannot be computed (all -inf, +inf or NaN)
+        std::fill(weights, weights+n, 0.0);
+        return stats;
+    }
+    const double shift = alpha*maxLogLL;
+    
+    // Pass 2: unnormalized weights, their sum and sum of squares
+    const size_t nBlocks = n - n%kBlock;
+    double sumLanes[kLanes] = {0};
+    double sumSqLanes[kLanes] = {0};
+    for(size_t b=0; b<nBlocks; b+=kBlock){
+        computeUnnormalizedWeights(logLikelihoods, priorWeights, b, b+kBlock, weights, alpha, maxLogLL);
+        for(size_t i=b; i<b+kBlock; i+=kLanes){
+            for(size_t k=0; k<kLanes; k++){
+                double w = weights[i+k];
+                sumLanes[k] += w;
+                sumSqLanes[k] += w*w;
+            }
+        }
+    }
+    computeUnnormalizedWeights(logLikelihoods, priorWeights, nBlocks, n, weights, alpha, maxLogLL);
     double sum = 0;
-    for(int i=0; i<n; i++){
-        double tmp = exp(logLikelihoods.at(i)-maxLogLL);
-        weights[i] = tmp;
-        sum+=tmp;
+    double sumSq = 0;
+    for(size_t i=nBlocks; i<n; i++){
+        sum += weights[i];
+        sumSq += weights[i]*weights[i];
     }
-    for(int i=0; i<n; i++){
-        weights[i] = weights[i]/(sum);
+    for(size_t k=0; k<kLanes; k++){
+        sum += sumLanes[k];
+        sumSq += sumSqLanes[k];
     }
-    return weights;
+    stats.sumWeights = sum;
+    if(!(sum>0)){
+        return stats;
+    }
+    stats.logSumExp = shift + std::log(sum);
+    stats.ess = sum*sum/sumSq;
+    stats.needsResampling = stats.ess <= essThreshold;
+    
+    // Normalization
+    const double invSum = 1.0/sum;
+    for(size_t i=0; i<n; i++){
+        weights[i] *= invSum;
+    }
+    return stats;
 }
 
 Eigen::VectorXd ArrayUtils::vectorToEigenVector(std::vector<double> v){
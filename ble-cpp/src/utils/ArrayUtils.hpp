@@ -28,16 +28,74 @@
 #include <algorithm>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
 #include <Eigen/Core>
 
 class ArrayUtils{
     
 public:
+    // Summary of weights computed by computeNormalizedWeights
+    struct WeightStatistics{
+        double maxLogLikelihood = -std::numeric_limits<double>::infinity();
+        double logSumExp = -std::numeric_limits<double>::infinity(); // log(sum_i prior_i*exp(alpha*logLL_i))
+        double sumWeights = 0; // sum of unnormalized weights (relative to exp(alpha*maxLogLikelihood))
+        double ess = 0; // 1/sum_i(w_i^2) of normalized weights
+        bool needsResampling = false; // ess <= essThreshold
+    };
+    
     static void normalize(double outArray[], const double inArray[], int n);
     static std::vector<double> arrayToVector(double *array);
     
-    static std::vector<double> computeWeightsFromLogLikelihood(std::vector<double> logLikelihoods);
+    static std::vector<double> computeWeightsFromLogLikelihood(const std::vector<double>& logLikelihoods);
+    
+    // Computes normalized weights w_i ~ prior_i*exp(alpha*logLL_i) together with
+    // their log-sum-exp, ESS and the resampling decision in two passes over the inputs.
+    // priorWeights can be null (equal prior weights). weights can alias logLikelihoods.
+    // The loops are branch-free so that they are vectorized by the compiler.
+    static WeightStatistics computeNormalizedWeights(const double* logLikelihoods, const double* priorWeights, size_t n,
+                                                     double* weights, double alpha = 1.0,
+                                                     double essThreshold = -1);
+    
+    // exp(x) for x<=0 without branches.
+    // The relative error is less than 4e-16 (about 2 ulp) for -708<=x<=0.
+    // Returns 0 for x<-708 (std::exp returns a value smaller than 3.3e-308) and for NaN.
+    static inline double expNonPositive(double x){
+        const double log2e = 1.4426950408889634;
+        const double ln2hi = 6.93147180369123816490e-01;
+        const double ln2lo = 1.90821492927058770002e-10;
+        const double shifter = 6755399441055744.0; // 1.5*2^52
+        const double xc = std::min(0.0, std::max(-708.0, x)); // NaN is mapped to -708
+        // n = round(xc/ln2) is held in the low bits of t
+        const double t = xc*log2e + shifter;
+        const double n = t - shifter;
+        const double r = (xc - n*ln2hi) - n*ln2lo; // |r| <= ln2/2
+        // Taylor series up to r^13 (truncation error < 5e-18)
+        double p = 1.0/6227020800.0;
+        p = p*r + 1.0/479001600.0;
+        p = p*r + 1.0/39916800.0;
+        p = p*r + 1.0/3628800.0;
+        p = p*r + 1.0/362880.0;
+        p = p*r + 1.0/40320.0;
+        p = p*r + 1.0/5040.0;
+        p = p*r + 1.0/720.0;
+        p = p*r + 1.0/120.0;
+        p = p*r + 1.0/24.0;
+        p = p*r + 1.0/6.0;
+        p = p*r + 0.5;
+        p = p*r + 1.0;
+        p = p*r + 1.0;
+        // 2^n
+        std::int64_t tBits, shifterBits;
+        std::memcpy(&tBits, &t, sizeof(double));
+        std::memcpy(&shifterBits, &shifter, sizeof(double));
+        std::int64_t scaleBits = (tBits - shifterBits + 1023) << 52;
+        double scale;
+        std::memcpy(&scale, &scaleBits, sizeof(double));
+        return static_cast<double>(x >= -708.0)*(p*scale);
+    }
     
     static Eigen::VectorXd vectorToEigenVector(std::vector<double>);
     static std::vector<double> eigenVectorToEigen(Eigen::VectorXd);
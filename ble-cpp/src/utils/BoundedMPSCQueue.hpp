@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef BoundedMPSCQueue_hpp
+#define BoundedMPSCQueue_hpp
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+namespace loc{
+    
+    // Bounded multi-producer single-consumer queue.
+    // tryPush is wait-free: a producer reserves room in the queue and claims a cell with one fetch_add
+    // each and fails immediately when the queue is full. tryPop never blocks.
+    template<class T>
+    class BoundedMPSCQueue{
+        struct Cell{
+            std::atomic<size_t> sequence; // position+1 after the cell at position was written
+            T data;
+        };
+        
+        std::unique_ptr<Cell[]> buffer_;
+        size_t mask_;
+        alignas(64) std::atomic<size_t> enqueuePos_;
+        // Cells reserved by producers and not yet released by the consumer. A successful reservation
+        // guarantees that the consumer released the claimed cell (capacity positions earlier).
+        alignas(64) std::atomic<size_t> size_;
+        alignas(64) size_t dequeuePos_;
+        
+        static size_t roundUpPowerOfTwo(size_t n){
+            size_t p = 2;
+            while(p<n){
+                p <<= 1;
+            }
+            return p;
+        }
+        
+    public:
+        BoundedMPSCQueue(size_t capacity){
+            size_t n = roundUpPowerOfTwo(capacity);
+            buffer_.reset(new Cell[n]);
+            mask_ = n - 1;
+            for(size_t i=0; i<n; i++){
+                buffer_[i].sequence.store(0, std::memory_order_relaxed);
+            }
+            enqueuePos_.store(0, std::memory_order_relaxed);
+            size_.store(0, std::memory_order_relaxed);
+            dequeuePos_ = 0;
+        }
+        
+        BoundedMPSCQueue(const BoundedMPSCQueue&) = delete;
+        BoundedMPSCQueue& operator=(const BoundedMPSCQueue&) = delete;
+        
+        // value is moved only when it was pushed.
+        bool tryPush(T&& value){
+            if(capacity() <= size_.fetch_add(1, std::memory_order_acquire)){
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return false; // full
+            }
+            size_t pos = enqueuePos_.fetch_add(1, std::memory_order_relaxed);
+            Cell& cell = buffer_[pos & mask_];
+            cell.data = std::move(value);
+            cell.sequence.store(pos+1, std::memory_order_release);
+            return true;
+        }
+        
+        // Must be called only from the consumer thread.
+        // Returns false when the queue is empty or the next cell is still being written.
+        bool tryPop(T& value){
+            Cell& cell = buffer_[dequeuePos_ & mask_];
+            if(cell.sequence.load(std::memory_order_acquire) != dequeuePos_+1){
+                return false;
+            }
+            value = std::move(cell.data);
+            dequeuePos_++;
+            size_.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+        
+        size_t sizeApprox() const{
+            return std::min(size_.load(std::memory_order_relaxed), capacity());
+        }
+        
+        size_t capacity() const{
+            return mask_+1;
+        }
+    };
+}
+
+#endif /* BoundedMPSCQueue_hpp */
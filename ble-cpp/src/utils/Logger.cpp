@@ -0,0 +1,263 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "Logger.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include "LocException.hpp"
+
+namespace loc{
+    
+    std::atomic<int> Logger::levels_[Logger::N_COMPONENTS] = {
+        {LEVEL_DEBUG}, {LEVEL_DEBUG}, {LEVEL_DEBUG}, {LEVEL_DEBUG},
+        {LEVEL_DEBUG}, {LEVEL_DEBUG}, {LEVEL_DEBUG}, {LEVEL_DEBUG}
+    };
+    
+    namespace{
+        std::mutex& sinkMutex(){
+            static std::mutex* mtx = new std::mutex();
+            return *mtx;
+        }
+        
+        // Intentionally never destroyed so that messages can be logged from static destructors.
+        LogSink::Ptr& sinkInstance(){
+            static LogSink::Ptr* sink = new LogSink::Ptr();
+            return *sink;
+        }
+        
+        std::string toLower(std::string str){
+            std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+            return str;
+        }
+        
+        std::string trim(const std::string& str){
+            size_t begin = str.find_first_not_of(" \t");
+            if(begin==std::string::npos){
+                return "";
+            }
+            size_t end = str.find_last_not_of(" \t");
+            return str.substr(begin, end-begin+1);
+        }
+    }
+    
+    void Logger::write(Level level, Component component, const std::string& message){
+        LogRecord record;
+        record.level = level;
+        record.component = component;
+        record.time = std::chrono::system_clock::now();
+        record.threadId = std::this_thread::get_id();
+        record.message = message;
+        sink()->write(record);
+    }
+    
+    void Logger::level(Level level){
+        for(auto& l: levels_){
+            l.store(level, std::memory_order_relaxed);
+        }
+    }
+    
+    void Logger::level(Component component, Level level){
+        levels_[component].store(level, std::memory_order_relaxed);
+    }
+    
+    Logger::Level Logger::level(Component component){
+        return static_cast<Level>(levels_[component].load(std::memory_order_relaxed));
+    }
+    
+    void Logger::configure(const std::string& spec){
+        std::stringstream ss(spec);
+        std::string item;
+        while(std::getline(ss, item, ',')){
+            item = trim(item);
+            if(item.empty()){
+                continue;
+            }
+            size_t pos = item.find('=');
+            if(pos==std::string::npos){
+                level(levelFromString(item));
+            }else{
+                level(componentFromString(trim(item.substr(0, pos))), levelFromString(trim(item.substr(pos+1))));
+            }
+        }
+    }
+    
+    void Logger::sink(LogSink::Ptr sink){
+        LogSink::Ptr previous;
+        {
+            std::lock_guard<std::mutex> lock(sinkMutex());
+            previous = sinkInstance();
+            sinkInstance() = sink;
+        }
+        if(previous){
+            previous->flush();
+        }
+    }
+    
+    LogSink::Ptr Logger::sink(){
+        std::lock_guard<std::mutex> lock(sinkMutex());
+        LogSink::Ptr& sink = sinkInstance();
+        if(!sink){
+            sink = std::make_shared<AsyncLogSink>(std::make_shared<ConsoleLogSink>());
+            std::atexit([]{ Logger::flush(); });
+        }
+        return sink;
+    }
+    
+    void Logger::flush(){
+        LogSink::Ptr sink;
+        {
+            std::lock_guard<std::mutex> lock(sinkMutex());
+            sink = sinkInstance();
+        }
+        if(sink){
+            sink->flush();
+        }
+    }
+    
+    std::string Logger::levelToString(Level level){
+        switch(level){
+            case LEVEL_TRACE: return "TRACE";
+            case LEVEL_DEBUG: return "DEBUG";
+            case LEVEL_INFO: return "INFO";
+            case LEVEL_WARN: return "WARN";
+            case LEVEL_ERROR: return "ERROR";
+            case LEVEL_OFF: return "OFF";
+        }
+        return "UNKNOWN";
+    }
+    
+    std::string Logger::componentToString(Component component){
+        switch(component){
+            case GENERAL: return "general";
+            case LOCALIZER: return "localizer";
+            case FILTER: return "filter";
+            case MODEL: return "model";
+            case SAMPLER: return "sampler";
+            case SENSOR: return "sensor";
+            case DATA: return "data";
+            case MAP: return "map";
+            case N_COMPONENTS: break;
+        }
+        return "unknown";
+    }
+    
+    Logger::Level Logger::levelFromString(const std::string& str){
+        std::string s = toLower(str);
+        for(int l = LEVEL_TRACE; l <= LEVEL_OFF; l++){
+            if(s == toLower(levelToString(static_cast<Level>(l)))){
+                return static_cast<Level>(l);
+            }
+        }
+        if(s == "warning"){
+            return LEVEL_WARN;
+        }
+        BOOST_THROW_EXCEPTION(LocException("unknown log level: " + str));
+    }
+    
+    Logger::Component Logger::componentFromString(const std::string& str){
+        std::string s = toLower(str);
+        for(int c = GENERAL; c < N_COMPONENTS; c++){
+            if(s == componentToString(static_cast<Component>(c))){
+                return static_cast<Component>(c);
+            }
+        }
+        BOOST_THROW_EXCEPTION(LocException("unknown log component: " + str));
+    }
+    
+    // ConsoleLogSink
+    
+    void ConsoleLogSink::write(const LogRecord& record){
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::ostream& os = record.level >= Logger::LEVEL_ERROR ? std::cerr : std::cout;
+        os << "[" << Logger::levelToString(record.level) << "][" << Logger::componentToString(record.component) << "] "
+        << record.message << "\n";
+    }
+    
+    void ConsoleLogSink::flush(){
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::cout.flush();
+        std::cerr.flush();
+    }
+    
+    // AsyncLogSink
+    
+    AsyncLogSink::AsyncLogSink(LogSink::Ptr sink, size_t capacity)
+    : mSink(sink), mCapacity(capacity){
+        mThread = std::thread(&AsyncLogSink::run, this);
+    }
+    
+    AsyncLogSink::~AsyncLogSink(){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+            mCondQueued.notify_one();
+        }
+        if(mThread.joinable()){
+            mThread.join();
+        }
+        mSink->flush();
+    }
+    
+    void AsyncLogSink::write(const LogRecord& record){
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(mCapacity <= mQueue.size()){
+            mDropped++;
+            return;
+        }
+        mQueue.push_back(record);
+        mCondQueued.notify_one();
+    }
+    
+    void AsyncLogSink::flush(){
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondWritten.wait(lock, [&]{ return mQueue.empty() && !mWriting; });
+        }
+        mSink->flush();
+    }
+    
+    long AsyncLogSink::dropped() const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mDropped;
+    }
+    
+    void AsyncLogSink::run(){
+        std::deque<LogRecord> records;
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWriting = false;
+                mCondWritten.notify_all();
+                mCondQueued.wait(lock, [&]{ return !mQueue.empty() || mStopping; });
+                if(mQueue.empty() && mStopping){
+                    break;
+                }
+                records.swap(mQueue);
+                mWriting = true;
+            }
+            for(const auto& record: records){
+                mSink->write(record);
+            }
+            records.clear();
+        }
+    }
+}
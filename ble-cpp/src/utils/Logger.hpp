@@ -0,0 +1,178 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef Logger_hpp
+#define Logger_hpp
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// Messages below LOC_LOG_MIN_LEVEL are removed at compile time.
+#define LOC_LOG_LEVEL_TRACE 0
+#define LOC_LOG_LEVEL_DEBUG 1
+#define LOC_LOG_LEVEL_INFO 2
+#define LOC_LOG_LEVEL_WARN 3
+#define LOC_LOG_LEVEL_ERROR 4
+#define LOC_LOG_LEVEL_OFF 5
+
+#ifndef LOC_LOG_MIN_LEVEL
+#define LOC_LOG_MIN_LEVEL LOC_LOG_LEVEL_TRACE
+#endif
+
+// The message is a stream expression (e.g. "ESS=" << ess) that is evaluated only when the level is enabled.
+#define LOC_LOG(level, component, ...) \
+    do{ \
+        if(LOC_LOG_MIN_LEVEL <= (level) && ::loc::Logger::isEnabled((level), (component))){ \
+            std::ostringstream locLogStream_; \
+            locLogStream_ << __VA_ARGS__; \
+            ::loc::Logger::write((level), (component), locLogStream_.str()); \
+        } \
+    }while(0)
+
+#define LOC_LOG_ENABLED(level, component) \
+    (LOC_LOG_MIN_LEVEL <= ::loc::Logger::LEVEL_##level && ::loc::Logger::isEnabled(::loc::Logger::LEVEL_##level, ::loc::Logger::component))
+
+#define LOC_LOG_TRACE(component, ...) LOC_LOG(::loc::Logger::LEVEL_TRACE, ::loc::Logger::component, __VA_ARGS__)
+#define LOC_LOG_DEBUG(component, ...) LOC_LOG(::loc::Logger::LEVEL_DEBUG, ::loc::Logger::component, __VA_ARGS__)
+#define LOC_LOG_INFO(component, ...) LOC_LOG(::loc::Logger::LEVEL_INFO, ::loc::Logger::component, __VA_ARGS__)
+#define LOC_LOG_WARN(component, ...) LOC_LOG(::loc::Logger::LEVEL_WARN, ::loc::Logger::component, __VA_ARGS__)
+#define LOC_LOG_ERROR(component, ...) LOC_LOG(::loc::Logger::LEVEL_ERROR, ::loc::Logger::component, __VA_ARGS__)
+
+namespace loc{
+    
+    class LogRecord;
+    
+    class LogSink{
+    public:
+        using Ptr = std::shared_ptr<LogSink>;
+        virtual ~LogSink() = default;
+        virtual void write(const LogRecord& record) = 0;
+        virtual void flush(){}
+    };
+    
+    class Logger{
+    public:
+        enum Level{
+            LEVEL_TRACE = LOC_LOG_LEVEL_TRACE,
+            LEVEL_DEBUG = LOC_LOG_LEVEL_DEBUG,
+            LEVEL_INFO = LOC_LOG_LEVEL_INFO,
+            LEVEL_WARN = LOC_LOG_LEVEL_WARN,
+            LEVEL_ERROR = LOC_LOG_LEVEL_ERROR,
+            LEVEL_OFF = LOC_LOG_LEVEL_OFF
+        };
+        
+        enum Component{
+            GENERAL = 0,
+            LOCALIZER,
+            FILTER,
+            MODEL,
+            SAMPLER,
+            SENSOR,
+            DATA,
+            MAP,
+            N_COMPONENTS
+        };
+        
+        static bool isEnabled(Level level, Component component){
+            return levels_[component].load(std::memory_order_relaxed) <= level;
+        }
+        static void write(Level level, Component component, const std::string& message);
+        
+        // Runtime levels (LEVEL_DEBUG by default)
+        static void level(Level level);
+        static void level(Component component, Level level);
+        static Level level(Component component);
+        // Sets levels from a spec like "info,filter=debug,model=warn".
+        static void configure(const std::string& spec);
+        
+        // The default sink is an AsyncLogSink writing to the console.
+        static void sink(LogSink::Ptr sink);
+        static LogSink::Ptr sink();
+        static void flush();
+        
+        static std::string levelToString(Level level);
+        static std::string componentToString(Component component);
+        static Level levelFromString(const std::string& str);
+        static Component componentFromString(const std::string& str);
+        
+    private:
+        static std::atomic<int> levels_[N_COMPONENTS];
+    };
+    
+    class LogRecord{
+    public:
+        Logger::Level level = Logger::LEVEL_INFO;
+        Logger::Component component = Logger::GENERAL;
+        std::chrono::system_clock::time_point time;
+        std::thread::id threadId;
+        std::string message;
+    };
+    
+    // Writes "[LEVEL][component] message" to std::cout (std::cerr for errors).
+    class ConsoleLogSink : public LogSink{
+    public:
+        void write(const LogRecord& record) override;
+        void flush() override;
+    private:
+        std::mutex mMutex;
+    };
+    
+    // Passes records to another sink from a background thread.
+    // Records are dropped when the queue is full so that the caller never blocks.
+    class AsyncLogSink : public LogSink{
+    public:
+        AsyncLogSink(LogSink::Ptr sink, size_t capacity = 4096);
+        ~AsyncLogSink();
+        
+        AsyncLogSink(const AsyncLogSink&) = delete;
+        AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+        
+        void write(const LogRecord& record) override;
+        // Blocks until the queued records are written.
+        void flush() override;
+        long dropped() const;
+        
+    private:
+        LogSink::Ptr mSink;
+        size_t mCapacity;
+        std::deque<LogRecord> mQueue;
+        mutable std::mutex mMutex;
+        std::condition_variable mCondQueued;
+        std::condition_variable mCondWritten;
+        bool mStopping = false;
+        bool mWriting = false;
+        long mDropped = 0;
+        std::thread mThread;
+        
+        void run();
+    };
+}
+
+#endif /* Logger_hpp */
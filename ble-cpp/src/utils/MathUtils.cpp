@@ -21,6 +21,8 @@
  *******************************************************************************/
 
 #include <boost/math/distributions/chi_squared.hpp>
+#include <boost/math/special_functions/erf.hpp>
+#include <limits>
 #include "MathUtils.hpp"
 #include "LocException.hpp"
 
@@ -30,6 +32,28 @@ double MathUtils::quantileChiSquaredDistribution(int degreeOfFreedom, double cum
     return x;
 }
 
+double MathUtils::cdfStandardNormal(double x){
+    return 0.5*std::erfc(-x/M_SQRT2);
+}
+
+double MathUtils::ccdfStandardNormal(double x){
+    return 0.5*std::erfc(x/M_SQRT2);
+}
+
+double MathUtils::quantileStandardNormal(double p){
+    return -complementaryQuantileStandardNormal(p);
+}
+
+double MathUtils::complementaryQuantileStandardNormal(double q){
+    if(q<=0){
+        return std::numeric_limits<double>::infinity();
+    }
+    if(1<=q){
+        return -std::numeric_limits<double>::infinity();
+    }
+    return M_SQRT2*boost::math::erfc_inv(2*q);
+}
+
 DirectionalStatistics MathUtils::computeDirectionalStatistics(std::vector<double> orientations){
     size_t n = orientations.size();
     if(n==0){
@@ -58,6 +82,21 @@ WrappedNormalParameter MathUtils::computeWrappedNormalParameters(const std::vect
     double mu = dstats.circularMean();
     double R = 1.0 - dstats.circularVariance();
     
+    return computeWrappedNormalParameter(mu, R, n);
+}
+
+WrappedNormalParameter MathUtils::computeWrappedNormalParameters(double sumCos, double sumSin, size_t n){
+    if(n==0){
+        BOOST_THROW_EXCEPTION(LocException("The number of orientations is zero."));
+    }
+    double x = sumCos/n;
+    double y = sumSin/n;
+    double mu = std::atan2(y,x);
+    double R = std::sqrt(x*x + y*y);
+    return computeWrappedNormalParameter(mu, R, n);
+}
+
+WrappedNormalParameter MathUtils::computeWrappedNormalParameter(double mu, double R, size_t n){
     double R2 = R*R>1.0/n? R*R : 1.0/n;
     double Re2 = (double)n/(n-1)*(R2 - 1.0/n);
     
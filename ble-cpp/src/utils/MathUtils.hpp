@@ -86,6 +86,13 @@ public:
     
     static double quantileChiSquaredDistribution(int degreeOfFreedom, double cumulativeDensity);
     
+    // Standard normal distribution function, its complement and their inverses.
+    // The complementary forms keep full relative precision in the upper tail.
+    static double cdfStandardNormal(double x);
+    static double ccdfStandardNormal(double x);
+    static double quantileStandardNormal(double p);
+    static double complementaryQuantileStandardNormal(double q);
+    
     static double normalizeOrientaion(double orientation){
         double x = std::cos(orientation);
         double y = std::sin(orientation);
@@ -94,5 +101,9 @@ public:
     
     static DirectionalStatistics computeDirectionalStatistics(std::vector<double> orientations);
     static WrappedNormalParameter computeWrappedNormalParameters(const std::vector<double>& orientations);
+    // from the sums of cos and sin of n orientations
+    static WrappedNormalParameter computeWrappedNormalParameters(double sumCos, double sumSin, size_t n);
+private:
+    static WrappedNormalParameter computeWrappedNormalParameter(double mu, double R, size_t n);
 };
 #endif /* MathUtils_hpp */
@@ -0,0 +1,208 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "PhiloxEngine.hpp"
+#include <cmath>
+
+namespace loc{
+    
+    static const std::uint32_t PHILOX_M0 = 0xD2511F53u;
+    static const std::uint32_t PHILOX_M1 = 0xCD9E8D57u;
+    static const std::uint32_t PHILOX_W0 = 0x9E3779B9u;
+    static const std::uint32_t PHILOX_W1 = 0xBB67AE85u;
+    static const int PHILOX_ROUNDS = 10;
+    static const int BATCH_LANES = 4;
+    
+    const std::uint64_t PhiloxEngine::default_seed;
+    
+    PhiloxEngine::PhiloxEngine(){
+        seed(default_seed, 0);
+    }
+    
+    PhiloxEngine::PhiloxEngine(std::uint64_t seed, std::uint64_t stream){
+        this->seed(seed, stream);
+    }
+    
+    void PhiloxEngine::seed(std::uint64_t seed, std::uint64_t stream){
+        key_[0] = static_cast<std::uint32_t>(seed);
+        key_[1] = static_cast<std::uint32_t>(seed >> 32);
+        stream_ = stream;
+        position_ = 0;
+        index_ = 4;
+        for(int i=0; i<4; i++){
+            buffer_[i] = 0;
+        }
+    }
+    
+    std::uint64_t PhiloxEngine::seedValue() const{
+        return (static_cast<std::uint64_t>(key_[1]) << 32) | key_[0];
+    }
+    
+    std::uint64_t PhiloxEngine::stream() const{
+        return stream_;
+    }
+    
+    // The lanes are independent and every step is elementwise, so the loops over lanes vectorize.
+    template<int lanes>
+    static void philoxBlocks(const std::uint32_t key[2], std::uint64_t stream, std::uint64_t start, std::uint32_t c[4][lanes]){
+        for(int l=0; l<lanes; l++){
+            std::uint64_t position = start + l;
+            c[0][l] = static_cast<std::uint32_t>(position);
+            c[1][l] = static_cast<std::uint32_t>(position >> 32);
+            c[2][l] = static_cast<std::uint32_t>(stream);
+            c[3][l] = static_cast<std::uint32_t>(stream >> 32);
+        }
+        std::uint32_t k0 = key[0];
+        std::uint32_t k1 = key[1];
+        for(int r=0; r<PHILOX_ROUNDS; r++){
+            for(int l=0; l<lanes; l++){
+                std::uint64_t p0 = static_cast<std::uint64_t>(PHILOX_M0) * c[0][l];
+                std::uint64_t p1 = static_cast<std::uint64_t>(PHILOX_M1) * c[2][l];
+                std::uint32_t x0 = static_cast<std::uint32_t>(p1 >> 32) ^ c[1][l] ^ k0;
+                std::uint32_t x2 = static_cast<std::uint32_t>(p0 >> 32) ^ c[3][l] ^ k1;
+                c[0][l] = x0;
+                c[1][l] = static_cast<std::uint32_t>(p1);
+                c[2][l] = x2;
+                c[3][l] = static_cast<std::uint32_t>(p0);
+            }
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+    }
+    
+    template<int lanes>
+    void PhiloxEngine::generateBlocks(std::uint32_t out[4][lanes]){
+        philoxBlocks<lanes>(key_, stream_, position_, out);
+    }
+    
+    PhiloxEngine::result_type PhiloxEngine::operator()(){
+        if(4<=index_){
+            std::uint32_t block[4][1];
+            generateBlocks<1>(block);
+            for(int i=0; i<4; i++){
+                buffer_[i] = block[i][0];
+            }
+            position_++;
+            index_ = 0;
+        }
+        return buffer_[index_++];
+    }
+    
+    void PhiloxEngine::discard(unsigned long long z){
+        unsigned long long remaining = 4 - index_;
+        if(z < remaining){
+            index_ += static_cast<int>(z);
+            return;
+        }
+        z -= remaining;
+        index_ = 4;
+        position_ += z/4;
+        int rest = static_cast<int>(z%4);
+        if(0<rest){
+            (*this)();
+            index_ = rest;
+        }
+    }
+    
+    static inline double toUniform(std::uint32_t a, std::uint32_t b){
+        return ((a >> 5) * 67108864.0 + (b >> 6)) * (1.0/9007199254740992.0);
+    }
+    
+    void PhiloxEngine::fillUniform(double out[], std::size_t n){
+        index_ = 4;
+        std::size_t nBlocks = (n+1)/2;
+        std::uint32_t c[4][BATCH_LANES];
+        for(std::size_t b=0; b<nBlocks; b+=BATCH_LANES){
+            philoxBlocks<BATCH_LANES>(key_, stream_, position_ + b, c);
+            for(int l=0; l<BATCH_LANES; l++){
+                std::size_t i = 2*(b+l);
+                if(i<n){
+                    out[i] = toUniform(c[0][l], c[1][l]);
+                }
+                if(i+1<n){
+                    out[i+1] = toUniform(c[2][l], c[3][l]);
+                }
+            }
+        }
+        position_ += nBlocks;
+    }
+    
+    void PhiloxEngine::fillNormal(double out[], std::size_t n){
+        index_ = 4;
+        std::size_t nBlocks = (n+1)/2;
+        std::uint32_t c[4][BATCH_LANES];
+        double radius[BATCH_LANES];
+        double angle[BATCH_LANES];
+        for(std::size_t b=0; b<nBlocks; b+=BATCH_LANES){
+            philoxBlocks<BATCH_LANES>(key_, stream_, position_ + b, c);
+            for(int l=0; l<BATCH_LANES; l++){
+                // u1 in (0, 1] keeps the logarithm finite
+                double u1 = 1.0 - toUniform(c[0][l], c[1][l]);
+                double u2 = toUniform(c[2][l], c[3][l]);
+                radius[l] = std::sqrt(-2.0*std::log(u1));
+                angle[l] = 2.0*M_PI*u2;
+            }
+            for(int l=0; l<BATCH_LANES; l++){
+                std::size_t i = 2*(b+l);
+                if(i<n){
+                    out[i] = radius[l]*std::cos(angle[l]);
+                }
+                if(i+1<n){
+                    out[i+1] = radius[l]*std::sin(angle[l]);
+                }
+            }
+        }
+        position_ += nBlocks;
+    }
+    
+    bool PhiloxEngine::operator==(const PhiloxEngine& right) const{
+        if(key_[0]!=right.key_[0] || key_[1]!=right.key_[1] || stream_!=right.stream_ || position_!=right.position_ || index_!=right.index_){
+            return false;
+        }
+        for(int i=index_; i<4; i++){
+            if(buffer_[i]!=right.buffer_[i]){
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    bool PhiloxEngine::operator!=(const PhiloxEngine& right) const{
+        return !(*this==right);
+    }
+    
+    std::ostream& operator<<(std::ostream& os, const PhiloxEngine& engine){
+        os << engine.key_[0] << " " << engine.key_[1] << " " << engine.stream_ << " " << engine.position_ << " " << engine.index_;
+        for(int i=0; i<4; i++){
+            os << " " << engine.buffer_[i];
+        }
+        return os;
+    }
+    
+    std::istream& operator>>(std::istream& is, PhiloxEngine& engine){
+        is >> engine.key_[0] >> engine.key_[1] >> engine.stream_ >> engine.position_ >> engine.index_;
+        for(int i=0; i<4; i++){
+            is >> engine.buffer_[i];
+        }
+        return is;
+    }
+}
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef PhiloxEngine_hpp
+#define PhiloxEngine_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+
+namespace loc{
+    
+    // Counter-based random number engine Philox4x32-10 [Salmon et al., SC'11].
+    // The seed is the key and the stream id is the upper half of the counter, so engines with
+    // the same seed and different stream ids produce independent sequences and the n-th number
+    // of any stream can be computed without generating the preceding ones.
+    // Satisfies UniformRandomBitGenerator and can be used with the distributions of <random>.
+    class PhiloxEngine{
+    public:
+        using result_type = std::uint32_t;
+        static const std::uint64_t default_seed = 5489u;
+        
+        static constexpr result_type min(){ return 0; }
+        static constexpr result_type max(){ return 0xFFFFFFFFu; }
+        
+        PhiloxEngine();
+        explicit PhiloxEngine(std::uint64_t seed, std::uint64_t stream = 0);
+        
+        void seed(std::uint64_t seed = default_seed, std::uint64_t stream = 0);
+        result_type operator()();
+        void discard(unsigned long long z);
+        
+        std::uint64_t seedValue() const;
+        std::uint64_t stream() const;
+        
+        // Batched generation. Each call starts at the next unused counter block (a partially
+        // consumed block of operator() is skipped) and uses one block per two outputs.
+        // Uniform doubles in [0, 1) with 53 random bits
+        void fillUniform(double out[], std::size_t n);
+        // Standard normal doubles by the Box-Muller transform
+        void fillNormal(double out[], std::size_t n);
+        
+        bool operator==(const PhiloxEngine& right) const;
+        bool operator!=(const PhiloxEngine& right) const;
+        
+        friend std::ostream& operator<<(std::ostream& os, const PhiloxEngine& engine);
+        friend std::istream& operator>>(std::istream& is, PhiloxEngine& engine);
+        
+    private:
+        std::uint32_t key_[2];
+        std::uint64_t stream_;
+        std::uint64_t position_; // index of the next counter block
+        std::uint32_t buffer_[4];
+        int index_; // next unused word of buffer_ (4 if empty)
+        
+        // Generates the blocks at counters position_, ..., position_+lanes-1 into out[word][lane].
+        template<int lanes>
+        void generateBlocks(std::uint32_t out[4][lanes]);
+    };
+}
+
+#endif /* PhiloxEngine_hpp */
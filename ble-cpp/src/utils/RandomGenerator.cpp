@@ -25,9 +25,129 @@
 #include "LocException.hpp"
 #include "MathUtils.hpp"
 #include "sstream"
+#include <limits>
 
 namespace loc{
     
+    struct SeedSequence{
+        bool active = false;
+        std::uint64_t seed = 0;
+        std::uint64_t nextStream = 0;
+    };
+    
+    static thread_local SeedSequence seedSequence;
+    
+    // Intervals beyond this many standard deviations are sampled by Robert's method
+    static const double tailThreshold = 5.0;
+    // Bound on the rejection trials of Robert's method. Each trial is accepted with
+    // probability greater than 0.2, so the bound is practically never reached.
+    static const int maxTailTrials = 64;
+    
+    // Maps uniform numbers in [0, 1) to the standard normal distribution truncated to [a, b]
+    // by the inverse distribution function. The probabilities are taken from the lower or
+    // the upper side, whichever is smaller, so that they do not lose precision.
+    class TruncatedStandardNormalInverse{
+        double a_, b_;
+        double pa_, pb_, qa_, qb_;
+    public:
+        TruncatedStandardNormalInverse(double a, double b) : a_(a), b_(b){
+            pa_ = MathUtils::cdfStandardNormal(a);
+            pb_ = MathUtils::cdfStandardNormal(b);
+            qa_ = MathUtils::ccdfStandardNormal(a);
+            qb_ = MathUtils::ccdfStandardNormal(b);
+        }
+        
+        // u in [0,1) is shifted by half a step of the 53-bit grid into (0,1), and the probabilities are kept
+        // above the smallest normal number, so that an infinite bound is never returned.
+        double operator()(double u) const{
+            static const double halfStep = std::ldexp(1.0, -54);
+            static const double pMin = std::numeric_limits<double>::min();
+            u = std::min(u + halfStep, 1.0 - halfStep);
+            double x;
+            double p = pa_ + u*(pb_-pa_);
+            if(p <= 0.5){
+                x = MathUtils::quantileStandardNormal(std::max(p, pMin));
+            }else{
+                x = MathUtils::complementaryQuantileStandardNormal(std::max(qa_ - u*(qa_-qb_), pMin));
+            }
+            return std::min(std::max(x, a_), b_);
+        }
+    };
+    
+    static void checkTruncatedGaussianParameters(double mean, double min, double max){
+        if(mean < min){
+            std::stringstream ss;
+            ss << "mean < min (" << "mean=" << mean << ", min=" << min << ", max=" << max << ")";
+            BOOST_THROW_EXCEPTION(LocException(ss.str()));
+        }
+        if(max < mean){
+            std::stringstream ss;
+            ss << "max < mean (" << "mean=" << mean << ", min=" << min << ", max=" << max << ")";
+            BOOST_THROW_EXCEPTION(LocException(ss.str()));
+        }
+    }
+    
+    RandomGenerator::SeedScope::SeedScope(long seed){
+        active_ = 0<=seed;
+        wasActive_ = seedSequence.active;
+        seed_ = seedSequence.seed;
+        nextStream_ = seedSequence.nextStream;
+        if(active_){
+            seedSequence.active = true;
+            seedSequence.seed = static_cast<std::uint64_t>(seed);
+            seedSequence.nextStream = 0;
+        }
+    }
+    
+    RandomGenerator::SeedScope::~SeedScope(){
+        if(active_){
+            seedSequence.active = wasActive_;
+            seedSequence.seed = seed_;
+            seedSequence.nextStream = nextStream_;
+        }
+    }
+    
+    RandomGenerator::RandomGenerator(){
+        if(seedSequence.active){
+            engine.seed(seedSequence.seed, seedSequence.nextStream++);
+        }
+    }
+    
+    RandomGenerator::RandomGenerator(std::uint64_t seed, std::uint64_t stream) : engine(seed, stream){
+    }
+    
+    void RandomGenerator::seed(std::uint64_t seed, std::uint64_t stream){
+        engine.seed(seed, stream);
+        uniformDistribution.reset();
+        normalDistribution.reset();
+    }
+    
+    std::uint64_t RandomGenerator::seedValue() const{
+        return engine.seedValue();
+    }
+    
+    std::uint64_t RandomGenerator::stream() const{
+        return engine.stream();
+    }
+    
+    RandomGenerator RandomGenerator::substream(std::uint64_t stream) const{
+        return RandomGenerator(engine.seedValue(), stream);
+    }
+    
+    std::uint64_t RandomGenerator::nextUInt64(){
+        std::uint64_t hi = engine();
+        std::uint64_t lo = engine();
+        return (hi << 32) | lo;
+    }
+    
+    void RandomGenerator::nextDoubles(double out[], std::size_t n){
+        engine.fillUniform(out, n);
+    }
+    
+    void RandomGenerator::nextGaussians(double out[], std::size_t n){
+        engine.fillNormal(out, n);
+    }
+    
     int RandomGenerator::nextInt(int n){
         std::uniform_int_distribution<> uniIntDist(0,n);
         return uniIntDist(engine);
@@ -42,24 +162,60 @@ namespace loc{
     }
     
     double RandomGenerator::nextTruncatedGaussian(double mean, double std, double min, double max){
-        if(mean < min){
-            std::stringstream ss;
-            ss << "mean < min (" << "mean=" << mean << ", min=" << min << ", max=" << ")";
-            BOOST_THROW_EXCEPTION(LocException(ss.str()));
+        checkTruncatedGaussianParameters(mean, min, max);
+        if(!(0 < std) || min == max){
+            return mean;
         }
-        if(max < mean){
+        double value = mean + std*nextTruncatedStandardGaussian((min-mean)/std, (max-mean)/std);
+        return std::min(std::max(value, min), max);
+    }
+    
+    double RandomGenerator::nextTruncatedStandardGaussian(double a, double b){
+        if(!(a < b)){
+            if(a == b){
+                return a;
+            }
             std::stringstream ss;
-            ss << "max < mean (" << "mean=" << mean << ", min=" << min << ", max=" << ")";
+            ss << "b < a (a=" << a << ", b=" << b << ")";
             BOOST_THROW_EXCEPTION(LocException(ss.str()));
         }
-        double value = mean;
-        for(int i=0;i<max_iteration; i++){
-            value = mean + std*nextGaussian();
-            if(min<=value && value<=max){
-                break;
+        if(tailThreshold <= a){
+            return nextTailGaussian(a, b);
+        }
+        if(b <= -tailThreshold){
+            return -nextTailGaussian(-b, -a);
+        }
+        return TruncatedStandardNormalInverse(a, b)(nextDouble());
+    }
+    
+    // Robert's method for 0 < a < b. A short interval is sampled with a uniform proposal,
+    // otherwise the proposal is the exponential distribution shifted to a with the optimal rate.
+    double RandomGenerator::nextTailGaussian(double a, double b){
+        bool usesUniform = (b-a) <= 1.0/a;
+        double lambda = (a + std::sqrt(a*a+4.0))/2.0;
+        for(int i=0; i<maxTailTrials; i++){
+            double z, logRatio;
+            if(usesUniform){
+                z = a + (b-a)*nextDouble();
+                logRatio = (a*a - z*z)/2.0;
+            }else{
+                z = a - std::log(1.0-nextDouble())/lambda;
+                if(b < z){
+                    continue;
+                }
+                logRatio = -(z-lambda)*(z-lambda)/2.0;
             }
+            if(std::log(1.0-nextDouble()) <= logRatio){
+                return z;
+            }
+        }
+        // Not reached in practice. The inverse distribution function is used while the tail
+        // probability is representable, and the exponential approximation of the tail beyond.
+        if(std::numeric_limits<double>::min() < MathUtils::ccdfStandardNormal(a)){
+            return TruncatedStandardNormalInverse(a, b)(nextDouble());
         }
-        return value;
+        double z = a - std::log1p(-nextDouble()*(-std::expm1(-a*(b-a))))/a;
+        return std::min(z, b);
     }
     
     double RandomGenerator::nextWrappedNormal(double mean, double std){
@@ -67,6 +223,27 @@ namespace loc{
         return MathUtils::normalizeOrientaion(val);
     }
     
+    void RandomGenerator::nextTruncatedGaussians(double out[], std::size_t n, double mean, double std, double min, double max){
+        checkTruncatedGaussianParameters(mean, min, max);
+        if(!(0 < std) || min == max){
+            std::fill(out, out+n, mean);
+            return;
+        }
+        // min <= mean <= max, so the interval never lies in a far tail.
+        TruncatedStandardNormalInverse inverse((min-mean)/std, (max-mean)/std);
+        nextDoubles(out, n);
+        for(std::size_t i=0; i<n; i++){
+            double value = mean + std*inverse(out[i]);
+            out[i] = std::min(std::max(value, min), max);
+        }
+    }
+    
+    void RandomGenerator::nextWrappedNormals(double out[], std::size_t n, double mean, double std){
+        nextGaussians(out, n);
+        for(std::size_t i=0; i<n; i++){
+            out[i] = MathUtils::normalizeOrientaion(mean + std*out[i]);
+        }
+    }
     
     std::vector<int> RandomGenerator::randomSet(int n, int k){
         if(n<0 || k<0){
@@ -79,7 +256,7 @@ namespace loc{
         for(int i=0; i<n; i++){
             indices[i] = i;
         }
-        std::random_shuffle(indices.begin(), indices.end());
+        std::shuffle(indices.begin(), indices.end(), engine);
         
         std::vector<int> intSet(k);
         
@@ -89,4 +266,26 @@ namespace loc{
         }
         return intSet;
     }
+    
+    void SubstreamSequence::begin(RandomGenerator& parent){
+        key_ = parent.nextUInt64();
+        next_ = 0;
+        active_ = true;
+    }
+    
+    void SubstreamSequence::end(){
+        active_ = false;
+    }
+    
+    bool SubstreamSequence::active() const{
+        return active_;
+    }
+    
+    RandomGenerator& SubstreamSequence::next(RandomGenerator& parent){
+        if(!active_){
+            return parent;
+        }
+        current_.seed(key_, next_++);
+        return current_;
+    }
 }
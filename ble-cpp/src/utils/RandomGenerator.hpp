@@ -27,28 +27,105 @@
 #include <random>
 #include <algorithm>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <cereal/cereal.hpp>
+#include "PhiloxEngine.hpp"
 
 namespace loc{
     class RandomGenerator{
         
     private:
-        int max_iteration = 1000000;
-        std::mt19937 engine;
+        PhiloxEngine engine;
         std::uniform_real_distribution<> uniformDistribution;
         std::normal_distribution<> normalDistribution;
         
     public:
         using Ptr = std::shared_ptr<RandomGenerator>;
         
-        RandomGenerator() = default;
+        // While a SeedScope is alive, default-constructed generators on the same thread are seeded
+        // with its seed and consecutive stream ids, so the random numbers of a localizer depend only
+        // on the seed and the order in which its components are built. A negative seed does nothing.
+        class SeedScope{
+        public:
+            explicit SeedScope(long seed);
+            ~SeedScope();
+            SeedScope(const SeedScope&) = delete;
+            SeedScope& operator=(const SeedScope&) = delete;
+        private:
+            bool active_;
+            bool wasActive_;
+            std::uint64_t seed_;
+            std::uint64_t nextStream_;
+        };
+        
+        RandomGenerator();
+        explicit RandomGenerator(std::uint64_t seed, std::uint64_t stream = 0);
         ~RandomGenerator() = default;
         
+        void seed(std::uint64_t seed, std::uint64_t stream = 0);
+        std::uint64_t seedValue() const;
+        std::uint64_t stream() const;
+        // A generator with the same seed and another stream id
+        RandomGenerator substream(std::uint64_t stream) const;
+        std::uint64_t nextUInt64();
+        
+
         int nextInt(int n);
         double nextDouble();
         double nextGaussian();
+        // Exact samplers with bounded running time: the inverse distribution function is used
+        // except in the far tails, where Robert's rejection sampler [Robert, Stat. Comput. 1995]
+        // with a uniform or an exponential proposal is used.
         double nextTruncatedGaussian(double mean, double std, double min, double max);
+        // Standard normal truncated to [a, b] (a and b can be infinite)
+        double nextTruncatedStandardGaussian(double a, double b);
         double nextWrappedNormal(double mean, double std);
         std::vector<int> randomSet(int n, int k);
+        
+        // Batched generation (see PhiloxEngine::fillUniform and fillNormal)
+        void nextDoubles(double out[], std::size_t n);
+        void nextGaussians(double out[], std::size_t n);
+        void nextTruncatedGaussians(double out[], std::size_t n, double mean, double std, double min, double max);
+        void nextWrappedNormals(double out[], std::size_t n, double mean, double std);
+        
+    private:
+        double nextTailGaussian(double a, double b);
+        
+    public:
+        
+        // The engine and the distributions (normalDistribution caches its second value) are stored as text.
+        template<class Archive>
+        void save(Archive& ar) const{
+            std::stringstream ss;
+            ss << engine << " " << uniformDistribution << " " << normalDistribution;
+            std::string generatorState = ss.str();
+            ar(CEREAL_NVP(generatorState));
+        }
+        
+        template<class Archive>
+        void load(Archive& ar){
+            std::string generatorState;
+            ar(CEREAL_NVP(generatorState));
+            std::stringstream ss(generatorState);
+            ss >> engine >> uniformDistribution >> normalDistribution;
+        }
+    };
+    
+    // Generators for the predictions of a pass over particles. Between begin and end, each call of next
+    // reseeds a generator to the next stream of a key drawn from the parent, so the noise of a particle
+    // depends only on the key and its index in the pass. Outside a pass, next returns the parent.
+    class SubstreamSequence{
+        RandomGenerator current_{0};
+        std::uint64_t key_ = 0;
+        std::uint64_t next_ = 0;
+        bool active_ = false;
+        
+    public:
+        void begin(RandomGenerator& parent);
+        void end();
+        bool active() const;
+        RandomGenerator& next(RandomGenerator& parent);
     };
     
 }
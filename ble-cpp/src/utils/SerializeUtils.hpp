@@ -23,6 +23,7 @@
 #ifndef EigenSerializeUtils_h
 #define EigenSerializeUtils_h
 
+#include <vector>
 #ifdef ANDROID_STL_EXT
 #include "string_ext.hpp"
 #endif /* ANDROID_STL_EXT */
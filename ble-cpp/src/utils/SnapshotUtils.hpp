@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef SnapshotUtils_hpp
+#define SnapshotUtils_hpp
+
+#include <memory>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/deque.hpp>
+#include <cereal/types/map.hpp>
+
+#include "LocException.hpp"
+
+namespace loc{
+    
+    // Snapshots are written with the cereal binary archive so that doubles are restored bit-exactly.
+    // They are meant to be restored on the same platform by the same build (byte order and the
+    // text format of <random> engines are not portable).
+    using SnapshotOutputArchive = cereal::BinaryOutputArchive;
+    using SnapshotInputArchive = cereal::BinaryInputArchive;
+    
+    // Mixin for components that hold runtime state which has to be captured by a snapshot.
+    class Snapshottable{
+    public:
+        using Ptr = std::shared_ptr<Snapshottable>;
+        virtual ~Snapshottable() = default;
+        virtual void saveState(SnapshotOutputArchive& ar) const = 0;
+        virtual void loadState(SnapshotInputArchive& ar) = 0;
+    };
+    
+    // Components are written with a flag telling whether they had state so that restoring into a
+    // differently configured localizer fails instead of reading garbage.
+    template<class T>
+    void saveComponentState(SnapshotOutputArchive& ar, const std::shared_ptr<T>& component){
+        auto snapshottable = std::dynamic_pointer_cast<Snapshottable>(component);
+        bool hasState = snapshottable!=nullptr;
+        ar(CEREAL_NVP(hasState));
+        if(hasState){
+            snapshottable->saveState(ar);
+        }
+    }
+    
+    template<class T>
+    void loadComponentState(SnapshotInputArchive& ar, const std::shared_ptr<T>& component){
+        auto snapshottable = std::dynamic_pointer_cast<Snapshottable>(component);
+        bool hasState = false;
+        ar(CEREAL_NVP(hasState));
+        if(hasState != (snapshottable!=nullptr)){
+            BOOST_THROW_EXCEPTION(LocException("snapshot does not match the configuration of the localizer"));
+        }
+        if(hasState){
+            snapshottable->loadState(ar);
+        }
+    }
+}
+
+#endif /* SnapshotUtils_hpp */
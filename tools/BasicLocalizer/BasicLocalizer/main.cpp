@@ -74,7 +74,7 @@ void printHelp() {
     std::cout << " -r                  set beacon rssi smooth (default location smooth)" << std::endl;
     std::cout << " -s <double>         use student's t distribution and set nu value" << std::endl;
     std::cout << " -f                  find rssiBias" << std::endl;
-    std::cout << " --lm <string>       set localization mode [ONESHOT,RANDOM_WALK_ACC,RANDOM_WALK_ACC_ATT,WEAK_POSE_RANDOM_WALKER]" << std::endl;
+    std::cout << " --lm <string>       set localization mode [ONESHOT,RANDOM_WALK_ACC,RANDOM_WALK_ACC_ATT,WEAK_POSE_RANDOM_WALKER,GRID_POINT_MASS]" << std::endl;
     std::cout << " --wc                use wheelchair mode set" << std::endl;
     std::cout << " --reset             use reset in log" << std::endl;
     std::cout << " --restart=<outputpath>  use restart in log (outputpath is optional argument)" << std::endl;
@@ -135,6 +135,8 @@ Option parseArguments(int argc, char *argv[]){
                     opt.localizeMode = RANDOM_WALK_ACC_ATT;
                 }else if(strcmp(optarg, "WEAK_POSE_RANDOM_WALKER") == 0){
                     opt.localizeMode = WEAK_POSE_RANDOM_WALKER;
+                }else if(strcmp(optarg, "GRID_POINT_MASS") == 0){
+                    opt.localizeMode = GRID_POINT_MASS;
                 }else{
                     std::cerr << "Unknown localization mode: " << optarg << std::endl;
                     abort();
@@ -371,7 +373,7 @@ int main(int argc, char * argv[]) {
                 }
                 
                 for(loc::Status *st: ud.status_list) {
-                    loc::Location stdev = loc::Location::standardDeviation(*st->states());
+                    loc::Location stdev = st->summary()->standardDeviation();
                     std::cout << rssiBias << "," << stdev << std::endl;
                 }
             }else{
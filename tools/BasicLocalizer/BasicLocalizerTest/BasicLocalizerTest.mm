@@ -23,10 +23,211 @@
 #import <XCTest/XCTest.h>
 #import "Location.hpp"
 #import "State.hpp"
+#import "Status.hpp"
+#import "AncestorResampler.hpp"
+#import "CompressedStates.hpp"
+#import "RandomGenerator.hpp"
+#import "MathUtils.hpp"
+#import "ArrayUtils.hpp"
+#import "BoundedMPSCQueue.hpp"
+#import "AsyncSensorDispatcher.hpp"
+#import "StreamParticleFilter.hpp"
+#import "RandomWalker.hpp"
+#import "PoseRandomWalker.hpp"
+#import "PedometerWalkingState.hpp"
+#import "OrientationMeterAverage.hpp"
+#import "GaussianProcessLDPLMultiModel.hpp"
+#import "OccupancyBitmask.hpp"
+#import "Building.hpp"
+#import "SystemModelInBuilding.hpp"
+#include <fstream>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <sstream>
 
 using namespace loc;
 using namespace std;
 
+// States spread around the origin
+class TestStatusInitializer : public StatusInitializer{
+public:
+    Locations initializeLocations(int n) override{
+        Locations locations;
+        for(const auto& s: initializeStates(n)){
+            locations.push_back(s);
+        }
+        return locations;
+    }
+    Poses initializePoses(int n) override{
+        Poses poses;
+        for(const auto& s: initializeStates(n)){
+            poses.push_back(s);
+        }
+        return poses;
+    }
+    States initializeStates(int n) override{
+        RandomGenerator rand(17);
+        States states(n);
+        for(auto& s: states){
+            s.x(5.0*rand.nextGaussian()).y(5.0*rand.nextGaussian());
+            s.orientation(0.0).velocity(1.0).normalVelocity(1.0);
+            s.weight(1.0/n);
+        }
+        return states;
+    }
+    States resetStates(int n, Pose pose, double orientationMeasured) override{
+        return initializeStates(n);
+    }
+    States resetStates(int n, Pose meanPose, Pose stdevPose, double orientationMeasured) override{
+        return initializeStates(n);
+    }
+    States resetStates(int n, const std::vector<Beacon>& beacons) override{
+        return initializeStates(n);
+    }
+    States initializeStatesFromLocations(const Locations& locations) override{
+        return initializeStates(static_cast<int>(locations.size()));
+    }
+};
+
+// The likelihood is a normal density around x = rssi + 80 of the first beacon
+class TestObservationModel : public ObservationModel<State, Beacons>{
+public:
+    std::vector<State>* update(const std::vector<State>& states, const Beacons& input) override{
+        return nullptr;
+    }
+    std::vector<double> computeLogLikelihood(const std::vector<State>& states, const Beacons& input) override{
+        std::vector<double> logLLs;
+        for(const auto& values: computeLogLikelihoodRelatedValues(states, input)){
+            logLLs.push_back(values[0]);
+        }
+        return logLLs;
+    }
+    std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<State>& states, const Beacons& input) override{
+        double x0 = input.at(0).rssi() + 80;
+        std::vector<std::vector<double>> values;
+        for(const auto& s: states){
+            double d2 = (s.x()-x0)*(s.x()-x0) + s.y()*s.y();
+            values.push_back({-0.5*d2/4.0, d2/4.0, static_cast<double>(input.size()), 0});
+        }
+        return values;
+    }
+};
+
+// A filter with a random walker and the test models above
+static shared_ptr<StreamParticleFilter> makeTestFilter(bool compressesStates){
+    auto filter = make_shared<StreamParticleFilter>();
+    filter->numStates(500);
+    filter->compressesStates(compressesStates);
+    filter->enablesFloorUpdate(false);
+    filter->systemModel(make_shared<RandomWalker<State, SystemModelInput>>());
+    filter->observationModel(make_shared<TestObservationModel>());
+    filter->statusInitializer(make_shared<TestStatusInitializer>());
+    filter->resampler(make_shared<AncestorResampler<State>>());
+    filter->pedometer(make_shared<PedometerWalkingState>());
+    filter->orientationMeter(make_shared<OrientationMeterAverage>());
+    return filter;
+}
+
+// Sensor inputs every 100 ms and beacons every second. The states after each input are appended to outputs.
+static void runTestFilter(StreamParticleFilter& filter, int begin, int end, vector<vector<State>>* outputs){
+    for(int k=begin; k<end; k++){
+        long t = 1000 + 100*k;
+        filter.putAttitude(Attitude(t, 0, 0, 0.01*k));
+        filter.putAcceleration(Acceleration(t, 0, 0, -1.0 + 0.3*sin(0.5*k)));
+        if(k%10==9){
+            Beacons beacons;
+            beacons.push_back(Beacon(1, 1, -80 + 0.05*k));
+            beacons.push_back(Beacon(1, 2, -90));
+            beacons.push_back(Beacon(1, 3, -85));
+            beacons.timestamp(t);
+            filter.putBeacons(beacons);
+        }
+        if(outputs){
+            outputs->push_back(*filter.getStatus()->states());
+        }
+    }
+}
+
+static bool statesAreIdentical(const vector<State>& s1, const vector<State>& s2){
+    if(s1.size()!=s2.size()){
+        return false;
+    }
+    for(size_t i=0; i<s1.size(); i++){
+        if(s1[i].x()!=s2[i].x() || s1[i].y()!=s2[i].y() || s1[i].floor()!=s2[i].floor()
+           || s1[i].orientation()!=s2[i].orientation() || s1[i].velocity()!=s2[i].velocity()
+           || s1[i].rssiBias()!=s2[i].rssiBias() || s1[i].weight()!=s2[i].weight()){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Random wall segments of up to 40 pixels inside a rows x cols image
+static ImageHolder::Points makeRandomWalls(RandomGenerator& rand, int rows, int cols, int numSegments){
+    ImageHolder::Points walls;
+    for(int i=0; i<numSegments; i++){
+        double x = rand.nextDouble()*cols;
+        double y = rand.nextDouble()*rows;
+        double angle = 2.0*M_PI*rand.nextDouble();
+        int length = rand.nextInt(40);
+        for(int j=0; j<=length; j++){
+            int xInt = static_cast<int>(x + j*cos(angle));
+            int yInt = static_cast<int>(y + j*sin(angle));
+            if(0<=xInt && xInt<cols && 0<=yInt && yInt<rows){
+                walls.push_back(ImageHolder::Point(xInt, yInt));
+            }
+        }
+    }
+    return walls;
+}
+
+// Pixel walk of FloorMap::wallCrossingRatio without the bitmask; returns the first sample on a set pixel or n+1
+static int walkPixels(const OccupancyBitmask& mask, double x0, double y0, double dx, double dy, int n){
+    double x = x0;
+    double y = y0;
+    int count = 0;
+    while(count<=n){
+        int xInt = static_cast<int>(std::round(x));
+        int yInt = static_cast<int>(std::round(y));
+        if(0<=yInt && yInt<mask.rows() && 0<=xInt && xInt<mask.cols() && mask.test(yInt, xInt)){
+            return count;
+        }
+        x+=dx;
+        y+=dy;
+        count++;
+    }
+    return count;
+}
+
+// Writes a floor image as a binary PPM in the temporary directory and returns its path
+static string writeTestFloorImage(const string& name, int rows, int cols, const function<Color(int, int)>& colorAt){
+    string path = string([NSTemporaryDirectory() UTF8String]) + name;
+    ofstream ofs(path, ios::binary);
+    ofs << "P6\n" << cols << " " << rows << "\n255\n";
+    for(int y=0; y<rows; y++){
+        for(int x=0; x<cols; x++){
+            Color c = colorAt(y, x);
+            ofs.put(c.r_).put(c.g_).put(c.b_);
+        }
+    }
+    return path;
+}
+
+// Keeps states unchanged so that only floor moves are sampled
+class TestStaySystemModel : public SystemModel<State, SystemModelInput>{
+public:
+    State predict(State state, SystemModelInput input) override{
+        return state;
+    }
+    vector<State> predict(vector<State> states, SystemModelInput input) override{
+        return states;
+    }
+};
+
 @interface BasicLocalizerTest : XCTestCase
 
 @end
@@ -76,4 +277,751 @@ using namespace std;
 - (void)testPNG {
 }
 
+// The mean number of offspring of each state over repeated resampling approaches n*w_i for all the schemes
+- (void)testResamplingOffspringMeans {
+    std::mt19937 gen(0);
+    std::exponential_distribution<> dist(1.0);
+    const int n = 1000;
+    const int repeats = 2000;
+    std::vector<double> weights(n);
+    for(double& w: weights){
+        w = dist(gen);
+    }
+    double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+    
+    auto check = [&](AncestorResampler<State>& resampler){
+        std::vector<int> ancestors(n);
+        std::vector<double> counts(n, 0.0);
+        for(int r=0; r<repeats; r++){
+            resampler.ancestors(&weights[0], n, &ancestors[0]);
+            for(int a: ancestors){
+                XCTAssertTrue(0<=a && a<n);
+                counts[a]++;
+            }
+        }
+        double totalDeviation = 0;
+        for(int i=0; i<n; i++){
+            double expected = n*weights[i]/sum;
+            double mean = counts[i]/repeats;
+            // five times the standard error of a multinomial count (plus the rounding of low-variance schemes)
+            XCTAssertLessThan(std::abs(mean - expected), 5*std::sqrt((expected + 0.25)/repeats));
+            totalDeviation += std::abs(mean - expected);
+        }
+        XCTAssertLessThan(totalDeviation/n, 0.03);
+    };
+    
+    for(int scheme=SYSTEMATIC_RESAMPLING; scheme<=REJECTION_RESAMPLING; scheme++){
+        auto params = std::make_shared<ResamplingParameters>();
+        params->scheme(static_cast<ResamplingScheme>(scheme));
+        AncestorResampler<State> resampler(params);
+        check(resampler);
+    }
+    auto params = std::make_shared<ResamplingParameters>();
+    params->numThreads(4).parallelThreshold(0);
+    AncestorResampler<State> parallelResampler(params);
+    check(parallelResampler);
+}
+
+// Throughput of systematic resampling of 100000 states
+- (void)testResamplingThroughput {
+    std::mt19937 gen(0);
+    std::exponential_distribution<> dist(1.0);
+    const int n = 100000;
+    std::vector<double> weights(n);
+    for(double& w: weights){
+        w = dist(gen);
+    }
+    std::vector<int> ancestors(n);
+    AncestorResampler<State> resampler;
+    // C++ objects are captured by the block as const copies
+    AncestorResampler<State>* resamplerPtr = &resampler;
+    const double* weightsPtr = &weights[0];
+    int* ancestorsPtr = &ancestors[0];
+    [self measureBlock:^{
+        for(int r=0; r<10; r++){
+            resamplerPtr->ancestors(weightsPtr, n, ancestorsPtr);
+        }
+    }];
+}
+
+// Known answer of Philox4x32-10 and thread-count independence of the per-output streams
+- (void)testPhiloxStreams {
+    PhiloxEngine engine(0, 0);
+    std::uint32_t expected[] = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+    for(std::uint32_t e: expected){
+        XCTAssertEqual(engine(), e);
+    }
+    
+    PhiloxEngine a(12345, 7);
+    std::vector<std::uint32_t> values(20);
+    for(auto& v: values){
+        v = a();
+    }
+    PhiloxEngine b(12345, 7);
+    b.discard(13);
+    for(int i=13; i<20; i++){
+        XCTAssertEqual(b(), values[i]);
+    }
+    
+    int n = 10000;
+    std::vector<double> weights(n);
+    RandomGenerator rand(1);
+    rand.nextDoubles(&weights[0], n);
+    std::vector<int> ancestors1(n), ancestors4(n);
+    for(int scheme: {METROPOLIS_RESAMPLING, REJECTION_RESAMPLING}){
+        auto params1 = std::make_shared<ResamplingParameters>();
+        params1->scheme(static_cast<ResamplingScheme>(scheme));
+        auto params4 = std::make_shared<ResamplingParameters>(*params1);
+        params4->numThreads(4).parallelThreshold(0);
+        {
+            RandomGenerator::SeedScope scope(42);
+            AncestorResampler<State> resampler(params1);
+            resampler.ancestors(&weights[0], n, &ancestors1[0]);
+        }
+        {
+            RandomGenerator::SeedScope scope(42);
+            AncestorResampler<State> resampler(params4);
+            resampler.ancestors(&weights[0], n, &ancestors4[0]);
+        }
+        XCTAssertTrue(ancestors1==ancestors4);
+    }
+}
+
+- (void)testTruncatedAndWrappedNormal {
+    // Kolmogorov-Smirnov statistic sqrt(n)*D compared with its critical value at the 0.001 level
+    auto ksStatistic = [](vector<double> xs, function<double(double)> cdf){
+        sort(xs.begin(), xs.end());
+        size_t n = xs.size();
+        double d = 0;
+        for(size_t i=0; i<n; i++){
+            double f = cdf(xs[i]);
+            d = max(d, max(f - double(i)/n, double(i+1)/n - f));
+        }
+        return sqrt(double(n))*d;
+    };
+    const double critical = 1.95;
+    const double inf = numeric_limits<double>::infinity();
+    auto truncatedCdf = [](double x, double a, double b){
+        if(0<=a){
+            double qa = MathUtils::ccdfStandardNormal(a);
+            return (qa - MathUtils::ccdfStandardNormal(x))/(qa - MathUtils::ccdfStandardNormal(b));
+        }
+        double pa = MathUtils::cdfStandardNormal(a);
+        return (MathUtils::cdfStandardNormal(x) - pa)/(MathUtils::cdfStandardNormal(b) - pa);
+    };
+    
+    int n = 20000;
+    vector<double> xs(n);
+    RandomGenerator rand(5);
+    vector<pair<double, double>> intervals = {{-1, 1}, {-0.01, 0.02}, {0, inf}, {2, 2.001}, {-3, 8}, {6, 8}, {10, 10.05}, {-inf, -7}};
+    for(auto& interval: intervals){
+        double a = interval.first, b = interval.second;
+        for(auto& x: xs){
+            x = rand.nextTruncatedStandardGaussian(a, b);
+            XCTAssertTrue(a<=x && x<=b);
+        }
+        auto cdf = [&](double x){ return b<=0 ? 1 - truncatedCdf(-x, -b, -a) : truncatedCdf(x, a, b); };
+        XCTAssertLessThan(ksStatistic(xs, cdf), critical);
+    }
+    
+    rand.nextTruncatedGaussians(&xs[0], n, 1.0, 2.0, 0.0, 5.0);
+    XCTAssertLessThan(ksStatistic(xs, [&](double x){ return truncatedCdf((x-1.0)/2.0, -0.5, 2.0); }), critical);
+    for(auto& x: xs){
+        x = rand.nextTruncatedGaussian(1.0, 2.0, 0.0, 5.0);
+    }
+    XCTAssertLessThan(ksStatistic(xs, [&](double x){ return truncatedCdf((x-1.0)/2.0, -0.5, 2.0); }), critical);
+    
+    double mean = 2.5;
+    for(double stdev: {0.5, 3.0}){
+        rand.nextWrappedNormals(&xs[0], n, mean, stdev);
+        auto cdf = [&](double x){
+            double f = 0;
+            for(int k=-10; k<=10; k++){
+                f += MathUtils::cdfStandardNormal((x - mean + 2*M_PI*k)/stdev) - MathUtils::cdfStandardNormal((-M_PI - mean + 2*M_PI*k)/stdev);
+            }
+            return f;
+        };
+        XCTAssertLessThan(ksStatistic(xs, cdf), critical);
+        double meanCos = 0;
+        for(double x: xs){
+            meanCos += cos(x - mean)/n;
+        }
+        XCTAssertEqualWithAccuracy(meanCos, exp(-stdev*stdev/2), 0.03);
+    }
+}
+
+// The summary of a status follows the published states
+- (void)testStatusSummaryFollowsStates {
+    auto makeStates = [](double offset){
+        auto states = make_shared<vector<State>>(10);
+        for(int i=0; i<10; i++){
+            (*states)[i].x(i + offset);
+            (*states)[i].weight(0.1);
+        }
+        return states;
+    };
+    Status status;
+    auto states = makeStates(0);
+    status.states(states);
+    auto summary = status.summary();
+    XCTAssertEqualWithAccuracy(summary->meanLocation().x(), 4.5, 1e-12);
+    XCTAssertEqualWithAccuracy(status.meanLocation()->x(), 4.5, 1e-12);
+    long version = status.statesVersion();
+    
+    // A filtering step publishes a new vector and leaves the previous one untouched.
+    status.states(makeStates(10));
+    XCTAssertGreaterThan(status.statesVersion(), version);
+    XCTAssertEqualWithAccuracy(status.summary()->meanLocation().x(), 14.5, 1e-12);
+    XCTAssertEqualWithAccuracy(status.meanLocation()->x(), 14.5, 1e-12);
+    XCTAssertEqualWithAccuracy(summary->meanLocation().x(), 4.5, 1e-12);
+    XCTAssertEqualWithAccuracy((*states)[9].x(), 9.0, 1e-12);
+    
+    // States modified in place are summarized again after invalidateSummary.
+    version = status.statesVersion();
+    auto published = status.states();
+    for(auto& s: *published){
+        s.x(s.x() + 1);
+    }
+    status.invalidateSummary();
+    XCTAssertGreaterThan(status.statesVersion(), version);
+    XCTAssertEqualWithAccuracy(status.summary()->meanLocation().x(), 15.5, 1e-12);
+    XCTAssertEqualWithAccuracy(status.meanLocation()->x(), 15.5, 1e-12);
+}
+
+// Merging the moments of the updates in the smoothing window gives the summary of the concatenated states
+- (void)testSmoothedMomentsMatchConcatenatedStates {
+    RandomGenerator rand(11);
+    int nWindow = 5;
+    int nStates = 200;
+    StatesMoments moments;
+    vector<State> concatenated;
+    for(int k=0; k<nWindow; k++){
+        vector<State> states(nStates);
+        for(auto& s: states){
+            s.x(k + 3.0*rand.nextGaussian()).y(-k + 2.0*rand.nextGaussian()).z(0).floor(rand.nextDouble()<0.2 ? 1 : 0);
+            s.orientation(rand.nextWrappedNormal(0.5, 1.0)).velocity(rand.nextDouble()).normalVelocity(1.0);
+            s.rssiBias(rand.nextGaussian());
+            s.weight(rand.nextDouble());
+        }
+        moments += StatesMoments::compute(states);
+        concatenated.insert(concatenated.end(), states.begin(), states.end());
+    }
+    StatesSummary merged(moments);
+    
+    // Summary of the concatenated states as computed before the moments were merged
+    vector<double> weights;
+    double meanRssiBias = 0;
+    for(const auto& s: concatenated){
+        weights.push_back(s.weight());
+        meanRssiBias += s.rssiBias()/concatenated.size();
+    }
+    Pose meanPose = Pose::weightedMean(concatenated, weights);
+    Location stdev = Location::standardDeviation(concatenated);
+    
+    double eps = 1e-9;
+    XCTAssertEqual(merged.size(), concatenated.size());
+    XCTAssertEqualWithAccuracy(merged.meanLocation().x(), meanPose.x(), eps);
+    XCTAssertEqualWithAccuracy(merged.meanLocation().y(), meanPose.y(), eps);
+    XCTAssertEqualWithAccuracy(merged.meanLocation().z(), meanPose.z(), eps);
+    XCTAssertEqualWithAccuracy(merged.meanLocation().floor(), meanPose.floor(), eps);
+    XCTAssertEqualWithAccuracy(merged.meanPose().orientation(), meanPose.orientation(), eps);
+    XCTAssertEqualWithAccuracy(merged.meanPose().velocity(), meanPose.velocity(), eps);
+    XCTAssertEqualWithAccuracy(merged.meanPose().normalVelocity(), meanPose.normalVelocity(), eps);
+    XCTAssertEqualWithAccuracy(merged.standardDeviation().x(), stdev.x(), eps);
+    XCTAssertEqualWithAccuracy(merged.standardDeviation().y(), stdev.y(), eps);
+    XCTAssertEqualWithAccuracy(merged.standardDeviation().floor(), stdev.floor(), eps);
+    XCTAssertEqualWithAccuracy(moments.meanRssiBias(), meanRssiBias, eps);
+    
+    StatesSummary summary = StatesSummary::compute(concatenated);
+    XCTAssertEqualWithAccuracy(merged.covarianceXX(), summary.covarianceXX(), eps);
+    XCTAssertEqualWithAccuracy(merged.covarianceXY(), summary.covarianceXY(), eps);
+    XCTAssertEqualWithAccuracy(merged.variance2D(), summary.variance2D(), eps);
+    XCTAssertEqualWithAccuracy(merged.floorMass(1), summary.floorMass(1), eps);
+    XCTAssertEqualWithAccuracy(merged.effectiveSampleSize(), summary.effectiveSampleSize(), 1e-6);
+}
+
+// Values pushed by several producers are popped in the order of each producer and never beyond the capacity
+- (void)testBoundedMPSCQueue {
+    BoundedMPSCQueue<long> queue(5);
+    XCTAssertEqual(queue.capacity(), (size_t)8);
+    long value = -1;
+    XCTAssertFalse(queue.tryPop(value));
+    for(int round=0; round<3; round++){
+        for(long i=0; i<8; i++){
+            long v = round*8 + i;
+            XCTAssertTrue(queue.tryPush(std::move(v)));
+        }
+        long v = -1;
+        XCTAssertFalse(queue.tryPush(std::move(v)));
+        XCTAssertEqual(queue.sizeApprox(), (size_t)8);
+        for(long i=0; i<8; i++){
+            XCTAssertTrue(queue.tryPop(value));
+            XCTAssertEqual(value, round*8 + i);
+        }
+        XCTAssertFalse(queue.tryPop(value));
+    }
+    
+    const int nProducers = 4;
+    const long nValues = 100000;
+    BoundedMPSCQueue<long> shared(64);
+    vector<thread> producers;
+    for(int p=0; p<nProducers; p++){
+        producers.push_back(thread([&shared, p, nValues]{
+            for(long i=0; i<nValues; i++){
+                long v = p*nValues + i;
+                while(!shared.tryPush(std::move(v))){
+                    this_thread::yield();
+                }
+            }
+        }));
+    }
+    vector<long> next(nProducers, 0);
+    long popped = 0;
+    bool ordered = true;
+    while(popped < nProducers*nValues){
+        XCTAssertLessThanOrEqual(shared.sizeApprox(), shared.capacity());
+        if(shared.tryPop(value)){
+            long p = value/nValues;
+            ordered = ordered && value%nValues==next[p];
+            next[p]++;
+            popped++;
+        }else{
+            this_thread::yield();
+        }
+    }
+    for(auto& t: producers){
+        t.join();
+    }
+    XCTAssertTrue(ordered);
+    XCTAssertFalse(shared.tryPop(value));
+}
+
+// Events that do not fit in the queue are coalesced into the latest event of each type
+- (void)testAsyncSensorDispatcherCoalescing {
+    AsyncSensorParameters params;
+    params.queueCapacity = 4;
+    params.overflowPolicy = COALESCE;
+    params.reorderWindowMS = 0;
+    
+    mutex m;
+    condition_variable cv;
+    bool entered = false, released = false;
+    vector<pair<SensorEvent::Type, long>> processed;
+    AsyncSensorDispatcher dispatcher(params, [&](const SensorEvent& event){
+        unique_lock<mutex> lock(m);
+        processed.push_back(make_pair(event.type, event.timestamp));
+        entered = true;
+        cv.notify_all();
+        cv.wait(lock, [&]{ return released; });
+    });
+    dispatcher.start();
+    
+    // The worker is blocked in the handler while the queue is filled.
+    XCTAssertTrue(dispatcher.push(SensorEvent(Acceleration(0, 0, 0, 0))));
+    {
+        unique_lock<mutex> lock(m);
+        cv.wait(lock, [&]{ return entered; });
+    }
+    for(long t=1; t<=7; t++){
+        XCTAssertTrue(dispatcher.push(SensorEvent(Acceleration(t, 0, 0, 0))));
+    }
+    XCTAssertTrue(dispatcher.push(SensorEvent(Attitude(8, 0, 0, 0))));
+    AsyncSensorStatistics stats = dispatcher.statistics();
+    XCTAssertEqual(stats.coalesced, 2L);
+    XCTAssertEqual(stats.dropped, 0L);
+    XCTAssertEqual(stats.depth, (size_t)7);
+    
+    {
+        lock_guard<mutex> lock(m);
+        released = true;
+        cv.notify_all();
+    }
+    dispatcher.flush();
+    dispatcher.stop();
+    
+    // The queued events and the latest overflowing event of each type are processed in timestamp order.
+    vector<pair<SensorEvent::Type, long>> expected = {
+        {SensorEvent::ACCELERATION, 0}, {SensorEvent::ACCELERATION, 1}, {SensorEvent::ACCELERATION, 2},
+        {SensorEvent::ACCELERATION, 3}, {SensorEvent::ACCELERATION, 4}, {SensorEvent::ACCELERATION, 7},
+        {SensorEvent::ATTITUDE, 8}};
+    XCTAssertTrue(processed==expected);
+    stats = dispatcher.statistics();
+    XCTAssertEqual(stats.processed, 7L);
+    XCTAssertEqual(stats.outOfOrder, 0L);
+    XCTAssertEqual(stats.pushed, 9L);
+}
+
+// The fused weight normalization gives the same weights, log-sum-exp and ESS as separate passes with std::exp
+- (void)testComputeNormalizedWeights {
+    for(double x=-708.0; x<=0.0; x+=0.0137){
+        XCTAssertEqualWithAccuracy(ArrayUtils::expNonPositive(x), exp(x), 4e-16*exp(x));
+    }
+    XCTAssertEqual(ArrayUtils::expNonPositive(-1000.0), 0.0);
+    XCTAssertEqual(ArrayUtils::expNonPositive(-numeric_limits<double>::infinity()), 0.0);
+    
+    RandomGenerator rand(13);
+    for(size_t n: {1, 3, 63, 64, 65, 1000, 1003}){
+        for(double alpha: {1.0, 0.3}){
+            for(bool hasPrior: {false, true}){
+                vector<double> logLLs(n), priors(n);
+                for(size_t i=0; i<n; i++){
+                    double u = rand.nextDouble();
+                    logLLs[i] = u<0.05 ? -numeric_limits<double>::infinity() : u<0.1 ? -2000.0*rand.nextDouble() : -50.0*rand.nextDouble();
+                    priors[i] = rand.nextDouble();
+                }
+                logLLs[n/2] = -10.0; // at least one finite value
+                
+                // unfused
+                double maxLogLL = *max_element(logLLs.begin(), logLLs.end());
+                vector<double> expected(n);
+                double sum = 0;
+                for(size_t i=0; i<n; i++){
+                    expected[i] = exp(alpha*(logLLs[i] - maxLogLL))*(hasPrior ? priors[i] : 1.0);
+                    sum += expected[i];
+                }
+                double sumSq = 0;
+                for(auto& w: expected){
+                    w /= sum;
+                    sumSq += w*w;
+                }
+                
+                vector<double> weights(n);
+                double essThreshold = 0.5*n;
+                auto stats = ArrayUtils::computeNormalizedWeights(logLLs.data(), hasPrior ? priors.data() : nullptr, n, weights.data(), alpha, essThreshold);
+                XCTAssertEqual(stats.maxLogLikelihood, maxLogLL);
+                XCTAssertEqualWithAccuracy(stats.sumWeights, sum, 1e-12*sum);
+                XCTAssertEqualWithAccuracy(stats.logSumExp, alpha*maxLogLL + log(sum), 1e-12);
+                XCTAssertEqualWithAccuracy(stats.ess, 1.0/sumSq, 1e-9/sumSq);
+                XCTAssertEqual(stats.needsResampling, 1.0/sumSq <= essThreshold);
+                for(size_t i=0; i<n; i++){
+                    XCTAssertEqualWithAccuracy(weights[i], expected[i], 1e-14);
+                }
+                
+                // in place
+                ArrayUtils::computeNormalizedWeights(logLLs.data(), hasPrior ? priors.data() : nullptr, n, logLLs.data(), alpha, essThreshold);
+                XCTAssertTrue(logLLs==weights);
+            }
+        }
+    }
+}
+
+// A filter restored from a snapshot continues exactly like the filter the snapshot was taken from
+- (void)testSnapshotRestoresFilter {
+    for(bool compressesStates: {false, true}){
+        auto original = makeTestFilter(compressesStates);
+        runTestFilter(*original, 0, 55, nullptr);
+        stringstream snapshot;
+        {
+            SnapshotOutputArchive ar(snapshot);
+            original->saveState(ar);
+        }
+        vector<vector<State>> expected;
+        runTestFilter(*original, 55, 95, &expected);
+        
+        // The restored filter has run on different inputs before.
+        auto restored = makeTestFilter(compressesStates);
+        runTestFilter(*restored, 30, 42, nullptr);
+        {
+            SnapshotInputArchive ar(snapshot);
+            restored->loadState(ar);
+        }
+        vector<vector<State>> actual;
+        runTestFilter(*restored, 55, 95, &actual);
+        
+        XCTAssertEqual(actual.size(), expected.size());
+        for(size_t i=0; i<actual.size() && i<expected.size(); i++){
+            XCTAssertTrue(statesAreIdentical(actual[i], expected[i]));
+        }
+    }
+}
+
+// The sequential Kalman updates of the RSSI bias give the marginal likelihood integrated over the bias
+- (void)testMarginalLikelihoodOverRssiBias {
+    GaussianProcessLDPLMultiModel<State, Beacons> model;
+    double stdevRssi = 4.0;
+    model.fillsUnknownBeaconRssi(true).rssiStandardDeviationForUnknownBeacons(stdevRssi);
+    
+    State state;
+    state.rssiBias(2.0);
+    state.rssiBiasVariance(9.0);
+    double ypred = BeaconConfig::minRssi();
+    Beacons beacons;
+    beacons.push_back(Beacon(1, 1, ypred + 6.0));
+    beacons.push_back(Beacon(1, 2, ypred - 1.0));
+    beacons.push_back(Beacon(1, 3, ypred + 3.5));
+    beacons.push_back(Beacon(1, 4, ypred + 9.0));
+    std::map<long, NormalParameter> rssiStats; // all the beacons are unknown to the model
+    std::vector<double> values = model.computeLogLikelihoodRelatedValues(state, beacons, rssiStats);
+    
+    // trapezoidal integration of the likelihood times the prior of the bias
+    double biasMean = state.rssiBias();
+    double biasStdev = std::sqrt(state.rssiBiasVariance());
+    int n = 20000;
+    double lower = biasMean - 12*biasStdev;
+    double step = 24*biasStdev/n;
+    double integral = 0, moment1 = 0, moment2 = 0;
+    for(int i=0; i<=n; i++){
+        double bias = lower + step*i;
+        double logDensity = MathUtils::logProbaNormal(bias, biasMean, biasStdev);
+        for(const auto& b: beacons){
+            logDensity += MathUtils::logProbaNormal(b.rssi(), ypred + bias, stdevRssi);
+        }
+        double density = std::exp(logDensity)*((i==0 || i==n) ? 0.5 : 1.0)*step;
+        integral += density;
+        moment1 += density*bias;
+        moment2 += density*bias*bias;
+    }
+    double posteriorMean = moment1/integral;
+    double posteriorVariance = moment2/integral - posteriorMean*posteriorMean;
+    
+    XCTAssertEqualWithAccuracy(values[0], std::log(integral), 1e-8);
+    XCTAssertEqualWithAccuracy(values[4], posteriorMean, 1e-8);
+    XCTAssertEqualWithAccuracy(values[5], posteriorVariance, 1e-8);
+    
+    // independent of the order of the beacons
+    Beacons reversed;
+    reversed.insert(reversed.end(), beacons.rbegin(), beacons.rend());
+    std::vector<double> valuesReversed = model.computeLogLikelihoodRelatedValues(state, reversed, rssiStats);
+    XCTAssertEqualWithAccuracy(valuesReversed[0], values[0], 1e-10);
+    XCTAssertEqualWithAccuracy(valuesReversed[4], values[4], 1e-10);
+    XCTAssertEqualWithAccuracy(valuesReversed[5], values[5], 1e-10);
+}
+
+// Expanding the compressed states gives back the resampled states and the values of the merged copies
+- (void)testCompressedStatesExpand {
+    RandomGenerator rand(5);
+    vector<State> states(200);
+    vector<int> counts(states.size());
+    for(size_t i=0; i<states.size(); i++){
+        states[i].x(rand.nextGaussian()).y(rand.nextGaussian()).orientation(rand.nextDouble());
+        states[i].rssiBias(rand.nextGaussian()).weight(rand.nextDouble());
+        counts[i] = rand.nextInt(4);
+    }
+    CompressedStates resampled(states, counts);
+    vector<State> expanded = resampled.expand();
+    vector<State> expected;
+    for(size_t i=0; i<states.size(); i++){
+        expected.insert(expected.end(), counts[i], states[i]);
+    }
+    XCTAssertEqual(resampled.size(), expected.size());
+    XCTAssertEqual(accumulate(resampled.multiplicities().begin(), resampled.multiplicities().end(), 0), (int)expected.size());
+    XCTAssertTrue(statesAreIdentical(expanded, expected));
+    
+    // Copies that were moved apart are not merged.
+    expanded[3].x(expanded[3].x() + 1.0);
+    CompressedStates merged(expanded);
+    XCTAssertEqual(merged.size(), expanded.size());
+    XCTAssertTrue(merged.numUnique() < merged.size());
+    vector<double> xsOfUnique;
+    for(const auto& s: merged.uniqueStates()){
+        xsOfUnique.push_back(s.x() + s.rssiBias());
+    }
+    vector<double> xs = merged.expand(xsOfUnique);
+    XCTAssertEqual(xs.size(), expanded.size());
+    for(size_t i=0; i<expanded.size() && i<xs.size(); i++){
+        XCTAssertEqual(xs[i], expanded[i].x() + expanded[i].rssiBias());
+        XCTAssertTrue(CompressedStates::isObservedIdentically(merged.uniqueStates().at(merged.indices().at(i)), expanded[i]));
+    }
+}
+
+// The filter gives the same states with and without state compression
+- (void)testCompressedFilterMatchesUncompressed {
+    auto filter = makeTestFilter(false);
+    auto filterCompressed = makeTestFilter(true);
+    vector<vector<State>> outputs, outputsCompressed;
+    runTestFilter(*filter, 0, 100, &outputs);
+    runTestFilter(*filterCompressed, 0, 100, &outputsCompressed);
+    XCTAssertTrue(0 < filterCompressed->statesCompressionStatistics().savedRatio());
+    XCTAssertEqual(outputs.size(), outputsCompressed.size());
+    for(size_t i=0; i<outputs.size() && i<outputsCompressed.size(); i++){
+        XCTAssertTrue(statesAreIdentical(outputs[i], outputsCompressed[i]));
+    }
+}
+
+// The distance transform is exact on images wider than 4096 pixels, and routes within the clearance do not hit walls
+- (void)testDistanceTransformMatchesBruteForce {
+    RandomGenerator rand(7);
+    int rows = 48;
+    int cols = 5000;
+    ImageHolder::Points walls = makeRandomWalls(rand, rows, cols, 60);
+    OccupancyBitmask mask(rows, cols, walls);
+    vector<double> dist = mask.distanceTransform();
+    XCTAssertEqual(dist.size(), static_cast<size_t>(rows)*cols);
+    auto bruteForce = [&](const ImageHolder::Points& points, int x, int y){
+        double d2 = numeric_limits<double>::infinity();
+        for(const auto& p: points){
+            d2 = min(d2, static_cast<double>(p.x-x)*(p.x-x) + static_cast<double>(p.y-y)*(p.y-y));
+        }
+        return sqrt(d2);
+    };
+    for(int i=0; i<3000; i++){
+        int x = static_cast<int>(rand.nextDouble()*cols);
+        int y = static_cast<int>(rand.nextDouble()*rows);
+        XCTAssertEqual(dist[static_cast<size_t>(y)*cols + x], bruteForce(walls, x, y));
+    }
+    
+    // Squared distances beyond 2^24 are not representable in float.
+    ImageHolder::Points corners = {ImageHolder::Point(0, 0), ImageHolder::Point(8999, 2)};
+    OccupancyBitmask wide(3, 9000, corners);
+    vector<double> distWide = wide.distanceTransform();
+    for(int y=0; y<3; y++){
+        for(int x=0; x<9000; x++){
+            XCTAssertEqual(distWide[static_cast<size_t>(y)*9000 + x], bruteForce(corners, x, y));
+        }
+    }
+    
+    // Same bound as FloorMap::isClearOfWalls on the clearance map
+    int numClear = 0;
+    for(int i=0; i<20000; i++){
+        double x0 = rand.nextDouble()*cols - 0.5;
+        double y0 = rand.nextDouble()*rows - 0.5;
+        int x = static_cast<int>(std::round(x0));
+        int y = static_cast<int>(std::round(y0));
+        if(x<0 || cols<=x || y<0 || rows<=y){
+            continue;
+        }
+        double clearance = min(floor(dist[static_cast<size_t>(y)*cols + x]), 255.0);
+        double length = rand.nextDouble()*clearance;
+        if(!(length + 1.5 < clearance)){
+            continue;
+        }
+        numClear++;
+        double angle = 2.0*M_PI*rand.nextDouble();
+        int n = static_cast<int>(length) + 1;
+        double dx = length*cos(angle)/n;
+        double dy = length*sin(angle)/n;
+        XCTAssertEqual(walkPixels(mask, x0, y0, dx, dy, n), n+1);
+        XCTAssertEqual(mask.castRay(x0, y0, dx, dy, n), n+1);
+    }
+    XCTAssertTrue(1000 < numClear);
+}
+
+// castRay stops at the same sample as the pixel walk on random walls
+- (void)testCastRayMatchesPixelWalk {
+    RandomGenerator rand(3);
+    int rows = 600;
+    int cols = 4500;
+    for(int numSegments: {0, 30, 3000}){
+        OccupancyBitmask mask(rows, cols, makeRandomWalls(rand, rows, cols, numSegments));
+        int numHits = 0;
+        for(int i=0; i<20000; i++){
+            // Starts slightly outside the image and rays up to 1000 pixels
+            double x0 = rand.nextDouble()*(cols+20) - 10;
+            double y0 = rand.nextDouble()*(rows+20) - 10;
+            double length = 1000.0*pow(rand.nextDouble(), 3);
+            double angle = 2.0*M_PI*rand.nextDouble();
+            int n = static_cast<int>(length) + 1;
+            double dx = length*cos(angle)/n;
+            double dy = length*sin(angle)/n;
+            int count = walkPixels(mask, x0, y0, dx, dy, n);
+            XCTAssertEqual(mask.castRay(x0, y0, dx, dy, n), count);
+            if(count<=n){
+                numHits++;
+            }
+        }
+        if(numSegments==0){
+            XCTAssertEqual(numHits, 0);
+        }else{
+            XCTAssertTrue(0 < numHits);
+        }
+    }
+}
+
+// Vertical moves sampled from the transition table follow the distribution of the rejection loops
+- (void)testTransitionTableMatchesRejectionLoops {
+    // Elevators on floors 0, 1 and 3 and stairs on floors 0, 1 and 2
+    std::map<int, FloorMap> floors;
+    for(int f=0; f<4; f++){
+        string path = writeTestFloorImage("transition" + to_string(f) + ".ppm", 8, 8, [f](int y, int x){
+            if(x<=2 && y<=2 && f!=2){
+                return color::yellow;
+            }else if(5<=x && 5<=y && f!=3){
+                return color::blue;
+            }
+            return color::white;
+        });
+        floors.insert(make_pair(f, FloorMap(ImageHolder(path, path), CoordinateSystem(CoordinateSystemParameters()))));
+    }
+    auto building = make_shared<Building>(floors);
+    XCTAssertTrue(building->transitionTable()!=nullptr);
+    auto property = make_shared<SystemModelInBuildingProperty>();
+    property->probabilityUpStair(0.3).probabilityDownStair(0.2).probabilityStayStair(0.5).probabilityStayElevator(0.6);
+    
+    SystemModelInput input;
+    SystemModelInput inputSummary;
+    inputSummary.motionSummary(1.0, 1.0, 0.0, 3);
+    vector<pair<State, SystemModelInput>> cases;
+    for(int f: {0, 1, 3}){
+        State s;
+        s.x(1).y(1).floor(f);
+        cases.push_back(make_pair(s, input));
+        cases.push_back(make_pair(s, inputSummary));
+    }
+    for(int f: {0, 1, 2}){
+        State s;
+        s.x(6).y(6).floor(f);
+        cases.push_back(make_pair(s, input));
+        cases.push_back(make_pair(s, inputSummary));
+    }
+    
+    const int n = 20000;
+    auto floorFrequencies = [&](const State& s, const SystemModelInput& in){
+        SystemModelInBuilding<State, SystemModelInput> model(make_shared<TestStaySystemModel>(), building, property);
+        vector<double> freq(4, 0.0);
+        for(int i=0; i<n; i++){
+            freq.at(static_cast<int>(model.predict(s, in).floor())) += 1.0/n;
+        }
+        return freq;
+    };
+    for(const auto& c: cases){
+        Building::setUsesTransitionTable(true);
+        vector<double> freqTable = floorFrequencies(c.first, c.second);
+        Building::setUsesTransitionTable(false);
+        vector<double> freqLoop = floorFrequencies(c.first, c.second);
+        for(int f=0; f<4; f++){
+            // Five standard errors of the difference of the two frequencies
+            double p = (freqTable[f] + freqLoop[f])/2;
+            XCTAssertLessThanOrEqual(fabs(freqTable[f] - freqLoop[f]), 5.0*sqrt(2.0*p*(1.0-p)/n) + 1e-12);
+        }
+    }
+    Building::setUsesTransitionTable(true);
+}
+
+// Each particle in a prediction pass draws from its own substream, so its noise does not depend on the other particles
+- (void)testPredictionSubstreams {
+    PedometerWalkingState pedometer;
+    OrientationMeterAverage orientationMeter;
+    auto property = make_shared<PoseRandomWalkerProperty>();
+    property->pedometer(&pedometer);
+    property->orientationMeter(&orientationMeter);
+    property->doesUpdateWhenStopping(true);
+    auto stateProperty = make_shared<StateProperty>();
+    stateProperty->diffusionRssiBias(0.5);
+    auto makeWalker = [&](){
+        RandomGenerator::SeedScope scope(42);
+        auto walker = make_shared<PoseRandomWalker>();
+        walker->setProperty(property);
+        walker->setStateProperty(stateProperty);
+        return walker;
+    };
+    vector<State> states(10);
+    for(int i=0; i<10; i++){
+        states[i].x(i).y(-i).normalVelocity(1.0);
+    }
+    SystemModelInput input;
+    input.previousTimestamp(0);
+    input.timestamp(1000);
+    vector<State> predicted = makeWalker()->predict(states, input);
+    // The first particle draws one number less with a marginalized RSSI bias.
+    states[0].rssiBiasVariance(1.0);
+    vector<State> predictedOther = makeWalker()->predict(states, input);
+    for(int i=1; i<10; i++){
+        XCTAssertEqual(predicted[i].x(), predictedOther[i].x());
+        XCTAssertEqual(predicted[i].orientation(), predictedOther[i].orientation());
+        XCTAssertEqual(predicted[i].rssiBias(), predictedOther[i].rssiBias());
+    }
+    XCTAssertTrue(predicted[1].orientation() != predicted[2].orientation());
+    XCTAssertTrue(predicted[1].rssiBias() != 0.0);
+}
+
 @end
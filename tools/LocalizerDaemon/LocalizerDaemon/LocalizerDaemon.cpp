@@ -0,0 +1,471 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <cerrno>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "LocalizerDaemon.hpp"
+#include "LocException.hpp"
+#include "Logger.hpp"
+
+namespace loc{
+    
+    std::ostream& operator<<(std::ostream&os, const LocalizerDaemonStatistics& stats){
+        os << "connections=" << stats.connections
+        << ",sessions=" << stats.sessions
+        << ",frames=" << stats.frames
+        << ",events=" << stats.events
+        << ",results=" << stats.results
+        << ",errors=" << stats.errors
+        << ",bytesReceived=" << stats.bytesReceived
+        << ",bytesSent=" << stats.bytesSent
+        << ",eventsPerSecond=" << stats.eventsPerSecond
+        << ",meanLatencyMS=" << stats.meanLatencyMS
+        << ",maxLatencyMS=" << stats.maxLatencyMS;
+        return os;
+    }
+    
+    static bool readFully(int fd, char* buffer, size_t length){
+        size_t done = 0;
+        while(done < length){
+            ssize_t n = ::recv(fd, buffer + done, length - done, 0);
+            if(n < 0 && errno == EINTR){
+                continue;
+            }
+            if(n <= 0){
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+    
+    static Pose readPose(ProtocolReader& reader){
+        Pose pose;
+        pose.x(reader.f32());
+        pose.y(reader.f32());
+        pose.z(reader.f32());
+        pose.floor(reader.f32());
+        pose.orientation(reader.f32());
+        return pose;
+    }
+    
+    LocalizerDaemon::LocalizerDaemon(SessionEngine::Ptr engine) : mEngine(engine){
+        if(!mEngine){
+            BOOST_THROW_EXCEPTION(LocException("engine is null"));
+        }
+        mEngine->updateHandler([this](SessionEngine::SessionId id, Status* status){
+            sessionUpdated(id, status);
+        });
+    }
+    
+    LocalizerDaemon::~LocalizerDaemon(){
+        stop();
+        reapConnections(true);
+        if(0 <= mListenFd){
+            ::close(mListenFd);
+            ::unlink(mSocketPath.c_str());
+        }
+        mEngine->updateHandler(SessionEngine::UpdateHandler());
+    }
+    
+    LocalizerDaemon& LocalizerDaemon::listen(const std::string& socketPath){
+        struct sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        if(sizeof(addr.sun_path) <= socketPath.size()){
+            BOOST_THROW_EXCEPTION(LocException("socket path is too long: " + socketPath));
+        }
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0){
+            BOOST_THROW_EXCEPTION(LocException(std::string("socket failed: ") + std::strerror(errno)));
+        }
+        ::unlink(socketPath.c_str());
+        if(::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0
+           || ::listen(fd, SOMAXCONN) < 0){
+            std::string message = std::string("cannot listen on ") + socketPath + ": " + std::strerror(errno);
+            ::close(fd);
+            BOOST_THROW_EXCEPTION(LocException(message));
+        }
+        mListenFd = fd;
+        mSocketPath = socketPath;
+        LOC_LOG_INFO(LOCALIZER, "listening on " << socketPath);
+        return *this;
+    }
+    
+    void LocalizerDaemon::run(long statsIntervalMS){
+        if(mListenFd < 0){
+            BOOST_THROW_EXCEPTION(LocException("listen is not called"));
+        }
+        mRunning = true;
+        auto lastStats = std::chrono::steady_clock::now();
+        while(mRunning){
+            struct pollfd pfd;
+            pfd.fd = mListenFd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            int ret = ::poll(&pfd, 1, 200);
+            if(ret < 0 && errno != EINTR){
+                LOC_LOG_WARN(LOCALIZER, "poll failed: " << std::strerror(errno));
+                break;
+            }
+            if(0 < ret && (pfd.revents & POLLIN)){
+                int fd = ::accept(mListenFd, nullptr, nullptr);
+                if(0 <= fd){
+                    auto conn = std::make_shared<Connection>();
+                    conn->fd = fd;
+                    mNumConnections++;
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mConnections.push_back(conn);
+                    conn->thread = std::thread(&LocalizerDaemon::serve, this, conn);
+                }
+            }
+            reapConnections(false);
+            
+            auto now = std::chrono::steady_clock::now();
+            if(0 < statsIntervalMS && statsIntervalMS <= std::chrono::duration_cast<std::chrono::milliseconds>(now - lastStats).count()){
+                LOC_LOG_INFO(LOCALIZER, "LocalizerDaemonStatistics: " << statistics(true));
+                lastStats = now;
+            }
+        }
+        reapConnections(true);
+    }
+    
+    void LocalizerDaemon::stop(){
+        mRunning = false;
+    }
+    
+    void LocalizerDaemon::reapConnections(bool all){
+        std::list<std::shared_ptr<Connection>> done;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for(auto iter = mConnections.begin(); iter != mConnections.end();){
+                if(all){
+                    ::shutdown((*iter)->fd, SHUT_RDWR);
+                }
+                if(all || (*iter)->finished){
+                    done.push_back(*iter);
+                    iter = mConnections.erase(iter);
+                }else{
+                    ++iter;
+                }
+            }
+        }
+        for(auto& conn: done){
+            if(conn->thread.joinable()){
+                conn->thread.join();
+            }
+            ::close(conn->fd);
+        }
+    }
+    
+    void LocalizerDaemon::serve(std::shared_ptr<Connection> conn){
+        std::string payload;
+        char header[LocalizerProtocol::headerLength];
+        while(mRunning){
+            if(!readFully(conn->fd, header, sizeof(header))){
+                break;
+            }
+            ProtocolReader headerReader(header, sizeof(header));
+            uint32_t length = headerReader.u32();
+            if(length == 0 || LocalizerProtocol::maxFrameLength < length){
+                mNumErrors++;
+                writeError(*conn, "invalid frame length: " + std::to_string(length));
+                break;
+            }
+            payload.resize(length);
+            if(!readFully(conn->fd, &payload[0], length)){
+                break;
+            }
+            mBytesReceived += sizeof(header) + length;
+            mNumFrames++;
+            
+            bool continues = true;
+            try{
+                continues = handleFrame(conn, payload);
+            }catch(const std::exception& e){
+                mNumErrors++;
+                LOC_LOG_WARN(LOCALIZER, "session " << conn->sessionId << ": " << e.what());
+                writeError(*conn, e.what());
+            }
+            if(!continues){
+                break;
+            }
+        }
+        closeSession(*conn);
+        conn->finished = true;
+    }
+    
+    bool LocalizerDaemon::handleFrame(const std::shared_ptr<Connection>& conn, const std::string& payload){
+        ProtocolReader reader(payload.data(), payload.size());
+        uint8_t type = reader.u8();
+        switch(type){
+            case LocalizerProtocol::OPEN:
+                openSession(conn, reader);
+                break;
+            case LocalizerProtocol::EVENTS:
+                applyEvents(*conn, reader);
+                break;
+            case LocalizerProtocol::STATS:{
+                ProtocolWriter writer;
+                writeStatistics(writer);
+                send(*conn, writer.data());
+                break;
+            }
+            case LocalizerProtocol::CLOSE:
+                return false;
+            default:
+                BOOST_THROW_EXCEPTION(LocException("unknown message type: " + std::to_string(type)));
+        }
+        return true;
+    }
+    
+    void LocalizerDaemon::openSession(const std::shared_ptr<Connection>& conn, ProtocolReader& reader){
+        if(conn->sessionId != 0){
+            BOOST_THROW_EXCEPTION(LocException("a session is already open on this connection"));
+        }
+        std::string siteId = reader.str();
+        uint8_t flags = reader.u8();
+        SiteContext::Ptr site = mEngine->site(siteId);
+        conn->latLngConverter = site->latLngConverter();
+        conn->streamsPredictions = (flags & LocalizerProtocol::STREAMS_PREDICTIONS) != 0;
+        
+        SessionEngine::SessionId id = mEngine->createSession(siteId);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mSessions[id] = conn;
+        }
+        conn->sessionId = id;
+        
+        ProtocolWriter writer;
+        writer.beginFrame(LocalizerProtocol::OPENED).i64(id).endFrame();
+        send(*conn, writer.data());
+    }
+    
+    void LocalizerDaemon::closeSession(Connection& conn){
+        if(conn.sessionId == 0){
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mSessions.erase(conn.sessionId);
+        }
+        mEngine->destroySession(conn.sessionId);
+        conn.sessionId = 0;
+    }
+    
+    void LocalizerDaemon::applyEvents(Connection& conn, ProtocolReader& reader){
+        if(conn.sessionId == 0){
+            BOOST_THROW_EXCEPTION(LocException("no session is open on this connection"));
+        }
+        auto start = std::chrono::steady_clock::now();
+        SessionEngine::SessionId id = conn.sessionId;
+        {
+            std::lock_guard<std::mutex> lock(conn.mtx);
+            conn.inFrame = true;
+        }
+        std::string error;
+        try{
+            uint16_t count = reader.u16();
+            for(int i=0; i<count; i++){
+                uint8_t type = reader.u8();
+                switch(type){
+                    case LocalizerProtocol::BEACONS:
+                        mEngine->putBeacons(id, reader.beacons());
+                        break;
+                    case LocalizerProtocol::ACCELERATION:
+                        mEngine->putAcceleration(id, reader.acceleration());
+                        break;
+                    case LocalizerProtocol::ATTITUDE:
+                        mEngine->putAttitude(id, reader.attitude());
+                        break;
+                    case LocalizerProtocol::ALTIMETER:
+                        mEngine->putAltimeter(id, reader.altimeter());
+                        break;
+                    case LocalizerProtocol::HEADING:
+                        mEngine->putHeading(id, reader.heading());
+                        break;
+                    case LocalizerProtocol::LOCAL_HEADING:
+                        mEngine->putLocalHeading(id, reader.localHeading());
+                        break;
+                    case LocalizerProtocol::RESET:{
+                        uint8_t resetType = reader.u8();
+                        if(resetType == LocalizerProtocol::RESET_DEFAULT){
+                            mEngine->resetStatus(id);
+                        }else if(resetType == LocalizerProtocol::RESET_POSE){
+                            Pose meanPose = readPose(reader);
+                            Pose stdevPose = readPose(reader);
+                            mEngine->resetStatus(id, meanPose, stdevPose);
+                        }else if(resetType == LocalizerProtocol::RESET_BEACONS){
+                            mEngine->resetStatus(id, reader.beacons());
+                        }else{
+                            BOOST_THROW_EXCEPTION(LocException("unknown reset type: " + std::to_string(resetType)));
+                        }
+                        break;
+                    }
+                    default:
+                        BOOST_THROW_EXCEPTION(LocException("unknown event type: " + std::to_string(type)));
+                }
+                mNumEvents++;
+            }
+        }catch(const std::exception& e){
+            error = e.what();
+        }
+        
+        // The results are written even if a later event of the frame failed.
+        std::string results;
+        {
+            std::lock_guard<std::mutex> lock(conn.mtx);
+            conn.inFrame = false;
+            results = conn.pending.data();
+            conn.pending.clear();
+        }
+        if(!results.empty()){
+            send(conn, results);
+        }
+        double latencyMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        {
+            std::lock_guard<std::mutex> lock(mLatencyMutex);
+            mNumLatencies++;
+            mLatencySumMS += latencyMS;
+            mLatencyMaxMS = std::max(mLatencyMaxMS, latencyMS);
+        }
+        if(!error.empty()){
+            BOOST_THROW_EXCEPTION(LocException(error));
+        }
+    }
+    
+    void LocalizerDaemon::sessionUpdated(SessionEngine::SessionId id, Status* status){
+        Status::Step step = status->step();
+        std::shared_ptr<Connection> conn;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto iter = mSessions.find(id);
+            if(iter == mSessions.end()){
+                return;
+            }
+            conn = iter->second;
+        }
+        if(step == Status::OTHER || (step == Status::PREDICTION && !conn->streamsPredictions)){
+            return;
+        }
+        mNumResults++;
+        std::unique_lock<std::mutex> lock(conn->mtx);
+        if(conn->inFrame){
+            writeLocation(conn->pending, *status, *conn->latLngConverter);
+            return;
+        }
+        lock.unlock();
+        // results of asynchronous sessions arrive outside the frames
+        ProtocolWriter writer;
+        writeLocation(writer, *status, *conn->latLngConverter);
+        send(*conn, writer.data());
+    }
+    
+    void LocalizerDaemon::writeLocation(ProtocolWriter& writer, const Status& status, LatLngConverter& converter){
+        std::shared_ptr<Pose> meanPose = status.meanPose();
+        auto global = converter.localToGlobal(*meanPose);
+        const Location& stdev = status.summary()->standardDeviation();
+        writer.beginFrame(LocalizerProtocol::LOCATION);
+        writer.i64(status.timestamp());
+        writer.u8(status.step()).u8(status.locationStatus()).u8(status.degradations());
+        writer.f64(global.lat()).f64(global.lng());
+        writer.f32(meanPose->x()).f32(meanPose->y()).f32(meanPose->z()).f32(meanPose->floor()).f32(meanPose->orientation());
+        writer.f32(stdev.x()).f32(stdev.y());
+        writer.endFrame();
+    }
+    
+    void LocalizerDaemon::writeStatistics(ProtocolWriter& writer){
+        LocalizerDaemonStatistics stats = statistics();
+        writer.beginFrame(LocalizerProtocol::STATS_REPLY);
+        for(uint64_t value: {stats.connections, stats.sessions, stats.frames, stats.events, stats.results,
+            stats.errors, stats.bytesReceived, stats.bytesSent}){
+            writer.i64(static_cast<int64_t>(value));
+        }
+        writer.f64(stats.eventsPerSecond).f64(stats.meanLatencyMS).f64(stats.maxLatencyMS);
+        writer.endFrame();
+    }
+    
+    void LocalizerDaemon::writeError(Connection& conn, const std::string& message){
+        ProtocolWriter writer;
+        writer.beginFrame(LocalizerProtocol::ERROR).str(message.substr(0, 0xFFFF)).endFrame();
+        send(conn, writer.data());
+    }
+    
+    bool LocalizerDaemon::send(Connection& conn, const std::string& data){
+        std::lock_guard<std::mutex> lock(conn.writeMtx);
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        flags = MSG_NOSIGNAL;
+#endif
+        size_t done = 0;
+        while(done < data.size()){
+            ssize_t n = ::send(conn.fd, data.data() + done, data.size() - done, flags);
+            if(n < 0 && errno == EINTR){
+                continue;
+            }
+            if(n <= 0){
+                return false;
+            }
+            done += n;
+        }
+        mBytesSent += done;
+        return true;
+    }
+    
+    LocalizerDaemonStatistics LocalizerDaemon::statistics(bool resetsRate){
+        LocalizerDaemonStatistics stats;
+        stats.connections = mNumConnections;
+        stats.frames = mNumFrames;
+        stats.events = mNumEvents;
+        stats.results = mNumResults;
+        stats.errors = mNumErrors;
+        stats.bytesReceived = mBytesReceived;
+        stats.bytesSent = mBytesSent;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            stats.sessions = mSessions.size();
+        }
+        std::lock_guard<std::mutex> lock(mLatencyMutex);
+        if(0 < mNumLatencies){
+            stats.meanLatencyMS = mLatencySumMS/mNumLatencies;
+        }
+        stats.maxLatencyMS = mLatencyMaxMS;
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - mRateStart).count();
+        if(0 < seconds){
+            stats.eventsPerSecond = (stats.events - mRateEvents)/seconds;
+        }
+        if(resetsRate){
+            mRateEvents = stats.events;
+            mRateStart = now;
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,134 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef LocalizerDaemon_hpp
+#define LocalizerDaemon_hpp
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <list>
+#include <map>
+#include <chrono>
+#include <iostream>
+
+#include "SessionEngine.hpp"
+#include "LocalizerProtocol.hpp"
+
+namespace loc{
+    
+    class LocalizerDaemonStatistics{
+    public:
+        uint64_t connections = 0; // accepted in total
+        uint64_t sessions = 0; // open
+        uint64_t frames = 0;
+        uint64_t events = 0;
+        uint64_t results = 0;
+        uint64_t errors = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t bytesSent = 0;
+        double eventsPerSecond = 0; // since the previous call of statistics(true)
+        double meanLatencyMS = 0; // from the receipt of an EVENTS frame to the write of its results
+        double maxLatencyMS = 0;
+        
+        friend std::ostream& operator<<(std::ostream&os, const LocalizerDaemonStatistics& stats);
+    };
+    
+    // Serves localization sessions of a SessionEngine over a Unix domain socket with LocalizerProtocol.
+    // Each connection holds one session and is served by its own thread, so the events of a session are applied
+    // in the order they were sent. The results produced while an EVENTS frame is applied are written together.
+    class LocalizerDaemon{
+    public:
+        using Ptr = std::shared_ptr<LocalizerDaemon>;
+        
+        LocalizerDaemon(SessionEngine::Ptr engine);
+        ~LocalizerDaemon();
+        
+        LocalizerDaemon(const LocalizerDaemon&) = delete;
+        LocalizerDaemon& operator=(const LocalizerDaemon&) = delete;
+        
+        // Creates the socket. An existing file at the path is removed.
+        LocalizerDaemon& listen(const std::string& socketPath);
+        // Accepts connections until stop() is called. Statistics are logged every statsIntervalMS if positive.
+        void run(long statsIntervalMS = 0);
+        // Can be called from another thread or a signal handler.
+        void stop();
+        
+        // resetsRate restarts the window of eventsPerSecond
+        LocalizerDaemonStatistics statistics(bool resetsRate = false);
+        
+    private:
+        struct Connection{
+            int fd = -1;
+            SessionEngine::SessionId sessionId = 0;
+            LatLngConverter::Ptr latLngConverter;
+            bool streamsPredictions = false;
+            std::atomic<bool> finished{false};
+            std::thread thread;
+            
+            // results waiting for the end of the frame in process
+            std::mutex mtx;
+            bool inFrame = false;
+            ProtocolWriter pending;
+            std::mutex writeMtx;
+        };
+        
+        SessionEngine::Ptr mEngine;
+        std::string mSocketPath;
+        int mListenFd = -1;
+        std::atomic<bool> mRunning{false};
+        
+        std::mutex mMutex;
+        std::list<std::shared_ptr<Connection>> mConnections;
+        std::map<SessionEngine::SessionId, std::shared_ptr<Connection>> mSessions;
+        
+        std::atomic<uint64_t> mNumConnections{0};
+        std::atomic<uint64_t> mNumFrames{0};
+        std::atomic<uint64_t> mNumEvents{0};
+        std::atomic<uint64_t> mNumResults{0};
+        std::atomic<uint64_t> mNumErrors{0};
+        std::atomic<uint64_t> mBytesReceived{0};
+        std::atomic<uint64_t> mBytesSent{0};
+        std::mutex mLatencyMutex;
+        uint64_t mNumLatencies = 0;
+        double mLatencySumMS = 0;
+        double mLatencyMaxMS = 0;
+        uint64_t mRateEvents = 0;
+        std::chrono::steady_clock::time_point mRateStart = std::chrono::steady_clock::now();
+        
+        void serve(std::shared_ptr<Connection> conn);
+        bool handleFrame(const std::shared_ptr<Connection>& conn, const std::string& payload);
+        void applyEvents(Connection& conn, ProtocolReader& reader);
+        void openSession(const std::shared_ptr<Connection>& conn, ProtocolReader& reader);
+        void closeSession(Connection& conn);
+        void sessionUpdated(SessionEngine::SessionId id, Status* status);
+        void writeLocation(ProtocolWriter& writer, const Status& status, LatLngConverter& converter);
+        void writeStatistics(ProtocolWriter& writer);
+        void writeError(Connection& conn, const std::string& message);
+        bool send(Connection& conn, const std::string& data);
+        void reapConnections(bool all);
+    };
+}
+
+#endif /* LocalizerDaemon_hpp */
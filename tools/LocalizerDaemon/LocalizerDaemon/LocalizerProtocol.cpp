@@ -0,0 +1,303 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <cstring>
+#include "LocalizerProtocol.hpp"
+#include "LocException.hpp"
+
+namespace loc{
+    
+    const uint32_t LocalizerProtocol::maxFrameLength;
+    const size_t LocalizerProtocol::headerLength;
+    
+    // ProtocolWriter
+    
+    ProtocolWriter& ProtocolWriter::beginFrame(LocalizerProtocol::MessageType type){
+        if(inFrame_){
+            BOOST_THROW_EXCEPTION(LocException("the previous frame is not ended"));
+        }
+        inFrame_ = true;
+        frameStart_ = buffer_.size();
+        u32(0); // length is filled by endFrame
+        return u8(static_cast<uint8_t>(type));
+    }
+    
+    ProtocolWriter& ProtocolWriter::endFrame(){
+        if(!inFrame_){
+            BOOST_THROW_EXCEPTION(LocException("no frame is begun"));
+        }
+        size_t length = buffer_.size() - frameStart_ - LocalizerProtocol::headerLength;
+        if(LocalizerProtocol::maxFrameLength < length){
+            BOOST_THROW_EXCEPTION(LocException("frame length exceeds maxFrameLength"));
+        }
+        for(int i=0; i<4; i++){
+            buffer_[frameStart_+i] = static_cast<char>((length >> (8*i)) & 0xFF);
+        }
+        inFrame_ = false;
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::u8(uint8_t value){
+        buffer_.push_back(static_cast<char>(value));
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::u16(uint16_t value){
+        u8(value & 0xFF);
+        return u8(value >> 8);
+    }
+    
+    ProtocolWriter& ProtocolWriter::u32(uint32_t value){
+        u16(value & 0xFFFF);
+        return u16(value >> 16);
+    }
+    
+    ProtocolWriter& ProtocolWriter::i64(int64_t value){
+        uint64_t v = static_cast<uint64_t>(value);
+        u32(v & 0xFFFFFFFF);
+        return u32(v >> 32);
+    }
+    
+    ProtocolWriter& ProtocolWriter::f32(float value){
+        uint32_t v;
+        std::memcpy(&v, &value, sizeof(v));
+        return u32(v);
+    }
+    
+    ProtocolWriter& ProtocolWriter::f64(double value){
+        uint64_t v;
+        std::memcpy(&v, &value, sizeof(v));
+        return i64(static_cast<int64_t>(v));
+    }
+    
+    ProtocolWriter& ProtocolWriter::str(const std::string& value){
+        if(0xFFFF < value.size()){
+            BOOST_THROW_EXCEPTION(LocException("string is too long"));
+        }
+        u16(static_cast<uint16_t>(value.size()));
+        buffer_.append(value);
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::beaconsBody(const Beacons& beacons){
+        if(0xFFFF < beacons.size()){
+            BOOST_THROW_EXCEPTION(LocException("too many beacons"));
+        }
+        i64(beacons.timestamp());
+        u16(static_cast<uint16_t>(beacons.size()));
+        for(const Beacon& b: beacons){
+            u16(static_cast<uint16_t>(b.major()));
+            u16(static_cast<uint16_t>(b.minor()));
+            f32(static_cast<float>(b.rssi()));
+        }
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::beacons(const Beacons& beacons){
+        u8(LocalizerProtocol::BEACONS);
+        return beaconsBody(beacons);
+    }
+    
+    ProtocolWriter& ProtocolWriter::acceleration(const Acceleration& acc){
+        u8(LocalizerProtocol::ACCELERATION);
+        i64(acc.timestamp());
+        f32(acc.ax()).f32(acc.ay()).f32(acc.az());
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::attitude(const Attitude& att){
+        u8(LocalizerProtocol::ATTITUDE);
+        i64(att.timestamp());
+        f32(att.pitch()).f32(att.roll()).f32(att.yaw());
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::altimeter(const Altimeter& alt){
+        u8(LocalizerProtocol::ALTIMETER);
+        i64(alt.timestamp());
+        f32(alt.relativeAltitude()).f32(alt.pressure());
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::heading(const Heading& heading){
+        u8(LocalizerProtocol::HEADING);
+        i64(heading.timestamp());
+        f32(heading.magneticHeading()).f32(heading.trueHeading()).f32(heading.headingAccuracy());
+        f32(heading.x()).f32(heading.y()).f32(heading.z());
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::localHeading(const LocalHeading& heading){
+        u8(LocalizerProtocol::LOCAL_HEADING);
+        i64(heading.timestamp());
+        f32(heading.orientation()).f32(heading.orientationDeviation());
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::reset(){
+        u8(LocalizerProtocol::RESET);
+        return u8(LocalizerProtocol::RESET_DEFAULT);
+    }
+    
+    ProtocolWriter& ProtocolWriter::reset(const Pose& meanPose, const Pose& stdevPose){
+        u8(LocalizerProtocol::RESET);
+        u8(LocalizerProtocol::RESET_POSE);
+        for(const Pose* pose: {&meanPose, &stdevPose}){
+            f32(pose->x()).f32(pose->y()).f32(pose->z()).f32(pose->floor()).f32(pose->orientation());
+        }
+        return *this;
+    }
+    
+    ProtocolWriter& ProtocolWriter::reset(const Beacons& beacons){
+        u8(LocalizerProtocol::RESET);
+        u8(LocalizerProtocol::RESET_BEACONS);
+        return beaconsBody(beacons);
+    }
+    
+    const std::string& ProtocolWriter::data() const{
+        return buffer_;
+    }
+    
+    bool ProtocolWriter::empty() const{
+        return buffer_.empty();
+    }
+    
+    void ProtocolWriter::clear(){
+        buffer_.clear();
+        frameStart_ = 0;
+        inFrame_ = false;
+    }
+    
+    // ProtocolReader
+    
+    ProtocolReader::ProtocolReader(const char* data, size_t length)
+    : data_(reinterpret_cast<const unsigned char*>(data)), length_(length){ }
+    
+    const unsigned char* ProtocolReader::take(size_t n){
+        if(length_ < position_ + n){
+            BOOST_THROW_EXCEPTION(LocException("frame is truncated"));
+        }
+        const unsigned char* p = data_ + position_;
+        position_ += n;
+        return p;
+    }
+    
+    uint8_t ProtocolReader::u8(){
+        return *take(1);
+    }
+    
+    uint16_t ProtocolReader::u16(){
+        const unsigned char* p = take(2);
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+    
+    uint32_t ProtocolReader::u32(){
+        const unsigned char* p = take(4);
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+        | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+    
+    int64_t ProtocolReader::i64(){
+        uint64_t lo = u32();
+        uint64_t hi = u32();
+        return static_cast<int64_t>(lo | (hi << 32));
+    }
+    
+    float ProtocolReader::f32(){
+        uint32_t v = u32();
+        float value;
+        std::memcpy(&value, &v, sizeof(value));
+        return value;
+    }
+    
+    double ProtocolReader::f64(){
+        uint64_t v = static_cast<uint64_t>(i64());
+        double value;
+        std::memcpy(&value, &v, sizeof(value));
+        return value;
+    }
+    
+    std::string ProtocolReader::str(){
+        uint16_t n = u16();
+        const unsigned char* p = take(n);
+        return std::string(reinterpret_cast<const char*>(p), n);
+    }
+    
+    Beacons ProtocolReader::beacons(){
+        Beacons beacons;
+        beacons.timestamp(i64());
+        uint16_t n = u16();
+        beacons.reserve(n);
+        for(int i=0; i<n; i++){
+            int major = u16();
+            int minor = u16();
+            double rssi = f32();
+            beacons.push_back(Beacon(major, minor, rssi));
+        }
+        return beacons;
+    }
+    
+    Acceleration ProtocolReader::acceleration(){
+        long timestamp = i64();
+        double ax = f32();
+        double ay = f32();
+        double az = f32();
+        return Acceleration(timestamp, ax, ay, az);
+    }
+    
+    Attitude ProtocolReader::attitude(){
+        long timestamp = i64();
+        double pitch = f32();
+        double roll = f32();
+        double yaw = f32();
+        return Attitude(timestamp, pitch, roll, yaw);
+    }
+    
+    Altimeter ProtocolReader::altimeter(){
+        long timestamp = i64();
+        double relativeAltitude = f32();
+        double pressure = f32();
+        return Altimeter(timestamp, relativeAltitude, pressure);
+    }
+    
+    Heading ProtocolReader::heading(){
+        long timestamp = i64();
+        double magneticHeading = f32();
+        double trueHeading = f32();
+        double headingAccuracy = f32();
+        double x = f32();
+        double y = f32();
+        double z = f32();
+        return Heading(timestamp, magneticHeading, trueHeading, headingAccuracy, x, y, z);
+    }
+    
+    LocalHeading ProtocolReader::localHeading(){
+        long timestamp = i64();
+        double orientation = f32();
+        double orientationDeviation = f32();
+        return LocalHeading(timestamp, orientation, orientationDeviation);
+    }
+    
+    bool ProtocolReader::atEnd() const{
+        return position_==length_;
+    }
+}
@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef LocalizerProtocol_hpp
+#define LocalizerProtocol_hpp
+
+#include <cstdint>
+#include <string>
+
+#include "Beacon.hpp"
+#include "Acceleration.hpp"
+#include "Attitude.hpp"
+#include "Heading.hpp"
+#include "Altimeter.hpp"
+#include "Pose.hpp"
+
+namespace loc{
+    
+    // Binary protocol of LocalizerDaemon.
+    //
+    // A frame is a little-endian uint32 payload length followed by the payload. The payload starts with
+    // a uint8 message type. Strings are a uint16 length followed by the bytes. Timestamps are int64 [ms].
+    //
+    // client -> daemon
+    //  OPEN    : string siteId, uint8 flags                  opens the session of the connection
+    //  EVENTS  : uint16 count, count x (uint8 eventType, body) events applied in order
+    //  STATS   : (empty)
+    //  CLOSE   : (empty)
+    //
+    // daemon -> client
+    //  OPENED   : int64 sessionId
+    //  LOCATION : int64 timestamp, uint8 step, uint8 locationStatus, uint8 degradations,
+    //             float64 lat, float64 lng, float32 x, y, z, floor, orientation, stdevX, stdevY
+    //  STATS    : int64 connections, sessions, frames, events, results, errors, bytesReceived, bytesSent,
+    //             float64 eventsPerSecond, meanLatencyMS, maxLatencyMS (see LocalizerDaemonStatistics)
+    //  ERROR    : string message
+    //
+    // event bodies
+    //  BEACONS       : int64 timestamp, uint16 n, n x (uint16 major, uint16 minor, float32 rssi)
+    //  ACCELERATION  : int64 timestamp, float32 ax, ay, az
+    //  ATTITUDE      : int64 timestamp, float32 pitch, roll, yaw
+    //  ALTIMETER     : int64 timestamp, float32 relativeAltitude, pressure
+    //  HEADING       : int64 timestamp, float32 magneticHeading, trueHeading, headingAccuracy, x, y, z
+    //  LOCAL_HEADING : int64 timestamp, float32 orientation, orientationDeviation
+    //  RESET         : uint8 resetType, then nothing (RESET_DEFAULT),
+    //                  float32 x, y, z, floor, orientation and their standard deviations (RESET_POSE)
+    //                  or a BEACONS body (RESET_BEACONS)
+    class LocalizerProtocol{
+    public:
+        enum MessageType{
+            OPEN = 0x01,
+            EVENTS = 0x02,
+            STATS = 0x03,
+            CLOSE = 0x04,
+            OPENED = 0x81,
+            LOCATION = 0x82,
+            STATS_REPLY = 0x83,
+            ERROR = 0x8F
+        };
+        
+        enum EventType{
+            BEACONS = 1,
+            ACCELERATION = 2,
+            ATTITUDE = 3,
+            ALTIMETER = 4,
+            HEADING = 5,
+            LOCAL_HEADING = 6,
+            RESET = 7
+        };
+        
+        enum ResetType{
+            RESET_DEFAULT = 0,
+            RESET_POSE = 1,
+            RESET_BEACONS = 2
+        };
+        
+        // flags of OPEN
+        enum OpenFlag{
+            STREAMS_PREDICTIONS = 1 // also send the results of the predictions by the motion sensors
+        };
+        
+        static const uint32_t maxFrameLength = 1 << 20;
+        static const size_t headerLength = 4;
+    };
+    
+    // Builds frames in a buffer. Several frames can be written before the buffer is sent.
+    class ProtocolWriter{
+    public:
+        ProtocolWriter& beginFrame(LocalizerProtocol::MessageType type);
+        ProtocolWriter& endFrame();
+        
+        ProtocolWriter& u8(uint8_t);
+        ProtocolWriter& u16(uint16_t);
+        ProtocolWriter& u32(uint32_t);
+        ProtocolWriter& i64(int64_t);
+        ProtocolWriter& f32(float);
+        ProtocolWriter& f64(double);
+        ProtocolWriter& str(const std::string&);
+        
+        // event bodies including the event type
+        ProtocolWriter& beacons(const Beacons&);
+        ProtocolWriter& acceleration(const Acceleration&);
+        ProtocolWriter& attitude(const Attitude&);
+        ProtocolWriter& altimeter(const Altimeter&);
+        ProtocolWriter& heading(const Heading&);
+        ProtocolWriter& localHeading(const LocalHeading&);
+        ProtocolWriter& reset();
+        ProtocolWriter& reset(const Pose& meanPose, const Pose& stdevPose);
+        ProtocolWriter& reset(const Beacons&);
+        
+        const std::string& data() const;
+        bool empty() const;
+        void clear();
+        
+    private:
+        std::string buffer_;
+        size_t frameStart_ = 0;
+        bool inFrame_ = false;
+        
+        ProtocolWriter& beaconsBody(const Beacons&);
+    };
+    
+    // Reads the payload of a frame. Throws LocException when the payload is shorter than expected.
+    class ProtocolReader{
+    public:
+        ProtocolReader(const char* data, size_t length);
+        
+        uint8_t u8();
+        uint16_t u16();
+        uint32_t u32();
+        int64_t i64();
+        float f32();
+        double f64();
+        std::string str();
+        
+        // event bodies after the event type
+        Beacons beacons();
+        Acceleration acceleration();
+        Attitude attitude();
+        Altimeter altimeter();
+        Heading heading();
+        LocalHeading localHeading();
+        
+        bool atEnd() const;
+        
+    private:
+        const unsigned char* data_;
+        size_t length_;
+        size_t position_ = 0;
+        
+        const unsigned char* take(size_t n);
+    };
+}
+
+#endif /* LocalizerProtocol_hpp */
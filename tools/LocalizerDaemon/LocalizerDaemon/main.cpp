@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <csignal>
+#include <cstring>
+#include <getopt.h>
+
+#include "LocalizerDaemon.hpp"
+#include "Logger.hpp"
+
+using namespace loc;
+
+struct Option{
+    std::string socketPath = "/tmp/bleloc.sock";
+    std::string workingDir = "./";
+    std::string localizerJSONPath = "";
+    std::vector<std::pair<std::string, std::string>> sites; // site id and model path
+    bool batchesLikelihoods = false;
+    long statsIntervalMS = 60000;
+    std::string logSpec = "";
+};
+
+void printHelp(){
+    std::cout << "Serve localization sessions over a Unix domain socket" << std::endl;
+    std::cout << " -h                  show this help" << std::endl;
+    std::cout << " -s socketPath       set socket path (default: /tmp/bleloc.sock)" << std::endl;
+    std::cout << " --site id=mapfile   load a site at startup (can be repeated)" << std::endl;
+    std::cout << " --lj                set localizer config json used for all sites" << std::endl;
+    std::cout << " -w directory        set working directory for the models (default: ./)" << std::endl;
+    std::cout << " --batch             evaluate likelihoods of the sessions on the same site in batches" << std::endl;
+    std::cout << " --stats <seconds>   set interval of statistics logging (0 to disable, default: 60)" << std::endl;
+    std::cout << " --log <spec>        set log levels (e.g. info,filter=debug)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Example" << std::endl;
+    std::cout << "$ LocalizerDaemon -s /tmp/bleloc.sock --site bldg1=map1.json --site bldg2=map2.json" << std::endl;
+}
+
+Option parseArguments(int argc, char *argv[]){
+    Option opt;
+    
+    int c = 0;
+    int option_index = 0;
+    struct option long_options[] = {
+        {"site",    required_argument, NULL, 0},
+        {"lj",      required_argument, NULL, 0},
+        {"batch",   no_argument, NULL, 0},
+        {"stats",   required_argument, NULL, 0},
+        {"log",     required_argument, NULL, 0},
+        {0,         0,                 0,  0 }
+    };
+    
+    while ((c = getopt_long(argc, argv, "hs:w:", long_options, &option_index )) != -1)
+        switch (c)
+    {
+        case 0:
+            if (strcmp(long_options[option_index].name, "site") == 0){
+                std::string str(optarg);
+                size_t pos = str.find('=');
+                if(pos==std::string::npos || pos==0){
+                    std::cerr << "Site must be given as id=mapfile: " << optarg << std::endl;
+                    abort();
+                }
+                opt.sites.push_back(std::make_pair(str.substr(0, pos), str.substr(pos+1)));
+            }
+            if (strcmp(long_options[option_index].name, "lj") == 0){
+                opt.localizerJSONPath.assign(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "batch") == 0){
+                opt.batchesLikelihoods = true;
+            }
+            if (strcmp(long_options[option_index].name, "stats") == 0){
+                opt.statsIntervalMS = static_cast<long>(atof(optarg)*1000);
+            }
+            if (strcmp(long_options[option_index].name, "log") == 0){
+                opt.logSpec.assign(optarg);
+            }
+            break;
+        case 'h':
+            printHelp();
+            exit(0);
+        case 's':
+            opt.socketPath.assign(optarg);
+            break;
+        case 'w':
+            opt.workingDir.assign(optarg);
+            break;
+        default:
+            abort();
+    }
+    return opt;
+}
+
+static LocalizerDaemon* daemonToStop = nullptr;
+
+void stopDaemon(int signum){
+    if(daemonToStop){
+        daemonToStop->stop();
+    }
+}
+
+int main(int argc, char * argv[]) {
+    Option opt = parseArguments(argc, argv);
+    if(opt.sites.size()==0){
+        printHelp();
+        return 0;
+    }
+    if(opt.logSpec!=""){
+        Logger::configure(opt.logSpec);
+    }
+    
+    BasicLocalizerParameters params;
+    if(opt.localizerJSONPath!=""){
+        std::ifstream ifs(opt.localizerJSONPath);
+        if(!ifs.is_open()){
+            std::cerr << "localizer config json is unable to read: " << opt.localizerJSONPath << std::endl;
+            return -1;
+        }
+        cereal::JSONInputArchive iarchive(ifs);
+        iarchive(params);
+    }
+    
+    auto engine = std::make_shared<SessionEngine>();
+    engine->batchesLikelihoods(opt.batchesLikelihoods);
+    for(const auto& site: opt.sites){
+        std::cout << "loading site " << site.first << " from " << site.second << std::endl;
+        engine->loadSite(site.first, site.second, opt.workingDir, params);
+    }
+    
+    LocalizerDaemon daemon(engine);
+    daemon.listen(opt.socketPath);
+    
+    daemonToStop = &daemon;
+    std::signal(SIGINT, stopDaemon);
+    std::signal(SIGTERM, stopDaemon);
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    daemon.run(opt.statsIntervalMS);
+    
+    daemonToStop = nullptr;
+    std::cout << "LocalizerDaemonStatistics: " << daemon.statistics() << std::endl;
+    Logger::flush();
+    return 0;
+}
@@ -31,6 +31,7 @@
 #include <boost/program_options.hpp>
 #include "NavCogLogPlayer.hpp"
 #include "DataLogger.hpp"
+#include "ParticleTraceRecorder.hpp"
 #include "ExtendedDataUtils.hpp"
 #include "StreamParticleFilterBuilder.hpp"
 
@@ -115,7 +116,7 @@ void printHelp(std::string command){
     std::cout << " -p modelFile         set the name of saved model file" << std::endl;
     std::cout << " -n                   set oneshot mode" << std::endl;
     std::cout << " -c                   consider bias for oneshot" << std::endl;
-    std::cout << " -d                   set directory to output log play details" <<std::endl;
+    std::cout << " -d                   set directory to output log play details (particles are traced to particles.trace)" <<std::endl;
     std::cout << " -g                   set grid size to evaluate observation model" << std::endl;
     std::cout << " --minRssiBias        set minimum value of rssi bias" << std::endl;
     std::cout << " --maxRssiBias        set maximum value of rssi bias" << std::endl;
@@ -351,6 +352,7 @@ int main(int argc,char *argv[]){
     
     if(opt.directoryLog!=""){
         DataLogger::createInstance(opt.directoryLog);
+        ParticleTraceRecorder::createInstance(opt.directoryLog + "/particles.trace");
     }
     // Predict rssis at grid positions generated from sampling ploints.
     if(opt.directoryLog!=""){
@@ -443,6 +445,11 @@ int main(int argc,char *argv[]){
         logPlayer.run();
     }
     
+    if(ParticleTraceRecorder::getInstance()){
+        std::cout << "particle trace: " << ParticleTraceRecorder::getInstance()->statistics() << std::endl;
+        ParticleTraceRecorder::destroyInstance();
+    }
+    
     if(opt.outputFilePath!=""){
         std::ofstream ofs(opt.outputFilePath);
         ofs << "timestamp," << Pose::header() << std::endl;
@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <getopt.h>
+#include "DataUtils.hpp"
+#include "ParticleTraceRecorder.hpp"
+
+using namespace loc;
+
+struct Option{
+    std::string tracePath;
+    std::string directory = ".";
+    bool writesMetadata = false;
+};
+
+std::string lastComponent(char *cstr) {
+    std::string str(cstr);
+    std::size_t found = str.find_last_of("/");
+    return str.substr(found+1);
+}
+
+void printHelp(std::string command){
+    std::cout << "Convert a particle trace file to per-frame csv files." << std::endl;
+    std::cout << " -h                   show this help" << std::endl;
+    std::cout << " -i traceFile         set particle trace file (particles.trace)" << std::endl;
+    std::cout << " -o directory         set output directory (default: current directory)" << std::endl;
+    std::cout << " -m                   also write metadata of all frames to trace_metadata.csv" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Example" << std::endl;
+    std::cout << "$ " << command << " -i particles.trace -o states" << std::endl;
+    std::cout << std::endl;
+}
+
+Option parseArguments(int argc, char *argv[]){
+    Option opt;
+    int c = 0;
+    while ((c = getopt(argc, argv, "hi:o:m")) != -1)
+        switch (c)
+    {
+        case 'h':
+            printHelp(lastComponent(argv[0]));
+            abort();
+        case 'i':
+            opt.tracePath.assign(optarg);
+            break;
+        case 'o':
+            opt.directory.assign(optarg);
+            break;
+        case 'm':
+            opt.writesMetadata = true;
+            break;
+        default:
+            abort();
+    }
+    return opt;
+}
+
+int main(int argc, char * argv[]){
+    if (argc <= 1) {
+        printHelp(lastComponent(argv[0]));
+        return 0;
+    }
+    
+    Option opt = parseArguments(argc, argv);
+    std::cout << "trace=" << opt.tracePath << std::endl;
+    std::cout << "directory=" << opt.directory << std::endl;
+    
+    std::ofstream ofsMeta;
+    if(opt.writesMetadata){
+        ofsMeta.open(opt.directory + "/trace_metadata.csv");
+        ofsMeta << "timestamp,stage,step,degradations,ess,nStates" << std::endl;
+    }
+    
+    ParticleTraceReader reader(opt.tracePath);
+    ParticleTraceRecord record;
+    long count = 0;
+    while(reader.next(record)){
+        // Same layout as the csv files written by DataLogger
+        std::ofstream ofs(opt.directory + "/" + record.csvFileName());
+        ofs << DataUtils::statesToCSV(record.states) << std::endl;
+        if(ofsMeta.is_open()){
+            ofsMeta << record.timestamp << "," << ParticleTraceRecord::stageToString(record.stage)
+            << "," << record.step << "," << record.degradations << "," << record.ess
+            << "," << record.states.size() << std::endl;
+        }
+        count++;
+    }
+    std::cout << count << " frames were converted." << std::endl;
+    
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <getopt.h>
+
+#include "SiteContext.hpp"
+#include "Pose.hpp"
+
+using namespace loc;
+
+struct Option{
+    std::string mapPath = "";
+    std::string workingDir = "./";
+    std::string localizerJSONPath = "";
+    std::string outputPath = "";
+    long samples = 100000;
+    double stepLength = 1.0;
+    unsigned long seed = 0;
+};
+
+void printHelp(){
+    std::cout << "Compare wall angles from the precomputed wall tangent field with the ray sweep" << std::endl;
+    std::cout << " -h                  show this help" << std::endl;
+    std::cout << " -m mapfile          set map data file" << std::endl;
+    std::cout << " -w directory        set working directory for the model (default: ./)" << std::endl;
+    std::cout << " --lj                set localizer config json" << std::endl;
+    std::cout << " -n samples          set number of random wall-crossing steps (default: 100000)" << std::endl;
+    std::cout << " -l length           set step length in meters (default: 1.0)" << std::endl;
+    std::cout << " -s seed             set random seed (default: 0)" << std::endl;
+    std::cout << " -o file             write per-step results to a csv file" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Example" << std::endl;
+    std::cout << "$ WallAngleValidator -m map.json -n 10000 -o wallangle.csv" << std::endl;
+}
+
+Option parseArguments(int argc, char *argv[]){
+    Option opt;
+    
+    int c = 0;
+    int option_index = 0;
+    struct option long_options[] = {
+        {"lj",      required_argument, NULL, 0},
+        {0,         0,                 0,  0 }
+    };
+    
+    while ((c = getopt_long(argc, argv, "hm:w:n:l:s:o:", long_options, &option_index )) != -1)
+        switch (c)
+    {
+        case 0:
+            if (strcmp(long_options[option_index].name, "lj") == 0){
+                opt.localizerJSONPath.assign(optarg);
+            }
+            break;
+        case 'h':
+            printHelp();
+            exit(0);
+        case 'm':
+            opt.mapPath.assign(optarg);
+            break;
+        case 'w':
+            opt.workingDir.assign(optarg);
+            break;
+        case 'n':
+            opt.samples = atol(optarg);
+            break;
+        case 'l':
+            opt.stepLength = atof(optarg);
+            break;
+        case 's':
+            opt.seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            opt.outputPath.assign(optarg);
+            break;
+        default:
+            printHelp();
+            abort();
+    }
+    return opt;
+}
+
+double percentile(std::vector<double> values, double q){
+    if(values.size()==0){
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    size_t k = std::min(values.size()-1, static_cast<size_t>(q*values.size()));
+    std::nth_element(values.begin(), values.begin()+k, values.end());
+    return values[k];
+}
+
+int main(int argc, char * argv[]){
+    Option opt = parseArguments(argc, argv);
+    if(opt.mapPath==""){
+        printHelp();
+        return -1;
+    }
+    
+    BasicLocalizerParameters params;
+    if(opt.localizerJSONPath!=""){
+        std::ifstream ifs(opt.localizerJSONPath);
+        if(!ifs.is_open()){
+            std::cerr << "localizer config json is unable to read: " << opt.localizerJSONPath << std::endl;
+            return -1;
+        }
+        cereal::JSONInputArchive iarchive(ifs);
+        iarchive(params);
+    }
+    
+    SiteContext::Ptr site = SiteContext::load(opt.mapPath, opt.workingDir, params);
+    Building::Ptr building = site->building();
+    
+    std::vector<int> floors;
+    for(int f=building->minFloor(); f<=building->maxFloor(); f++){
+        if(building->isValidFloor(f)){
+            floors.push_back(f);
+        }
+    }
+    
+    std::ofstream ofs;
+    if(opt.outputPath!=""){
+        ofs.open(opt.outputPath);
+        ofs << "floor,x0,y0,x1,y1,sweep,field,difference" << std::endl;
+    }
+    
+    std::mt19937 engine(static_cast<unsigned int>(opt.seed));
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    
+    std::vector<double> differences;
+    long crossings = 0;
+    long noField = 0;
+    long noSweep = 0;
+    long trials = 0;
+    double sweepSeconds = 0;
+    double fieldSeconds = 0;
+    
+    while(crossings < opt.samples && trials < 100*opt.samples){
+        trials++;
+        int f = floors.at(static_cast<size_t>(uniform(engine)*floors.size()) % floors.size());
+        const FloorMap& floorMap = building->getFloorAt(f);
+        Location lb = floorMap.lowerBound();
+        Location ub = floorMap.upperBound();
+        Location start(lb.x() + uniform(engine)*(ub.x()-lb.x()), lb.y() + uniform(engine)*(ub.y()-lb.y()), 0, f);
+        if(!floorMap.isMovable(start)){
+            continue;
+        }
+        double a = 2.0*M_PI*uniform(engine);
+        Location end(start);
+        end.x(start.x() + opt.stepLength*std::cos(a));
+        end.y(start.y() + opt.stepLength*std::sin(a));
+        if(!floorMap.checkCrossingWall(start, end)){
+            continue;
+        }
+        crossings++;
+        
+        auto t0 = std::chrono::steady_clock::now();
+        double sweep = floorMap.sweepWallAngle(start, end);
+        auto t1 = std::chrono::steady_clock::now();
+        double field = floorMap.lookUpWallAngle(start, end);
+        auto t2 = std::chrono::steady_clock::now();
+        sweepSeconds += std::chrono::duration<double>(t1-t0).count();
+        fieldSeconds += std::chrono::duration<double>(t2-t1).count();
+        
+        double diff = std::numeric_limits<double>::quiet_NaN();
+        if(std::isnan(sweep)){
+            noSweep++;
+        }
+        if(std::isnan(field)){
+            noField++;
+        }
+        if(!std::isnan(sweep) && !std::isnan(field)){
+            diff = std::abs(Pose::computeOrientationDifference(sweep, field))/M_PI*180.0;
+            differences.push_back(diff);
+        }
+        if(ofs.is_open()){
+            ofs << f << "," << start.x() << "," << start.y() << "," << end.x() << "," << end.y()
+            << "," << sweep << "," << field << "," << diff << std::endl;
+        }
+    }
+    
+    double mean = 0;
+    for(double d: differences){
+        mean += d;
+    }
+    mean = differences.size()>0 ? mean/differences.size() : std::numeric_limits<double>::quiet_NaN();
+    
+    std::cout << "crossings=" << crossings << " (trials=" << trials << ")" << std::endl;
+    std::cout << "noField=" << noField << ",noSweep=" << noSweep << std::endl;
+    std::cout << "difference[deg]: mean=" << mean
+    << ",median=" << percentile(differences, 0.5)
+    << ",p90=" << percentile(differences, 0.9)
+    << ",p99=" << percentile(differences, 0.99)
+    << ",max=" << percentile(differences, 1.0) << std::endl;
+    if(0<crossings){
+        std::cout << "time per query[us]: sweep=" << sweepSeconds/crossings*1e6
+        << ",field=" << fieldSeconds/crossings*1e6 << std::endl;
+    }
+    
+    return 0;
+}